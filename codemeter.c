@@ -8,7 +8,9 @@ Module Name:
     
 Abstract:
 
-    This module implements CodeMeter, a program for counting lines of code.
+    This module implements the engine of CodeMeter, a program for counting
+    lines of code, behind the interface declared in codemeter.h. The program
+    itself is implemented in main.c.
 
     Throughout the code, the term "revision" refers to the entire process, which
     includes scanning files, counting the number of files, and calculating the
@@ -25,9 +27,16 @@ Abstract:
 //
 
 #include <assert.h>
+#include <limits.h>
 #include <malloc.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#ifdef _WIN32
 
 #ifndef UNICODE
 #define UNICODE
@@ -36,6 +45,471 @@ Abstract:
 #define WIN32_LEAN_AND_MEAN
 
 #include <Windows.h>
+#include <winternl.h>
+
+#else
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#include <locale.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#define REVISION_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <immintrin.h>
+
+#endif
+
+#include "codemeter.h"
+
+//
+// ------------------------------------------------------- Platform Definitions
+//
+
+/*
+ * Directory and file names are kept in the native encoding of the file
+ * system: unicode on Windows, multibyte elsewhere. Files are read through
+ * a native handle: a HANDLE on Windows, a file descriptor elsewhere.
+ */
+#ifdef _WIN32
+
+typedef WCHAR PATHCHAR, *PPATHCHAR;
+typedef HANDLE FILEHANDLE;
+
+#define INVALID_FILE_HANDLE         INVALID_HANDLE_VALUE
+
+#define PATH_FORMAT                 "%ls"
+#define PATH_SEPARATOR              L'\\'
+#define PATH_TEXT(Text)             L##Text
+#define RevPathLength               wcslen
+
+#ifndef NT_SUCCESS
+#define NT_SUCCESS(Status)          (((NTSTATUS)(Status)) >= 0)
+#endif
+
+#ifndef FILE_OPEN_FOR_BACKUP_INTENT
+#define FILE_OPEN_FOR_BACKUP_INTENT 0x00004000
+#endif
+
+#else
+
+typedef char PATHCHAR, *PPATHCHAR;
+typedef int FILEHANDLE;
+
+#define INVALID_FILE_HANDLE         (-1)
+
+#define PATH_FORMAT                 "%s"
+#define PATH_SEPARATOR              '/'
+#define PATH_TEXT(Text)             Text
+#define RevPathLength               strlen
+
+#endif
+
+/*
+ * The line counting kernels are compiled for instruction sets above the
+ * baseline of the build and only called when the processor supports them.
+ * MSVC accepts the intrinsics of any instruction set, GCC and Clang need
+ * the target of every such function.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define REVISION_TARGET(Isa)        __attribute__((target(Isa)))
+#else
+#define REVISION_TARGET(Isa)
+#endif
+
+/*
+ * Readers batch small files through io_uring where the kernel headers of
+ * the build know linked files and direct descriptors (Linux 5.17). With
+ * older headers, or on other platforms, every file is read with blocking
+ * system calls.
+ */
+#if defined(IORING_FEAT_LINKED_FILE) && defined(__NR_io_uring_setup)
+#define REVISION_IO_URING
+#endif
+
+#ifndef _WIN32
+
+/*
+ * On non-Windows platforms, provide the subset of Win32 types, annotations
+ * and primitives the revision engine is written against. Everything that
+ * touches the file system has a native implementation instead.
+ */
+
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _In_reads_(Count)
+#define _In_reads_bytes_(Size)
+#define _Out_writes_(Count)
+#define _Out_writes_bytes_(Size)
+#define _Out_writes_opt_(Size)
+#define _Inout_
+#define _Out_
+#define _Out_opt_
+#define _Field_z_
+#define _Ret_maybenull_
+#define _Must_inspect_result_
+
+#define VOID                        void
+#define WINAPI
+#define FORCEINLINE                 static inline
+#define TRUE                        1
+#define FALSE                       0
+#define INFINITE                    0xFFFFFFFF
+#define ALL_PROCESSOR_GROUPS        0xFFFF
+
+#define ARRAYSIZE(Array)            (sizeof(Array) / sizeof((Array)[0]))
+#define CONTAINING_RECORD(Address, Type, Field) \
+    ((Type *)((PCHAR)(Address) - offsetof(Type, Field)))
+
+typedef int BOOL, *PBOOL;
+typedef char CHAR, *PCHAR;
+typedef unsigned char UCHAR, *PUCHAR;
+typedef wchar_t WCHAR, *PWCHAR;
+typedef unsigned short WORD, USHORT, *PUSHORT;
+typedef unsigned long DWORD, ULONG;
+typedef long LONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG, *PULONGLONG, SIZE_T, *PSIZE_T;
+typedef void *HANDLE, *PVOID, *LPVOID;
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID Parameter);
+
+typedef union LARGE_INTEGER {
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef pthread_mutex_t SRWLOCK, *PSRWLOCK;
+
+/**
+ * @brief This structure describes a directory entry returned by the
+ * getdents64 system call.
+ */
+typedef struct LINUX_DIRENT64 {
+    ULONGLONG Inode;
+    LONGLONG Offset;
+    unsigned short RecordLength;
+    unsigned char Type;
+    CHAR Name[];
+} LINUX_DIRENT64, *PLINUX_DIRENT64;
+
+/**
+ * @brief This structure carries the start routine of a thread created by
+ * the CreateThread emulation. The thread handle points to it.
+ */
+typedef struct COMPAT_THREAD {
+    pthread_t Thread;
+    LPTHREAD_START_ROUTINE StartRoutine;
+    LPVOID Parameter;
+} COMPAT_THREAD, *PCOMPAT_THREAD;
+
+FORCEINLINE
+VOID
+InitializeSRWLock(
+    _Out_ PSRWLOCK Lock
+    )
+{
+    pthread_mutex_init(Lock, NULL);
+}
+
+FORCEINLINE
+VOID
+AcquireSRWLockExclusive(
+    _Inout_ PSRWLOCK Lock
+    )
+{
+    pthread_mutex_lock(Lock);
+}
+
+FORCEINLINE
+VOID
+ReleaseSRWLockExclusive(
+    _Inout_ PSRWLOCK Lock
+    )
+{
+    pthread_mutex_unlock(Lock);
+}
+
+FORCEINLINE
+LONG
+InterlockedIncrement(
+    _Inout_ volatile LONG *Addend
+    )
+{
+    return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE
+LONG
+InterlockedDecrement(
+    _Inout_ volatile LONG *Addend
+    )
+{
+    return __atomic_sub_fetch(Addend, 1, __ATOMIC_SEQ_CST);
+}
+
+FORCEINLINE
+LONG
+InterlockedCompareExchange(
+    _Inout_ volatile LONG *Destination,
+    _In_ LONG Exchange,
+    _In_ LONG Comparand
+    )
+{
+    __atomic_compare_exchange_n(Destination,
+                                &Comparand,
+                                Exchange,
+                                FALSE,
+                                __ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST);
+    return Comparand;
+}
+
+FORCEINLINE
+LONG
+ReadAcquire(
+    _In_ const volatile LONG *Source
+    )
+{
+    return __atomic_load_n(Source, __ATOMIC_ACQUIRE);
+}
+
+FORCEINLINE
+VOID
+WriteRelease(
+    _Out_ volatile LONG *Destination,
+    _In_ LONG Value
+    )
+{
+    __atomic_store_n(Destination, Value, __ATOMIC_RELEASE);
+}
+
+FORCEINLINE
+LPVOID
+CompatThreadTrampoline(
+    _In_ LPVOID Parameter
+    )
+{
+    PCOMPAT_THREAD thread = (PCOMPAT_THREAD)Parameter;
+
+    thread->StartRoutine(thread->Parameter);
+
+    return NULL;
+}
+
+FORCEINLINE
+HANDLE
+CreateThread(
+    _In_ LPVOID ThreadAttributes,
+    _In_ SIZE_T StackSize,
+    _In_ LPTHREAD_START_ROUTINE StartRoutine,
+    _In_ LPVOID Parameter,
+    _In_ DWORD CreationFlags,
+    _Out_ DWORD *ThreadId
+    )
+{
+    PCOMPAT_THREAD thread;
+
+    (VOID)ThreadAttributes;
+    (VOID)StackSize;
+    (VOID)CreationFlags;
+    (VOID)ThreadId;
+
+    thread = (PCOMPAT_THREAD)malloc(sizeof(COMPAT_THREAD));
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    thread->StartRoutine = StartRoutine;
+    thread->Parameter = Parameter;
+
+    if (pthread_create(&thread->Thread,
+                       NULL,
+                       CompatThreadTrampoline,
+                       thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+FORCEINLINE
+DWORD
+WaitForSingleObject(
+    _In_ HANDLE Thread,
+    _In_ DWORD Milliseconds
+    )
+{
+    (VOID)Milliseconds;
+
+    return pthread_join(((PCOMPAT_THREAD)Thread)->Thread, NULL);
+}
+
+FORCEINLINE
+BOOL
+CloseHandle(
+    _In_ HANDLE Thread
+    )
+{
+    free(Thread);
+
+    return TRUE;
+}
+
+FORCEINLINE
+BOOL
+SwitchToThread(
+    VOID
+    )
+{
+    return sched_yield() == 0;
+}
+
+FORCEINLINE
+VOID
+Sleep(
+    _In_ DWORD Milliseconds
+    )
+{
+    struct timespec duration;
+
+    duration.tv_sec = Milliseconds / 1000;
+    duration.tv_nsec = (Milliseconds % 1000) * 1000000L;
+    nanosleep(&duration, NULL);
+}
+
+FORCEINLINE
+DWORD
+GetActiveProcessorCount(
+    _In_ WORD GroupNumber
+    )
+{
+    LONG count;
+
+    (VOID)GroupNumber;
+
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (DWORD)count : 0;
+}
+
+FORCEINLINE
+PVOID
+_aligned_malloc(
+    _In_ SIZE_T Size,
+    _In_ SIZE_T Alignment
+    )
+{
+    PVOID memory;
+
+    return posix_memalign(&memory, Alignment, Size) == 0 ? memory : NULL;
+}
+
+FORCEINLINE
+VOID
+_aligned_free(
+    _In_opt_ PVOID Memory
+    )
+{
+    free(Memory);
+}
+
+FORCEINLINE
+BOOL
+QueryPerformanceFrequency(
+    _Out_ PLARGE_INTEGER Frequency
+    )
+{
+    Frequency->QuadPart = 1000000000LL;
+
+    return TRUE;
+}
+
+FORCEINLINE
+BOOL
+QueryPerformanceCounter(
+    _Out_ PLARGE_INTEGER PerformanceCount
+    )
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return FALSE;
+    }
+
+    PerformanceCount->QuadPart = now.tv_sec * 1000000000LL + now.tv_nsec;
+
+    return TRUE;
+}
+
+FORCEINLINE
+int
+wcscpy_s(
+    _Out_ PWCHAR Destination,
+    _In_ SIZE_T DestinationSize,
+    _In_z_ const WCHAR *Source
+    )
+{
+    SIZE_T length = wcslen(Source);
+
+    if (length >= DestinationSize) {
+        if (DestinationSize > 0) {
+            Destination[0] = L'\0';
+        }
+        return ERANGE;
+    }
+
+    wmemcpy(Destination, Source, length + 1);
+
+    return 0;
+}
+
+FORCEINLINE
+int
+wcscat_s(
+    _Inout_ PWCHAR Destination,
+    _In_ SIZE_T DestinationSize,
+    _In_z_ const WCHAR *Source
+    )
+{
+    SIZE_T length = wcslen(Destination);
+
+    if (length >= DestinationSize) {
+        return ERANGE;
+    }
+
+    return wcscpy_s(Destination + length, DestinationSize - length, Source);
+}
+
+#define _wcsdup wcsdup
+
+#endif
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -55,306 +529,2305 @@ typedef struct REVISION_INIT_PARAMS {
      * @brief Indicates whether verbose revision mode is active.
      */
     BOOL IsVerboseMode;
-} REVISION_INIT_PARAMS, *PREVISION_INIT_PARAMS;
 
-/**
- * @brief This enumeration defines the types of file extensions
- * (to be used in REVISION_RECORD_EXTENSION_MAPPING)
- */
-typedef enum REVISION_RECORD_EXTENSION_TYPE {
     /**
-     * @brief File extension with a single dot, e.g. ".txt".
+     * @brief Number of enumerator threads to run the revision with. Zero
+     * means one per logical processor.
      */
-    SingleDot,
+    ULONG CountOfWorkers;
 
     /**
-     * @brief File extension with multiple dots, e.g. ".CMakeLists.txt".
+     * @brief Number of reader threads to run the revision with. Zero means
+     * one per logical processor.
      */
-    MultiDot
-} REVISION_RECORD_EXTENSION_TYPE;
+    ULONG CountOfReaders;
 
-/**
- * @brief This structure stores the mapping of file extensions to
- * programming languages.
- */
-typedef struct REVISION_RECORD_EXTENSION_MAPPING {
     /**
-     * @brief File extension.
+     * @brief Number of counter threads to run the revision with. Zero means
+     * one per logical processor.
      */
-    _Field_z_ PWCHAR Extension;
+    ULONG CountOfCounters;
 
     /**
-     * @brief Programming language or file type.
+     * @brief Size in bytes from which files are mapped into memory rather
+     * than read into the worker read buffer.
      */
-    _Field_z_ PWCHAR LanguageOrFileType;
+    ULONGLONG MapThreshold;
 
     /**
-     * @brief Extension type which indicates whether the extension is a
-     * single-dot or multi-dot extension.
+     * @brief Indicates whether small files are read in batches through
+     * io_uring, where the kernel supports it. Ignored on Windows.
      */
-    /* TODO: Temporarily disabled. Re-evaluate the approach.
-    REVISION_RECORD_EXTENSION_TYPE ExtensionType; */
-} REVISION_RECORD_EXTENSION_MAPPING, *PREVISION_RECORD_EXTENSION_MAPPING;
+    BOOL IsIoUringEnabled;
 
-/**
- * @brief This structure stores statistics for some specific file
- * extension.
- */
-typedef struct REVISION_RECORD {
     /**
-     * @brief Linked list entry.
+     * @brief Path of the scan cache file, or NULL to count every file. The
+     * counts of files that have not changed since the previous revision
+     * are taken from the cache, which is then replaced.
      */
-    LIST_ENTRY ListEntry;
+    _Field_z_ PWCHAR CacheFile;
 
     /**
-     * @brief Extension of the revision record file and recognized
-     * programming language/file type based on extension.
+     * @brief Indicates whether a directory whose version has not changed
+     * since the previous revision is replayed from the scan cache, without
+     * enumerating it or querying its files. A directory changes when its
+     * entries do, not when a file is modified in place, so this trusts
+     * files to be replaced rather than rewritten. Ignored with a file
+     * callback, which must see every file.
      */
-    REVISION_RECORD_EXTENSION_MAPPING ExtensionMapping;
+    BOOL IsDirectoryTimeTrusted;
 
     /**
-     * @brief Number of lines in the revision record.
+     * @brief Indicates whether the files to revise are those tracked by the
+     * git index of the root directory, which must be a git work tree,
+     * rather than those found by enumerating it.
      */
-    ULONGLONG CountOfLinesTotal;
+    BOOL IsGitIndexUsed;
 
     /**
-     * @brief Number of blank lines in the revision record.
+     * @brief Path of a file listing the files to revise, relative to the
+     * root directory, or "-" for the standard input, or NULL to enumerate
+     * the root directory. Takes precedence over the git index.
      */
-    ULONGLONG CountOfLinesBlank;
+    _Field_z_ PWCHAR FileList;
 
     /**
-     * @brief Number of files in the revision record.
+     * @brief Indicates whether the paths of the file list are separated by
+     * NUL characters rather than by newlines.
      */
-    ULONG CountOfFiles;
-} REVISION_RECORD, *PREVISION_RECORD;
+    BOOL IsFileListNulSeparated;
 
-/**
- * @brief This structure stores the statistics of the entire revision.
- */
-typedef struct REVISION {
     /**
-     * @brief Revision initialization parameters provided by the user.
+     * @brief Exclude patterns, in the syntax of .gitignore files, relative
+     * to the root directory. They take precedence over .gitignore files.
      */
-    REVISION_INIT_PARAMS InitParams;
+    PWCHAR *ExcludePatterns;
+    ULONG CountOfExcludePatterns;
 
     /**
-     * @brief List of revision records.
+     * @brief Include patterns. If there are any, only the files matching
+     * one of them are revised.
      */
-    LIST_ENTRY RevisionRecordListHead;
+    PWCHAR *IncludePatterns;
+    ULONG CountOfIncludePatterns;
 
     /**
-     * @brief Number of lines in the whole project.
+     * @brief Indicates whether the .gitignore files of the tree are
+     * honoured, and .git directories skipped, while enumerating it.
      */
-    ULONGLONG CountOfLinesTotal;
+    BOOL IsGitIgnoreUsed;
 
     /**
-     * @brief Number of blank lines in the whole project.
+     * @brief Indicates whether files with the same contents as a file
+     * already counted, as the same language/file type, are skipped.
      */
-    ULONGLONG CountOfLinesBlank;
+    BOOL IsContentDeduplicated;
 
     /**
-     * @brief Number of files in the whole project.
+     * @brief Indicates whether symbolic links to directories are descended
+     * into. Symbolic links to files are always followed. Either way, a
+     * file or directory is revised once however many links lead to it.
      */
-    ULONG CountOfFiles;
+    BOOL IsSymlinkFollowed;
 
     /**
-     * @brief Number of ignored files during the revision.
+     * @brief Callback of a library caller receiving every counted file, or
+     * NULL, and the context passed to it.
      */
-    ULONG CountOfIgnoredFiles;
-} REVISION, *PREVISION;
+    PCODEMETER_FILE_CALLBACK FileCallback;
+    PVOID CallbackContext;
+} REVISION_INIT_PARAMS, *PREVISION_INIT_PARAMS;
 
 /**
- * @brief This enumeration represents different console text colors.
- */
-typedef enum CONSOLE_FOREGROUND_COLOR {
-    Red,
-    Green,
-    Yellow,
-    Blue,
-    Magenta,
-    Cyan
-} CONSOLE_FOREGROUND_COLOR;
+ * @brief This enumeration defines the types of file extensions
+ * (to be used in REVISION_RECORD_EXTENSION_MAPPING)
+ */
+typedef enum REVISION_RECORD_EXTENSION_TYPE {
+    /**
+     * @brief File extension with a single dot, e.g. ".txt".
+     */
+    SingleDot,
 
-//
-// ------------------------------------------------------ Constants and Globals
-//
+    /**
+     * @brief File extension with multiple dots, e.g. ".blade.php".
+     */
+    MultiDot,
+
+    /**
+     * @brief File name with a dot put in front of it, e.g. ".CMakeLists.txt".
+     * Besides the names ending with it, it matches the file of that name.
+     */
+    WholeName
+} REVISION_RECORD_EXTENSION_TYPE;
 
 /**
- * @brief The string to be prepended to a path to avoid the MAX_PATH
- * limitation.
+ * @brief This structure stores the mapping of file extensions to
+ * programming languages.
  */
-#define MAX_PATH_FIX    L"\\\\?\\"
+typedef struct REVISION_RECORD_EXTENSION_MAPPING {
+    /**
+     * @brief File extension.
+     */
+    _Field_z_ PWCHAR Extension;
+
+    /**
+     * @brief Programming language or file type.
+     */
+    _Field_z_ PWCHAR LanguageOrFileType;
+
+    /**
+     * @brief Dense identifier of LanguageOrFileType, assigned by
+     * RevBuildLanguageTable. Indexes the revision records.
+     */
+    ULONG LanguageId;
+
+    /**
+     * @brief Extension type which indicates whether the extension is a
+     * single-dot or multi-dot extension, assigned by RevBuildSuffixTrie,
+     * or a whole file name, as given by the table.
+     */
+    REVISION_RECORD_EXTENSION_TYPE ExtensionType;
+} REVISION_RECORD_EXTENSION_MAPPING, *PREVISION_RECORD_EXTENSION_MAPPING;
 
 /**
- * @brief The string to be appended to a path to indicate all of its
- * contents.
+ * @brief This structure stores a slot of the suffix trie, laid out as a
+ * double array: the child of a node for a character is the slot at the
+ * base of the node plus the class of the character, if that slot names
+ * the node as its parent.
  */
-#define ASTERISK        L"\\*"
+typedef struct REVISION_SUFFIX_NODE {
+    /**
+     * @brief Base of the children of the node.
+     */
+    USHORT Base;
 
-const WCHAR WelcomeString[] =
-    L"CodeMeter v0.0.1                 Copyright(c) 2023 Glebs\n"
-    "--------------------------------------------------------\n\n";
+    /**
+     * @brief Slot of the parent of the node, or REVISION_SUFFIX_TRIE_EMPTY
+     * if the slot is free.
+     */
+    USHORT Parent;
 
-const WCHAR UsageString[] =
-    L"DESCRIPTION:\n\n"
-    "\tIn order to count the number of lines of CodeMeter code, you need\n"
-    "\tthe path to the root directory of the project you want to revise.\n"
-    "\tThe path should be passed as the first argument of the command line:\n\n\t"
-    "CodeMeter.exe \"C:\\\\MyProject\"\n\n"
-    "OPTIONS:\n\n"
-    "\t-help, -h, -?\n"
-    "\tPrint a help message and exit.\n\n"
-    "\t-v\n"
-    "\tEnable verbose logging mode.\n\n";
+    /**
+     * @brief Index into ExtensionMappingTable of the extension spelled by
+     * the path from the root to the node, or REVISION_SUFFIX_TRIE_EMPTY.
+     */
+    USHORT Mapping;
+} REVISION_SUFFIX_NODE, *PREVISION_SUFFIX_NODE;
 
 /**
- * @brief This array holds ANSI escape sequences for changing text color
- * in the console for each corresponding CONSOLE_FOREGROUND_COLOR.
+ * @brief This structure stores statistics for some specific language/file
+ * type. Revision records are kept in arrays indexed by the language ID,
+ * the name is only resolved for the output.
+ */
+typedef struct REVISION_RECORD {
+    /**
+     * @brief Number of lines in the revision record.
+     */
+    ULONGLONG CountOfLinesTotal;
+
+    /**
+     * @brief Number of blank lines in the revision record.
+     */
+    ULONGLONG CountOfLinesBlank;
+
+    /**
+     * @brief Number of comment lines in the revision record.
+     */
+    ULONGLONG CountOfLinesComment;
+
+    /**
+     * @brief Number of files in the revision record.
+     */
+    ULONG CountOfFiles;
+} REVISION_RECORD, *PREVISION_RECORD;
+
+/**
+ * @brief This enumeration defines the types of revision tasks.
+ */
+typedef enum REVISION_TASK_TYPE {
+    /**
+     * @brief Enumerate a directory, schedule its subdirectories and submit
+     * its files to the pipeline.
+     */
+    RevisionTaskDirectory,
+
+    /**
+     * @brief Submit the files tracked by the git index of a work tree to
+     * the pipeline, without enumerating any directory.
+     */
+    RevisionTaskGitIndex,
+
+    /**
+     * @brief Submit the files of a file list to the pipeline, without
+     * enumerating any directory.
+     */
+    RevisionTaskFileList
+} REVISION_TASK_TYPE;
+
+/**
+ * @brief This structure identifies a version of a file or directory in the
+ * scan cache. A file whose key still matches has not been modified since
+ * its lines were counted, a directory whose key still matches has had no
+ * entries added, removed or renamed.
+ */
+typedef struct REVISION_CACHE_KEY {
+    /**
+     * @brief Device (volume serial number on Windows) and inode (file ID)
+     * of the file or directory.
+     */
+    ULONGLONG Device;
+    ULONGLONG Inode;
+
+    /**
+     * @brief Size of the file or directory in bytes.
+     */
+    ULONGLONG Size;
+
+    /**
+     * @brief Last modification time of the file or directory, in the
+     * native unit.
+     */
+    ULONGLONG ModificationTime;
+} REVISION_CACHE_KEY, *PREVISION_CACHE_KEY;
+
+/**
+ * @brief This structure represents a directory of the revised tree.
+ * Children of the directory are opened relative to its handle, so the
+ * path prefix is never resolved again.
  *
- * @note The order must be the same as in the enumeration
- * CONSOLE_FOREGROUND_COLOR.
+ * @note A directory is referenced by its own task, by each of its
+ * subdirectories and by each of its files until the file is read. The handle is
+ * closed and the entry blocks are freed when the last reference is
+ * released, which in turn releases the parent directory. The structure
+ * itself lives in an entry block of the parent directory, so it outlives
+ * every use of it.
  */
-const PWCHAR ConsoleForegroundColors[] = {
-    /* Red */
-    L"\x1b[31m",
+typedef struct REVISION_DIRECTORY {
+    /**
+     * @brief Parent directory. NULL for the revision root directory.
+     */
+    struct REVISION_DIRECTORY *Parent;
 
-    /* Green */
-    L"\x1b[32m",
+    /**
+     * @brief Number of references to the directory.
+     */
+    volatile LONG ReferenceCount;
 
-    /* Yellow */
-    L"\x1b[33m",
+    /**
+     * @brief Handle of the directory, once it has been opened.
+     */
+#ifdef _WIN32
+    HANDLE Handle;
+#else
+    int Handle;
+#endif
 
-    /* Blue */
-    L"\x1b[34m",
+    /**
+     * @brief Name of the directory relative to its parent, or the path of
+     * the root directory.
+     */
+    _Field_z_ PPATHCHAR Name;
 
-    /* Magenta */
-    L"\x1b[35m",
+    /**
+     * @brief Entry blocks allocated while enumerating the directory.
+     */
+    struct REVISION_ENTRY_BLOCK *EntryBlocks;
 
-    /* Cyan */
-    L"\x1b[36m"
-};
+    /**
+     * @brief Innermost pattern list of the directory: the one compiled from
+     * its own .gitignore file, which it owns, or the one of its parent.
+     */
+    struct REVISION_PATTERN_LIST *PatternList;
+
+    /**
+     * @brief Version of the directory, queried once it has been opened
+     * when the revision has a scan cache, and its record in the loaded
+     * cache, or NULL. The cached files of the directory are looked up in
+     * the record.
+     */
+    REVISION_CACHE_KEY CacheKey;
+    BOOL HasCacheKey;
+    const struct REVISION_CACHE_DIRECTORY *CachedDirectory;
+
+    /**
+     * @brief Index of the device of the directory in the identity set, or
+     * zero if it is unknown. It is set, together with the version, when
+     * the directory is claimed after it has been opened; the files of the
+     * directory are on the same device.
+     */
+    ULONG DeviceIndex;
+} REVISION_DIRECTORY, *PREVISION_DIRECTORY;
 
 /**
- * @brief Mapping of file extensions that can be recognized to
- * human-readable descriptions of file types.
+ * @brief This structure holds the entries scheduled from one batch of a
+ * directory enumeration: a REVISION_DIRECTORY for each subdirectory,
+ * followed by the names of all entries. A single block is allocated per
+ * batch, so scheduling an entry never allocates memory on its own.
+ */
+typedef struct REVISION_ENTRY_BLOCK {
+    /**
+     * @brief Next entry block of the same directory.
+     */
+    struct REVISION_ENTRY_BLOCK *Next;
+
+    /**
+     * @brief Number of subdirectories in the block.
+     */
+    ULONG CountOfDirectories;
+
+    /**
+     * @brief Subdirectories of the batch. The names follow the array.
+     */
+    REVISION_DIRECTORY Directories[];
+} REVISION_ENTRY_BLOCK, *PREVISION_ENTRY_BLOCK;
+
+/**
+ * @brief The flags of an exclude pattern.
+ *
+ * REVISION_PATTERN_NEGATED: The pattern starts with "!" and includes again
+ * what a pattern of lower precedence excluded.
  *
- * TODO: Multi-dot extensions are commented out, we need to add support
- *       for them. The current algorithm counts everything after the last
- *       dot as an extension.
+ * REVISION_PATTERN_DIRECTORY_ONLY: The pattern ends with "/" and only
+ * matches directories.
+ *
+ * REVISION_PATTERN_ANCHORED: The pattern contains a "/" other than the
+ * trailing one, so it is matched against the path relative to the base
+ * directory of its list rather than against the name alone.
  */
-REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
-    {L".abap",               L"ABAP"},
-    {L".asl",               L"ACPI Machine Language "},
-    {L".ac",                 L"m4"},
-    {L".ada",                L"Ada"},
-    {L".adb",                L"Ada"},
-    {L".ads",                L"Ada"},
-    {L".adso",               L"ADSO/IDSM"},
-    {L".ahkl",               L"AutoHotkey"},
-    {L".ahk",                L"AutoHotkey"},
-    {L".agda",               L"Agda"},
-    {L".lagda",              L"Agda"},
-    {L".aj",                 L"AspectJ"},
-    {L".am",                 L"make"},
-    {L".ample",              L"AMPLE"},
-    {L".apl",                L"APL"},
-    {L".apla",               L"APL"},
-    {L".aplf",               L"APL"},
-    {L".aplo",               L"APL"},
-    {L".apln",               L"APL"},
-    {L".aplc",               L"APL"},
-    {L".apli",               L"APL"},
-    {L".dyalog",             L"APL"},
-    {L".dyapp",              L"APL"},
-    {L".mipage",             L"APL"},
-    {L".as",                 L"ActionScript"},
-    {L".adoc",               L"AsciiDoc"},
-    {L".asciidoc",           L"AsciiDoc"},
-    {L".dofile",             L"AMPLE"},
-    {L".startup",            L"AMPLE"},
-    {L".axd",                L"ASP"},
-    {L".ashx",               L"ASP"},
-    {L".asa",                L"ASP"},
-    {L".asax",               L"ASP.NET"},
-    {L".ascx",               L"ASP.NET"},
-    {L".asd",                L"Lisp"},
-    {L".asmx",               L"ASP.NET"},
-    {L".asp",                L"ASP"},
-    {L".aspx",               L"ASP.NET"},
-    {L".master",             L"ASP.NET"},
-    {L".sitemap",            L"ASP.NET"},
-    {L".nasm",               L"Assembly"},
-    {L".a51",                L"Assembly"},
-    {L".asm",                L"Assembly"},
-    {L".astro",              L"Astro"},
-    {L".asy",                L"Asymptote"},
-    {L".cshtml",             L"Razor"},
-    {L".razor",              L"Razor"},
-    {L".nawk",               L"awk"},
-    {L".mawk",               L"awk"},
-    {L".gawk",               L"awk"},
-    {L".auk",                L"awk"},
-    {L".awk",                L"awk"},
-    {L".bash",               L"Bourne Again Shell"},
-    {L".bazel",              L"Starlark"},
-    {L".BUILD",              L"Bazel"},
-    {L".dxl",                L"DOORS Extension Language"},
-    {L".bat",                L"DOS Batch"},
-    {L".BAT",                L"DOS Batch"},
-    {L".cmd",                L"DOS Batch"},
-    {L".CMD",                L"DOS Batch"},
-    {L".btm",                L"DOS Batch"},
-    {L".BTM",                L"DOS Batch"},
-    {L".blade",              L"Blade"},
-//    {L".blade.php",          L"Blade"},
-//    {L".build.xml",          L"Ant"},
-    {L".b",                  L"Brainfuck"},
-    {L".bf",                 L"Brainfuck"},
-    {L".brs",                L"BrightScript"},
-    {L".bzl",                L"Starlark"},
-    {L".btp",                L"BizTalk Pipeline"},
-    {L".odx",                L"BizTalk Orchestration"},
-    {L".carbon",             L"Carbon"},
-    {L".cpy",                L"COBOL"},
-    {L".cobol",              L"COBOL"},
-    {L".ccp",                L"COBOL"},
-    {L".cbl",                L"COBOL"},
-    {L".CBL",                L"COBOL"},
-    {L".idc",                L"C"},
-    {L".cats",               L"C"},
-    {L".c",                  L"C"},
-    {L".c++",                L"C++"},
-    {L".C",                  L"C++"},
-    {L".cc",                 L"C++"},
-    {L".ccm",                L"C++"},
-    {L".c++m",               L"C++"},
-    {L".cppm",               L"C++"},
-    {L".cxxm",               L"C++"},
-    {L".h++",                L"C++"},
-    {L".inl",                L"C++"},
-    {L".ipp",                L"C++"},
-    {L".ixx",                L"C++"},
-    {L".tcc",                L"C++"},
-    {L".tpp",                L"C++"},
-    {L".ccs",                L"CCS"},
-    {L".cfc",                L"ColdFusion CFScript"},
-    {L".cfml",               L"ColdFusion"},
-    {L".cfm",                L"ColdFusion"},
-    {L".chpl",               L"Chapel"},
-    {L".cl",                 L"Lisp/OpenCL"},
-//    {L".riemann.config",     L"Clojure"},
-    {L".hic",                L"Clojure"},
-    {L".cljx",               L"Clojure"},
-    {L".cljscm",             L"Clojure"},
-//    {L".cljs.hl",            L"Clojure"},
-    {L".cl2",                L"Clojure"},
-    {L".boot",               L"Clojure"},
+#define REVISION_PATTERN_NEGATED            0x1
+#define REVISION_PATTERN_DIRECTORY_ONLY     0x2
+#define REVISION_PATTERN_ANCHORED           0x4
+
+/**
+ * @brief This enumeration defines how a compiled exclude pattern is
+ * matched, from the cheapest to the most general.
+ */
+typedef enum REVISION_PATTERN_TYPE {
+    /**
+     * @brief A pattern without wildcards, compared as a whole.
+     */
+    RevisionPatternLiteral,
+
+    /**
+     * @brief A "*" followed by a literal, such as "*.o", compared with the
+     * end of the name.
+     */
+    RevisionPatternSuffix,
+
+    /**
+     * @brief Any other pattern, matched with RevMatchGlob.
+     */
+    RevisionPatternGlob
+} REVISION_PATTERN_TYPE;
+
+/**
+ * @brief This structure stores an exclude pattern, in the syntax of
+ * .gitignore files, compiled by RevCompilePatternList.
+ */
+typedef struct REVISION_PATTERN {
+    /**
+     * @brief Text of the pattern without the "!", the leading and the
+     * trailing "/". The literal after the "*" of a suffix pattern.
+     */
+    _Field_z_ PPATHCHAR Text;
+    SIZE_T Length;
+
+    /**
+     * @brief How the pattern is matched.
+     */
+    REVISION_PATTERN_TYPE Type;
+
+    /**
+     * @brief REVISION_PATTERN_* flags of the pattern.
+     */
+    ULONG Flags;
+} REVISION_PATTERN, *PREVISION_PATTERN;
+
+/**
+ * @brief This structure stores the patterns of a .gitignore file or of
+ * the command line, compiled once for the whole subtree they apply to.
+ * Within a list, the last matching pattern decides, and a list takes
+ * precedence over the lists of the enclosing directories.
+ */
+typedef struct REVISION_PATTERN_LIST {
+    /**
+     * @brief List of the nearest enclosing directory with one, or NULL.
+     */
+    struct REVISION_PATTERN_LIST *Parent;
+
+    /**
+     * @brief Directory whose .gitignore file the list was compiled from,
+     * which owns it. NULL for the lists of the command line.
+     */
+    struct REVISION_DIRECTORY *Directory;
+
+    /**
+     * @brief Length of the path of the base directory relative to the
+     * root directory. Anchored patterns are matched against the rest of
+     * the path.
+     */
+    SIZE_T BaseLength;
+
+    /**
+     * @brief Indicates whether the list or one of its parents has anchored
+     * patterns, so that the entries need a path and not just a name.
+     */
+    BOOL HasAnchoredPatterns;
+
+    /**
+     * @brief Patterns of the list, in the order of the file. Their text
+     * follows the array.
+     */
+    ULONG CountOfPatterns;
+    REVISION_PATTERN Patterns[];
+} REVISION_PATTERN_LIST, *PREVISION_PATTERN_LIST;
+
+/**
+ * @brief This structure describes a unit of work that can be executed by
+ * any revision worker.
+ */
+typedef struct REVISION_TASK {
+    /**
+     * @brief Type of the task.
+     */
+    REVISION_TASK_TYPE Type;
+
+    /**
+     * @brief Directory to be enumerated. The task holds a reference to it.
+     */
+    PREVISION_DIRECTORY Directory;
+
+    /**
+     * @brief Name of the directory. Stored in an entry block, the task does
+     * not own it.
+     */
+    _Field_z_ PPATHCHAR Name;
+} REVISION_TASK, *PREVISION_TASK;
+
+/**
+ * @brief This structure is a double-ended queue of revision tasks owned by
+ * a single worker. The owner pushes and pops tasks at the bottom, other
+ * workers steal tasks from the top.
+ */
+typedef struct REVISION_TASK_DEQUE {
+    /**
+     * @brief Lock protecting the deque.
+     */
+    SRWLOCK Lock;
+
+    /**
+     * @brief Ring buffer of tasks.
+     */
+    PREVISION_TASK Tasks;
+
+    /**
+     * @brief Capacity of the ring buffer (always a power of two).
+     */
+    ULONG Capacity;
+
+    /**
+     * @brief Index of the topmost (oldest) task.
+     */
+    ULONG Top;
+
+    /**
+     * @brief Number of tasks in the deque.
+     */
+    ULONG Count;
+} REVISION_TASK_DEQUE, *PREVISION_TASK_DEQUE;
+
+/**
+ * @brief This enumeration defines the stages of the revision pipeline.
+ * Enumerators walk the tree and submit files, readers fill the file
+ * buffers, counters run the line counting kernels on them.
+ */
+typedef enum REVISION_STAGE {
+    RevisionStageEnumerate,
+    RevisionStageRead,
+    RevisionStageCount
+} REVISION_STAGE;
+
+/**
+ * @brief The signature and version of a scan cache file. The version must
+ * change whenever the counting rules do, which invalidates every cache.
+ */
+#define REVISION_CACHE_SIGNATURE        0x3145484341434D43ULL
+#define REVISION_CACHE_VERSION          8
+
+/**
+ * @brief The flag of a scan cache file written by a revision of the files
+ * of a git index, whose directories do not record the whole tree.
+ */
+#define REVISION_CACHE_FLAG_GIT_INDEX   0x1
+
+/**
+ * @brief The flag of a scan cache file written by a revision of the files
+ * of a file list.
+ */
+#define REVISION_CACHE_FLAG_FILE_LIST   0x2
+
+/**
+ * @brief The flag of a scan cache file whose entries record the hashes of
+ * the contents of their files.
+ */
+#define REVISION_CACHE_FLAG_CONTENT_HASH 0x4
+
+/**
+ * @brief The number of scan cache entries, directories or name characters
+ * a worker allocates room for at first. The room doubles whenever it runs
+ * out.
+ */
+#define REVISION_CACHE_INITIAL_CAPACITY 1024
+
+/**
+ * @brief This structure is an entry of the scan cache: the line counts of
+ * a version of a file. It is stored as is in the cache file.
+ */
+typedef struct REVISION_CACHE_ENTRY {
+    /**
+     * @brief Version of the file.
+     */
+    REVISION_CACHE_KEY Key;
+
+    /**
+     * @brief Device and inode of the directory the file was found in. The
+     * entries of a directory are stored together.
+     */
+    ULONGLONG DirectoryDevice;
+    ULONGLONG DirectoryInode;
+
+    /**
+     * @brief Language ID the file was counted as. A renamed file keeps its
+     * key, but may need to be counted as another language.
+     */
+    ULONGLONG LanguageId;
+
+    /**
+     * @brief Line counts of the file.
+     */
+    ULONGLONG CountOfLinesTotal;
+    ULONGLONG CountOfLinesBlank;
+    ULONGLONG CountOfLinesComment;
+
+    /**
+     * @brief Hash of the contents of the file if the revision deduplicated
+     * contents, zero otherwise.
+     */
+    ULONGLONG ContentHash;
+} REVISION_CACHE_ENTRY, *PREVISION_CACHE_ENTRY;
+
+/**
+ * @brief This structure is a directory of the scan cache: what the
+ * enumeration of a version of the directory found. It is stored as is in
+ * the cache file.
+ */
+typedef struct REVISION_CACHE_DIRECTORY {
+    /**
+     * @brief Version of the directory.
+     */
+    REVISION_CACHE_KEY Key;
+
+    /**
+     * @brief Index and number of the entries of the files cached for the
+     * directory.
+     */
+    ULONGLONG FirstEntry;
+    ULONGLONG CountOfEntries;
+
+    /**
+     * @brief Number of files the enumeration submitted and ignored. The
+     * directory can only be replayed if every submitted file is cached.
+     */
+    ULONGLONG CountOfFiles;
+    ULONGLONG CountOfIgnoredFiles;
+
+    /**
+     * @brief Names of the subdirectories, stored one after another with
+     * their terminators: the index of the first character, the number of
+     * characters and the number of names.
+     */
+    ULONGLONG FirstNameChar;
+    ULONGLONG CountOfNameChars;
+    ULONGLONG CountOfSubdirectories;
+} REVISION_CACHE_DIRECTORY, *PREVISION_CACHE_DIRECTORY;
+
+/**
+ * @brief This structure is the header of a scan cache file. It is followed
+ * by CountOfEntries entries sorted by directory, device and inode, by
+ * CountOfDirectories directories sorted by device and inode and by
+ * CountOfNameChars characters of subdirectory names.
+ */
+typedef struct REVISION_CACHE_HEADER {
+    /**
+     * @brief REVISION_CACHE_SIGNATURE and REVISION_CACHE_VERSION.
+     */
+    ULONGLONG Signature;
+    ULONGLONG Version;
+
+    /**
+     * @brief Hash of the language table the language IDs refer to.
+     */
+    ULONGLONG LanguageTableHash;
+
+    /**
+     * @brief REVISION_CACHE_FLAG_* flags of the revision that wrote the
+     * file. A cache is only used by revisions with the same flags.
+     */
+    ULONGLONG Flags;
+
+    /**
+     * @brief Hash of the exclude and include options of the revision that
+     * wrote the file, which must match as well.
+     */
+    ULONGLONG FilterHash;
+
+    /**
+     * @brief Number of entries, directories and name characters following
+     * the header.
+     */
+    ULONGLONG CountOfEntries;
+    ULONGLONG CountOfDirectories;
+    ULONGLONG CountOfNameChars;
+} REVISION_CACHE_HEADER, *PREVISION_CACHE_HEADER;
+
+/**
+ * @brief This structure stores the scan cache of a revision: the entries
+ * loaded from the cache file, which are looked up in place in a view of
+ * the file, and the entries collected by the revision to replace them.
+ */
+typedef struct REVISION_CACHE {
+    /**
+     * @brief Path of the cache file in the native encoding, NULL if the
+     * revision has no cache.
+     */
+    PPATHCHAR Path;
+
+    /**
+     * @brief View of the cache file, NULL if there was no valid one.
+     */
+    const CHAR *View;
+    SIZE_T ViewSize;
+
+    /**
+     * @brief Loaded entries, directories and subdirectory names.
+     */
+    const REVISION_CACHE_ENTRY *Entries;
+    ULONGLONG CountOfEntries;
+    const REVISION_CACHE_DIRECTORY *Directories;
+    ULONGLONG CountOfDirectories;
+    const PATHCHAR *Names;
+    ULONGLONG CountOfNameChars;
+
+    /**
+     * @brief Entries, directories and subdirectory names collected by the
+     * revision, merged from the workers.
+     */
+    PREVISION_CACHE_ENTRY NewEntries;
+    SIZE_T CountOfNewEntries;
+    PREVISION_CACHE_DIRECTORY NewDirectories;
+    SIZE_T CountOfNewDirectories;
+    PPATHCHAR NewNames;
+    SIZE_T CountOfNewNameChars;
+} REVISION_CACHE, *PREVISION_CACHE;
+
+/**
+ * @brief The signature of a git index file ("DIRC"), and the versions of
+ * it that can be read.
+ */
+#define REVISION_GIT_INDEX_SIGNATURE        0x44495243
+#define REVISION_GIT_INDEX_MIN_VERSION      2
+#define REVISION_GIT_INDEX_MAX_VERSION      4
+
+/**
+ * @brief The size of the header of a git index file, and the sizes of the
+ * object IDs of SHA-1 and SHA-256 repositories. The index does not record
+ * which one it uses, so both are tried.
+ */
+#define REVISION_GIT_INDEX_HEADER_SIZE      12
+#define REVISION_GIT_SHA1_SIZE              20
+#define REVISION_GIT_SHA256_SIZE            32
+
+/**
+ * @brief The offsets of the mode and of the object ID in a git index
+ * entry. The flags follow the object ID.
+ */
+#define REVISION_GIT_ENTRY_MODE_OFFSET      24
+#define REVISION_GIT_ENTRY_OBJECT_ID_OFFSET 40
+
+/**
+ * @brief The flags of a git index entry, and its extended flags (index
+ * version 3 and later).
+ */
+#define REVISION_GIT_FLAG_NAME_MASK         0x0FFF
+#define REVISION_GIT_FLAG_STAGE_MASK        0x3000
+#define REVISION_GIT_FLAG_STAGE_SHIFT       12
+#define REVISION_GIT_FLAG_EXTENDED          0x4000
+#define REVISION_GIT_EXTENDED_SKIP_WORKTREE 0x4000
+
+/**
+ * @brief The object types of a git index entry mode. Other types are
+ * submodules and the directories of a sparse index.
+ */
+#define REVISION_GIT_MODE_TYPE_MASK         0xF000
+#define REVISION_GIT_MODE_REGULAR           0x8000
+#define REVISION_GIT_MODE_SYMLINK           0xA000
+
+/**
+ * @brief The signature of the split index extension ("link"). The entries
+ * of a split index are partly stored in another file, which is not read.
+ */
+#define REVISION_GIT_EXTENSION_LINK         0x6C696E6B
+
+/**
+ * @brief The largest .git file read, which links a work tree to its git
+ * directory.
+ */
+#define REVISION_GIT_LINK_SIZE              4096
+
+/**
+ * @brief Size of the blocks a file list is read in. No listed path may be
+ * longer than a block.
+ */
+#define REVISION_FILE_LIST_BLOCK_SIZE       (1024 * 1024)
+
+/**
+ * @brief The length in characters from which RevPrintEx gives up on a
+ * message it cannot format.
+ */
+#define REVISION_MAX_PRINT_LENGTH           (1024 * 1024)
+
+/**
+ * @brief The largest .gitignore file compiled. Larger ones are ignored.
+ */
+#define REVISION_IGNORE_FILE_MAX_SIZE       (16 * 1024 * 1024)
+
+/**
+ * @brief This structure reads the entries of a git index file in order,
+ * from a view of the file.
+ */
+typedef struct REVISION_GIT_INDEX {
+    /**
+     * @brief View of the index file.
+     */
+    const UCHAR *View;
+    SIZE_T Size;
+
+    /**
+     * @brief Version of the index, number of entries and size of the
+     * object IDs.
+     */
+    ULONG Version;
+    ULONG CountOfEntries;
+    ULONG ObjectIdSize;
+
+    /**
+     * @brief Offset and index of the next entry.
+     */
+    SIZE_T Offset;
+    ULONG EntryIndex;
+
+    /**
+     * @brief Path of the last entry read. From version 4, a path is stored
+     * as the part that differs from the path of the previous entry.
+     */
+    PCHAR Path;
+    SIZE_T PathLength;
+    SIZE_T PathCapacity;
+
+    /**
+     * @brief Number of characters of all paths with their terminators.
+     */
+    SIZE_T CountOfPathChars;
+} REVISION_GIT_INDEX, *PREVISION_GIT_INDEX;
+
+/**
+ * @brief This structure describes an entry of a git index.
+ */
+typedef struct REVISION_GIT_INDEX_ENTRY {
+    /**
+     * @brief Path of the entry relative to the work tree, in UTF-8 with
+     * slashes. Valid until the next entry is read.
+     */
+    const CHAR *Path;
+    SIZE_T PathLength;
+
+    /**
+     * @brief Whether the path is that of the previous entry, which is the
+     * case for the stages of an unmerged path.
+     */
+    BOOL IsRepeatedPath;
+
+    /**
+     * @brief Mode, merge stage and object ID of the entry.
+     */
+    ULONG Mode;
+    ULONG Stage;
+    const UCHAR *ObjectId;
+
+    /**
+     * @brief Whether the entry is outside of a sparse checkout, and so
+     * absent from the work tree.
+     */
+    BOOL IsSkipWorktree;
+} REVISION_GIT_INDEX_ENTRY, *PREVISION_GIT_INDEX_ENTRY;
+
+/**
+ * @brief The number of bytes a content hash consumes at a time: one 64-bit
+ * word for each of its four lanes.
+ */
+#define REVISION_CONTENT_STRIPE_SIZE        32
+
+/**
+ * @brief The primes of the content hash, which is xxHash64 with a zero
+ * seed.
+ */
+#define REVISION_CONTENT_PRIME1             0x9E3779B185EBCA87ULL
+#define REVISION_CONTENT_PRIME2             0xC2B2AE3D27D4EB4FULL
+#define REVISION_CONTENT_PRIME3             0x165667B19E3779F9ULL
+#define REVISION_CONTENT_PRIME4             0x85EBCA77C2B2AE63ULL
+#define REVISION_CONTENT_PRIME5             0x27D4EB2F165667C5ULL
+
+/**
+ * @brief The number of shards of the content set, and the number of
+ * entries a shard allocates room for at first. The room doubles whenever
+ * the shard is three quarters full.
+ */
+#define REVISION_CONTENT_SHARD_COUNT        64
+#define REVISION_CONTENT_INITIAL_CAPACITY   256
+
+/**
+ * @brief This structure stores the state of the hash of the contents of a
+ * file, which is fed the contents in pieces as they are counted. The four
+ * lanes are independent of each other, so the processor, or the compiler
+ * with vector instructions, works on them at once.
+ */
+typedef struct REVISION_CONTENT_HASH {
+    /**
+     * @brief Accumulators of the lanes.
+     */
+    ULONGLONG Lanes[4];
+
+    /**
+     * @brief Bytes fed since the last full stripe.
+     */
+    UCHAR Stripe[REVISION_CONTENT_STRIPE_SIZE];
+    SIZE_T CountOfStripeBytes;
+
+    /**
+     * @brief Number of bytes fed in total.
+     */
+    ULONGLONG Size;
+} REVISION_CONTENT_HASH, *PREVISION_CONTENT_HASH;
+
+/**
+ * @brief This structure is an entry of the content set: contents counted
+ * once, and their line counts.
+ */
+typedef struct REVISION_CONTENT_ENTRY {
+    /**
+     * @brief Hash of the contents, which includes their size.
+     */
+    ULONGLONG ContentHash;
+
+    /**
+     * @brief Language ID the contents were counted as. The same contents
+     * are counted once for each language.
+     */
+    ULONG LanguageId;
+
+    /**
+     * @brief Indicates whether the slot of the shard holds an entry.
+     */
+    BOOL IsUsed;
+
+    /**
+     * @brief Line counts of the contents.
+     */
+    ULONGLONG CountOfLinesTotal;
+    ULONGLONG CountOfLinesBlank;
+    ULONGLONG CountOfLinesComment;
+} REVISION_CONTENT_ENTRY, *PREVISION_CONTENT_ENTRY;
+
+/**
+ * @brief This structure is a shard of the content set: an open addressing
+ * hash table with linear probing.
+ */
+typedef struct REVISION_CONTENT_SHARD {
+    /**
+     * @brief Lock protecting the shard.
+     */
+    SRWLOCK Lock;
+
+    /**
+     * @brief Slots of the shard (always a power of two), and the number
+     * of those in use.
+     */
+    PREVISION_CONTENT_ENTRY Entries;
+    SIZE_T Capacity;
+    SIZE_T Count;
+} REVISION_CONTENT_SHARD, *PREVISION_CONTENT_SHARD;
+
+/**
+ * @brief This structure stores the contents counted by a revision that
+ * deduplicates them. The top bits of a hash select the shard, so the
+ * counters rarely wait for one another.
+ */
+typedef struct REVISION_CONTENT_SET {
+    REVISION_CONTENT_SHARD Shards[REVISION_CONTENT_SHARD_COUNT];
+} REVISION_CONTENT_SET, *PREVISION_CONTENT_SET;
+
+/**
+ * @brief The number of shards of the identity set, and the number of keys
+ * a shard allocates room for at first. The room doubles whenever the shard
+ * is three quarters full.
+ */
+#define REVISION_IDENTITY_SHARD_COUNT       64
+#define REVISION_IDENTITY_INITIAL_CAPACITY  1024
+
+/**
+ * @brief The number of bits of the inode in a packed identity key, and the
+ * number of devices whose index fits in the bits above them. Index zero
+ * stands for an unknown device, and a zero key for an empty slot.
+ */
+#define REVISION_IDENTITY_INODE_BITS        48
+#define REVISION_IDENTITY_MAX_DEVICES       0xFFFF
+
+/**
+ * @brief This structure is the identity of a file or directory whose inode
+ * does not fit in a packed key, such as the file IDs of NTFS, whose upper
+ * bits hold a sequence number.
+ */
+typedef struct REVISION_IDENTITY {
+    /**
+     * @brief Index of the device in the identity set, zero for an empty
+     * slot.
+     */
+    ULONGLONG DeviceIndex;
+
+    /**
+     * @brief Inode (file ID on Windows).
+     */
+    ULONGLONG Inode;
+} REVISION_IDENTITY, *PREVISION_IDENTITY;
+
+/**
+ * @brief This structure is a shard of the identity set: two open
+ * addressing hash tables with linear probing, one of packed keys and one
+ * of the identities that do not pack.
+ */
+typedef struct REVISION_IDENTITY_SHARD {
+    /**
+     * @brief Lock protecting the shard.
+     */
+    SRWLOCK Lock;
+
+    /**
+     * @brief Slots of packed keys (always a power of two): the device
+     * index above REVISION_IDENTITY_INODE_BITS bits of inode. The number of
+     * slots in use.
+     */
+    PULONGLONG Keys;
+    SIZE_T Capacity;
+    SIZE_T Count;
+
+    /**
+     * @brief Slots of identities that do not pack, and the number of those
+     * in use.
+     */
+    PREVISION_IDENTITY WideKeys;
+    SIZE_T WideCapacity;
+    SIZE_T WideCount;
+} REVISION_IDENTITY_SHARD, *PREVISION_IDENTITY_SHARD;
+
+/**
+ * @brief This structure stores the device and inode pairs of the files and
+ * directories a revision has reached, so that each is revised once however
+ * many links lead to it. Devices are numbered in the order they are found,
+ * which packs a pair into a single 64-bit key. Only the files with a known
+ * extension are stored, so ten million of them take 128 MiB of packed keys.
+ */
+typedef struct REVISION_IDENTITY_SET {
+    REVISION_IDENTITY_SHARD Shards[REVISION_IDENTITY_SHARD_COUNT];
+
+    /**
+     * @brief Lock protecting the devices, the devices indexed from one and
+     * the room allocated for them.
+     */
+    SRWLOCK DeviceLock;
+    PULONGLONG Devices;
+    SIZE_T CountOfDevices;
+    SIZE_T DevicesCapacity;
+} REVISION_IDENTITY_SET, *PREVISION_IDENTITY_SET;
+
+/**
+ * @brief This structure carries a file through the revision pipeline,
+ * together with the buffer its contents are read into. A fixed pool of
+ * them circulates between the stages, which bounds the memory of the
+ * pipeline: an enumerator cannot submit a file until a counter has
+ * recycled a buffer.
+ */
+typedef struct REVISION_FILE_BUFFER {
+    /**
+     * @brief Directory containing the file. The file holds a reference to
+     * it until it has been read.
+     */
+    PREVISION_DIRECTORY Directory;
+
+    /**
+     * @brief Name of the file, stored in an entry block of the directory.
+     */
+    _Field_z_ PPATHCHAR FileName;
+
+    /**
+     * @brief Extension mapping of the file, found by the enumerator.
+     */
+    PREVISION_RECORD_EXTENSION_MAPPING Mapping;
+
+    /**
+     * @brief Contents of the file: the buffer, or a view of the file if it
+     * is mapped.
+     */
+    const CHAR *Contents;
+
+    /**
+     * @brief Size of the contents in bytes.
+     */
+    SIZE_T Size;
+
+    /**
+     * @brief Whether the contents are a mapped view, to be unmapped by the
+     * counter.
+     */
+    BOOL IsMapped;
+
+    /**
+     * @brief Buffer of REVISION_FILE_BUFFER_SIZE bytes in the buffer pool.
+     */
+    PCHAR Data;
+
+    /**
+     * @brief Scan cache entry of the file, when the revision has a scan
+     * cache and the versions of the file and its directory are known. The
+     * enumerator fills in the versions, the counter the counts.
+     */
+    REVISION_CACHE_ENTRY CacheEntry;
+    BOOL HasCacheKey;
+
+    /**
+     * @brief Hash of the contents of the file, once the counter has
+     * computed it for a revision that deduplicates contents.
+     */
+    ULONGLONG ContentHash;
+    BOOL HasContentHash;
+} REVISION_FILE_BUFFER, *PREVISION_FILE_BUFFER;
+
+/**
+ * @brief This structure is a cell of a pipeline queue. Its sequence number
+ * tells which lap of the queue may write or read it next.
+ */
+typedef struct REVISION_QUEUE_CELL {
+    /**
+     * @brief Sequence number of the cell.
+     */
+    volatile LONG Sequence;
+
+    /**
+     * @brief File buffer held by the cell.
+     */
+    PREVISION_FILE_BUFFER Item;
+} REVISION_QUEUE_CELL, *PREVISION_QUEUE_CELL;
+
+/**
+ * @brief This structure is a bounded lock-free multi-producer
+ * multi-consumer queue of file buffers, linking two stages of the
+ * pipeline. Producers and consumers claim cells by advancing their
+ * position with a compare-exchange and hand them over through the
+ * sequence number of the cell (D. Vyukov's bounded MPMC queue).
+ */
+typedef struct REVISION_QUEUE {
+    /**
+     * @brief Cells of the queue.
+     */
+    PREVISION_QUEUE_CELL Cells;
+
+    /**
+     * @brief Number of cells minus one (always a power of two minus one).
+     */
+    ULONG Mask;
+
+    /**
+     * @brief Position of the next push.
+     */
+    volatile LONG EnqueuePosition;
+
+    /**
+     * @brief Position of the next pop.
+     */
+    volatile LONG DequeuePosition;
+} REVISION_QUEUE, *PREVISION_QUEUE;
+
+#ifdef REVISION_IO_URING
+
+/**
+ * @brief The number of files a reader keeps in flight through io_uring.
+ */
+#define REVISION_RING_SLOTS             64
+
+/**
+ * @brief The number of files queued to io_uring before they are submitted
+ * to the kernel with a single system call.
+ */
+#define REVISION_RING_SUBMIT_BATCH      16
+
+/**
+ * @brief This enumeration represents the linked operations that read a
+ * file through io_uring. Each one posts a completion of its own.
+ */
+typedef enum REVISION_RING_OPERATION {
+    RevisionRingOpen,
+    RevisionRingRead,
+    RevisionRingClose,
+    RevisionRingOperations
+} REVISION_RING_OPERATION;
+
+/**
+ * @brief This structure describes a file in flight through io_uring. The
+ * slot index is also the index of the direct descriptor the file is
+ * opened into.
+ */
+typedef struct REVISION_RING_SLOT {
+    /**
+     * @brief File in flight and the buffer receiving its contents.
+     */
+    PREVISION_FILE_BUFFER File;
+
+    /**
+     * @brief Result of opening the file: zero or a negated errno.
+     */
+    int OpenResult;
+
+    /**
+     * @brief Result of reading the file: the number of bytes read or a
+     * negated errno.
+     */
+    int ReadResult;
+
+    /**
+     * @brief Number of operations of the file that have not completed.
+     */
+    ULONG CountOfPendingOperations;
+
+    /**
+     * @brief Index of the next free slot, while the slot is free.
+     */
+    ULONG NextFreeSlot;
+} REVISION_RING_SLOT, *PREVISION_RING_SLOT;
+
+/**
+ * @brief This structure holds the io_uring instance of a reader: the
+ * submission and completion queues shared with the kernel, and the files
+ * in flight. Only the owning reader uses it.
+ */
+typedef struct REVISION_RING {
+    /**
+     * @brief File descriptor of the io_uring instance, or -1 if the reader
+     * reads files with blocking system calls.
+     */
+    int Handle;
+
+    /**
+     * @brief Mapping of the submission queue ring and its size.
+     */
+    PVOID SubmissionRing;
+    SIZE_T SubmissionRingSize;
+
+    /**
+     * @brief Mapping of the completion queue ring and its size. It is the
+     * submission queue mapping if the kernel maps both at once.
+     */
+    PVOID CompletionRing;
+    SIZE_T CompletionRingSize;
+
+    /**
+     * @brief Mapping of the submission queue entries and its size.
+     */
+    struct io_uring_sqe *Submissions;
+    SIZE_T SubmissionsSize;
+
+    /**
+     * @brief Submission queue indices shared with the kernel.
+     */
+    unsigned *SubmissionTail;
+    unsigned *SubmissionArray;
+    unsigned SubmissionMask;
+
+    /**
+     * @brief Completion queue shared with the kernel.
+     */
+    unsigned *CompletionHead;
+    unsigned *CompletionTail;
+    unsigned CompletionMask;
+    struct io_uring_cqe *Completions;
+
+    /**
+     * @brief Number of submission queue entries not yet submitted.
+     */
+    ULONG CountOfUnsubmitted;
+
+    /**
+     * @brief Number of files in flight.
+     */
+    ULONG CountOfFilesInFlight;
+
+    /**
+     * @brief Index of the first free slot, REVISION_RING_SLOTS if none.
+     */
+    ULONG FreeSlot;
+
+    /**
+     * @brief Whether the file buffer pool is registered with the kernel,
+     * so that files can be read with IORING_OP_READ_FIXED.
+     */
+    BOOL AreBuffersRegistered;
+
+    /**
+     * @brief Files in flight.
+     */
+    REVISION_RING_SLOT Slots[REVISION_RING_SLOTS];
+} REVISION_RING, *PREVISION_RING;
+
+#endif
+
+/**
+ * @brief The size of a memory page, the alignment of the read buffers.
+ */
+#define REVISION_PAGE_SIZE              4096
+
+/**
+ * @brief The number of size classes of a worker buffer pool. The sizes
+ * double from one page up to REVISION_READ_CHUNK_SIZE.
+ */
+#define REVISION_BUFFER_CLASSES         9
+
+/**
+ * @brief This structure holds the read buffers a worker has allocated and
+ * is not using. Buffers are page aligned and come in power of two size
+ * classes. A free buffer stores the next free buffer of its class in its
+ * first bytes. Only the owning worker uses the pool, so it needs no lock.
+ */
+typedef struct REVISION_BUFFER_POOL {
+    /**
+     * @brief First free buffer of each size class, or NULL.
+     */
+    PCHAR FreeBuffers[REVISION_BUFFER_CLASSES];
+
+    /**
+     * @brief Number of buffers served from the pool.
+     */
+    ULONGLONG CountOfHits;
+
+    /**
+     * @brief Number of buffers allocated from the heap, and their bytes.
+     */
+    ULONG CountOfAllocations;
+    ULONGLONG CountOfBytesAllocated;
+} REVISION_BUFFER_POOL, *PREVISION_BUFFER_POOL;
+
+/**
+ * @brief This structure stores the state of a single revision worker.
+ * Each worker accumulates its own statistics, which are merged into the
+ * revision once all workers are finished.
+ */
+typedef struct REVISION_WORKER {
+    /**
+     * @brief Revision the worker belongs to.
+     */
+    struct REVISION *Revision;
+
+    /**
+     * @brief Pipeline stage the worker runs.
+     */
+    REVISION_STAGE Stage;
+
+    /**
+     * @brief Index of the worker in the revision's worker array.
+     */
+    ULONG Index;
+
+    /**
+     * @brief Handle of the worker thread. NULL for the worker that runs on
+     * the thread that started the revision.
+     */
+    HANDLE Thread;
+
+    /**
+     * @brief State of the pseudo-random generator used to pick victims.
+     */
+    ULONG RandomState;
+
+    /**
+     * @brief Tasks owned by the worker.
+     */
+    REVISION_TASK_DEQUE Deque;
+
+    /**
+     * @brief Buffer receiving batches of directory entries.
+     */
+    PCHAR DirectoryBuffer;
+
+    /**
+     * @brief Buffers receiving the chunks of the files being streamed.
+     */
+    REVISION_BUFFER_POOL BufferPool;
+
+#ifdef REVISION_IO_URING
+    /**
+     * @brief io_uring instance of a reader, reading files in batches.
+     */
+    REVISION_RING Ring;
+#endif
+
+    /**
+     * @brief Revision records collected by the worker, indexed by the
+     * language ID.
+     */
+    PREVISION_RECORD RevisionRecords;
+
+    /**
+     * @brief Number of lines revised by the worker.
+     */
+    ULONGLONG CountOfLinesTotal;
+
+    /**
+     * @brief Number of blank lines revised by the worker.
+     */
+    ULONGLONG CountOfLinesBlank;
+
+    /**
+     * @brief Number of comment lines revised by the worker.
+     */
+    ULONGLONG CountOfLinesComment;
+
+    /**
+     * @brief Number of files revised by the worker.
+     */
+    ULONG CountOfFiles;
+
+    /**
+     * @brief Number of files ignored by the worker.
+     */
+    ULONG CountOfIgnoredFiles;
+
+    /**
+     * @brief Number of directories enumerated by the worker.
+     */
+    ULONG CountOfDirectories;
+
+    /**
+     * @brief Number of heap allocations made by the worker while walking
+     * the tree.
+     */
+    ULONG CountOfAllocations;
+
+    /**
+     * @brief Number of files the worker mapped into memory.
+     */
+    ULONG CountOfMappedFiles;
+
+    /**
+     * @brief Number of bytes the worker read into its read buffer.
+     */
+    ULONGLONG CountOfBytesRead;
+
+    /**
+     * @brief Number of bytes the worker revised through file mappings.
+     */
+    ULONGLONG CountOfBytesMapped;
+
+    /**
+     * @brief Number of files the worker read through io_uring.
+     */
+    ULONG CountOfRingFiles;
+
+    /**
+     * @brief Scan cache entries of the files revised by the worker, and
+     * the number of those taken from the scan cache.
+     */
+    PREVISION_CACHE_ENTRY CacheEntries;
+    SIZE_T CountOfCacheEntries;
+    SIZE_T CacheEntriesCapacity;
+    ULONG CountOfCachedFiles;
+
+    /**
+     * @brief Scan cache directories enumerated by the worker, the names of
+     * their subdirectories, and the number of directories replayed from
+     * the scan cache.
+     */
+    PREVISION_CACHE_DIRECTORY CacheDirectories;
+    SIZE_T CountOfCacheDirectories;
+    SIZE_T CacheDirectoriesCapacity;
+    PPATHCHAR CacheNames;
+    SIZE_T CountOfCacheNameChars;
+    SIZE_T CacheNamesCapacity;
+    ULONG CountOfCachedDirectories;
+
+    /**
+     * @brief Path relative to the root directory of the entry checked
+     * against anchored patterns: the path of the directory being
+     * enumerated, of the given length, followed by the name of the entry.
+     */
+    PPATHCHAR PatternPath;
+    SIZE_T PatternPathCapacity;
+    SIZE_T PatternPathLength;
+    BOOL HasPatternPath;
+
+    /**
+     * @brief Number of files and directories excluded by patterns.
+     */
+    ULONG CountOfExcludedFiles;
+    ULONG CountOfExcludedDirectories;
+
+    /**
+     * @brief Number of files skipped by the worker as duplicates of files
+     * already counted.
+     */
+    ULONG CountOfDuplicateFiles;
+
+    /**
+     * @brief Number of files and directories skipped by the worker because
+     * they had been reached through another link.
+     */
+    ULONG CountOfLinkedFiles;
+    ULONG CountOfLinkedDirectories;
+
+    /**
+     * @brief Number of directories, git indexes and file lists that the
+     * worker failed to open or enumerate.
+     */
+    ULONG CountOfFailedDirectories;
+} REVISION_WORKER, *PREVISION_WORKER;
+
+/**
+ * @brief The size of an arena block. Larger allocations get a block of
+ * their own.
+ */
+#define REVISION_ARENA_BLOCK_SIZE       (64 * 1024)
+
+/**
+ * @brief This structure is the header of an arena block. The allocations
+ * follow it in the same block.
+ */
+typedef struct REVISION_ARENA_BLOCK {
+    /**
+     * @brief Previously filled block, or NULL.
+     */
+    struct REVISION_ARENA_BLOCK *Next;
+
+    /**
+     * @brief Size of the block, header included.
+     */
+    SIZE_T Size;
+
+    /**
+     * @brief Offset of the first free byte from the start of the block.
+     */
+    SIZE_T Used;
+} REVISION_ARENA_BLOCK, *PREVISION_ARENA_BLOCK;
+
+/**
+ * @brief This structure is a bump pointer arena. Allocations are carved
+ * out of page aligned blocks in order and are never freed one by one;
+ * deleting the arena frees every block at once. It is not thread safe: the
+ * revision only allocates from it while it is being set up.
+ */
+typedef struct REVISION_ARENA {
+    /**
+     * @brief Block being filled, linked to the previous ones.
+     */
+    PREVISION_ARENA_BLOCK Blocks;
+
+    /**
+     * @brief Number of blocks and their total size in bytes.
+     */
+    ULONG CountOfBlocks;
+    ULONGLONG CountOfBytes;
+} REVISION_ARENA, *PREVISION_ARENA;
+
+/**
+ * @brief This structure stores the statistics of the entire revision.
+ */
+typedef struct REVISION {
+    /**
+     * @brief Arena backing the revision structure itself and every
+     * allocation that lives as long as the revision.
+     */
+    REVISION_ARENA Arena;
+
+    /**
+     * @brief Revision initialization parameters provided by the user.
+     */
+    REVISION_INIT_PARAMS InitParams;
+
+    /**
+     * @brief Revision records, indexed by the language ID.
+     */
+    PREVISION_RECORD RevisionRecords;
+
+    /**
+     * @brief Array of revision workers.
+     */
+    PREVISION_WORKER Workers;
+
+    /**
+     * @brief Number of revision workers of all stages. The enumerators
+     * come first, then the readers, then the counters.
+     */
+    ULONG CountOfWorkers;
+
+    /**
+     * @brief Number of workers of each stage.
+     */
+    ULONG CountOfEnumerators;
+    ULONG CountOfReaders;
+    ULONG CountOfCounters;
+
+    /**
+     * @brief Number of directory tasks that have been scheduled but not
+     * yet completed. The enumeration is finished when it drops to zero.
+     */
+    volatile LONG CountOfPendingTasks;
+
+    /**
+     * @brief Number of files that have been submitted to the pipeline but
+     * not yet counted. Once the enumeration is finished, the revision is
+     * finished when it drops to zero.
+     */
+    volatile LONG CountOfPendingFiles;
+
+    /**
+     * @brief File buffers of the pipeline and the pool of their data.
+     */
+    PREVISION_FILE_BUFFER FileBuffers;
+    PCHAR FileBufferPool;
+    ULONG CountOfFileBuffers;
+
+    /**
+     * @brief Queues linking the stages: free buffers go to enumerators,
+     * submitted files to readers, read files to counters.
+     */
+    REVISION_QUEUE FreeQueue;
+    REVISION_QUEUE ReadQueue;
+    REVISION_QUEUE CountQueue;
+
+    /**
+     * @brief Number of lines in the whole project.
+     */
+    ULONGLONG CountOfLinesTotal;
+
+    /**
+     * @brief Number of blank lines in the whole project.
+     */
+    ULONGLONG CountOfLinesBlank;
+
+    /**
+     * @brief Number of comment lines in the whole project.
+     */
+    ULONGLONG CountOfLinesComment;
+
+    /**
+     * @brief Number of files in the whole project.
+     */
+    ULONG CountOfFiles;
+
+    /**
+     * @brief Number of ignored files during the revision.
+     */
+    ULONG CountOfIgnoredFiles;
+
+    /**
+     * @brief Number of directories enumerated during the revision.
+     */
+    ULONG CountOfDirectories;
+
+    /**
+     * @brief Number of heap allocations made while walking the tree. It
+     * grows with the number of directories, not with the number of files.
+     */
+    ULONG CountOfAllocations;
+
+    /**
+     * @brief Number of files mapped into memory during the revision.
+     */
+    ULONG CountOfMappedFiles;
+
+    /**
+     * @brief Number of bytes read into the worker read buffers.
+     */
+    ULONGLONG CountOfBytesRead;
+
+    /**
+     * @brief Number of bytes revised through file mappings.
+     */
+    ULONGLONG CountOfBytesMapped;
+
+    /**
+     * @brief Number of files read through io_uring.
+     */
+    ULONG CountOfRingFiles;
+
+    /**
+     * @brief Number of read buffers served from the worker buffer pools,
+     * and the number and bytes of those allocated from the heap.
+     */
+    ULONGLONG CountOfBufferHits;
+    ULONG CountOfBufferAllocations;
+    ULONGLONG CountOfBufferBytes;
+
+    /**
+     * @brief Scan cache of the revision, and the number of files whose
+     * counts were taken from it and of directories replayed from it.
+     */
+    REVISION_CACHE Cache;
+    ULONG CountOfCachedFiles;
+    ULONG CountOfCachedDirectories;
+
+    /**
+     * @brief Exclude and include patterns of the command line, or NULL,
+     * and whether any entry may be excluded at all.
+     */
+    PREVISION_PATTERN_LIST ExcludePatterns;
+    PREVISION_PATTERN_LIST IncludePatterns;
+    BOOL IsFiltered;
+
+    /**
+     * @brief Number of files and directories excluded by patterns.
+     */
+    ULONG CountOfExcludedFiles;
+    ULONG CountOfExcludedDirectories;
+
+    /**
+     * @brief Contents counted so far when the revision deduplicates them,
+     * and the number of files skipped as duplicates.
+     */
+    REVISION_CONTENT_SET ContentSet;
+    ULONG CountOfDuplicateFiles;
+
+    /**
+     * @brief Files and directories reached so far, and the number of those
+     * skipped because they had been reached through another link.
+     */
+    REVISION_IDENTITY_SET IdentitySet;
+    ULONG CountOfLinkedFiles;
+    ULONG CountOfLinkedDirectories;
+
+    /**
+     * @brief Number of directories, git indexes and file lists that could
+     * not be opened or enumerated. Their files are missing from the counts.
+     */
+    ULONG CountOfFailedDirectories;
+
+    /**
+     * @brief TRUE if the root task failed, so that nothing was revised and
+     * the revision fails as a whole.
+     */
+    BOOL IsRootFailed;
+} REVISION, *PREVISION;
+
+/**
+ * @brief This enumeration represents different console text colors.
+ */
+typedef enum CONSOLE_FOREGROUND_COLOR {
+    Red,
+    Green,
+    Yellow,
+    Blue,
+    Magenta,
+    Cyan
+} CONSOLE_FOREGROUND_COLOR;
+
+/**
+ * @brief This structure holds the line counts of a buffer while a line
+ * counting kernel walks it.
+ */
+typedef struct REVISION_LINE_STATE {
+    /**
+     * @brief Number of lines ended so far.
+     */
+    ULONGLONG CountOfLinesTotal;
+
+    /**
+     * @brief Number of blank lines ended so far.
+     */
+    ULONGLONG CountOfLinesBlank;
+
+    /**
+     * @brief 1 if the current line holds a character other than white
+     * space, 0 otherwise.
+     */
+    ULONGLONG IsLineDirty;
+
+    /**
+     * @brief 1 if the last byte counted is "\r", 0 otherwise. A "\n" right
+     * after a "\r" does not end another line.
+     */
+    ULONGLONG IsPreviousCarriageReturn;
+
+    /**
+     * @brief 1 if the last byte counted is not a line break, so that a line
+     * is still open, 0 otherwise.
+     */
+    ULONGLONG IsLineOpen;
+} REVISION_LINE_STATE, *PREVISION_LINE_STATE;
+
+/**
+ * @brief This type describes a routine that counts the lines of a chunk
+ * of a file. Chunks are counted in order, the state carries the line
+ * that goes on from one chunk to the next.
+ *
+ * @param Buffer Supplies the chunk.
+ *
+ * @param Size Supplies the size of the chunk in bytes.
+ *
+ * @param State Supplies the line counts before the chunk and receives the
+ * line counts after it. RevCompleteLineCount completes the last line.
+ */
+typedef VOID (REVISION_COUNT_LINES_ROUTINE)(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Inout_ PREVISION_LINE_STATE State
+    );
+
+typedef REVISION_COUNT_LINES_ROUTINE *PREVISION_COUNT_LINES_ROUTINE;
+
+/**
+ * @brief This type describes a routine that skips a run of plain bytes for
+ * the line classifier, a block of 64 bytes at a time: bytes that are none
+ * of the stop bytes of a syntax.
+ *
+ * @param Buffer Supplies the run, starting at a plain byte.
+ *
+ * @param Size Supplies the size of the buffer in bytes.
+ *
+ * @param StopBytes Supplies the stop bytes of the syntax.
+ *
+ * @param CountOfStopBytes Supplies the number of stop bytes.
+ *
+ * @param IsContent Receives TRUE if the run holds a byte other than white
+ * space, and is left unchanged otherwise.
+ *
+ * @return The length of the run, up to the first stop byte, or the number
+ * of bytes in the whole blocks of the buffer if none of them stops it.
+ */
+typedef SIZE_T (REVISION_SKIP_PLAIN_BYTES_ROUTINE)(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_reads_(CountOfStopBytes) const CHAR *StopBytes,
+    _In_ ULONG CountOfStopBytes,
+    _Inout_ PBOOL IsContent
+    );
+
+typedef REVISION_SKIP_PLAIN_BYTES_ROUTINE *PREVISION_SKIP_PLAIN_BYTES_ROUTINE;
+
+/**
+ * @brief This structure describes a line counting kernel.
+ *
+ * @note A line ends with "\n", "\r\n" or a lone "\r". A line that holds
+ * nothing but spaces, tabs, vertical tabs and form feeds is blank. The last
+ * line counts even without a line end. The kernels end a line at its "\r"
+ * rather than at the "\n" of a "\r\n", so they never need to look past
+ * the end of a chunk.
+ */
+typedef struct REVISION_LINE_COUNTER {
+    /**
+     * @brief Name of the kernel.
+     */
+    _Field_z_ PWCHAR Name;
+
+    /**
+     * @brief The routine that counts the lines.
+     */
+    PREVISION_COUNT_LINES_ROUTINE Routine;
+
+    /**
+     * @brief The routine that skips plain bytes for the line classifier,
+     * or NULL if the classifier walks every byte.
+     */
+    PREVISION_SKIP_PLAIN_BYTES_ROUTINE SkipRoutine;
+
+    /**
+     * @brief Processor features (REVISION_CPU_FEATURE_*) the kernel
+     * requires.
+     */
+    ULONG RequiredFeatures;
+} REVISION_LINE_COUNTER, *PREVISION_LINE_COUNTER;
+
+/**
+ * @brief This enumeration represents the lexical syntaxes of comments and
+ * strings shared by families of languages.
+ */
+typedef enum REVISION_SYNTAX {
+    RevisionSyntaxC,
+    RevisionSyntaxCNested,
+    RevisionSyntaxJavaScript,
+    RevisionSyntaxCss,
+    RevisionSyntaxPhp,
+    RevisionSyntaxHash,
+    RevisionSyntaxCoffeeScript,
+    RevisionSyntaxPowerShell,
+    RevisionSyntaxNim,
+    RevisionSyntaxNix,
+    RevisionSyntaxHcl,
+    RevisionSyntaxSql,
+    RevisionSyntaxAda,
+    RevisionSyntaxHaskell,
+    RevisionSyntaxLean,
+    RevisionSyntaxLua,
+    RevisionSyntaxLisp,
+    RevisionSyntaxIni,
+    RevisionSyntaxAssembly,
+    RevisionSyntaxAutoHotkey,
+    RevisionSyntaxErlang,
+    RevisionSyntaxTex,
+    RevisionSyntaxProlog,
+    RevisionSyntaxMl,
+    RevisionSyntaxFSharp,
+    RevisionSyntaxPascal,
+    RevisionSyntaxBasic,
+    RevisionSyntaxFortran,
+    RevisionSyntaxBatch,
+    RevisionSyntaxRexx,
+    RevisionSyntaxM4,
+    RevisionSyntaxXml,
+    RevisionSyntaxJinja,
+    RevisionSyntaxHandlebars,
+    RevisionSyntaxSmarty
+} REVISION_SYNTAX;
+
+/**
+ * @brief The maximum number of line comment markers of a syntax.
+ */
+#define REVISION_MAX_LINE_COMMENTS      3
+
+/**
+ * @brief The maximum length of a comment marker. The line classifier
+ * keeps this many bytes minus one back at the end of a chunk, so that no
+ * marker is split between two chunks.
+ */
+#define REVISION_MAX_MARKER_LENGTH      4
+
+/**
+ * @brief The maximum number of stop bytes of a syntax. A syntax with more
+ * is classified byte by byte.
+ */
+#define REVISION_MAX_STOP_BYTES         16
+
+/**
+ * @brief This structure describes how comments and strings are written in
+ * a family of languages. It drives the line classifier RevClassifyLines.
+ *
+ * @note Markers are matched anywhere outside of strings and comments.
+ * Strings end at their delimiter or at the end of the line.
+ */
+typedef struct REVISION_LANGUAGE_SYNTAX {
+    /**
+     * @brief Markers that start a comment running to the end of the line.
+     * Unused entries are NULL.
+     */
+    const CHAR *LineComments[REVISION_MAX_LINE_COMMENTS];
+
+    /**
+     * @brief Marker that opens a block comment, or NULL.
+     */
+    const CHAR *BlockCommentOpen;
+
+    /**
+     * @brief Marker that closes a block comment, or NULL.
+     */
+    const CHAR *BlockCommentClose;
+
+    /**
+     * @brief Whether block comments nest.
+     */
+    BOOL AreBlockCommentsNested;
+
+    /**
+     * @brief Characters that open and close a string literal.
+     */
+    _Field_z_ const CHAR *StringDelimiters;
+
+    /**
+     * @brief Character that escapes the next one within a string literal,
+     * or zero.
+     */
+    CHAR EscapeCharacter;
+
+    /**
+     * @brief Class (REVISION_CHARACTER_*) of every byte, built by
+     * RevBuildSyntaxClasses.
+     */
+    UCHAR CharacterClasses[256];
+
+    /**
+     * @brief Bytes with a class other than white space: line breaks and
+     * the first bytes of markers, string delimiters and escapes. Any other
+     * byte only marks its line as having content, so the classifier skips
+     * runs of them with the kernel of the processor. Built by
+     * RevBuildSyntaxClasses, zero if there are too many.
+     */
+    CHAR StopBytes[REVISION_MAX_STOP_BYTES];
+    ULONG CountOfStopBytes;
+} REVISION_LANGUAGE_SYNTAX, *PREVISION_LANGUAGE_SYNTAX;
+
+/**
+ * @brief This structure maps a language/file type to its syntax.
+ */
+typedef struct REVISION_LANGUAGE_SYNTAX_MAPPING {
+    /**
+     * @brief Programming language or file type, as in
+     * ExtensionMappingTable.
+     */
+    _Field_z_ PWCHAR LanguageOrFileType;
+
+    /**
+     * @brief Syntax of the language.
+     */
+    REVISION_SYNTAX Syntax;
+} REVISION_LANGUAGE_SYNTAX_MAPPING, *PREVISION_LANGUAGE_SYNTAX_MAPPING;
+
+/**
+ * @brief This enumeration represents the states of the line classifier.
+ */
+typedef enum REVISION_SCANNER_STATE {
+    RevisionScannerCode,
+    RevisionScannerString,
+    RevisionScannerLineComment,
+    RevisionScannerBlockComment
+} REVISION_SCANNER_STATE;
+
+/**
+ * @brief This structure holds the state of the line classifier between
+ * the chunks of a file.
+ */
+typedef struct REVISION_SCANNER {
+    /**
+     * @brief Lexical state at the end of the last chunk.
+     */
+    REVISION_SCANNER_STATE State;
+
+    /**
+     * @brief Nesting depth of the current block comment.
+     */
+    ULONG Depth;
+
+    /**
+     * @brief Delimiter of the current string literal.
+     */
+    CHAR Delimiter;
+
+    /**
+     * @brief Whether the current line holds code.
+     */
+    BOOL IsLineCode;
+
+    /**
+     * @brief Whether the current line holds a comment.
+     */
+    BOOL IsLineComment;
+
+    /**
+     * @brief Whether the last byte classified is "\r".
+     */
+    BOOL IsPreviousCarriageReturn;
+
+    /**
+     * @brief Whether the last byte classified is not a line break, so that
+     * a line is still open.
+     */
+    BOOL IsLineOpen;
+
+    /**
+     * @brief Number of lines ended so far.
+     */
+    ULONGLONG CountOfLinesTotal;
+
+    /**
+     * @brief Number of blank lines ended so far.
+     */
+    ULONGLONG CountOfLinesBlank;
+
+    /**
+     * @brief Number of comment lines ended so far.
+     */
+    ULONGLONG CountOfLinesComment;
+} REVISION_SCANNER, *PREVISION_SCANNER;
+
+//
+// ------------------------------------------------------ Constants and Globals
+//
+
+/**
+ * @brief The string to be prepended to a path to avoid the MAX_PATH
+ * limitation.
+ */
+#define MAX_PATH_FIX    L"\\\\?\\"
+
+/**
+ * @brief The string to be appended to a path to indicate all of its
+ * contents.
+ */
+#define ASTERISK        L"\\*"
+
+/**
+ * @brief The maximum number of revision workers.
+ */
+#define REVISION_MAX_WORKERS            256
+
+/**
+ * @brief The initial capacity of a worker task deque (must be a power of
+ * two).
+ */
+#define REVISION_DEQUE_INITIAL_CAPACITY 256
+
+/**
+ * @brief The number of unsuccessful steal rounds after which an idle
+ * worker starts sleeping instead of yielding.
+ */
+#define REVISION_IDLE_SPIN_COUNT        64
+
+/**
+ * @brief The size of the per-worker buffer for batched directory
+ * enumeration. Large enough to list most directories in a single system
+ * call.
+ *
+ * @note Directory queries on SMB shares fail with buffers over 64 KiB.
+ */
+#define REVISION_DIRECTORY_BUFFER_SIZE  (64 * 1024)
+
+/**
+ * @brief The size of the chunks files are read and counted in. Every
+ * worker has a single read buffer of this size, so the memory used to
+ * revise a file does not depend on its size.
+ */
+#define REVISION_READ_CHUNK_SIZE        (1024 * 1024)
+
+/**
+ * @brief States of the one-time initialization of the process-wide tables.
+ */
+#define REVISION_TABLES_UNINITIALIZED   0
+#define REVISION_TABLES_BUILDING        1
+#define REVISION_TABLES_READY           2
+#define REVISION_TABLES_FAILED          3
+
+/**
+ * @brief The default size from which files are mapped rather than read.
+ */
+#define REVISION_DEFAULT_MAP_THRESHOLD  REVISION_READ_CHUNK_SIZE
+
+/**
+ * @brief The size of a pipeline file buffer. Files that do not fit are
+ * handed to the counters as a mapped view if they reach the map
+ * threshold, and are streamed and counted by the reader otherwise.
+ */
+#define REVISION_FILE_BUFFER_SIZE       (64 * 1024)
+
+/**
+ * @brief The number of pipeline file buffers per reader and counter.
+ */
+#define REVISION_FILE_BUFFERS_PER_THREAD 16
+
+/**
+ * @brief The number of slots of the suffix trie (comfortably more than
+ * the number of characters of the extensions in the mapping table, so that
+ * the nodes are placed quickly).
+ */
+#define REVISION_SUFFIX_TRIE_SLOTS      16384
+
+/**
+ * @brief The number of character classes of the suffix trie, including
+ * class zero for the characters that appear in no extension.
+ */
+#define REVISION_SUFFIX_TRIE_CLASSES    128
+
+/**
+ * @brief The number of characters above 0xFF that the extensions may use.
+ * Only Windows walks such characters, as UTF-16 code units.
+ */
+#define REVISION_SUFFIX_TRIE_WIDE_UNITS 16
+
+/**
+ * @brief The value of a suffix trie slot or mapping index that holds
+ * nothing.
+ */
+#define REVISION_SUFFIX_TRIE_EMPTY      0xFFFF
+
+/**
+ * @brief Processor features the line counting kernels are dispatched on.
+ * A feature is only reported if the operating system also saves the
+ * register state it needs.
+ */
+#define REVISION_CPU_FEATURE_SSE2       0x00000001
+#define REVISION_CPU_FEATURE_AVX2       0x00000002
+#define REVISION_CPU_FEATURE_AVX512BW   0x00000004
+
+/**
+ * @brief Classes of the bytes of a syntax. A byte without a class is plain
+ * content.
+ */
+#define REVISION_CHARACTER_SPACE        0x01
+#define REVISION_CHARACTER_LINE_BREAK   0x02
+#define REVISION_CHARACTER_COMMENT      0x04
+#define REVISION_CHARACTER_STRING       0x08
+#define REVISION_CHARACTER_ESCAPE       0x10
+
+/**
+ * @brief This array holds ANSI escape sequences for changing text color
+ * in the console for each corresponding CONSOLE_FOREGROUND_COLOR.
+ *
+ * @note The order must be the same as in the enumeration
+ * CONSOLE_FOREGROUND_COLOR.
+ */
+const PWCHAR ConsoleForegroundColors[] = {
+    /* Red */
+    L"\x1b[31m",
+
+    /* Green */
+    L"\x1b[32m",
+
+    /* Yellow */
+    L"\x1b[33m",
+
+    /* Blue */
+    L"\x1b[34m",
+
+    /* Magenta */
+    L"\x1b[35m",
+
+    /* Cyan */
+    L"\x1b[36m"
+};
+
+/**
+ * @brief Mapping of file extensions that can be recognized to
+ * human-readable descriptions of file types.
+ *
+ * @note A file takes its longest extension in the table, so multi-dot
+ * extensions such as ".blade.php" win over ".php". The entries marked as
+ * WholeName are file names, which also match the file of that name, such
+ * as "CMakeLists.txt".
+ */
+REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
+    {L".abap",               L"ABAP"},
+    {L".asl",               L"ACPI Machine Language "},
+    {L".ac",                 L"m4"},
+    {L".ada",                L"Ada"},
+    {L".adb",                L"Ada"},
+    {L".ads",                L"Ada"},
+    {L".adso",               L"ADSO/IDSM"},
+    {L".ahkl",               L"AutoHotkey"},
+    {L".ahk",                L"AutoHotkey"},
+    {L".agda",               L"Agda"},
+    {L".lagda",              L"Agda"},
+    {L".aj",                 L"AspectJ"},
+    {L".am",                 L"make"},
+    {L".ample",              L"AMPLE"},
+    {L".apl",                L"APL"},
+    {L".apla",               L"APL"},
+    {L".aplf",               L"APL"},
+    {L".aplo",               L"APL"},
+    {L".apln",               L"APL"},
+    {L".aplc",               L"APL"},
+    {L".apli",               L"APL"},
+    {L".dyalog",             L"APL"},
+    {L".dyapp",              L"APL"},
+    {L".mipage",             L"APL"},
+    {L".as",                 L"ActionScript"},
+    {L".adoc",               L"AsciiDoc"},
+    {L".asciidoc",           L"AsciiDoc"},
+    {L".dofile",             L"AMPLE"},
+    {L".startup",            L"AMPLE"},
+    {L".axd",                L"ASP"},
+    {L".ashx",               L"ASP"},
+    {L".asa",                L"ASP"},
+    {L".asax",               L"ASP.NET"},
+    {L".ascx",               L"ASP.NET"},
+    {L".asd",                L"Lisp"},
+    {L".asmx",               L"ASP.NET"},
+    {L".asp",                L"ASP"},
+    {L".aspx",               L"ASP.NET"},
+    {L".master",             L"ASP.NET"},
+    {L".sitemap",            L"ASP.NET"},
+    {L".nasm",               L"Assembly"},
+    {L".a51",                L"Assembly"},
+    {L".asm",                L"Assembly"},
+    {L".astro",              L"Astro"},
+    {L".asy",                L"Asymptote"},
+    {L".cshtml",             L"Razor"},
+    {L".razor",              L"Razor"},
+    {L".nawk",               L"awk"},
+    {L".mawk",               L"awk"},
+    {L".gawk",               L"awk"},
+    {L".auk",                L"awk"},
+    {L".awk",                L"awk"},
+    {L".bash",               L"Bourne Again Shell"},
+    {L".bazel",              L"Starlark"},
+    {L".BUILD",              L"Bazel"},
+    {L".dxl",                L"DOORS Extension Language"},
+    {L".bat",                L"DOS Batch"},
+    {L".BAT",                L"DOS Batch"},
+    {L".cmd",                L"DOS Batch"},
+    {L".CMD",                L"DOS Batch"},
+    {L".btm",                L"DOS Batch"},
+    {L".BTM",                L"DOS Batch"},
+    {L".blade",              L"Blade"},
+    {L".blade.php",          L"Blade"},
+    {L".build.xml",          L"Ant", 0, WholeName},
+    {L".b",                  L"Brainfuck"},
+    {L".bf",                 L"Brainfuck"},
+    {L".brs",                L"BrightScript"},
+    {L".bzl",                L"Starlark"},
+    {L".btp",                L"BizTalk Pipeline"},
+    {L".odx",                L"BizTalk Orchestration"},
+    {L".carbon",             L"Carbon"},
+    {L".cpy",                L"COBOL"},
+    {L".cobol",              L"COBOL"},
+    {L".ccp",                L"COBOL"},
+    {L".cbl",                L"COBOL"},
+    {L".CBL",                L"COBOL"},
+    {L".idc",                L"C"},
+    {L".cats",               L"C"},
+    {L".c",                  L"C"},
+    {L".c++",                L"C++"},
+    {L".C",                  L"C++"},
+    {L".cc",                 L"C++"},
+    {L".ccm",                L"C++"},
+    {L".c++m",               L"C++"},
+    {L".cppm",               L"C++"},
+    {L".cxxm",               L"C++"},
+    {L".h++",                L"C++"},
+    {L".inl",                L"C++"},
+    {L".ipp",                L"C++"},
+    {L".ixx",                L"C++"},
+    {L".tcc",                L"C++"},
+    {L".tpp",                L"C++"},
+    {L".ccs",                L"CCS"},
+    {L".cfc",                L"ColdFusion CFScript"},
+    {L".cfml",               L"ColdFusion"},
+    {L".cfm",                L"ColdFusion"},
+    {L".chpl",               L"Chapel"},
+    {L".cl",                 L"Lisp/OpenCL"},
+    {L".riemann.config",     L"Clojure", 0, WholeName},
+    {L".hic",                L"Clojure"},
+    {L".cljx",               L"Clojure"},
+    {L".cljscm",             L"Clojure"},
+    {L".cljs.hl",            L"Clojure"},
+    {L".cl2",                L"Clojure"},
+    {L".boot",               L"Clojure"},
     {L".clj",                L"Clojure"},
     {L".cljs",               L"ClojureScript"},
     {L".cljc",               L"ClojureC"},
     {L".cls",                L"Visual Basic/TeX/Apex Class"},
-//    {L".cmake.in",           L"CMake"},
-//    {L".CMakeLists.txt",     L"CMake"},
+    {L".cmake.in",           L"CMake"},
+    {L".CMakeLists.txt",     L"CMake", 0, WholeName},
     {L".cmake",              L"CMake"},
     {L".cob",                L"COBOL"},
     {L".COB",                L"COBOL"},
@@ -370,12 +2843,12 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".component",          L"Visualforce Component"},
     {L".cg3",                L"Constraint Grammar"},
     {L".rlx",                L"Constraint Grammar"},
-    {L".Containerfile",      L"Containerfile"},
+    {L".Containerfile",      L"Containerfile", 0, WholeName},
     {L".cpp",                L"C++"},
     {L".CPP",                L"C++"},
     {L".cr",                 L"Crystal"},
     {L".cs",                 L"C#/Smalltalk"},
-//    {L".designer.cs",        L"C# Designer"},
+    {L".designer.cs",        L"C# Designer"},
     {L".cake",               L"Cake Build Script"},
     {L".csh",                L"C Shell"},
     {L".cson",               L"CSON"},
@@ -403,8 +2876,8 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".ado",                L"Stata"},
     {L".do",                 L"Stata"},
     {L".DO",                 L"Stata"},
-    {L".Dockerfile",         L"Dockerfile"},
-    {L".dockerfile",         L"Dockerfile"},
+    {L".Dockerfile",         L"Dockerfile", 0, WholeName},
+    {L".dockerfile",         L"Dockerfile", 0, WholeName},
     {L".pascal",             L"Pascal"},
     {L".lpr",                L"Pascal"},
     {L".dfm",                L"Delphi Form"},
@@ -425,11 +2898,11 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".ERB",                L"ERB"},
     {L".yrl",                L"Erlang"},
     {L".xrl",                L"Erlang"},
-//    {L".rebar.lock",         L"Erlang"},
-//    {L".rebar.config.lock",  L"Erlang"},
-//    {L".rebar.config",       L"Erlang"},
-    {L".emakefile",          L"Erlang"},
-//    {L".app.src",            L"Erlang"},
+    {L".rebar.lock",         L"Erlang", 0, WholeName},
+    {L".rebar.config.lock",  L"Erlang", 0, WholeName},
+    {L".rebar.config",       L"Erlang", 0, WholeName},
+    {L".emakefile",          L"Erlang", 0, WholeName},
+    {L".app.src",            L"Erlang"},
     {L".erl",                L"Erlang"},
     {L".exp",                L"Expect"},
     {L".4th",                L"Forth"},
@@ -467,8 +2940,8 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".fsx",                L"F# Script"},
     {L".fut",                L"Futhark"},
     {L".fxml",               L"FXML"},
-    {L".gnumakefile",        L"make"},
-    {L".Gnumakefile",        L"make"},
+    {L".gnumakefile",        L"make", 0, WholeName},
+    {L".Gnumakefile",        L"make", 0, WholeName},
     {L".gd",                 L"GDScript"},
     {L".gdshader",           L"Godot Shaders"},
     {L".vshader",            L"GLSL"},
@@ -506,7 +2979,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".groovy",             L"Groovy"},
     {L".gant",               L"Groovy"},
     {L".gradle",             L"Gradle"},
-//    {L".gradle.kts",         L"Gradle"},
+    {L".gradle.kts",         L"Gradle"},
     {L".h",                  L"C/C++ Header"},
     {L".H",                  L"C/C++ Header"},
     {L".hh",                 L"C/C++ Header"},
@@ -526,7 +2999,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".shader",             L"HLSL"},
     {L".cg",                 L"HLSL"},
     {L".cginc",              L"HLSL"},
-//    {L".haml.deface",        L"Haml"},
+    {L".haml.deface",        L"Haml"},
     {L".haml",               L"Haml"},
     {L".handlebars",         L"Handlebars"},
     {L".hbs",                L"Handlebars"},
@@ -536,7 +3009,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".HC",                 L"HolyC"},
     {L".hoon",               L"Hoon"},
     {L".xht",                L"HTML"},
-//    {L".html.hl",            L"HTML"},
+    {L".html.hl",            L"HTML"},
     {L".htm",                L"HTML"},
     {L".html",               L"HTML"},
     {L".heex",               L"HTML EEx"},
@@ -551,7 +3024,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".imba",               L"Imba"},
     {L".prefs",              L"INI"},
     {L".lektorproject",      L"INI"},
-//    {L".buildozer.spec",     L"INI"},
+    {L".buildozer.spec",     L"INI", 0, WholeName},
     {L".ini",                L"INI"},
     {L".editorconfig",       L"INI"},
     {L".ism",                L"InstallShield"},
@@ -597,16 +3070,16 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".webmanifest",        L"JSON"},
     {L".webapp",             L"JSON"},
     {L".topojson",           L"JSON"},
-//    {L".tfstate.backup",     L"JSON"},
+    {L".tfstate.backup",     L"JSON"},
     {L".tfstate",            L"JSON"},
-//    {L".mcmod.info",         L"JSON"},
+    {L".mcmod.info",         L"JSON", 0, WholeName},
     {L".mcmeta",             L"JSON"},
     {L".json-tmlanguage",    L"JSON"},
     {L".jsonl",              L"JSON"},
     {L".har",                L"JSON"},
     {L".gltf",               L"JSON"},
     {L".geojson",            L"JSON"},
-//    {L".composer.lock",      L"JSON"},
+    {L".composer.lock",      L"JSON", 0, WholeName},
     {L".avsc",               L"JSON"},
     {L".watchmanconfig",     L"JSON"},
     {L".tern-project",       L"JSON"},
@@ -648,8 +3121,8 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".lua",                L"Lua"},
     {L".m3",                 L"Modula3"},
     {L".m4",                 L"m4"},
-    {L".makefile",           L"make"},
-    {L".Makefile",           L"make"},
+    {L".makefile",           L"make", 0, WholeName},
+    {L".Makefile",           L"make", 0, WholeName},
     {L".mao",                L"Mako"},
     {L".mako",               L"Mako"},
     {L".workbook",           L"Markdown"},
@@ -661,13 +3134,13 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".mdwn",               L"Markdown"},
     {L".mdown",              L"Markdown"},
     {L".markdown",           L"Markdown"},
-//    {L".contents.lr",        L"Markdown"},
+    {L".contents.lr",        L"Markdown", 0, WholeName},
     {L".md",                 L"Markdown"},
     {L".mc",                 L"Windows Message File"},
     {L".met",                L"Teamcenter met"},
     {L".mg",                 L"Modula3"},
     {L".mojom",              L"Mojo"},
-//    {L".meson.build",        L"Meson"},
+    {L".meson.build",        L"Meson", 0, WholeName},
     {L".metal",              L"Metal"},
     {L".mk",                 L"make"},
     {L".ml4",                L"OCaml"},
@@ -703,7 +3176,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".nims",               L"Nim"},
     {L".nimrod",             L"Nim"},
     {L".nimble",             L"Nim"},
-//    {L".nim.cfg",            L"Nim"},
+    {L".nim.cfg",            L"Nim", 0, WholeName},
     {L".nim",                L"Nim"},
     {L".nix",                L"Nix"},
     {L".nut",                L"Squirrel"},
@@ -722,7 +3195,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".rexfile",            L"Perl"},
     {L".psgi",               L"Perl"},
     {L".ph",                 L"Perl"},
-//    {L".makefile.pl",        L"Perl"},
+    {L".Makefile.PL",        L"Perl", 0, WholeName},
     {L".cpanfile",           L"Perl"},
     {L".al",                 L"Perl"},
     {L".ack",                L"Perl"},
@@ -734,7 +3207,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".phakefile",          L"PHP"},
     {L".ctp",                L"PHP"},
     {L".aw",                 L"PHP"},
-//    {L".php_cs.dist",        L"PHP"},
+    {L".php_cs.dist",        L"PHP"},
     {L".php_cs",             L"PHP"},
     {L".php3",               L"PHP"},
     {L".php4",               L"PHP"},
@@ -752,7 +3225,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".pm6",                L"Raku"},
     {L".raku",               L"Raku"},
     {L".rakumod",            L"Raku"},
-//    {L".pom.xml",            L"Maven"},
+    {L".pom.xml",            L"Maven", 0, WholeName},
     {L".pom",                L"Maven"},
     {L".scad",               L"OpenSCAD"},
     {L".yap",                L"Prolog"},
@@ -782,7 +3255,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".lmi",                L"Python"},
     {L".gypi",               L"Python"},
     {L".gyp",                L"Python"},
-//    {L".build.bazel",        L"Python"},
+    {L".BUILD.bazel",        L"Python", 0, WholeName},
     {L".buck",               L"Python"},
     {L".gclient",            L"Python"},
     {L".py",                 L"Python"},
@@ -813,7 +3286,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".guardfile",          L"Ruby"},
     {L".god",                L"Ruby"},
     {L".gemspec",            L"Ruby"},
-//    {L".gemfile.lock",       L"Ruby"},
+    {L".Gemfile.lock",       L"Ruby", 0, WholeName},
     {L".gemfile",            L"Ruby"},
     {L".fastfile",           L"Ruby"},
     {L".eye",                L"Ruby"},
@@ -836,10 +3309,10 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".rhtml",              L"Ruby HTML"},
     {L".circom",             L"Circom"},
     {L".cairo",              L"Cairo"},
-//    {L".rs.in",              L"Rust"},
+    {L".rs.in",              L"Rust"},
     {L".rs",                 L"Rust"},
-//    {L".rst.txt",            L"reStructuredText"},
-//    {L".rest.txt",           L"reStructuredText"},
+    {L".rst.txt",            L"reStructuredText"},
+    {L".rest.txt",           L"reStructuredText"},
     {L".rest",               L"reStructuredText"},
     {L".rst",                L"reStructuredText"},
     {L".s",                  L"Assembly"},
@@ -933,11 +3406,11 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".e",                  L"Specman e"},
     {L".sql",                L"SQL"},
     {L".SQL",                L"SQL"},
-//    {L".sproc.sql",          L"SQL Stored Procedure"},
-//    {L".spoc.sql",           L"SQL Stored Procedure"},
-//    {L".spc.sql",            L"SQL Stored Procedure"},
-//    {L".udf.sql",            L"SQL Stored Procedure"},
-//    {L".data.sql",           L"SQL Data"},
+    {L".sproc.sql",          L"SQL Stored Procedure"},
+    {L".spoc.sql",           L"SQL Stored Procedure"},
+    {L".spc.sql",            L"SQL Stored Procedure"},
+    {L".udf.sql",            L"SQL Stored Procedure"},
+    {L".data.sql",           L"SQL Data"},
     {L".sss",                L"SugarSS"},
     {L".st",                 L"Smalltalk"},
     {L".rules",              L"Snakemake"},
@@ -1057,9 +3530,9 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".xacro",              L"XML"},
     {L".x3d",                L"XML"},
     {L".wsf",                L"XML"},
-//    {L".web.release.config", L"XML"},
-//    {L".web.debug.config",   L"XML"},
-//    {L".web.config",         L"XML"},
+    {L".web.release.config", L"XML", 0, WholeName},
+    {L".web.debug.config",   L"XML", 0, WholeName},
+    {L".web.config",         L"XML", 0, WholeName},
     {L".wxml",               L"WXML"},
     {L".wxss",               L"WXSS"},
     {L".vxml",               L"XML"},
@@ -1082,7 +3555,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".srdf",               L"XML"},
     {L".shproj",             L"XML"},
     {L".sfproj",             L"XML"},
-//    {L".settings.stylecop",  L"XML"},
+    {L".settings.stylecop",  L"XML", 0, WholeName},
     {L".scxml",              L"XML"},
     {L".rss",                L"XML"},
     {L".resx",               L"XML"},
@@ -1094,11 +3567,11 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".proj",               L"XML"},
     {L".plist",              L"XML"},
     {L".pkgproj",            L"XML"},
-//    {L".packages.config",    L"XML"},
+    {L".packages.config",    L"XML", 0, WholeName},
     {L".osm",                L"XML"},
     {L".odd",                L"XML"},
     {L".nuspec",             L"XML"},
-//    {L".nuget.config",       L"XML"},
+    {L".nuget.config",       L"XML", 0, WholeName},
     {L".nproj",              L"XML"},
     {L".ndproj",             L"XML"},
     {L".natvis",             L"XML"},
@@ -1115,7 +3588,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".fsproj",             L"XML"},
     {L".filters",            L"XML"},
     {L".dotsettings",        L"XML"},
-//    {L".dll.config",         L"XML"},
+    {L".dll.config",         L"XML"},
     {L".ditaval",            L"XML"},
     {L".ditamap",            L"XML"},
     {L".depproj",            L"XML"},
@@ -1129,7 +3602,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".ccproj",             L"XML"},
     {L".builds",             L"XML"},
     {L".axml",               L"XML"},
-//    {L".app.config",         L"XML"},
+    {L".app.config",         L"XML", 0, WholeName},
     {L".ant",                L"XML"},
     {L".admx",               L"XML"},
     {L".adml",               L"XML"},
@@ -1138,7 +3611,7 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".xml",                L"XML"},
     {L".XML",                L"XML"},
     {L".mxml",               L"MXML"},
-//    {L".xml.builder",        L"builder"},
+    {L".xml.builder",        L"builder"},
     {L".build",              L"NAnt script"},
     {L".vim",                L"vim script"},
     {L".swift",              L"Swift"},
@@ -1166,14 +3639,14 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".xtend",              L"Xtend"},
     {L".yacc",               L"yacc"},
     {L".y",                  L"yacc"},
-//    {L".yml.mysql",          L"YAML"},
+    {L".yml.mysql",          L"YAML"},
     {L".yaml-tmlanguage",    L"YAML"},
     {L".syntax",             L"YAML"},
     {L".sublime-syntax",     L"YAML"},
     {L".rviz",               L"YAML"},
     {L".reek",               L"YAML"},
     {L".mir",                L"YAML"},
-//    {L".glide.lock",         L"YAML"},
+    {L".glide.lock",         L"YAML", 0, WholeName},
     {L".gemrc",              L"YAML"},
     {L".clang-tidy",         L"YAML"},
     {L".clang-format",       L"YAML"},
@@ -1183,1312 +3656,13134 @@ REVISION_RECORD_EXTENSION_MAPPING ExtensionMappingTable[] = {
     {L".zsh",                L"zsh"},
 };
 
-/**
- * @brief The global revision state used throughout the entire program
- * run-time.
- */
-PREVISION Revision = NULL;
+/**
+ * @brief This array holds the comment and string syntax of each
+ * REVISION_SYNTAX.
+ *
+ * @note The order must be the same as in the enumeration REVISION_SYNTAX.
+ */
+REVISION_LANGUAGE_SYNTAX LanguageSyntaxes[] = {
+    /* RevisionSyntaxC */
+    {{"//"},                    "/*",       "*/",       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxCNested */
+    {{"//"},                    "/*",       "*/",       TRUE,   "\"'",   '\\'},
+    /* RevisionSyntaxJavaScript */
+    {{"//"},                    "/*",       "*/",       FALSE,  "\"'`",  '\\'},
+    /* RevisionSyntaxCss */
+    {{NULL},                    "/*",       "*/",       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxPhp */
+    {{"//", "#"},               "/*",       "*/",       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxHash */
+    {{"#"},                     NULL,       NULL,       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxCoffeeScript */
+    {{"#"},                     "###",      "###",      FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxPowerShell */
+    {{"#"},                     "<#",       "#>",       FALSE,  "\"'",   '`'},
+    /* RevisionSyntaxNim */
+    {{"#"},                     "#[",       "]#",       TRUE,   "\"",    '\\'},
+    /* RevisionSyntaxNix */
+    {{"#"},                     "/*",       "*/",       FALSE,  "\"",    '\\'},
+    /* RevisionSyntaxHcl */
+    {{"#", "//"},               "/*",       "*/",       FALSE,  "\"",    '\\'},
+    /* RevisionSyntaxSql */
+    {{"--"},                    "/*",       "*/",       FALSE,  "\"'",   0},
+    /* RevisionSyntaxAda */
+    {{"--"},                    NULL,       NULL,       FALSE,  "\"",    0},
+    /* RevisionSyntaxHaskell */
+    {{"--"},                    "{-",       "-}",       TRUE,   "\"",    '\\'},
+    /* RevisionSyntaxLean */
+    {{"--"},                    "/-",       "-/",       TRUE,   "\"",    '\\'},
+    /* RevisionSyntaxLua */
+    {{"--"},                    "--[[",     "]]",       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxLisp */
+    {{";"},                     "#|",       "|#",       TRUE,   "\"",    '\\'},
+    /* RevisionSyntaxIni */
+    {{";", "#"},                NULL,       NULL,       FALSE,  "",     0},
+    /* RevisionSyntaxAssembly */
+    {{";", "#"},                "/*",       "*/",       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxAutoHotkey */
+    {{";"},                     "/*",       "*/",       FALSE,  "\"",    '`'},
+    /* RevisionSyntaxErlang */
+    {{"%"},                     NULL,       NULL,       FALSE,  "\"",    '\\'},
+    /* RevisionSyntaxTex */
+    {{"%"},                     NULL,       NULL,       FALSE,  "",     '\\'},
+    /* RevisionSyntaxProlog */
+    {{"%"},                     "/*",       "*/",       FALSE,  "\"'",   '\\'},
+    /* RevisionSyntaxMl */
+    {{NULL},                    "(*",       "*)",       TRUE,   "\"",    '\\'},
+    /* RevisionSyntaxFSharp */
+    {{"//"},                    "(*",       "*)",       TRUE,   "\"",    '\\'},
+    /* RevisionSyntaxPascal */
+    {{"//"},                    "{",        "}",        FALSE,  "'",    0},
+    /* RevisionSyntaxBasic */
+    {{"'"},                     NULL,       NULL,       FALSE,  "\"",    0},
+    /* RevisionSyntaxFortran */
+    {{"!"},                     NULL,       NULL,       FALSE,  "\"'",   0},
+    /* RevisionSyntaxBatch */
+    {{"::", "REM ", "rem "},    NULL,       NULL,       FALSE,  "\"",    0},
+    /* RevisionSyntaxRexx */
+    {{NULL},                    "/*",       "*/",       TRUE,   "\"'",   0},
+    /* RevisionSyntaxM4 */
+    {{"#", "dnl"},              NULL,       NULL,       FALSE,  "",     0},
+    /* RevisionSyntaxXml */
+    {{NULL},                    "<!--",     "-->",      FALSE,  "",     0},
+    /* RevisionSyntaxJinja */
+    {{NULL},                    "{#",       "#}",       FALSE,  "",     0},
+    /* RevisionSyntaxHandlebars */
+    {{NULL},                    "{{!",      "}}",       FALSE,  "",     0},
+    /* RevisionSyntaxSmarty */
+    {{NULL},                    "{*",       "*}",       FALSE,  "",     0},
+};
+
+/**
+ * @brief This table maps the languages/file types of ExtensionMappingTable
+ * to their syntax. Languages that are not in the table are counted without
+ * comments.
+ */
+REVISION_LANGUAGE_SYNTAX_MAPPING LanguageSyntaxTable[] = {
+    {L"ActionScript",               RevisionSyntaxC},
+    {L"Apex Trigger",               RevisionSyntaxC},
+    {L"Arduino Sketch",             RevisionSyntaxC},
+    {L"AspectJ",                    RevisionSyntaxC},
+    {L"C",                          RevisionSyntaxC},
+    {L"C#/Smalltalk",               RevisionSyntaxC},
+    {L"C# Designer",                RevisionSyntaxC},
+    {L"C++",                        RevisionSyntaxC},
+    {L"C/C++ Header",               RevisionSyntaxC},
+    {L"Cairo",                      RevisionSyntaxC},
+    {L"Cake Build Script",          RevisionSyntaxC},
+    {L"Carbon",                     RevisionSyntaxC},
+    {L"Chapel",                     RevisionSyntaxC},
+    {L"Circom",                     RevisionSyntaxC},
+    {L"CUDA",                       RevisionSyntaxC},
+    {L"D/dtrace",                   RevisionSyntaxC},
+    {L"Flatbuffers",                RevisionSyntaxC},
+    {L"Gleam",                      RevisionSyntaxC},
+    {L"GLSL",                       RevisionSyntaxC},
+    {L"Godot Shaders",              RevisionSyntaxC},
+    {L"Gradle",                     RevisionSyntaxC},
+    {L"Groovy",                     RevisionSyntaxC},
+    {L"Hare",                       RevisionSyntaxC},
+    {L"Haxe",                       RevisionSyntaxC},
+    {L"HLSL",                       RevisionSyntaxC},
+    {L"HolyC",                      RevisionSyntaxC},
+    {L"Java",                       RevisionSyntaxC},
+    {L"Jai",                        RevisionSyntaxC},
+    {L"JSON5",                      RevisionSyntaxC},
+    {L"LESS",                       RevisionSyntaxC},
+    {L"lex",                        RevisionSyntaxC},
+    {L"Logos",                      RevisionSyntaxC},
+    {L"Metal",                      RevisionSyntaxC},
+    {L"Nemerle",                    RevisionSyntaxC},
+    {L"Objective-C++",              RevisionSyntaxC},
+    {L"OpenSCAD",                   RevisionSyntaxC},
+    {L"P4",                         RevisionSyntaxC},
+    {L"Prisma Schema",              RevisionSyntaxC},
+    {L"Protocol Buffers",           RevisionSyntaxC},
+    {L"QML",                        RevisionSyntaxC},
+    {L"ReasonML",                   RevisionSyntaxC},
+    {L"ReScript",                   RevisionSyntaxC},
+    {L"Sass",                       RevisionSyntaxC},
+    {L"SCSS",                       RevisionSyntaxC},
+    {L"Slice",                      RevisionSyntaxC},
+    {L"Solidity",                   RevisionSyntaxC},
+    {L"Squirrel",                   RevisionSyntaxC},
+    {L"Stylus",                     RevisionSyntaxC},
+    {L"SWIG",                       RevisionSyntaxC},
+    {L"TableGen",                   RevisionSyntaxC},
+    {L"Thrift",                     RevisionSyntaxC},
+    {L"Umka",                       RevisionSyntaxC},
+    {L"Vala",                       RevisionSyntaxC},
+    {L"Vala Header",                RevisionSyntaxC},
+    {L"Verilog-SystemVerilog",      RevisionSyntaxC},
+    {L"X++",                        RevisionSyntaxC},
+    {L"Xtend",                      RevisionSyntaxC},
+    {L"yacc",                       RevisionSyntaxC},
+    {L"Zig",                        RevisionSyntaxC},
+    {L"Dart",                       RevisionSyntaxCNested},
+    {L"Kotlin",                     RevisionSyntaxCNested},
+    {L"Odin",                       RevisionSyntaxCNested},
+    {L"Pony",                       RevisionSyntaxCNested},
+    {L"Rust",                       RevisionSyntaxCNested},
+    {L"Scala",                      RevisionSyntaxCNested},
+    {L"Swift",                      RevisionSyntaxCNested},
+    {L"Typst",                      RevisionSyntaxCNested},
+    {L"WGSL",                       RevisionSyntaxCNested},
+    {L"Go",                         RevisionSyntaxJavaScript},
+    {L"JavaScript",                 RevisionSyntaxJavaScript},
+    {L"JSX",                        RevisionSyntaxJavaScript},
+    {L"TypeScript",                 RevisionSyntaxJavaScript},
+    {L"CSS",                        RevisionSyntaxCss},
+    {L"PL/I",                       RevisionSyntaxCss},
+    {L"SAS",                        RevisionSyntaxCss},
+    {L"WXSS",                       RevisionSyntaxCss},
+    {L"PHP",                        RevisionSyntaxPhp},
+    {L"awk",                        RevisionSyntaxHash},
+    {L"Bazel",                      RevisionSyntaxHash},
+    {L"Bourne Again Shell",         RevisionSyntaxHash},
+    {L"Bourne Shell",               RevisionSyntaxHash},
+    {L"C Shell",                    RevisionSyntaxHash},
+    {L"CMake",                      RevisionSyntaxHash},
+    {L"Containerfile",              RevisionSyntaxHash},
+    {L"Crystal",                    RevisionSyntaxHash},
+    {L"Cucumber",                   RevisionSyntaxHash},
+    {L"Cython",                     RevisionSyntaxHash},
+    {L"Dockerfile",                 RevisionSyntaxHash},
+    {L"Elixir",                     RevisionSyntaxHash},
+    {L"Expect",                     RevisionSyntaxHash},
+    {L"Fish Shell",                 RevisionSyntaxHash},
+    {L"GDScript",                   RevisionSyntaxHash},
+    {L"GraphQL",                    RevisionSyntaxHash},
+    {L"Korn Shell",                 RevisionSyntaxHash},
+    {L"make",                       RevisionSyntaxHash},
+    {L"Meson",                      RevisionSyntaxHash},
+    {L"Mojo",                       RevisionSyntaxHash},
+    {L"Perl",                       RevisionSyntaxHash},
+    {L"Properties",                 RevisionSyntaxHash},
+    {L"PRQL",                       RevisionSyntaxHash},
+    {L"Python",                     RevisionSyntaxHash},
+    {L"R",                          RevisionSyntaxHash},
+    {L"Raku",                       RevisionSyntaxHash},
+    {L"RapydScript",                RevisionSyntaxHash},
+    {L"RobotFramework",             RevisionSyntaxHash},
+    {L"Ruby",                       RevisionSyntaxHash},
+    {L"sed",                        RevisionSyntaxHash},
+    {L"Snakemake",                  RevisionSyntaxHash},
+    {L"Starlark",                   RevisionSyntaxHash},
+    {L"Tcl/Tk",                     RevisionSyntaxHash},
+    {L"TOML",                       RevisionSyntaxHash},
+    {L"Vyper",                      RevisionSyntaxHash},
+    {L"YAML",                       RevisionSyntaxHash},
+    {L"zsh",                        RevisionSyntaxHash},
+    {L"CoffeeScript",               RevisionSyntaxCoffeeScript},
+    {L"PowerShell",                 RevisionSyntaxPowerShell},
+    {L"Nim",                        RevisionSyntaxNim},
+    {L"Nix",                        RevisionSyntaxNix},
+    {L"HCL",                        RevisionSyntaxHcl},
+    {L"Oracle PL/SQL",              RevisionSyntaxSql},
+    {L"SQL",                        RevisionSyntaxSql},
+    {L"SQL Stored Procedure",       RevisionSyntaxSql},
+    {L"Ada",                        RevisionSyntaxAda},
+    {L"VHDL",                       RevisionSyntaxAda},
+    {L"Agda",                       RevisionSyntaxHaskell},
+    {L"dhall",                      RevisionSyntaxHaskell},
+    {L"Elm",                        RevisionSyntaxHaskell},
+    {L"Futhark",                    RevisionSyntaxHaskell},
+    {L"Haskell",                    RevisionSyntaxHaskell},
+    {L"Idris",                      RevisionSyntaxHaskell},
+    {L"PureScript",                 RevisionSyntaxHaskell},
+    {L"Lean",                       RevisionSyntaxLean},
+    {L"Lua",                        RevisionSyntaxLua},
+    {L"Clojure",                    RevisionSyntaxLisp},
+    {L"ClojureC",                   RevisionSyntaxLisp},
+    {L"ClojureScript",              RevisionSyntaxLisp},
+    {L"Fennel",                     RevisionSyntaxLisp},
+    {L"LFE",                        RevisionSyntaxLisp},
+    {L"Lisp",                       RevisionSyntaxLisp},
+    {L"LLVM IR",                    RevisionSyntaxLisp},
+    {L"Racket",                     RevisionSyntaxLisp},
+    {L"Scheme",                     RevisionSyntaxLisp},
+    {L"Godot Resource",             RevisionSyntaxIni},
+    {L"Godot Scene",                RevisionSyntaxIni},
+    {L"INI",                        RevisionSyntaxIni},
+    {L"Windows Module Definition",  RevisionSyntaxIni},
+    {L"Assembly",                   RevisionSyntaxAssembly},
+    {L"AutoHotkey",                 RevisionSyntaxAutoHotkey},
+    {L"Erlang",                     RevisionSyntaxErlang},
+    {L"TeX",                        RevisionSyntaxTex},
+    {L"Logtalk",                    RevisionSyntaxProlog},
+    {L"Prolog",                     RevisionSyntaxProlog},
+    {L"Mathematica",                RevisionSyntaxMl},
+    {L"Modula3",                    RevisionSyntaxMl},
+    {L"OCaml",                      RevisionSyntaxMl},
+    {L"Standard ML",                RevisionSyntaxMl},
+    {L"F#",                         RevisionSyntaxFSharp},
+    {L"F# Script",                  RevisionSyntaxFSharp},
+    {L"Pascal",                     RevisionSyntaxPascal},
+    {L"BrightScript",               RevisionSyntaxBasic},
+    {L"Softbridge Basic",           RevisionSyntaxBasic},
+    {L"VB for Applications",        RevisionSyntaxBasic},
+    {L"Visual Basic",               RevisionSyntaxBasic},
+    {L"Visual Basic .NET",          RevisionSyntaxBasic},
+    {L"Visual Basic Script",        RevisionSyntaxBasic},
+    {L"Fortran 90",                 RevisionSyntaxFortran},
+    {L"Fortran 95",                 RevisionSyntaxFortran},
+    {L"DOS Batch",                  RevisionSyntaxBatch},
+    {L"Rexx",                       RevisionSyntaxRexx},
+    {L"m4",                         RevisionSyntaxM4},
+    {L"Ant",                        RevisionSyntaxXml},
+    {L"DITA",                       RevisionSyntaxXml},
+    {L"DTD",                        RevisionSyntaxXml},
+    {L"FXML",                       RevisionSyntaxXml},
+    {L"Glade",                      RevisionSyntaxXml},
+    {L"HTML",                       RevisionSyntaxXml},
+    {L"JavaServer Faces",           RevisionSyntaxXml},
+    {L"Markdown",                   RevisionSyntaxXml},
+    {L"Maven",                      RevisionSyntaxXml},
+    {L"MSBuild script",             RevisionSyntaxXml},
+    {L"MXML",                       RevisionSyntaxXml},
+    {L"NAnt script",                RevisionSyntaxXml},
+    {L"Qt/Glade",                   RevisionSyntaxXml},
+    {L"SVG",                        RevisionSyntaxXml},
+    {L"Web Services Description",   RevisionSyntaxXml},
+    {L"WiX include",                RevisionSyntaxXml},
+    {L"WiX source",                 RevisionSyntaxXml},
+    {L"WiX string localization",    RevisionSyntaxXml},
+    {L"WXML",                       RevisionSyntaxXml},
+    {L"XAML",                       RevisionSyntaxXml},
+    {L"XHTML",                      RevisionSyntaxXml},
+    {L"XMI",                        RevisionSyntaxXml},
+    {L"XML",                        RevisionSyntaxXml},
+    {L"XSD",                        RevisionSyntaxXml},
+    {L"XSLT",                       RevisionSyntaxXml},
+    {L"Jinja Template",             RevisionSyntaxJinja},
+    {L"Nunjucks",                   RevisionSyntaxJinja},
+    {L"Twig",                       RevisionSyntaxJinja},
+    {L"Handlebars",                 RevisionSyntaxHandlebars},
+    {L"Mustache",                   RevisionSyntaxHandlebars},
+    {L"Smarty",                     RevisionSyntaxSmarty},
+};
+
+/**
+ * @brief Slots of the suffix trie. The root is slot zero.
+ *
+ * @note The suffix trie holds every extension of ExtensionMappingTable
+ * spelled backwards, in the native encoding of file names, so a name is
+ * matched with a single pass from its last character, which ends at the
+ * first character that no extension continues with. Every step costs one
+ * probe of the double array. The deepest node passed that holds an
+ * extension is the longest extension of the name: ".blade.php" rather
+ * than ".php". It is built once per process by RevBuildSuffixTrie, and the
+ * slots past the last base cover the largest class.
+ */
+REVISION_SUFFIX_NODE SuffixTrieNodes[REVISION_SUFFIX_TRIE_SLOTS + REVISION_SUFFIX_TRIE_CLASSES];
+
+/**
+ * @brief Class of every character below 0x100 (every byte outside of
+ * Windows), or zero if no extension uses it.
+ */
+UCHAR SuffixTrieClasses[256];
+
+#ifdef _WIN32
+/**
+ * @brief Characters above 0xFF used by the extensions, and their classes.
+ */
+WCHAR SuffixTrieWideUnits[REVISION_SUFFIX_TRIE_WIDE_UNITS];
+UCHAR SuffixTrieWideClasses[REVISION_SUFFIX_TRIE_WIDE_UNITS];
+ULONG CountOfSuffixTrieWideUnits;
+#endif
+
+/**
+ * @brief Number of character classes of the suffix trie, including class
+ * zero.
+ */
+ULONG CountOfSuffixTrieClasses;
+
+/**
+ * @brief Name of every language/file type, indexed by the language ID.
+ */
+PWCHAR LanguageTable[ARRAYSIZE(ExtensionMappingTable)];
+
+/**
+ * @brief Number of distinct languages/file types in LanguageTable.
+ */
+ULONG CountOfLanguages;
+
+/**
+ * @brief Syntax of every language/file type, indexed by the language ID.
+ * NULL for languages counted without comments.
+ */
+PREVISION_LANGUAGE_SYNTAX LanguageSyntax[ARRAYSIZE(ExtensionMappingTable)];
+
+/**
+ * @brief Processor features (REVISION_CPU_FEATURE_*) detected by
+ * RevQueryCpuFeatures.
+ */
+ULONG CpuFeatures;
+
+/**
+ * @brief The line counting kernel selected for this processor by
+ * RevSelectLineCounter.
+ */
+PREVISION_LINE_COUNTER LineCounter;
+
+/**
+ * @brief State of the one-time initialization of the language, extension
+ * and line counting tables above (REVISION_TABLES_*). The tables are
+ * shared by every revision in the process and only read once built.
+ */
+volatile LONG TablesState = REVISION_TABLES_UNINITIALIZED;
+
+/**
+ * @brief Indicates whether ANSI escape sequences are supported.
+ */
+BOOL SupportAnsi;
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+/**
+ * @brief This function retrieves the calling thread's last-error code
+ * value and translates it into its corresponding error message.
+ *
+ * @return A pointer to the error message string on success,
+ * or NULL on failure.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevGetLastKnownWin32Error(
+    VOID
+    );
+
+/**
+ * @brief This function appends one unicode string to another and returns
+ * the result.
+ *
+ * @param String1 The first string (to which String2 will be appended).
+ *
+ * @param String2 The second string (to be appended to String1).
+ *
+ * @return A new string containing the concatenation of String1 and
+ * String2. NULL if the function failed.
+ *
+ * @remarks The caller is responsible for freeing the memory.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevStringAppend(
+    _In_z_ PWCHAR String1,
+    _In_z_ PWCHAR String2
+    );
+
+/**
+ * @brief This function prepends one unicode string to another and
+ * returns the result.
+ *
+ * @param String1 Supplies the first string (to be appended to).
+ *
+ * @param String2 Supplies the second string (to be prepended).
+ *
+ * @return A new string containing the concatenation of String1 and
+ * String2. NULL if the function failed.
+ *
+ * @remarks N.B. The caller is responsible for freeing the memory.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevStringPrepend(
+    _In_z_ PWCHAR String1,
+    _In_z_ PWCHAR String2
+    );
+
+#ifndef _WIN32
+/**
+ * @brief This function converts a unicode string to the native multibyte
+ * encoding used by the file system.
+ *
+ * @param String Supplies the string to be converted.
+ *
+ * @return A new string in the native encoding. NULL if the function
+ * failed.
+ *
+ * @remarks The caller is responsible for freeing the memory.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PCHAR
+RevConvertToMultiByte(
+    _In_z_ PWCHAR String
+    );
+#endif
+
+/**
+ * @brief This function normalizes the path of a root directory, the same
+ * way for the program and the library: trailing separators are removed,
+ * and on Windows the path is prefixed with "\\?\" to lift the MAX_PATH
+ * limitation.
+ *
+ * @param RootDirectory Supplies the path of the root directory.
+ *
+ * @return A new path in the native encoding. NULL if the function failed.
+ *
+ * @remarks The caller is responsible for freeing the memory.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PPATHCHAR
+RevNormalizeRootDirectory(
+    _In_z_ PWCHAR RootDirectory
+    );
+
+/**
+ * @brief This function is responsible for initializing a revision.
+ * Revisions are independent of each other, so several of them can run
+ * in the same process.
+ *
+ * @param InitParams Supplies the revision initialization parameters.
+ *
+ * @param Revision Receives the revision, to be deleted by
+ * RevDeleteRevision.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevInitializeRevision(
+    _In_ PREVISION_INIT_PARAMS InitParams,
+    _Out_ PREVISION *Revision
+    );
+
+/**
+ * @brief This function is responsible for starting the revision system.
+ * It ensures that the system has been initialized correctly before
+ * proceeding with its operations.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevStartRevision(
+    _Inout_ PREVISION Revision
+    );
+
+/**
+ * @brief This function deletes the revision, releasing its arena and with
+ * it every allocation that lived as long as the revision.
+ *
+ * @param Revision Supplies the revision, or NULL.
+ */
+VOID
+RevDeleteRevision(
+    _In_opt_ PREVISION Revision
+    );
+
+/**
+ * @brief This function initializes an empty arena.
+ *
+ * @param Arena Supplies the arena to be initialized.
+ */
+VOID
+RevInitializeArena(
+    _Out_ PREVISION_ARENA Arena
+    );
+
+/**
+ * @brief This function allocates zeroed memory from an arena.
+ *
+ * @param Arena Supplies the arena.
+ *
+ * @param Size Supplies the number of bytes to allocate.
+ *
+ * @param Alignment Supplies the alignment of the allocation, a power of
+ * two no larger than REVISION_PAGE_SIZE.
+ *
+ * @return The allocation, or NULL if a new block could not be allocated.
+ */
+_Must_inspect_result_
+PVOID
+RevAllocateFromArena(
+    _Inout_ PREVISION_ARENA Arena,
+    _In_ SIZE_T Size,
+    _In_ SIZE_T Alignment
+    );
+
+/**
+ * @brief This function frees every block of an arena, and with them every
+ * allocation made from it.
+ *
+ * @param Arena Supplies the arena.
+ */
+VOID
+RevDeleteArena(
+    _Inout_ PREVISION_ARENA Arena
+    );
+
+/**
+ * @brief This function initializes a revision worker and the resources of
+ * its stage: the task deque and the directory buffer of an enumerator, the
+ * io_uring instance of a reader.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Worker Supplies the worker to be initialized.
+ *
+ * @param Index Supplies the index of the worker.
+ *
+ * @param Stage Supplies the pipeline stage the worker runs.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevInitializeWorker(
+    _Inout_ PREVISION Revision,
+    _Out_ PREVISION_WORKER Worker,
+    _In_ ULONG Index,
+    _In_ REVISION_STAGE Stage
+    );
+
+/**
+ * @brief This function pushes a task to the bottom of the worker's deque,
+ * growing the deque if needed.
+ *
+ * @param Worker Supplies the worker that owns the deque.
+ *
+ * @param Task Supplies the task to be pushed.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevPushTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_TASK Task
+    );
+
+/**
+ * @brief This function pops the most recently pushed task from the bottom
+ * of the worker's own deque.
+ *
+ * @param Worker Supplies the worker that owns the deque.
+ *
+ * @param Task Receives the popped task.
+ *
+ * @return TRUE if a task was popped, FALSE if the deque is empty.
+ */
+_Must_inspect_result_
+BOOL
+RevPopTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _Out_ PREVISION_TASK Task
+    );
+
+/**
+ * @brief This function steals the oldest task from the top of another
+ * worker's deque.
+ *
+ * @param Victim Supplies the worker to steal from.
+ *
+ * @param Task Receives the stolen task.
+ *
+ * @return TRUE if a task was stolen, FALSE if the deque is empty.
+ */
+_Must_inspect_result_
+BOOL
+RevStealTask(
+    _Inout_ PREVISION_WORKER Victim,
+    _Out_ PREVISION_TASK Task
+    );
+
+/**
+ * @brief This function schedules a new task on the worker. If the task
+ * cannot be queued, it is executed in place.
+ *
+ * @param Worker Supplies the worker scheduling the task.
+ *
+ * @param Type Supplies the type of the task.
+ *
+ * @param Directory Supplies the directory to be enumerated. The task
+ * takes a new reference to it.
+ *
+ * @param Name Supplies the name of the entry. It must stay valid until the
+ * task is executed.
+ */
+VOID
+RevScheduleTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ REVISION_TASK_TYPE Type,
+    _Inout_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name
+    );
+
+/**
+ * @brief This function executes a task and releases its resources.
+ *
+ * @param Worker Supplies the worker executing the task.
+ *
+ * @param Task Supplies the task to be executed.
+ */
+VOID
+RevExecuteTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_TASK Task
+    );
+
+/**
+ * @brief This function runs the enumerator loop: it executes tasks from
+ * the worker's own deque, steals tasks from other enumerators when it runs
+ * out of work, and returns when no tasks are pending in the revision.
+ *
+ * @param Worker Supplies the worker to be run.
+ */
+VOID
+RevRunWorker(
+    _Inout_ PREVISION_WORKER Worker
+    );
+
+/**
+ * @brief This function runs the reader loop: it reads the files submitted
+ * to the pipeline and passes them on to the counters, and returns once
+ * the enumeration is finished and every submitted file has been read.
+ *
+ * @param Worker Supplies the worker to be run.
+ */
+VOID
+RevRunReader(
+    _Inout_ PREVISION_WORKER Worker
+    );
+
+/**
+ * @brief This function runs the counter loop: it counts the lines of the
+ * files read by the readers and recycles their buffers, and returns once
+ * every file of the revision has been counted.
+ *
+ * @param Worker Supplies the worker to be run.
+ */
+VOID
+RevRunCounter(
+    _Inout_ PREVISION_WORKER Worker
+    );
+
+/**
+ * @brief This function is the entry point of a revision worker thread. It
+ * runs the loop of the worker's stage.
+ *
+ * @param Parameter Supplies the worker to be run.
+ *
+ * @return Always zero.
+ */
+DWORD
+WINAPI
+RevWorkerThreadProc(
+    _In_ LPVOID Parameter
+    );
+
+/**
+ * @brief This function merges the statistics collected by the worker into
+ * the revision and releases the worker's resources.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Worker Supplies the worker to be merged.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevMergeWorker(
+    _Inout_ PREVISION Revision,
+    _Inout_ PREVISION_WORKER Worker
+    );
+
+/**
+ * @brief This function initializes a pipeline queue, allocating its cells
+ * from the revision arena.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Queue Supplies the queue to be initialized.
+ *
+ * @param Capacity Supplies the number of cells (must be a power of two).
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevInitializeQueue(
+    _Inout_ PREVISION Revision,
+    _Out_ PREVISION_QUEUE Queue,
+    _In_ ULONG Capacity
+    );
+
+/**
+ * @brief This function pushes a file buffer to a pipeline queue.
+ *
+ * @param Queue Supplies the queue.
+ *
+ * @param Item Supplies the file buffer.
+ *
+ * @return TRUE if succeeded, FALSE if the queue is full.
+ */
+_Must_inspect_result_
+BOOL
+RevPushQueue(
+    _Inout_ PREVISION_QUEUE Queue,
+    _In_ PREVISION_FILE_BUFFER Item
+    );
+
+/**
+ * @brief This function pops the oldest file buffer from a pipeline queue.
+ *
+ * @param Queue Supplies the queue.
+ *
+ * @param Item Receives the file buffer.
+ *
+ * @return TRUE if succeeded, FALSE if the queue is empty.
+ */
+_Must_inspect_result_
+BOOL
+RevPopQueue(
+    _Inout_ PREVISION_QUEUE Queue,
+    _Out_ PREVISION_FILE_BUFFER *Item
+    );
+
+/**
+ * @brief This function allocates the file buffers and the queues of the
+ * pipeline from the revision arena, and puts every buffer in the free
+ * queue.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param CountOfFileBuffers Supplies the number of file buffers.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevInitializePipeline(
+    _Inout_ PREVISION Revision,
+    _In_ ULONG CountOfFileBuffers
+    );
+
+/**
+ * @brief This function submits a file to the pipeline. If every file
+ * buffer is taken, the enumerator helps the readers and counters until a
+ * buffer is recycled.
+ *
+ * @param Worker Supplies the enumerator submitting the file.
+ *
+ * @param Directory Supplies the directory containing the file. The file
+ * takes a new reference to it.
+ *
+ * @param FileName Supplies the name of the file. It must stay valid until
+ * the file is read.
+ *
+ * @param Mapping Supplies the extension mapping the enumerator found for
+ * the name, so that the file is not looked up again.
+ */
+VOID
+RevSubmitFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ PREVISION_RECORD_EXTENSION_MAPPING Mapping
+    );
+
+/**
+ * @brief This function does a unit of work of the later stages on behalf
+ * of an enumerator that is waiting for a free file buffer: it counts a
+ * read file, or reads a submitted one, or yields if there is neither.
+ *
+ * @param Worker Supplies the enumerator.
+ */
+VOID
+RevHelpPipeline(
+    _Inout_ PREVISION_WORKER Worker
+    );
+
+/**
+ * @brief This function reads a submitted file into its buffer with
+ * blocking system calls, or maps it, and passes it on to the counters.
+ * A file that neither fits nor reaches the map threshold is streamed and
+ * counted by the reader itself.
+ *
+ * @param Worker Supplies the worker reading the file.
+ *
+ * @param File Supplies the file.
+ */
+VOID
+RevReadFileBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    );
+
+/**
+ * @brief This function releases the reference of a file that has been
+ * read to its directory, and passes the file on to the counters.
+ *
+ * @param Worker Supplies the worker that read the file. It counts the
+ * file itself if the counters cannot take it.
+ *
+ * @param File Supplies the file.
+ */
+VOID
+RevPassFileBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    );
+
+/**
+ * @brief This function counts the lines of a file that has been read and
+ * recycles its buffer.
+ *
+ * @param Worker Supplies the worker counting the file.
+ *
+ * @param File Supplies the file.
+ */
+VOID
+RevCountFileBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    );
+
+/**
+ * @brief This function retires a file that leaves the pipeline early,
+ * because it failed or has been counted by its reader, and recycles its
+ * buffer.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param File Supplies the file.
+ */
+VOID
+RevRetireFileBuffer(
+    _Inout_ PREVISION Revision,
+    _Inout_ PREVISION_FILE_BUFFER File
+    );
+
+/**
+ * @brief This function initializes a REVISION_DIRECTORY structure. The
+ * directory is not opened until its task is executed.
+ *
+ * @param Directory Supplies the directory to be initialized.
+ *
+ * @param Parent Supplies the parent directory, or NULL if the name is a
+ * path on its own. The directory takes a new reference to it.
+ *
+ * @param Name Supplies the name of the directory. It must outlive the
+ * directory.
+ */
+VOID
+RevInitializeDirectory(
+    _Out_ PREVISION_DIRECTORY Directory,
+    _In_opt_ PREVISION_DIRECTORY Parent,
+    _In_z_ PPATHCHAR Name
+    );
+
+/**
+ * @brief This function opens a directory relative to its parent directory.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory to be opened.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevOpenDirectory(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function takes a new reference to a directory.
+ *
+ * @param Directory Supplies the directory.
+ */
+VOID
+RevReferenceDirectory(
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function releases a reference to a directory. When the last
+ * reference is released, the directory is closed, its entry blocks are
+ * freed and its reference to the parent directory is released too.
+ *
+ * @param Directory Supplies the directory, or NULL.
+ */
+VOID
+RevReleaseDirectory(
+    _In_opt_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function builds the full path of a directory entry by
+ * walking up the chain of parent directories.
+ *
+ * @param Directory Supplies the directory containing the entry, or NULL.
+ *
+ * @param Name Supplies the name of the entry.
+ *
+ * @return A new string containing the full path. NULL if the function
+ * failed.
+ *
+ * @remarks Paths are only needed for reports and error messages, so they
+ * are built lazily. The caller is responsible for freeing the memory.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PPATHCHAR
+RevBuildPath(
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name
+    );
+
+/**
+ * @brief This function enumerates files and subdirectories of the given
+ * directory and schedules a task for each of them.
+ *
+ * @param Worker Supplies the worker performing the enumeration.
+ *
+ * @param Directory Supplies the open directory to enumerate.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevEnumerateDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory
+    );
+
+#ifndef _WIN32
+/**
+ * @brief This function resolves a symbolic link found by the enumeration
+ * of a directory. A link to a directory becomes a directory entry if
+ * symbolic links are followed.
+ *
+ * @param Worker Supplies the worker.
+ *
+ * @param Directory Supplies the directory holding the link.
+ *
+ * @param Entry Supplies the entry of the link.
+ *
+ * @param LinkStat Receives the status of the target of the link.
+ *
+ * @return TRUE if the link is to be kept, FALSE if it is broken, or leads
+ * to neither a regular file nor a directory that can be descended into.
+ */
+_Must_inspect_result_
+BOOL
+RevResolveLinkEntry(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _Inout_ PLINUX_DIRENT64 Entry,
+    _Out_ struct stat *LinkStat
+    );
+#endif
+
+/**
+ * @brief This function builds the language, extension and line counting
+ * tables shared by every revision of the process. The first caller builds
+ * them, concurrent callers wait until they are built.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevInitializeTables(
+    VOID
+    );
+
+/**
+ * @brief This function assigns a dense language ID to every entry of
+ * ExtensionMappingTable, fills LanguageTable and attaches the syntax of
+ * every language in LanguageSyntax.
+ */
+VOID
+RevBuildLanguageTable(
+    VOID
+    );
+
+/**
+ * @brief This function builds the suffix trie of ExtensionMappingTable
+ * used by RevLookupFileName, and assigns the type of every extension.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevBuildSuffixTrie(
+    VOID
+    );
+
+/**
+ * @brief This function returns the class of a character of an extension
+ * while the suffix trie is built, numbering the character if it is new.
+ *
+ * @param Character Supplies the character, in the native encoding.
+ *
+ * @return The class of the character, or zero if there are too many
+ * classes.
+ */
+ULONG
+RevAddSuffixClass(
+    _In_ PATHCHAR Character
+    );
+
+/**
+ * @brief This function looks up the longest extension of a file name in
+ * the mapping table with a single pass of the suffix trie. A WholeName
+ * entry also matches the whole name without its leading dot.
+ *
+ * @param FileName Supplies the name of the file. A path is matched by its
+ * last component.
+ *
+ * @return The mapping of the extension, or NULL if the name has none in
+ * the table.
+ *
+ * @note The extensions are ASCII, so outside of Windows the name is
+ * walked byte by byte in the native encoding, without converting it.
+ */
+_Ret_maybenull_
+PREVISION_RECORD_EXTENSION_MAPPING
+RevLookupFileName(
+    _In_z_ PPATHCHAR FileName
+    );
+
+/**
+ * @brief This function returns the class of a character of a file name
+ * in the suffix trie.
+ *
+ * @param Character Supplies the character, in the native encoding.
+ *
+ * @return The class of the character, or zero if no extension uses it.
+ */
+FORCEINLINE
+ULONG
+RevGetSuffixClass(
+    _In_ PATHCHAR Character
+    )
+{
+#ifdef _WIN32
+    ULONG index;
+
+    if (Character > 0xFF) {
+        for (index = 0; index < CountOfSuffixTrieWideUnits; ++index) {
+            if (SuffixTrieWideUnits[index] == Character) {
+                return SuffixTrieWideClasses[index];
+            }
+        }
+
+        return 0;
+    }
+
+    return SuffixTrieClasses[Character];
+#else
+    return SuffixTrieClasses[(UCHAR)Character];
+#endif
+}
+
+/**
+ * @brief This function finds the child of a suffix trie node for a
+ * character.
+ *
+ * @param Node Supplies the slot of the node.
+ *
+ * @param Character Supplies the character, in the native encoding.
+ *
+ * @return The slot of the child, or REVISION_SUFFIX_TRIE_EMPTY if there is
+ * none.
+ */
+FORCEINLINE
+ULONG
+RevFindSuffixChild(
+    _In_ ULONG Node,
+    _In_ PATHCHAR Character
+    )
+{
+    ULONG characterClass = RevGetSuffixClass(Character);
+    ULONG child = SuffixTrieNodes[Node].Base + characterClass;
+
+    if (characterClass == 0 || SuffixTrieNodes[child].Parent != Node) {
+        return REVISION_SUFFIX_TRIE_EMPTY;
+    }
+
+    return child;
+}
+
+/**
+ * @brief This function looks up a file extension with a linear scan of
+ * the mapping table. It is only kept as a baseline for
+ * RevBenchmarkExtensionLookup.
+ *
+ * @param Extension Supplies the file extension, including the dot.
+ *
+ * @return The mapping of the extension, or NULL if it is not in the
+ * table.
+ */
+_Ret_maybenull_
+PREVISION_RECORD_EXTENSION_MAPPING
+RevLookupExtensionLinear(
+    _In_z_ PWCHAR Extension
+    );
+
+/**
+ * @brief This function measures the cost of the extension lookups made
+ * for every file, with the suffix trie and with a linear scan of the
+ * mapping table, and prints the results.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevBenchmarkExtensionLookup(
+    VOID
+    );
+
+/**
+ * @brief This function counts the lines of a chunk byte by byte, starting
+ * at some offset. The kernels use it for the bytes that do not fill a
+ * whole block.
+ *
+ * @param Buffer Supplies the chunk.
+ *
+ * @param Size Supplies the size of the chunk in bytes.
+ *
+ * @param Offset Supplies the offset to start counting at.
+ *
+ * @param State Supplies the line counts before Offset and receives the
+ * line counts after the chunk.
+ */
+FORCEINLINE
+VOID
+RevCountLinesFrom(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_ SIZE_T Offset,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    ULONGLONG countOfLinesTotal = State->CountOfLinesTotal;
+    ULONGLONG countOfLinesBlank = State->CountOfLinesBlank;
+    ULONGLONG isLineDirty = State->IsLineDirty;
+    ULONGLONG isPreviousCarriageReturn;
+    ULONGLONG isCarriageReturn;
+    ULONGLONG isLineEnd;
+    ULONGLONG isContent;
+    CHAR character;
+
+    if (Offset >= Size) {
+        return;
+    }
+
+    isPreviousCarriageReturn = Offset > 0 ? Buffer[Offset - 1] == '\r' :
+                                            State->IsPreviousCarriageReturn;
+
+    /*
+     * N.B. Line ends and content depend on the data and would mispredict
+     * on every line, so they are accumulated without branches.
+     */
+    for (; Offset < Size; ++Offset) {
+        character = Buffer[Offset];
+        isCarriageReturn = character == '\r';
+        isLineEnd = isCarriageReturn |
+                    ((character == '\n') & (isPreviousCarriageReturn ^ 1));
+        isContent = (character != ' ') &
+                    ((unsigned char)(character - '\t') > '\r' - '\t');
+
+        isLineDirty |= isContent;
+        countOfLinesTotal += isLineEnd;
+        countOfLinesBlank += isLineEnd & (isLineDirty ^ 1);
+        isLineDirty &= isLineEnd ^ 1;
+        isPreviousCarriageReturn = isCarriageReturn;
+    }
+
+    State->CountOfLinesTotal = countOfLinesTotal;
+    State->CountOfLinesBlank = countOfLinesBlank;
+    State->IsLineDirty = isLineDirty;
+    State->IsPreviousCarriageReturn = isPreviousCarriageReturn;
+    State->IsLineOpen = Buffer[Size - 1] != '\n' && Buffer[Size - 1] != '\r';
+}
+
+/**
+ * @brief This function completes the line counts of a file after its
+ * last chunk: the last line counts even without a line end.
+ *
+ * @param State Supplies the line counts after the last chunk and receives
+ * the line counts of the file.
+ */
+FORCEINLINE
+VOID
+RevCompleteLineCount(
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    State->CountOfLinesTotal += State->IsLineOpen;
+    State->CountOfLinesBlank += State->IsLineOpen & (State->IsLineDirty ^ 1);
+}
+
+/**
+ * @brief This function counts the set bits of a value.
+ *
+ * @param Value Supplies the value.
+ *
+ * @return The number of set bits.
+ */
+FORCEINLINE
+ULONG
+RevPopCount64(
+    _In_ ULONGLONG Value
+    )
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (ULONG)__builtin_popcountll(Value);
+#else
+    Value = Value - ((Value >> 1) & 0x5555555555555555ULL);
+    Value = (Value & 0x3333333333333333ULL) + ((Value >> 2) & 0x3333333333333333ULL);
+    Value = (Value + (Value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+    return (ULONG)((Value * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * @brief This function counts the trailing zero bits of a value.
+ *
+ * @param Value Supplies the value, which must not be zero.
+ *
+ * @return The index of the lowest set bit.
+ */
+FORCEINLINE
+ULONG
+RevCountTrailingZeros64(
+    _In_ ULONGLONG Value
+    )
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (ULONG)__builtin_ctzll(Value);
+#else
+    return RevPopCount64((Value & (0 - Value)) - 1);
+#endif
+}
+
+/**
+ * @brief This function counts the lines of a block of 64 bytes from the
+ * byte class masks of the block, bit i standing for byte i.
+ *
+ * @param LineFeeds Supplies the mask of "\n" bytes.
+ *
+ * @param CarriageReturns Supplies the mask of "\r" bytes.
+ *
+ * @param Spaces Supplies the mask of white space bytes, line breaks
+ * included.
+ *
+ * @param State Supplies the line counts before the block and receives the
+ * line counts after it.
+ */
+FORCEINLINE
+VOID
+RevCountLinesInBlock(
+    _In_ ULONGLONG LineFeeds,
+    _In_ ULONGLONG CarriageReturns,
+    _In_ ULONGLONG Spaces,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    ULONGLONG lineEnds;
+    ULONGLONG insideLines;
+    ULONGLONG partialSum;
+    ULONGLONG sum;
+
+    lineEnds = CarriageReturns |
+               (LineFeeds & ~((CarriageReturns << 1) | State->IsPreviousCarriageReturn));
+    insideLines = ~lineEnds;
+
+    /*
+     * Adding the content bytes to the bytes inside the lines carries from
+     * every content byte up to the end of its line, so exactly the line
+     * ends of lines with content receive a carry. The carry out of the
+     * block is the state of the line that goes on in the next block.
+     */
+    partialSum = insideLines + ~Spaces;
+    sum = partialSum + State->IsLineDirty;
+
+    State->CountOfLinesTotal += RevPopCount64(lineEnds);
+    State->CountOfLinesBlank += RevPopCount64(lineEnds & ~sum);
+    State->IsLineDirty = (partialSum < insideLines) | (sum < partialSum);
+    State->IsPreviousCarriageReturn = CarriageReturns >> 63;
+    State->IsLineOpen = ((LineFeeds | CarriageReturns) >> 63) ^ 1;
+}
+
+/**
+ * @brief This function extends a run of plain bytes with a block of 64
+ * bytes from the byte class masks of the block, bit i standing for byte i.
+ *
+ * @param Stops Supplies the mask of stop bytes.
+ *
+ * @param Spaces Supplies the mask of white space bytes.
+ *
+ * @param Offset Supplies the offset of the block and receives the offset
+ * of the end of the run, or of the block if the run goes on.
+ *
+ * @param IsContent Receives TRUE if the run holds a byte other than white
+ * space within the block, and is left unchanged otherwise.
+ *
+ * @return TRUE if the run ends in the block, FALSE if it goes on.
+ */
+FORCEINLINE
+BOOL
+RevSkipPlainBlock(
+    _In_ ULONGLONG Stops,
+    _In_ ULONGLONG Spaces,
+    _Inout_ PSIZE_T Offset,
+    _Inout_ PBOOL IsContent
+    )
+{
+    ULONGLONG plain = ~0ULL;
+    ULONG length = 64;
+
+    if (Stops != 0) {
+        length = RevCountTrailingZeros64(Stops);
+        plain = (1ULL << length) - 1;
+    }
+
+    if ((plain & ~Spaces) != 0) {
+        *IsContent = TRUE;
+    }
+
+    *Offset += length;
+
+    return Stops != 0;
+}
+
+/**
+ * @brief This function gathers the marks of RevMatchBytes into a mask.
+ *
+ * @param Marks Supplies 0x80 in some bytes of a word, zero in the others.
+ *
+ * @return A mask with bit i set if byte i of the word is marked.
+ */
+FORCEINLINE
+ULONGLONG
+RevGatherByteMarks(
+    _In_ ULONGLONG Marks
+    )
+{
+    return ((Marks >> 7) * 0x0102040810204080ULL) >> 56;
+}
+
+/**
+ * @brief This function marks the bytes of a word equal to some byte.
+ *
+ * @param Word Supplies eight bytes of the buffer.
+ *
+ * @param Pattern Supplies the byte to match, repeated eight times.
+ *
+ * @return 0x80 in every byte of Word that matches, zero in the others.
+ */
+FORCEINLINE
+ULONGLONG
+RevMatchBytes(
+    _In_ ULONGLONG Word,
+    _In_ ULONGLONG Pattern
+    )
+{
+    const ULONGLONG lowBits = 0x7F7F7F7F7F7F7F7FULL;
+    ULONGLONG difference = Word ^ Pattern;
+
+    /*
+     * N.B. Unlike the usual "has zero byte" trick, this does not carry
+     * between bytes, so every byte is marked exactly.
+     */
+    return ~(((difference & lowBits) + lowBits) | difference | lowBits);
+}
+
+/**
+ * @brief This function loads eight unaligned bytes of a buffer.
+ *
+ * @param Buffer Supplies the address of the bytes.
+ *
+ * @return The bytes.
+ */
+FORCEINLINE
+ULONGLONG
+RevLoadWord(
+    _In_reads_bytes_(8) const CHAR *Buffer
+    )
+{
+    ULONGLONG word;
+
+    memcpy(&word, Buffer, sizeof(word));
+
+    return word;
+}
+
+/**
+ * @brief This function counts the lines of a buffer byte by byte. It is
+ * the reference the other kernels are checked against.
+ */
+REVISION_COUNT_LINES_ROUTINE RevCountLinesScalar;
+
+/**
+ * @brief This function counts the lines of a buffer eight bytes at a time
+ * in general purpose registers. It runs on any processor.
+ */
+REVISION_COUNT_LINES_ROUTINE RevCountLinesSwar;
+
+/**
+ * @brief This function skips plain bytes eight bytes at a time in general
+ * purpose registers.
+ */
+REVISION_SKIP_PLAIN_BYTES_ROUTINE RevSkipPlainBytesSwar;
+
+#ifdef REVISION_X86
+
+/**
+ * @brief This function counts the lines of a buffer 16 bytes at a time
+ * with SSE2.
+ */
+REVISION_COUNT_LINES_ROUTINE RevCountLinesSse2;
+
+/**
+ * @brief This function skips plain bytes 16 bytes at a time with SSE2.
+ */
+REVISION_SKIP_PLAIN_BYTES_ROUTINE RevSkipPlainBytesSse2;
+
+/**
+ * @brief This function counts the lines of a buffer 32 bytes at a time
+ * with AVX2.
+ */
+REVISION_COUNT_LINES_ROUTINE RevCountLinesAvx2;
+
+/**
+ * @brief This function skips plain bytes 32 bytes at a time with AVX2.
+ */
+REVISION_SKIP_PLAIN_BYTES_ROUTINE RevSkipPlainBytesAvx2;
+
+/**
+ * @brief This function counts the lines of a buffer 64 bytes at a time
+ * with AVX-512BW.
+ */
+REVISION_COUNT_LINES_ROUTINE RevCountLinesAvx512;
+
+/**
+ * @brief This function skips plain bytes 64 bytes at a time with
+ * AVX-512BW.
+ */
+REVISION_SKIP_PLAIN_BYTES_ROUTINE RevSkipPlainBytesAvx512;
+
+#endif
+
+/**
+ * @brief This function detects the processor features the line counting
+ * kernels are dispatched on and stores them in CpuFeatures.
+ */
+VOID
+RevQueryCpuFeatures(
+    VOID
+    );
+
+/**
+ * @brief This function selects the fastest line counting kernel the
+ * processor supports and stores it in LineCounter.
+ */
+VOID
+RevSelectLineCounter(
+    VOID
+    );
+
+/**
+ * @brief This function checks every line counting kernel the processor
+ * supports against the scalar kernel, and the line classifier with the
+ * skip routine of every kernel against the classifier walking every byte.
+ * It measures their throughput and prints the results.
+ *
+ * @return TRUE if succeeded, FALSE if failed or if the kernels disagree.
+ */
+_Must_inspect_result_
+BOOL
+RevBenchmarkLineCounters(
+    VOID
+    );
+
+/**
+ * @brief This function builds the byte classes of a syntax from its
+ * markers and string delimiters.
+ *
+ * @param Syntax Supplies the syntax.
+ */
+VOID
+RevBuildSyntaxClasses(
+    _Inout_ PREVISION_LANGUAGE_SYNTAX Syntax
+    );
+
+/**
+ * @brief This function checks whether a marker starts at some offset of
+ * a buffer.
+ *
+ * @param Buffer Supplies the contents of the file.
+ *
+ * @param Size Supplies the size of the buffer in bytes.
+ *
+ * @param Offset Supplies the offset of the candidate marker.
+ *
+ * @param Marker Supplies the marker, or NULL.
+ *
+ * @return The length of the marker if it matches, zero otherwise.
+ */
+FORCEINLINE
+SIZE_T
+RevMatchMarker(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_ SIZE_T Offset,
+    _In_opt_ const CHAR *Marker
+    )
+{
+    SIZE_T length = 0;
+
+    if (Marker == NULL) {
+        return 0;
+    }
+
+    for (; Marker[length] != '\0'; ++length) {
+        if (Offset + length >= Size ||
+            Buffer[Offset + length] != Marker[length]) {
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * @brief This function classifies every line of a chunk of a file as
+ * code, comment or blank in a single pass. Chunks are classified in
+ * order, the scanner carries the lexical state from one to the next.
+ *
+ * @param Buffer Supplies the chunk.
+ *
+ * @param Size Supplies the size of the chunk in bytes.
+ *
+ * @param IsLastChunk Supplies whether the chunk ends the file.
+ *
+ * @param Syntax Supplies the comment and string syntax of the language.
+ *
+ * @param SkipRoutine Supplies the routine that skips runs of plain bytes,
+ * or NULL to walk every byte.
+ *
+ * @param Scanner Supplies the state before the chunk and receives the
+ * state after it.
+ *
+ * @return The number of bytes classified. Unless the chunk is the last
+ * one, up to REVISION_MAX_MARKER_LENGTH - 1 bytes at its end are left for
+ * the next chunk.
+ *
+ * @remarks Lines end and are blank as for the line counting kernels. A
+ * line that is not blank is a comment line if nothing but comments and
+ * white space is on it, and a code line otherwise.
+ */
+SIZE_T
+RevClassifyLines(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_ BOOL IsLastChunk,
+    _In_ PREVISION_LANGUAGE_SYNTAX Syntax,
+    _In_opt_ PREVISION_SKIP_PLAIN_BYTES_ROUTINE SkipRoutine,
+    _Inout_ PREVISION_SCANNER Scanner
+    );
+
+/**
+ * @brief This function opens a file for sequential reading.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory containing the file, or NULL.
+ *
+ * @param FileName Supplies the name of the file to be opened.
+ *
+ * @param File Receives the handle of the file.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ *
+ * @remarks The caller is responsible for closing the file with
+ * RevCloseFile.
+ */
+_Must_inspect_result_
+BOOL
+RevOpenFile(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _Out_ FILEHANDLE *File
+    );
+
+/**
+ * @brief This function reads the next chunk of a file.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory containing the file, or NULL.
+ *
+ * @param FileName Supplies the name of the file, for error messages.
+ *
+ * @param File Supplies the handle of the file.
+ *
+ * @param Buffer Supplies the buffer that receives the chunk.
+ *
+ * @param Size Supplies the size of the buffer in bytes.
+ *
+ * @param BytesRead Receives the number of bytes read. It is less than
+ * Size only at the end of the file.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevReadFileChunk(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _Out_writes_bytes_(Size) PCHAR Buffer,
+    _In_ SIZE_T Size,
+    _Out_ SIZE_T *BytesRead
+    );
+
+/**
+ * @brief This function retrieves the size of an open file.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory containing the file, or NULL.
+ *
+ * @param FileName Supplies the name of the file, for error messages.
+ *
+ * @param File Supplies the handle of the file.
+ *
+ * @param FileSize Receives the size of the file in bytes.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevQueryFileSize(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _Out_ ULONGLONG *FileSize
+    );
+
+/**
+ * @brief This function maps an entire file into memory for reading, and
+ * hints the system that the view will be read once, from start to end.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory containing the file, or NULL.
+ *
+ * @param FileName Supplies the name of the file, for error messages.
+ *
+ * @param File Supplies the handle of the file.
+ *
+ * @param FileSize Supplies the size of the file in bytes. It must not be
+ * zero.
+ *
+ * @param View Receives the address of the view.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ *
+ * @remarks The caller is responsible for unmapping the view with
+ * RevUnmapFile. The file handle may be closed while the view is mapped.
+ */
+_Must_inspect_result_
+BOOL
+RevMapFile(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _In_ SIZE_T FileSize,
+    _Out_ const CHAR **View
+    );
+
+/**
+ * @brief This function unmaps a view mapped by RevMapFile.
+ *
+ * @param View Supplies the address of the view.
+ *
+ * @param FileSize Supplies the size of the file in bytes.
+ */
+VOID
+RevUnmapFile(
+    _In_ const CHAR *View,
+    _In_ SIZE_T FileSize
+    );
+
+/**
+ * @brief This function closes a file opened by RevOpenFile.
+ *
+ * @param File Supplies the handle of the file.
+ */
+VOID
+RevCloseFile(
+    _In_ FILEHANDLE File
+    );
+
+/**
+ * @brief This function queries the version of a file for the scan cache
+ * without opening it where the platform allows (on Linux, one fstatat
+ * relative to the open directory).
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory containing the file, or NULL.
+ *
+ * @param FileName Supplies the name of the file.
+ *
+ * @param CacheKey Receives the version of the file.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevQueryFileKey(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _Out_ PREVISION_CACHE_KEY CacheKey
+    );
+
+/**
+ * @brief This function queries the version of an open directory for the
+ * scan cache into its CacheKey.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the directory.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevQueryDirectoryKey(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function checks whether a directory entry exists and is a
+ * directory, following symbolic links. Nothing is logged if it does not
+ * exist.
+ *
+ * @param Directory Supplies the directory containing the entry.
+ *
+ * @param Name Supplies the name of the entry.
+ *
+ * @param IsDirectory Receives whether the entry is a directory.
+ *
+ * @return TRUE if the entry exists, FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevQueryIsDirectory(
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name,
+    _Out_ PBOOL IsDirectory
+    );
+
+/**
+ * @brief This function writes a scan cache file. The file is written next
+ * to the cache and renamed over it, so that an interrupted write leaves
+ * the previous cache intact.
+ *
+ * @param Revision Supplies the revision whose cache is written.
+ *
+ * @param Header Supplies the header of the file.
+ *
+ * @param Entries Supplies the entries following the header.
+ *
+ * @param Directories Supplies the directories following the entries.
+ *
+ * @param Names Supplies the subdirectory names following the directories.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevWriteCacheFile(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_CACHE_HEADER Header,
+    _In_ const REVISION_CACHE_ENTRY *Entries,
+    _In_ const REVISION_CACHE_DIRECTORY *Directories,
+    _In_ const PATHCHAR *Names
+    );
+
+/**
+ * @brief This function takes a read buffer from a worker buffer pool,
+ * allocating one if the pool has none of the size class.
+ *
+ * @param Pool Supplies the buffer pool.
+ *
+ * @param Size Supplies the number of bytes needed. Sizes above the largest
+ * class get a buffer of the largest class.
+ *
+ * @param Capacity Receives the size of the buffer.
+ *
+ * @return The page aligned buffer, or NULL if the allocation failed.
+ */
+_Must_inspect_result_
+PCHAR
+RevAcquireBuffer(
+    _Inout_ PREVISION_BUFFER_POOL Pool,
+    _In_ SIZE_T Size,
+    _Out_ SIZE_T *Capacity
+    );
+
+/**
+ * @brief This function returns a read buffer to the pool it was taken
+ * from, to be reused for the next file.
+ *
+ * @param Pool Supplies the buffer pool.
+ *
+ * @param Buffer Supplies the buffer.
+ *
+ * @param Capacity Supplies the size of the buffer.
+ */
+VOID
+RevReleaseBuffer(
+    _Inout_ PREVISION_BUFFER_POOL Pool,
+    _In_ PCHAR Buffer,
+    _In_ SIZE_T Capacity
+    );
+
+/**
+ * @brief This function frees every buffer of a worker buffer pool.
+ *
+ * @param Pool Supplies the buffer pool.
+ */
+VOID
+RevDeleteBufferPool(
+    _Inout_ PREVISION_BUFFER_POOL Pool
+    );
+
+/**
+ * @brief This function reads an open file one chunk at a time through a
+ * buffer of the worker buffer pool, and revises it.
+ *
+ * @param Worker Supplies the worker whose statistics are updated.
+ *
+ * @param File Supplies the file, whose buffer is not used.
+ *
+ * @param Handle Supplies the handle of the file, positioned at its start.
+ *
+ * @param FileSize Supplies the size of the file, which selects the size of
+ * the buffer. The file is read to its end whatever its size.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevStreamFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_FILE_BUFFER File,
+    _In_ FILEHANDLE Handle,
+    _In_ ULONGLONG FileSize
+    );
+
+/**
+ * @brief This function counts the lines of a buffer holding the entire
+ * contents of a file of some language/file type.
+ *
+ * @param LanguageId Supplies the language ID of the file.
+ *
+ * @param Buffer Supplies the contents of the file.
+ *
+ * @param Size Supplies the size of the file in bytes.
+ *
+ * @param CountOfLinesTotal Receives the number of lines.
+ *
+ * @param CountOfLinesBlank Receives the number of blank lines.
+ *
+ * @param CountOfLinesComment Receives the number of comment lines.
+ */
+VOID
+RevCountBufferLines(
+    _In_ ULONG LanguageId,
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Out_ PULONGLONG CountOfLinesTotal,
+    _Out_ PULONGLONG CountOfLinesBlank,
+    _Out_ PULONGLONG CountOfLinesComment
+    );
+
+/**
+ * @brief This function revises a file whose entire contents are in memory.
+ *
+ * @param Worker Supplies the worker whose statistics are updated.
+ *
+ * @param File Supplies the file.
+ */
+VOID
+RevReviseBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_FILE_BUFFER File
+    );
+
+/**
+ * @brief This function adds the line counts of a file to the statistics of
+ * a worker.
+ *
+ * @param Worker Supplies the worker whose statistics are updated.
+ *
+ * @param LanguageId Supplies the language ID of the file.
+ *
+ * @param CountOfLinesTotal Supplies the number of lines of the file.
+ *
+ * @param CountOfLinesBlank Supplies the number of blank lines of the file.
+ *
+ * @param CountOfLinesComment Supplies the number of comment lines of the
+ * file.
+ */
+VOID
+RevAddFileLines(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG LanguageId,
+    _In_ ULONGLONG CountOfLinesTotal,
+    _In_ ULONGLONG CountOfLinesBlank,
+    _In_ ULONGLONG CountOfLinesComment
+    );
+
+/**
+ * @brief This function adds the line counts of a revised file to the
+ * statistics of a worker and reports the file to the file callback of the
+ * revision, if any.
+ *
+ * @param Worker Supplies the worker whose statistics are updated.
+ *
+ * @param File Supplies the file. Its directory and name are only needed
+ * when the revision has a file callback.
+ *
+ * @param CountOfLinesTotal Supplies the number of lines of the file.
+ *
+ * @param CountOfLinesBlank Supplies the number of blank lines of the file.
+ *
+ * @param CountOfLinesComment Supplies the number of comment lines of the
+ * file.
+ */
+VOID
+RevRecordFileLines(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_FILE_BUFFER File,
+    _In_ ULONGLONG CountOfLinesTotal,
+    _In_ ULONGLONG CountOfLinesBlank,
+    _In_ ULONGLONG CountOfLinesComment
+    );
+
+/**
+ * @brief This function maps the scan cache file of a revision, if there is
+ * a valid one. A missing, outdated or corrupt cache file is ignored, and
+ * every file is counted.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevLoadCache(
+    _Inout_ PREVISION Revision
+    );
+
+/**
+ * @brief This function checks that the directories of a loaded scan cache
+ * only refer to entries and names inside the cache, and that its entries
+ * only refer to known language IDs.
+ *
+ * @param Cache Supplies the scan cache.
+ *
+ * @return TRUE if the cache is consistent, FALSE if it is corrupt.
+ */
+_Must_inspect_result_
+BOOL
+RevValidateCache(
+    _In_ PREVISION_CACHE Cache
+    );
+
+/**
+ * @brief This function replaces the scan cache file of a revision with the
+ * entries of the files it revised.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevSaveCache(
+    _Inout_ PREVISION Revision
+    );
+
+/**
+ * @brief This function returns the flags of the scan cache file of a
+ * revision, which tell what the files were taken from: a directory tree,
+ * a git index or a file list.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @return The flags.
+ */
+ULONGLONG
+RevGetCacheFlags(
+    _In_ PREVISION Revision
+    );
+
+/**
+ * @brief This function unmaps the scan cache of a revision and frees the
+ * entries collected for it.
+ *
+ * @param Revision Supplies the revision.
+ */
+VOID
+RevDeleteCache(
+    _Inout_ PREVISION Revision
+    );
+
+/**
+ * @brief This function computes the hash of the language table, which
+ * invalidates the cache files written by a build with other language IDs.
+ *
+ * @return The hash of the language table.
+ */
+ULONGLONG
+RevHashLanguageTable(
+    VOID
+    );
+
+/**
+ * @brief This function compares two scan cache entries by the device and
+ * inode of their directory, then by their own, for qsort.
+ *
+ * @param Entry1 Supplies the first entry.
+ *
+ * @param Entry2 Supplies the second entry.
+ *
+ * @return A negative value, zero or a positive value if the first entry
+ * sorts before, with or after the second entry.
+ */
+int
+RevCompareCacheEntries(
+    _In_ const void *Entry1,
+    _In_ const void *Entry2
+    );
+
+/**
+ * @brief This function compares two scan cache directories by device and
+ * inode, for qsort.
+ *
+ * @param Directory1 Supplies the first directory.
+ *
+ * @param Directory2 Supplies the second directory.
+ *
+ * @return A negative value, zero or a positive value if the first
+ * directory sorts before, with or after the second directory.
+ */
+int
+RevCompareCacheDirectories(
+    _In_ const void *Directory1,
+    _In_ const void *Directory2
+    );
+
+/**
+ * @brief This function looks up a directory in the loaded scan cache by
+ * device and inode, whatever its version.
+ *
+ * @param Cache Supplies the scan cache.
+ *
+ * @param CacheKey Supplies the version of the directory.
+ *
+ * @return The cached directory, or NULL if it is not cached.
+ */
+_Ret_maybenull_
+const REVISION_CACHE_DIRECTORY *
+RevLookupCacheDirectory(
+    _In_ PREVISION_CACHE Cache,
+    _In_ PREVISION_CACHE_KEY CacheKey
+    );
+
+/**
+ * @brief This function looks up a file among the entries of its directory
+ * in the loaded scan cache.
+ *
+ * @param Cache Supplies the scan cache.
+ *
+ * @param CachedDirectory Supplies the cached directory of the file.
+ *
+ * @param CacheKey Supplies the version of the file.
+ *
+ * @return The entry of the file if it is cached with the same size and
+ * modification time, NULL otherwise.
+ */
+_Ret_maybenull_
+const REVISION_CACHE_ENTRY *
+RevLookupCache(
+    _In_ PREVISION_CACHE Cache,
+    _In_ const REVISION_CACHE_DIRECTORY *CachedDirectory,
+    _In_ PREVISION_CACHE_KEY CacheKey
+    );
+
+/**
+ * @brief This function queries the version of an open directory and finds
+ * its record in the loaded scan cache, for the lookups of its files.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the open directory. It has a cache key if the
+ * revision has a scan cache and the version could be queried.
+ *
+ * @return The cached directory, or NULL if it is not cached.
+ */
+_Ret_maybenull_
+const REVISION_CACHE_DIRECTORY *
+RevQueryCachedDirectory(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function replays an open directory from the scan cache, if
+ * the revision trusts directory versions and the directory has not changed
+ * since it was cached: its cached files are recorded and its cached
+ * subdirectories scheduled, without enumerating it. Otherwise, it only
+ * finds the record of the directory for the lookups of its files.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the open directory.
+ *
+ * @return TRUE if the directory was replayed, FALSE if it has to be
+ * enumerated.
+ */
+_Must_inspect_result_
+BOOL
+RevReviseCachedDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function revises a file from the scan cache, if the file has
+ * not changed since it was cached as the same language.
+ *
+ * @param Worker Supplies the enumerator that found the file.
+ *
+ * @param Directory Supplies the directory containing the file.
+ *
+ * @param FileName Supplies the name of the file.
+ *
+ * @param Mapping Supplies the extension mapping of the file.
+ *
+ * @param CacheKey Supplies the version of the file.
+ *
+ * @return TRUE if the file was revised, FALSE if it has to be read.
+ */
+_Must_inspect_result_
+BOOL
+RevReviseCachedFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ PREVISION_RECORD_EXTENSION_MAPPING Mapping,
+    _In_ PREVISION_CACHE_KEY CacheKey
+    );
+
+/**
+ * @brief This function adds the entry of a revised file to the scan cache
+ * entries collected by a worker. If it cannot be added, the file is simply
+ * counted again by the next revision.
+ *
+ * @param Worker Supplies the worker.
+ *
+ * @param Entry Supplies the entry.
+ */
+VOID
+RevAppendCacheEntry(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ const REVISION_CACHE_ENTRY *Entry
+    );
+
+/**
+ * @brief This function adds an enumerated directory and the names of its
+ * subdirectories, taken from its entry blocks, to the scan cache
+ * directories collected by a worker. If they cannot be added, the
+ * directory is simply enumerated again by the next revision.
+ *
+ * @param Worker Supplies the worker.
+ *
+ * @param Directory Supplies the directory, which has a cache key.
+ *
+ * @param CountOfFiles Supplies the number of files submitted from the
+ * directory.
+ *
+ * @param CountOfIgnoredFiles Supplies the number of files of the directory
+ * that were ignored.
+ */
+VOID
+RevAppendCacheDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_ ULONG CountOfFiles,
+    _In_ ULONG CountOfIgnoredFiles
+    );
+
+/**
+ * @brief This function makes room for more elements in an array collected
+ * by a worker for the scan cache, doubling its capacity as needed.
+ *
+ * @param Array Supplies the array, updated if it moves.
+ *
+ * @param Capacity Supplies the capacity of the array in elements, updated
+ * if it grows.
+ *
+ * @param Count Supplies the number of elements the array must hold.
+ *
+ * @param ElementSize Supplies the size of an element in bytes.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevReserveCacheRoom(
+    _Inout_ PVOID *Array,
+    _Inout_ PSIZE_T Capacity,
+    _In_ SIZE_T Count,
+    _In_ SIZE_T ElementSize
+    );
+
+/**
+ * @brief This function submits the files tracked by the git index of a
+ * work tree to the pipeline. Only the index is read: no directory of the
+ * work tree is enumerated, and the files are opened by their paths
+ * relative to the root directory.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the open root directory of the work tree.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevEnumerateGitIndex(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function finds the git index of a work tree: the index file
+ * in its .git directory, or in the directory a .git file links to, as in
+ * linked worktrees and submodules.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the open root directory of the work tree.
+ *
+ * @return A new string containing the path of the index file, NULL if
+ * the function failed. The caller is responsible for freeing the memory.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PPATHCHAR
+RevLocateGitIndex(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function maps the git index of a work tree and checks the
+ * whole of it, so that its entries can then be read without failing.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Directory Supplies the open root directory of the work tree.
+ *
+ * @param Index Receives the index, positioned at its first entry.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ *
+ * @remarks The index must be closed with RevCloseGitIndex, even if the
+ * function failed.
+ */
+_Must_inspect_result_
+BOOL
+RevOpenGitIndex(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_DIRECTORY Directory,
+    _Out_ PREVISION_GIT_INDEX Index
+    );
+
+/**
+ * @brief This function reads every entry of a git index and its
+ * extensions, assuming object IDs of the given size, and counts the
+ * characters of the paths.
+ *
+ * @param Index Supplies the index.
+ *
+ * @param ObjectIdSize Supplies the size of the object IDs.
+ *
+ * @return TRUE if the index is well formed with that object ID size,
+ * FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevCheckGitIndex(
+    _Inout_ PREVISION_GIT_INDEX Index,
+    _In_ ULONG ObjectIdSize
+    );
+
+/**
+ * @brief This function positions a git index at its first entry.
+ *
+ * @param Index Supplies the index.
+ */
+VOID
+RevRewindGitIndex(
+    _Inout_ PREVISION_GIT_INDEX Index
+    );
+
+/**
+ * @brief This function reads the next entry of a git index.
+ *
+ * @param Index Supplies the index.
+ *
+ * @param Entry Receives the entry.
+ *
+ * @return TRUE if an entry was read, FALSE if there are no more entries or
+ * the entry is malformed, which EntryIndex tells apart.
+ */
+_Must_inspect_result_
+BOOL
+RevReadGitIndexEntry(
+    _Inout_ PREVISION_GIT_INDEX Index,
+    _Out_ PREVISION_GIT_INDEX_ENTRY Entry
+    );
+
+/**
+ * @brief This function unmaps a git index and frees its path buffer.
+ *
+ * @param Index Supplies the index.
+ */
+VOID
+RevCloseGitIndex(
+    _Inout_ PREVISION_GIT_INDEX Index
+    );
+
+/**
+ * @brief This function converts a path in UTF-8 with slashes, as found in
+ * git indexes and file lists, into a native path.
+ *
+ * @param Path Supplies the path.
+ *
+ * @param PathLength Supplies the length of the path in bytes.
+ *
+ * @param Buffer Receives the native path, terminated. It must hold
+ * PathLength + 1 characters.
+ *
+ * @param NativePathLength Receives the length of the native path in
+ * characters.
+ *
+ * @return TRUE if succeeded, FALSE if the path is not valid UTF-8.
+ */
+_Must_inspect_result_
+BOOL
+RevConvertUtf8Path(
+    _In_reads_(PathLength) const CHAR *Path,
+    _In_ SIZE_T PathLength,
+    _Out_writes_(PathLength + 1) PPATHCHAR Buffer,
+    _Out_ PSIZE_T NativePathLength
+    );
+
+/**
+ * @brief This function checks whether a path relative to a directory
+ * stays within it: the path is not absolute and has no ".." component.
+ *
+ * @param Path Supplies the path, with native separators.
+ *
+ * @return TRUE if the path stays within the directory, FALSE otherwise.
+ */
+BOOL
+RevIsPathWithinDirectory(
+    _In_z_ PPATHCHAR Path
+    );
+
+/**
+ * @brief This function submits a file given by its path relative to a
+ * directory to the pipeline, unless it leaves the directory, its name is ignored, it is not a
+ * regular file or it has been reached already, as for the files of a git
+ * index or a file list.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the directory the path is relative to.
+ *
+ * @param Path Supplies the path of the file. It must stay valid until the
+ * file is read.
+ *
+ * @return TRUE if the file was submitted, FALSE if it was ignored.
+ */
+BOOL
+RevSubmitListedFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Path
+    );
+
+/**
+ * @brief This function submits the files of the file list of a revision
+ * to the pipeline, reading the list in blocks from a file or the standard
+ * input. No directory is enumerated: the files are opened by their paths
+ * relative to the root directory.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the open root directory.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevEnumerateFileList(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function compiles exclude patterns, one per line in the
+ * syntax of .gitignore files, into a pattern list.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Text Supplies the lines.
+ *
+ * @param TextLength Supplies the length of the lines in characters.
+ *
+ * @param Parent Supplies the list of the enclosing directory, or NULL.
+ *
+ * @param BaseLength Supplies the length of the path of the base directory
+ * of the patterns relative to the root directory.
+ *
+ * @return The list, allocated from the heap, or NULL if there are no
+ * patterns in the lines or the function failed.
+ */
+_Ret_maybenull_
+_Must_inspect_result_
+PREVISION_PATTERN_LIST
+RevCompilePatternList(
+    _In_ PREVISION Revision,
+    _In_reads_(TextLength) const PATHCHAR *Text,
+    _In_ SIZE_T TextLength,
+    _In_opt_ PREVISION_PATTERN_LIST Parent,
+    _In_ SIZE_T BaseLength
+    );
+
+/**
+ * @brief This function compiles the exclude or include patterns given on
+ * the command line, relative to the root directory.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Patterns Supplies the patterns.
+ *
+ * @param CountOfPatterns Supplies the number of patterns.
+ *
+ * @param PatternList Receives the list, or NULL if there are no patterns.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevCompileCommandLinePatterns(
+    _In_ PREVISION Revision,
+    _In_reads_(CountOfPatterns) PWCHAR *Patterns,
+    _In_ ULONG CountOfPatterns,
+    _Out_ PREVISION_PATTERN_LIST *PatternList
+    );
+
+/**
+ * @brief This function compiles the .gitignore file of an open directory,
+ * if it has one, and makes it the pattern list of the directory. The
+ * directory otherwise keeps the list of its parent.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the open directory.
+ */
+VOID
+RevLoadIgnoreFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function returns the length of the path of a directory
+ * relative to the root directory.
+ *
+ * @param Directory Supplies the directory.
+ *
+ * @return The length of the path in characters, zero for the root.
+ */
+SIZE_T
+RevQueryRelativePathLength(
+    _In_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function prepares the pattern path of a worker for the
+ * entries of a directory: the path of the directory relative to the root
+ * directory, to which the name of each entry is appended. Nothing is done
+ * unless an anchored pattern applies to the directory.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the directory about to be enumerated.
+ *
+ * @return TRUE if succeeded, FALSE if failed.
+ */
+_Must_inspect_result_
+BOOL
+RevPreparePatternPath(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function checks whether an entry of the directory prepared
+ * by RevPreparePatternPath is excluded by the patterns of the revision.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Directory Supplies the directory of the entry.
+ *
+ * @param Name Supplies the name of the entry.
+ *
+ * @param IsDirectory Supplies whether the entry is a directory.
+ *
+ * @return TRUE if the entry is excluded, FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevIsEntryExcluded(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ const PATHCHAR *Name,
+    _In_ BOOL IsDirectory
+    );
+
+/**
+ * @brief This function checks whether a file given by its path relative
+ * to the root directory, or one of the directories on the way to it, is
+ * excluded by the patterns of the command line.
+ *
+ * @param Worker Supplies the enumerator.
+ *
+ * @param Path Supplies the path of the file.
+ *
+ * @return TRUE if the file is excluded, FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevIsPathExcluded(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_z_ const PATHCHAR *Path
+    );
+
+/**
+ * @brief This function checks an entry against the patterns of the
+ * revision, in the order of precedence: the exclude patterns of the
+ * command line, the pattern lists from the innermost directory outwards,
+ * then the include patterns of the command line for files.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param PatternList Supplies the innermost pattern list, or NULL.
+ *
+ * @param Name Supplies the name of the entry.
+ *
+ * @param NameLength Supplies the length of the name in characters.
+ *
+ * @param Path Supplies the path of the entry relative to the root
+ * directory, or NULL if no anchored pattern applies.
+ *
+ * @param IsDirectory Supplies whether the entry is a directory.
+ *
+ * @return TRUE if the entry is excluded, FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevIsExcluded(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_PATTERN_LIST PatternList,
+    _In_z_ const PATHCHAR *Name,
+    _In_ SIZE_T NameLength,
+    _In_opt_z_ const PATHCHAR *Path,
+    _In_ BOOL IsDirectory
+    );
+
+/**
+ * @brief This function finds the pattern of highest precedence matching
+ * an entry in a chain of pattern lists.
+ *
+ * @param PatternList Supplies the innermost pattern list.
+ *
+ * @param Name Supplies the name of the entry.
+ *
+ * @param NameLength Supplies the length of the name in characters.
+ *
+ * @param Path Supplies the path of the entry relative to the root
+ * directory, or NULL if no anchored pattern applies.
+ *
+ * @param IsDirectory Supplies whether the entry is a directory.
+ *
+ * @return The matching pattern, or NULL if there is none.
+ */
+_Ret_maybenull_
+const REVISION_PATTERN *
+RevMatchPatternList(
+    _In_ PREVISION_PATTERN_LIST PatternList,
+    _In_z_ const PATHCHAR *Name,
+    _In_ SIZE_T NameLength,
+    _In_opt_z_ const PATHCHAR *Path,
+    _In_ BOOL IsDirectory
+    );
+
+/**
+ * @brief This function matches a text against a glob of a .gitignore
+ * file: "*" and "?" do not match a separator, "**" as a whole component
+ * matches any number of components, and "[...]" is a set of characters
+ * or ranges, negated by a leading "!" or "^".
+ *
+ * @param PatternStart Supplies the start of the whole pattern.
+ *
+ * @param Pattern Supplies the rest of the pattern to match.
+ *
+ * @param Text Supplies the rest of the text to match.
+ *
+ * @return TRUE if the text matches, FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevMatchGlob(
+    _In_z_ const PATHCHAR *PatternStart,
+    _In_z_ const PATHCHAR *Pattern,
+    _In_z_ const PATHCHAR *Text
+    );
+
+/**
+ * @brief This function matches a character against a "[...]" set of a
+ * glob.
+ *
+ * @param Pattern Supplies the position of the "[", and receives the
+ * position of the closing "]".
+ *
+ * @param Char Supplies the character.
+ *
+ * @param IsMatch Receives whether the character is in the set.
+ *
+ * @return TRUE if the set is well formed, FALSE if it is not closed, in
+ * which case the "[" is a literal character.
+ */
+_Must_inspect_result_
+BOOL
+RevMatchGlobSet(
+    _Inout_ const PATHCHAR **Pattern,
+    _In_ PATHCHAR Char,
+    _Out_ PBOOL IsMatch
+    );
+
+/**
+ * @brief This function compares two path characters, ignoring the case on
+ * Windows, where file names are case-insensitive.
+ *
+ * @param Char1 Supplies the first character.
+ *
+ * @param Char2 Supplies the second character.
+ *
+ * @return TRUE if the characters are equal, FALSE otherwise.
+ */
+FORCEINLINE
+BOOL
+RevPathCharsEqual(
+    _In_ PATHCHAR Char1,
+    _In_ PATHCHAR Char2
+    )
+{
+#ifdef _WIN32
+    return Char1 == Char2 || towlower(Char1) == towlower(Char2);
+#else
+    return Char1 == Char2;
+#endif
+}
+
+/**
+ * @brief This function compares two strings of path characters of the
+ * same length, ignoring the case on Windows.
+ *
+ * @param String1 Supplies the first string.
+ *
+ * @param String2 Supplies the second string.
+ *
+ * @param Length Supplies the length of the strings in characters.
+ *
+ * @return TRUE if the strings are equal, FALSE otherwise.
+ */
+FORCEINLINE
+BOOL
+RevPathStringsEqual(
+    _In_reads_(Length) const PATHCHAR *String1,
+    _In_reads_(Length) const PATHCHAR *String2,
+    _In_ SIZE_T Length
+    )
+{
+    SIZE_T index;
+
+    for (index = 0; index < Length; ++index) {
+        if (!RevPathCharsEqual(String1[index], String2[index])) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief This function computes a hash of the exclude and include options
+ * of a revision, which decide the files a scan cache describes.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @return The hash.
+ */
+ULONGLONG
+RevHashFilters(
+    _In_ PREVISION Revision
+    );
+
+/**
+ * @brief This function initializes an empty content set.
+ *
+ * @param Set Receives the content set.
+ */
+VOID
+RevInitializeContentSet(
+    _Out_ PREVISION_CONTENT_SET Set
+    );
+
+/**
+ * @brief This function frees the entries of a content set.
+ *
+ * @param Set Supplies the content set.
+ */
+VOID
+RevDeleteContentSet(
+    _Inout_ PREVISION_CONTENT_SET Set
+    );
+
+/**
+ * @brief This function looks up contents in a content set.
+ *
+ * @param Set Supplies the content set.
+ *
+ * @param Entry Supplies the hash and the language ID of the contents, and
+ * receives their line counts if they are found.
+ *
+ * @return TRUE if the contents have been counted already, FALSE otherwise.
+ */
+_Must_inspect_result_
+BOOL
+RevLookupContent(
+    _Inout_ PREVISION_CONTENT_SET Set,
+    _Inout_ PREVISION_CONTENT_ENTRY Entry
+    );
+
+/**
+ * @brief This function adds contents to a content set, unless they are in
+ * it already.
+ *
+ * @param Set Supplies the content set.
+ *
+ * @param Entry Supplies the contents and their line counts, and receives
+ * the line counts of the entry in the set if there is one.
+ *
+ * @return TRUE if the contents were not in the set, FALSE otherwise. If
+ * the set cannot grow, the contents are not added, but TRUE is returned
+ * all the same: they are counted again rather than lost.
+ */
+_Must_inspect_result_
+BOOL
+RevInsertContent(
+    _Inout_ PREVISION_CONTENT_SET Set,
+    _Inout_ PREVISION_CONTENT_ENTRY Entry
+    );
+
+/**
+ * @brief This function finds the slot of contents in a content shard: the
+ * slot holding them, or the empty slot they belong in. The caller holds the
+ * lock of the shard, which must have room.
+ *
+ * @param Shard Supplies the content shard.
+ *
+ * @param ContentHash Supplies the hash of the contents.
+ *
+ * @param LanguageId Supplies the language ID of the contents.
+ *
+ * @return The slot.
+ */
+PREVISION_CONTENT_ENTRY
+RevFindContentSlot(
+    _In_ PREVISION_CONTENT_SHARD Shard,
+    _In_ ULONGLONG ContentHash,
+    _In_ ULONG LanguageId
+    );
+
+/**
+ * @brief This function doubles the room of a content shard. The caller
+ * holds the lock of the shard.
+ *
+ * @param Shard Supplies the content shard.
+ *
+ * @return TRUE if succeeded, FALSE if there is not enough memory.
+ */
+_Must_inspect_result_
+BOOL
+RevGrowContentShard(
+    _Inout_ PREVISION_CONTENT_SHARD Shard
+    );
+
+/**
+ * @brief This function claims contents for the file being recorded by a
+ * worker of a revision that deduplicates contents. The first file with the
+ * contents is counted, the others are duplicates.
+ *
+ * @param Worker Supplies the worker.
+ *
+ * @param LanguageId Supplies the language ID of the file.
+ *
+ * @param ContentHash Supplies the hash of the contents of the file.
+ *
+ * @param CountOfLinesTotal Supplies the number of lines of the file.
+ *
+ * @param CountOfLinesBlank Supplies the number of blank lines.
+ *
+ * @param CountOfLinesComment Supplies the number of comment lines.
+ *
+ * @return TRUE if the file is to be counted, FALSE if it is a duplicate.
+ */
+_Must_inspect_result_
+BOOL
+RevClaimContent(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG LanguageId,
+    _In_ ULONGLONG ContentHash,
+    _In_ ULONGLONG CountOfLinesTotal,
+    _In_ ULONGLONG CountOfLinesBlank,
+    _In_ ULONGLONG CountOfLinesComment
+    );
+
+/**
+ * @brief This function starts the hash of the contents of a file.
+ *
+ * @param Hash Receives the state of the hash.
+ */
+VOID
+RevInitializeContentHash(
+    _Out_ PREVISION_CONTENT_HASH Hash
+    );
+
+/**
+ * @brief This function feeds the next piece of the contents of a file to
+ * its hash.
+ *
+ * @param Hash Supplies the state of the hash.
+ *
+ * @param Buffer Supplies the piece of the contents.
+ *
+ * @param Size Supplies the size of the piece in bytes.
+ */
+VOID
+RevUpdateContentHash(
+    _Inout_ PREVISION_CONTENT_HASH Hash,
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size
+    );
+
+/**
+ * @brief This function completes the hash of the contents of a file.
+ *
+ * @param Hash Supplies the state of the hash, fed every piece of the
+ * contents.
+ *
+ * @return The hash.
+ */
+ULONGLONG
+RevFinalizeContentHash(
+    _In_ PREVISION_CONTENT_HASH Hash
+    );
+
+/**
+ * @brief This function hashes the contents of a file held in memory as a
+ * whole.
+ *
+ * @param Buffer Supplies the contents.
+ *
+ * @param Size Supplies the size of the contents in bytes.
+ *
+ * @return The hash.
+ */
+ULONGLONG
+RevHashContents(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size
+    );
+
+/**
+ * @brief This function rotates a 64-bit value left.
+ *
+ * @param Value Supplies the value.
+ *
+ * @param Count Supplies the number of bits, from 1 to 63.
+ *
+ * @return The rotated value.
+ */
+FORCEINLINE
+ULONGLONG
+RevRotateLeft64(
+    _In_ ULONGLONG Value,
+    _In_ ULONG Count
+    )
+{
+    return (Value << Count) | (Value >> (64 - Count));
+}
+
+/**
+ * @brief This function reads a 64-bit value in the byte order of the
+ * processor. The content hash only has to agree with itself on the same
+ * machine.
+ *
+ * @param Bytes Supplies the bytes of the value, with any alignment.
+ *
+ * @return The value.
+ */
+FORCEINLINE
+ULONGLONG
+RevReadContentWord64(
+    _In_reads_(8) const UCHAR *Bytes
+    )
+{
+    ULONGLONG value;
+
+    memcpy(&value, Bytes, sizeof(value));
+
+    return value;
+}
+
+/**
+ * @brief This function reads a 32-bit value in the byte order of the
+ * processor.
+ *
+ * @param Bytes Supplies the bytes of the value, with any alignment.
+ *
+ * @return The value.
+ */
+FORCEINLINE
+ULONGLONG
+RevReadContentWord32(
+    _In_reads_(4) const UCHAR *Bytes
+    )
+{
+    unsigned int value;
+
+    memcpy(&value, Bytes, sizeof(value));
+
+    return value;
+}
+
+/**
+ * @brief This function mixes a 64-bit word of the contents into a lane of
+ * the content hash.
+ *
+ * @param Lane Supplies the accumulator of the lane.
+ *
+ * @param Word Supplies the word.
+ *
+ * @return The new accumulator.
+ */
+FORCEINLINE
+ULONGLONG
+RevMixContentLane(
+    _In_ ULONGLONG Lane,
+    _In_ ULONGLONG Word
+    )
+{
+    Lane += Word * REVISION_CONTENT_PRIME2;
+    Lane = RevRotateLeft64(Lane, 31);
+
+    return Lane * REVISION_CONTENT_PRIME1;
+}
+
+/**
+ * @brief This function merges a lane into the content hash once the
+ * contents are complete.
+ *
+ * @param Hash Supplies the hash so far.
+ *
+ * @param Lane Supplies the accumulator of the lane.
+ *
+ * @return The new hash.
+ */
+FORCEINLINE
+ULONGLONG
+RevMergeContentLane(
+    _In_ ULONGLONG Hash,
+    _In_ ULONGLONG Lane
+    )
+{
+    Hash ^= RevMixContentLane(0, Lane);
+
+    return Hash * REVISION_CONTENT_PRIME1 + REVISION_CONTENT_PRIME4;
+}
+
+/**
+ * @brief This function initializes an empty identity set.
+ *
+ * @param Set Receives the identity set.
+ */
+VOID
+RevInitializeIdentitySet(
+    _Out_ PREVISION_IDENTITY_SET Set
+    );
+
+/**
+ * @brief This function frees the keys and devices of an identity set.
+ *
+ * @param Set Supplies the identity set.
+ */
+VOID
+RevDeleteIdentitySet(
+    _Inout_ PREVISION_IDENTITY_SET Set
+    );
+
+/**
+ * @brief This function returns the index of a device in an identity set,
+ * numbering the device if it is new.
+ *
+ * @param Set Supplies the identity set.
+ *
+ * @param Device Supplies the device (volume serial number on Windows).
+ *
+ * @return The index of the device, from one, or zero if the set cannot
+ * number any more devices.
+ */
+ULONG
+RevQueryDeviceIndex(
+    _Inout_ PREVISION_IDENTITY_SET Set,
+    _In_ ULONGLONG Device
+    );
+
+/**
+ * @brief This function adds a file or directory to an identity set, unless
+ * it is in it already.
+ *
+ * @param Set Supplies the identity set.
+ *
+ * @param DeviceIndex Supplies the index of the device of the file or
+ * directory, zero if it is unknown.
+ *
+ * @param Inode Supplies the inode (file ID on Windows).
+ *
+ * @return TRUE if the file or directory was not in the set, FALSE
+ * otherwise. If the device is unknown or the set cannot grow, TRUE is
+ * returned all the same: the file or directory is revised again rather
+ * than lost.
+ */
+_Must_inspect_result_
+BOOL
+RevInsertIdentity(
+    _Inout_ PREVISION_IDENTITY_SET Set,
+    _In_ ULONG DeviceIndex,
+    _In_ ULONGLONG Inode
+    );
+
+/**
+ * @brief This function finds the slot of a packed key in an identity
+ * shard: the slot holding it, or the empty slot it belongs in. The caller
+ * holds the lock of the shard, which must have room.
+ *
+ * @param Shard Supplies the identity shard.
+ *
+ * @param Key Supplies the packed key.
+ *
+ * @return The slot.
+ */
+PULONGLONG
+RevFindIdentitySlot(
+    _In_ PREVISION_IDENTITY_SHARD Shard,
+    _In_ ULONGLONG Key
+    );
+
+/**
+ * @brief This function finds the slot of an identity that does not pack
+ * in an identity shard, like RevFindIdentitySlot.
+ *
+ * @param Shard Supplies the identity shard.
+ *
+ * @param DeviceIndex Supplies the index of the device.
+ *
+ * @param Inode Supplies the inode.
+ *
+ * @return The slot.
+ */
+PREVISION_IDENTITY
+RevFindWideIdentitySlot(
+    _In_ PREVISION_IDENTITY_SHARD Shard,
+    _In_ ULONGLONG DeviceIndex,
+    _In_ ULONGLONG Inode
+    );
+
+/**
+ * @brief This function doubles the room of the packed keys of an identity
+ * shard. The caller holds the lock of the shard.
+ *
+ * @param Shard Supplies the identity shard.
+ *
+ * @return TRUE if succeeded, FALSE if there is not enough memory.
+ */
+_Must_inspect_result_
+BOOL
+RevGrowIdentityShard(
+    _Inout_ PREVISION_IDENTITY_SHARD Shard
+    );
+
+/**
+ * @brief This function doubles the room of the identities that do not
+ * pack of an identity shard. The caller holds the lock of the shard.
+ *
+ * @param Shard Supplies the identity shard.
+ *
+ * @return TRUE if succeeded, FALSE if there is not enough memory.
+ */
+_Must_inspect_result_
+BOOL
+RevGrowWideIdentityShard(
+    _Inout_ PREVISION_IDENTITY_SHARD Shard
+    );
+
+/**
+ * @brief This function measures an identity set once the revision is
+ * finished.
+ *
+ * @param Set Supplies the identity set.
+ *
+ * @param CountOfKeys Receives the number of files and directories in the
+ * set.
+ *
+ * @param CountOfBytes Receives the size of the slots in bytes.
+ */
+VOID
+RevMeasureIdentitySet(
+    _In_ PREVISION_IDENTITY_SET Set,
+    _Out_ PSIZE_T CountOfKeys,
+    _Out_ PSIZE_T CountOfBytes
+    );
+
+/**
+ * @brief This function claims a directory that has just been opened for
+ * the worker about to enumerate it: it queries the version and the device
+ * of the directory, and, when following symbolic links, checks that no
+ * other link has led to it. This is what breaks the cycles of links.
+ *
+ * @param Worker Supplies the worker.
+ *
+ * @param Directory Supplies the directory.
+ *
+ * @return TRUE if the directory is to be enumerated, FALSE if it has been
+ * reached already.
+ */
+_Must_inspect_result_
+BOOL
+RevClaimDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    );
+
+/**
+ * @brief This function claims a file found by a worker, so that a file with
+ * several hard links, or reached through symbolic links, is revised once.
+ *
+ * @param Worker Supplies the worker.
+ *
+ * @param DeviceIndex Supplies the index of the device of the file, zero if
+ * it is unknown.
+ *
+ * @param Inode Supplies the inode (file ID on Windows) of the file.
+ *
+ * @return TRUE if the file is to be revised, FALSE if it has been reached
+ * already.
+ */
+_Must_inspect_result_
+BOOL
+RevClaimFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG DeviceIndex,
+    _In_ ULONGLONG Inode
+    );
+
+/**
+ * @brief This function scatters the bits of an identity key, whose inode
+ * bits are mostly sequential, over the whole key.
+ *
+ * @param Key Supplies the key.
+ *
+ * @return The hash of the key.
+ */
+FORCEINLINE
+ULONGLONG
+RevHashIdentity(
+    _In_ ULONGLONG Key
+    )
+{
+    Key ^= Key >> 33;
+    Key *= 0xFF51AFD7ED558CCDULL;
+    Key ^= Key >> 33;
+    Key *= 0xC4CEB9FE1A85EC53ULL;
+
+    return Key ^ (Key >> 33);
+}
+
+/**
+ * @brief This function reads a 16-bit big-endian value, the byte order of
+ * git index files.
+ *
+ * @param Bytes Supplies the bytes of the value.
+ *
+ * @return The value.
+ */
+FORCEINLINE
+ULONG
+RevReadBigEndian16(
+    _In_reads_(2) const UCHAR *Bytes
+    )
+{
+    return ((ULONG)Bytes[0] << 8) | Bytes[1];
+}
+
+/**
+ * @brief This function reads a 32-bit big-endian value, the byte order of
+ * git index files.
+ *
+ * @param Bytes Supplies the bytes of the value.
+ *
+ * @return The value.
+ */
+FORCEINLINE
+ULONG
+RevReadBigEndian32(
+    _In_reads_(4) const UCHAR *Bytes
+    )
+{
+    return ((ULONG)Bytes[0] << 24) |
+           ((ULONG)Bytes[1] << 16) |
+           ((ULONG)Bytes[2] << 8) |
+           Bytes[3];
+}
+
+#ifdef REVISION_IO_URING
+
+/**
+ * @brief This function sets up the io_uring instance of a reader: the
+ * shared queues and a sparse table of direct descriptors. The pipeline
+ * buffer pool is registered with it if the locked memory limit permits.
+ *
+ * @param Revision Supplies the revision.
+ *
+ * @param Ring Receives the io_uring instance.
+ *
+ * @return TRUE if succeeded, FALSE if the kernel does not support the
+ * operations needed. The ring is then unusable but safe to delete.
+ */
+_Must_inspect_result_
+BOOL
+RevInitializeRing(
+    _In_ PREVISION Revision,
+    _Out_ PREVISION_RING Ring
+    );
+
+/**
+ * @brief This function tears down the io_uring instance of a reader. No
+ * file may be in flight.
+ *
+ * @param Ring Supplies the io_uring instance.
+ */
+VOID
+RevDeleteRing(
+    _Inout_ PREVISION_RING Ring
+    );
+
+/**
+ * @brief This function queues the linked open, read and close of a file
+ * to the io_uring instance of a reader. The file is passed on to the
+ * counters when the last of them completes.
+ *
+ * @param Worker Supplies the reader.
+ *
+ * @param File Supplies the file.
+ */
+VOID
+RevQueueRingFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    );
+
+/**
+ * @brief This function submits the queued operations of a reader's
+ * io_uring instance, optionally waits for completions, and passes on every
+ * file whose operations have all completed.
+ *
+ * @param Worker Supplies the reader.
+ *
+ * @param IsWaiting Supplies whether to wait for at least one completion
+ * if none is available yet.
+ */
+VOID
+RevSubmitRing(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ BOOL IsWaiting
+    );
+
+/**
+ * @brief This function consumes the available completions of a reader's
+ * io_uring instance and passes on every file whose operations have all
+ * completed.
+ *
+ * @param Worker Supplies the reader.
+ *
+ * @return The number of completions consumed.
+ */
+ULONG
+RevReapRing(
+    _Inout_ PREVISION_WORKER Worker
+    );
+
+/**
+ * @brief This function passes a file read through io_uring on to the
+ * counters and frees its slot.
+ *
+ * @param Worker Supplies the reader.
+ *
+ * @param SlotIndex Supplies the index of the slot of the file.
+ */
+VOID
+RevCompleteRingFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG SlotIndex
+    );
+
+#endif
+
+/**
+ * @brief This function outputs the statistics of the revision engine, such
+ * as the number of workers and allocations, to the console. The counts
+ * themselves are left to the caller.
+ *
+ * @param Revision Supplies the revision.
+ */
+VOID
+RevOutputRevisionStatistics(
+    _In_ PREVISION Revision
+    );
+
+/**
+ * @brief This function prints a formatted string in the specified color.
+ *
+ * @param Color Supplies the text foreground color.
+ *
+ * @param Format Supplies the format specifier.
+ *
+ * @param ... Supplies additional parameters to be formatted and printed.
+ */
+VOID
+RevPrintEx(
+    CONSOLE_FOREGROUND_COLOR Color,
+    const wchar_t *Format,
+    ...
+)
+{
+    va_list args;
+    const PWCHAR color = ConsoleForegroundColors[Color];
+#ifndef _WIN32
+    va_list argsCopy;
+    WCHAR stackBuffer[1024];
+    PWCHAR buffer = stackBuffer;
+    SIZE_T bufferLength = ARRAYSIZE(stackBuffer);
+    PWCHAR grownBuffer;
+    int length;
+#endif
+
+#ifdef _WIN32
+    if (SupportAnsi) {
+        wprintf(color);
+    }
+    va_start(args, Format);
+    vwprintf(Format, args);
+    va_end(args);
+    if (SupportAnsi) {
+        wprintf(L"\033[0m");
+    }
+#else
+    /*
+     * N.B. The logging macros write narrow strings to stdout, and a stream
+     * cannot be both wide- and byte-oriented outside of Windows. Format the
+     * message into a wide buffer and print it as a multibyte string.
+     *
+     * Unlike snprintf, vswprintf does not tell how long the message is when
+     * it does not fit, so the buffer is doubled until it does. A message
+     * that cannot be formatted at all is given up at 1M characters.
+     */
+    va_start(args, Format);
+    for (;;) {
+        va_copy(argsCopy, args);
+        length = vswprintf(buffer, bufferLength, Format, argsCopy);
+        va_end(argsCopy);
+
+        if (length >= 0 || bufferLength >= REVISION_MAX_PRINT_LENGTH) {
+            break;
+        }
+
+        grownBuffer = (PWCHAR)realloc(buffer != stackBuffer ? buffer : NULL,
+                                      bufferLength * 2 * sizeof(WCHAR));
+        if (grownBuffer == NULL) {
+            break;
+        }
+
+        buffer = grownBuffer;
+        bufferLength *= 2;
+    }
+    va_end(args);
+
+    if (length >= 0) {
+        printf("%ls%ls%s",
+               SupportAnsi ? color : L"",
+               buffer,
+               SupportAnsi ? "\033[0m" : "");
+    }
+
+    if (buffer != stackBuffer) {
+        free(buffer);
+    }
+#endif
+}
+
+/**
+ * @brief This function prints a formatted string in [default] green
+ * color.
+ *
+ * @param Format Supplies the format specifier.
+ *
+ * @param ... Supplies additional parameters to be formatted and printed.
+ */
+#define RevPrint(Format, ...)                           \
+    do {                                                \
+        RevPrintEx(Green, Format, ##__VA_ARGS__);       \
+    } while (0)
+
+/**
+ * @brief This function outputs a red text error message to the standard
+ * error stream.
+ *
+ * @param Context Supplies the revision the message is about, or NULL.
+ *
+ * @param Message Supplies the error message.
+ *
+ * @note This function respects the verbose mode setting of the revision.
+ * Messages outside of any revision are always printed.
+ */
+#define RevLogError(Context, Message, ...)                                              \
+    do {                                                                                \
+        PREVISION logRevision = (Context);                                              \
+        if (logRevision == NULL || logRevision->InitParams.IsVerboseMode) {             \
+            fprintf(stderr,                                                             \
+                    SupportAnsi ?                                                       \
+                        "\033[0;31m[ERROR]\n└───> (in %s@%d): " Message "\033[0m\n" :   \
+                        "[ERROR]\n└───> (in %s@%d): " Message "\n",                     \
+                        __FUNCTION__,                                                   \
+                        __LINE__,                                                       \
+                        ##__VA_ARGS__);                                                 \
+        }                                                                               \
+    } while (0)
+
+/**
+ * @brief This function outputs a yellow text warning message to the
+ * standard output stream.
+ *
+ * @param Context Supplies the revision the message is about, or NULL.
+ *
+ * @param Message Supplies the warning message.
+ *
+ * @note This function respects the verbose mode setting of the revision.
+ * Messages outside of any revision are always printed.
+ */
+#define RevLogWarning(Context, Message, ...)                                            \
+    do {                                                                                \
+        PREVISION logRevision = (Context);                                              \
+        if (logRevision == NULL || logRevision->InitParams.IsVerboseMode) {             \
+            fprintf(stdout,                                                             \
+                    SupportAnsi ?                                                       \
+                        "\033[0;33m[WARNING]\n└───> (in %s@%d): " Message "\033[0m\n" : \
+                        "[WARNING]\n└───> (in %s@%d): " Message "\n",                   \
+                        __FUNCTION__,                                                   \
+                        __LINE__,                                                       \
+                        ##__VA_ARGS__);                                                 \
+        }                                                                               \
+    } while (0)
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+#ifdef _WIN32
+
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevGetLastKnownWin32Error(
+    VOID
+    )
+{
+    PWCHAR messageBuffer;
+    SIZE_T messageBufferSize;
+    DWORD formatResult;
+    const DWORD lastKnownError = GetLastError();
+
+    /*
+     * Attempt to format the error code into a human-readable string.
+     */
+    formatResult = FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER |
+                                  FORMAT_MESSAGE_FROM_SYSTEM,
+                                  NULL,
+                                  lastKnownError,
+                                  0,
+                                  (LPWSTR)&messageBuffer,
+                                  0,
+                                  NULL);
+
+    if (formatResult == 0) {
+        /*
+         * If FormatMessageW failed, convert the error code to a string
+         * and return that.
+         */
+
+        /* N.B. The maximum error code value is a 5-digit number (15999). */
+        messageBufferSize = (5 + 1) * sizeof(WCHAR);
+        messageBuffer = (PWCHAR) malloc(messageBufferSize);
+        if (messageBuffer == NULL) {
+            RevLogError(NULL,
+                        "Failed to allocate a message buffer (%llu bytes).",
+                        messageBufferSize);
+            goto Exit;
+        }
+
+        if (swprintf_s(messageBuffer,
+                       (5 + 1),
+                       L"%lu",
+                       lastKnownError) == -1) {
+            RevLogError(NULL,
+                        "Failed to write formatted data to a string.");
+            if (messageBuffer) {
+                free(messageBuffer);
+            }
+            messageBuffer = NULL;
+            goto Exit;
+        }
+    }
+
+Exit:
+
+    return messageBuffer;
+}
+
+#else
+
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevGetLastKnownWin32Error(
+    VOID
+    )
+{
+    PWCHAR messageBuffer;
+    SIZE_T messageBufferLength;
+    const int lastKnownError = errno;
+    const char *message = strerror(lastKnownError);
+
+    /*
+     * N.B. On non-Windows platforms the last known error is errno, and its
+     * description is converted from the native encoding.
+     */
+    messageBufferLength = strlen(message) + 1;
+    messageBuffer = (PWCHAR)malloc(messageBufferLength * sizeof(WCHAR));
+    if (messageBuffer == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate a message buffer (%llu bytes).",
+                    messageBufferLength * sizeof(WCHAR));
+        return NULL;
+    }
+
+    if (mbstowcs(messageBuffer, message, messageBufferLength) == (SIZE_T)-1) {
+        swprintf(messageBuffer, messageBufferLength, L"%d", lastKnownError);
+    }
+
+    return messageBuffer;
+}
+
+#endif
+
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevStringAppend(
+    _In_z_ PWCHAR String1,
+    _In_z_ PWCHAR String2
+    )
+{
+    SIZE_T string1Length;
+    SIZE_T string2Length;
+    SIZE_T resultStringLength;
+    PWCHAR result;
+
+    /*
+     * Find the length of the result string.
+     */
+    string1Length = wcslen(String1);
+    string2Length = wcslen(String2);
+    resultStringLength = string1Length + string2Length + 1;
+
+    /*
+     * Allocate buffer for the new string.
+     */
+    result = (PWCHAR) malloc(resultStringLength * sizeof(WCHAR));
+    if (result == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate string buffer (%llu bytes).",
+                    resultStringLength * sizeof(WCHAR));
+        goto Exit;
+    }
+
+    /*
+     * Copy the first string to the result.
+     */
+    if (wcscpy_s(result, resultStringLength, String1) != 0) {
+        free(result);
+        result = NULL;
+        goto Exit;
+    }
+
+    /*
+     * Concatenate the second string to the result.
+     */
+    if (wcscat_s(result, resultStringLength, String2) != 0) {
+        free(result);
+        result = NULL;
+        goto Exit;
+    }
+
+Exit:
+    return result;
+}
+
+_Ret_maybenull_
+_Must_inspect_result_
+PWCHAR
+RevStringPrepend(
+    _In_z_ PWCHAR String1,
+    _In_z_ PWCHAR String2
+    )
+{
+    SIZE_T string1Length;
+    SIZE_T string2Length;
+    SIZE_T resultStringLength;
+    PWCHAR result;
+
+    if (String1 == NULL || String2 == NULL) {
+        RevLogError(NULL,
+                    "Invalid parameter/-s.");
+        result = NULL;
+        goto Exit;
+    }
+
+    /*
+     * Find the length of the result string.
+     */
+    string1Length = wcslen(String1);
+    string2Length = wcslen(String2);
+    resultStringLength = string1Length + string2Length + 1;
+
+    /*
+     * Allocate buffer for the new string.
+     */
+    result = (PWCHAR) malloc(resultStringLength * sizeof(WCHAR));
+    if (result == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate string buffer (%llu bytes).",
+                    resultStringLength * sizeof(WCHAR));
+        goto Exit;
+    }
+
+    /*
+     * Copy the second string to the beginning of the result.
+     */
+    if (wcscpy_s(result, resultStringLength, String2) != 0) {
+        free(result);
+        result = NULL;
+        goto Exit;
+    }
+
+    /*
+     * Concatenate the first string to the result.
+     */
+    if (wcscat_s(result, resultStringLength, String1) != 0) {
+        free(result);
+        result = NULL;
+        goto Exit;
+    }
+
+Exit:
+    return result;
+}
+
+#ifndef _WIN32
+
+_Ret_maybenull_
+_Must_inspect_result_
+PCHAR
+RevConvertToMultiByte(
+    _In_z_ PWCHAR String
+    )
+{
+    SIZE_T resultLength;
+    PCHAR result;
+
+    /*
+     * Find the length of the result string.
+     */
+    resultLength = wcstombs(NULL, String, 0);
+    if (resultLength == (SIZE_T)-1) {
+        RevLogError(NULL,
+                    "The string \"%ls\" cannot be represented in the native "
+                    "encoding.",
+                    String);
+        return NULL;
+    }
+
+    result = (PCHAR)malloc(resultLength + 1);
+    if (result == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate string buffer (%llu bytes).",
+                    resultLength + 1);
+        return NULL;
+    }
+
+    wcstombs(result, String, resultLength + 1);
+
+    return result;
+}
+
+#endif
+
+_Ret_maybenull_
+_Must_inspect_result_
+PPATHCHAR
+RevNormalizeRootDirectory(
+    _In_z_ PWCHAR RootDirectory
+    )
+{
+    PWCHAR path;
+    SIZE_T pathLength;
+#ifdef _WIN32
+    PWCHAR prefixedPath;
+#else
+    PCHAR nativePath;
+#endif
+
+    path = _wcsdup(RootDirectory);
+    if (path == NULL) {
+        RevLogError(NULL,
+                    "Failed to copy the root directory path.");
+        return NULL;
+    }
+
+    pathLength = wcslen(path);
+
+#ifdef _WIN32
+    /*
+     * Remove trailing '\' symbols, replacing them with '\0' characters.
+     */
+    while (pathLength > 0 &&
+           path[pathLength - 1] == L'\\') {
+        path[--pathLength] = L'\0';
+    }
+
+    /*
+     * Prepend L"\\?\" to the path if not prepended yet to avoid the obsolete
+     * MAX_PATH limitation.
+     */
+    if (wcsncmp(path, MAX_PATH_FIX, wcslen(MAX_PATH_FIX)) != 0) {
+        prefixedPath = RevStringPrepend(path, MAX_PATH_FIX);
+        free(path);
+        path = prefixedPath;
+    }
+
+    return path;
+#else
+    /*
+     * Remove trailing '/' symbols, but keep the root directory intact.
+     */
+    while (pathLength > 1 &&
+           path[pathLength - 1] == L'/') {
+        path[--pathLength] = L'\0';
+    }
+
+    nativePath = RevConvertToMultiByte(path);
+    free(path);
+
+    return nativePath;
+#endif
+}
+
+BOOL
+RevInitializeRevision(
+    _In_ PREVISION_INIT_PARAMS InitParams,
+    _Out_ PREVISION *Revision
+    )
+{
+    BOOL status = TRUE;
+    PREVISION revision = NULL;
+    REVISION_ARENA arena;
+
+    if (InitParams == NULL ||
+        InitParams->RootDirectory == NULL ||
+        Revision == NULL) {
+
+        RevLogError(NULL, "Invalid parameter/-s.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Initialize the revision structure. It is the first allocation of its
+     * own arena, which then moves into it.
+     */
+    RevInitializeArena(&arena);
+
+    revision = (PREVISION)RevAllocateFromArena(&arena,
+                                               sizeof(REVISION),
+                                               sizeof(PVOID));
+    if (revision == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate memory for the revision structure "
+                    "(%llu bytes).",
+                    (ULONGLONG)sizeof(REVISION));
+        RevDeleteArena(&arena);
+        status = FALSE;
+        goto Exit;
+    }
+
+    revision->Arena = arena;
+
+    /*
+     * Initialize the fields.
+     */
+    revision->InitParams = *InitParams;
+    revision->RevisionRecords = NULL;
+    revision->Workers = NULL;
+    revision->CountOfWorkers = 0;
+    revision->CountOfEnumerators = 0;
+    revision->CountOfReaders = 0;
+    revision->CountOfCounters = 0;
+    revision->CountOfPendingTasks = 0;
+    revision->CountOfPendingFiles = 0;
+    revision->FileBuffers = NULL;
+    revision->FileBufferPool = NULL;
+    revision->CountOfFileBuffers = 0;
+    revision->FreeQueue.Cells = NULL;
+    revision->ReadQueue.Cells = NULL;
+    revision->CountQueue.Cells = NULL;
+    revision->CountOfLinesTotal = 0;
+    revision->CountOfLinesBlank = 0;
+    revision->CountOfLinesComment = 0;
+    revision->CountOfFiles = 0;
+    revision->CountOfIgnoredFiles = 0;
+    revision->CountOfDirectories = 0;
+    revision->CountOfAllocations = 0;
+    revision->CountOfMappedFiles = 0;
+    revision->CountOfBytesRead = 0;
+    revision->CountOfBytesMapped = 0;
+    revision->CountOfRingFiles = 0;
+    revision->CountOfBufferHits = 0;
+    revision->CountOfBufferAllocations = 0;
+    revision->CountOfBufferBytes = 0;
+    memset(&revision->Cache, 0, sizeof(revision->Cache));
+    revision->CountOfCachedFiles = 0;
+    revision->CountOfCachedDirectories = 0;
+    revision->ExcludePatterns = NULL;
+    revision->IncludePatterns = NULL;
+    revision->IsFiltered = FALSE;
+    revision->CountOfExcludedFiles = 0;
+    revision->CountOfExcludedDirectories = 0;
+    RevInitializeContentSet(&revision->ContentSet);
+    revision->CountOfDuplicateFiles = 0;
+    RevInitializeIdentitySet(&revision->IdentitySet);
+    revision->CountOfLinkedFiles = 0;
+    revision->CountOfLinkedDirectories = 0;
+    revision->CountOfFailedDirectories = 0;
+    revision->IsRootFailed = FALSE;
+
+    /*
+     * Build the process-wide tables and allocate one revision record for
+     * each language.
+     */
+    if (!RevInitializeTables()) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    revision->RevisionRecords = (PREVISION_RECORD)RevAllocateFromArena(
+        &revision->Arena,
+        CountOfLanguages * sizeof(REVISION_RECORD),
+        sizeof(ULONGLONG));
+    if (revision->RevisionRecords == NULL) {
+        RevLogError(revision,
+                    "Failed to allocate memory for the revision records "
+                    "(%llu bytes).",
+                    (ULONGLONG)CountOfLanguages * sizeof(REVISION_RECORD));
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * The patterns of the command line are compiled once for the whole
+     * revision.
+     */
+    if (!RevCompileCommandLinePatterns(revision,
+                                       InitParams->ExcludePatterns,
+                                       InitParams->CountOfExcludePatterns,
+                                       &revision->ExcludePatterns) ||
+        !RevCompileCommandLinePatterns(revision,
+                                       InitParams->IncludePatterns,
+                                       InitParams->CountOfIncludePatterns,
+                                       &revision->IncludePatterns)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    revision->IsFiltered = revision->ExcludePatterns != NULL ||
+                           revision->IncludePatterns != NULL ||
+                           InitParams->IsGitIgnoreUsed;
+
+Exit:
+    if (!status && revision != NULL) {
+        RevDeleteRevision(revision);
+        revision = NULL;
+    }
+
+    if (Revision != NULL) {
+        *Revision = revision;
+    }
+
+    return status;
+}
+
+BOOL
+RevStartRevision(
+    _Inout_ PREVISION Revision
+    )
+{
+    BOOL status = TRUE;
+    ULONG countOfProcessors;
+    ULONG countOfEnumerators;
+    ULONG countOfReaders;
+    ULONG countOfCounters;
+    ULONG countOfWorkers;
+    REVISION_STAGE stage;
+    ULONG index;
+    PPATHCHAR rootDirectoryPath = NULL;
+    REVISION_DIRECTORY rootDirectory;
+    REVISION_TASK_TYPE rootTaskType;
+
+    if (Revision == NULL ||
+        Revision->InitParams.RootDirectory == NULL) {
+        RevLogError(Revision,
+                    "The revision is not initialized/initialized correctly.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Determine the number of workers of each stage. By default, run one
+     * worker of each stage per logical processor.
+     */
+    countOfProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    if (countOfProcessors == 0) {
+        countOfProcessors = 1;
+    }
+
+    countOfEnumerators = Revision->InitParams.CountOfWorkers;
+    if (countOfEnumerators == 0) {
+        countOfEnumerators = countOfProcessors;
+    }
+    countOfReaders = Revision->InitParams.CountOfReaders;
+    if (countOfReaders == 0) {
+        countOfReaders = countOfProcessors;
+    }
+    countOfCounters = Revision->InitParams.CountOfCounters;
+    if (countOfCounters == 0) {
+        countOfCounters = countOfProcessors;
+    }
+
+    /*
+     * Keep at least one worker of each stage within the worker limit.
+     */
+    if (countOfEnumerators > REVISION_MAX_WORKERS - 2) {
+        countOfEnumerators = REVISION_MAX_WORKERS - 2;
+    }
+    if (countOfReaders > REVISION_MAX_WORKERS - 1 - countOfEnumerators) {
+        countOfReaders = REVISION_MAX_WORKERS - 1 - countOfEnumerators;
+    }
+    if (countOfCounters > REVISION_MAX_WORKERS - countOfEnumerators - countOfReaders) {
+        countOfCounters = REVISION_MAX_WORKERS - countOfEnumerators - countOfReaders;
+    }
+
+    countOfWorkers = countOfEnumerators + countOfReaders + countOfCounters;
+
+    Revision->CountOfEnumerators = countOfEnumerators;
+    Revision->CountOfReaders = countOfReaders;
+    Revision->CountOfCounters = countOfCounters;
+
+    /*
+     * The readers register the buffer pool with io_uring, so set up the
+     * pipeline first.
+     */
+    if (!RevInitializePipeline(Revision,
+                               (countOfReaders + countOfCounters) *
+                               REVISION_FILE_BUFFERS_PER_THREAD)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    Revision->Workers = (PREVISION_WORKER)RevAllocateFromArena(
+        &Revision->Arena,
+        countOfWorkers * sizeof(REVISION_WORKER),
+        sizeof(PVOID));
+    if (Revision->Workers == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate memory for the revision workers "
+                    "(%llu bytes).",
+                    (ULONGLONG)countOfWorkers * sizeof(REVISION_WORKER));
+        status = FALSE;
+        goto Exit;
+    }
+
+    for (index = 0; index < countOfWorkers; ++index) {
+        if (index < countOfEnumerators) {
+            stage = RevisionStageEnumerate;
+        } else if (index < countOfEnumerators + countOfReaders) {
+            stage = RevisionStageRead;
+        } else {
+            stage = RevisionStageCount;
+        }
+
+        if (!RevInitializeWorker(Revision, &Revision->Workers[index], index, stage)) {
+            RevLogError(Revision,
+                        "Failed to initialize the revision worker #%lu.",
+                        index);
+            status = FALSE;
+            goto Exit;
+        }
+        Revision->CountOfWorkers += 1;
+    }
+
+    if (Revision->InitParams.CacheFile != NULL &&
+        !RevLoadCache(Revision)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Seed the revision with the root directory. The root directory and its
+     * normalized path are kept here until all workers finish.
+     */
+    rootDirectoryPath = RevNormalizeRootDirectory(Revision->InitParams.RootDirectory);
+    if (rootDirectoryPath == NULL) {
+        RevLogError(Revision,
+                    "Failed to copy the revision root directory path.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    RevInitializeDirectory(&rootDirectory, NULL, rootDirectoryPath);
+
+    if (Revision->InitParams.FileList != NULL) {
+        rootTaskType = RevisionTaskFileList;
+    } else if (Revision->InitParams.IsGitIndexUsed) {
+        rootTaskType = RevisionTaskGitIndex;
+    } else {
+        rootTaskType = RevisionTaskDirectory;
+    }
+
+    RevScheduleTask(&Revision->Workers[0],
+                    rootTaskType,
+                    &rootDirectory,
+                    rootDirectory.Name);
+
+    /*
+     * Start the worker threads. The first enumerator runs on the calling
+     * thread.
+     */
+    for (index = 1; index < Revision->CountOfWorkers; ++index) {
+        Revision->Workers[index].Thread = CreateThread(NULL,
+                                                       0,
+                                                       RevWorkerThreadProc,
+                                                       &Revision->Workers[index],
+                                                       0,
+                                                       NULL);
+        if (Revision->Workers[index].Thread == NULL) {
+            /*
+             * Not fatal: the tasks will be executed by the remaining workers.
+             * Once done enumerating, the calling thread reads and counts
+             * files too, so every stage has at least one worker.
+             */
+            RevLogWarning(Revision,
+                          "Failed to start the revision worker #%lu. "
+                          "The last known error: %ls",
+                          index,
+                          RevGetLastKnownWin32Error());
+        }
+    }
+
+    RevWorkerThreadProc(&Revision->Workers[0]);
+
+    for (index = 1; index < Revision->CountOfWorkers; ++index) {
+        if (Revision->Workers[index].Thread != NULL) {
+            WaitForSingleObject(Revision->Workers[index].Thread, INFINITE);
+            CloseHandle(Revision->Workers[index].Thread);
+            Revision->Workers[index].Thread = NULL;
+        }
+    }
+
+    /*
+     * N.B. The root task sets the flag before its worker runs out of tasks,
+     * so it is visible once every worker has been joined.
+     */
+    if (Revision->IsRootFailed) {
+        status = FALSE;
+    }
+
+Exit:
+    /*
+     * Merge the statistics collected by each worker into the revision.
+     */
+    if (Revision != NULL && Revision->Workers != NULL) {
+        for (index = 0; index < Revision->CountOfWorkers; ++index) {
+            if (!RevMergeWorker(Revision, &Revision->Workers[index])) {
+                RevLogError(Revision,
+                            "Failed to merge the revision worker #%lu.",
+                            index);
+                status = FALSE;
+            }
+        }
+
+        Revision->Workers = NULL;
+        Revision->CountOfWorkers = 0;
+    }
+
+    /*
+     * N.B. A revision that failed, or that could not open or enumerate some
+     * of its directories, has missed files whose entries would be dropped
+     * from the cache. Keep the previous cache instead.
+     */
+    if (status &&
+        Revision != NULL &&
+        Revision->Cache.Path != NULL &&
+        Revision->CountOfFailedDirectories > 0) {
+        RevLogWarning(Revision,
+                      "The scan cache was not updated, because %lu directories "
+                      "could not be enumerated.",
+                      Revision->CountOfFailedDirectories);
+    } else if (status &&
+               Revision != NULL &&
+               Revision->Cache.Path != NULL &&
+               !RevSaveCache(Revision)) {
+        RevLogWarning(Revision,
+                      "The scan cache was not updated.");
+    }
+
+    free(rootDirectoryPath);
+
+    return status;
+}
+
+VOID
+RevDeleteRevision(
+    _In_opt_ PREVISION Revision
+    )
+{
+    REVISION_ARENA arena;
+
+    if (Revision == NULL) {
+        return;
+    }
+
+    RevDeleteCache(Revision);
+
+    free(Revision->ExcludePatterns);
+    free(Revision->IncludePatterns);
+
+    RevDeleteContentSet(&Revision->ContentSet);
+    RevDeleteIdentitySet(&Revision->IdentitySet);
+
+    /*
+     * The revision lives in its own arena, so move the arena out of it
+     * before deleting it.
+     */
+    arena = Revision->Arena;
+
+    RevDeleteArena(&arena);
+}
+
+VOID
+RevInitializeArena(
+    _Out_ PREVISION_ARENA Arena
+    )
+{
+    Arena->Blocks = NULL;
+    Arena->CountOfBlocks = 0;
+    Arena->CountOfBytes = 0;
+}
+
+_Must_inspect_result_
+PVOID
+RevAllocateFromArena(
+    _Inout_ PREVISION_ARENA Arena,
+    _In_ SIZE_T Size,
+    _In_ SIZE_T Alignment
+    )
+{
+    PREVISION_ARENA_BLOCK block = Arena->Blocks;
+    SIZE_T blockSize;
+    SIZE_T offset = 0;
+    BOOL isDedicated;
+    PVOID memory;
+
+    assert((Alignment & (Alignment - 1)) == 0 && Alignment <= REVISION_PAGE_SIZE);
+
+    if (block != NULL) {
+        offset = (block->Used + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    if (block == NULL || offset > block->Size || Size > block->Size - offset) {
+
+        /*
+         * Start a new block. An allocation too large for a regular block
+         * gets one of its own, with the header alone in the first page.
+         * It is linked behind the block being filled, which stays in use.
+         */
+        blockSize = REVISION_ARENA_BLOCK_SIZE;
+        isDedicated = Size > REVISION_ARENA_BLOCK_SIZE - REVISION_PAGE_SIZE;
+        if (isDedicated) {
+            blockSize = (REVISION_PAGE_SIZE + Size + REVISION_PAGE_SIZE - 1) &
+                        ~((SIZE_T)REVISION_PAGE_SIZE - 1);
+        }
+
+        block = (PREVISION_ARENA_BLOCK)_aligned_malloc(blockSize, REVISION_PAGE_SIZE);
+        if (block == NULL) {
+            RevLogError(NULL,
+                        "Failed to allocate an arena block (%llu bytes).",
+                        (ULONGLONG)blockSize);
+            return NULL;
+        }
+
+        block->Size = blockSize;
+        block->Used = sizeof(REVISION_ARENA_BLOCK);
+
+        if (isDedicated && Arena->Blocks != NULL) {
+            block->Next = Arena->Blocks->Next;
+            Arena->Blocks->Next = block;
+        } else {
+            block->Next = Arena->Blocks;
+            Arena->Blocks = block;
+        }
+
+        Arena->CountOfBlocks += 1;
+        Arena->CountOfBytes += blockSize;
+
+        offset = (block->Used + Alignment - 1) & ~(Alignment - 1);
+    }
+
+    memory = (PCHAR)block + offset;
+    block->Used = offset + Size;
+
+    memset(memory, 0, Size);
+
+    return memory;
+}
+
+VOID
+RevDeleteArena(
+    _Inout_ PREVISION_ARENA Arena
+    )
+{
+    PREVISION_ARENA_BLOCK block;
+
+    while (Arena->Blocks != NULL) {
+        block = Arena->Blocks;
+        Arena->Blocks = block->Next;
+        _aligned_free(block);
+    }
+
+    Arena->CountOfBlocks = 0;
+    Arena->CountOfBytes = 0;
+}
+
+_Must_inspect_result_
+BOOL
+RevInitializeWorker(
+    _Inout_ PREVISION Revision,
+    _Out_ PREVISION_WORKER Worker,
+    _In_ ULONG Index,
+    _In_ REVISION_STAGE Stage
+    )
+{
+    BOOL status = TRUE;
+
+    Worker->Revision = Revision;
+    Worker->Stage = Stage;
+    Worker->Index = Index;
+    Worker->Thread = NULL;
+
+    /*
+     * N.B. The xorshift generator must not be seeded with zero.
+     */
+    Worker->RandomState = Index * 2654435761UL + 1;
+
+    InitializeSRWLock(&Worker->Deque.Lock);
+    Worker->Deque.Capacity = 0;
+    Worker->Deque.Top = 0;
+    Worker->Deque.Count = 0;
+    Worker->Deque.Tasks = NULL;
+    Worker->DirectoryBuffer = NULL;
+    memset(&Worker->BufferPool, 0, sizeof(Worker->BufferPool));
+    Worker->RevisionRecords = NULL;
+    Worker->CacheEntries = NULL;
+    Worker->CountOfCacheEntries = 0;
+    Worker->CacheEntriesCapacity = 0;
+    Worker->CountOfCachedFiles = 0;
+    Worker->CacheDirectories = NULL;
+    Worker->CountOfCacheDirectories = 0;
+    Worker->CacheDirectoriesCapacity = 0;
+    Worker->CacheNames = NULL;
+    Worker->CountOfCacheNameChars = 0;
+    Worker->CacheNamesCapacity = 0;
+    Worker->CountOfCachedDirectories = 0;
+    Worker->PatternPath = NULL;
+    Worker->PatternPathCapacity = 0;
+    Worker->PatternPathLength = 0;
+    Worker->HasPatternPath = FALSE;
+    Worker->CountOfExcludedFiles = 0;
+    Worker->CountOfExcludedDirectories = 0;
+    Worker->CountOfDuplicateFiles = 0;
+    Worker->CountOfLinkedFiles = 0;
+    Worker->CountOfLinkedDirectories = 0;
+    Worker->CountOfFailedDirectories = 0;
+#ifdef REVISION_IO_URING
+    Worker->Ring.Handle = -1;
+#endif
+
+    /*
+     * Only enumerators execute tasks. The read buffers of the files that
+     * are streamed come from the buffer pool, which starts out empty.
+     */
+    if (Stage == RevisionStageEnumerate) {
+        Worker->Deque.Capacity = REVISION_DEQUE_INITIAL_CAPACITY;
+        Worker->Deque.Tasks = (PREVISION_TASK)malloc(REVISION_DEQUE_INITIAL_CAPACITY *
+                                                     sizeof(REVISION_TASK));
+        if (Worker->Deque.Tasks == NULL) {
+            RevLogError(Revision,
+                        "Failed to allocate the worker task deque (%llu bytes).",
+                        (ULONGLONG)REVISION_DEQUE_INITIAL_CAPACITY * sizeof(REVISION_TASK));
+            status = FALSE;
+            goto Exit;
+        }
+
+        Worker->DirectoryBuffer = (PCHAR)RevAllocateFromArena(&Revision->Arena,
+                                                              REVISION_DIRECTORY_BUFFER_SIZE,
+                                                              sizeof(ULONGLONG));
+        if (Worker->DirectoryBuffer == NULL) {
+            RevLogError(Revision,
+                        "Failed to allocate the worker directory buffer "
+                        "(%llu bytes).",
+                        (ULONGLONG)REVISION_DIRECTORY_BUFFER_SIZE);
+            status = FALSE;
+            goto Exit;
+        }
+    }
+
+    Worker->RevisionRecords = (PREVISION_RECORD)RevAllocateFromArena(
+        &Revision->Arena,
+        CountOfLanguages * sizeof(REVISION_RECORD),
+        sizeof(ULONGLONG));
+    if (Worker->RevisionRecords == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate the worker revision records "
+                    "(%llu bytes).",
+                    (ULONGLONG)CountOfLanguages * sizeof(REVISION_RECORD));
+        status = FALSE;
+        goto Exit;
+    }
+
+    Worker->CountOfLinesTotal = 0;
+    Worker->CountOfLinesBlank = 0;
+    Worker->CountOfLinesComment = 0;
+    Worker->CountOfFiles = 0;
+    Worker->CountOfIgnoredFiles = 0;
+    Worker->CountOfDirectories = 0;
+    Worker->CountOfAllocations = 0;
+    Worker->CountOfMappedFiles = 0;
+    Worker->CountOfBytesRead = 0;
+    Worker->CountOfBytesMapped = 0;
+    Worker->CountOfRingFiles = 0;
+
+#ifdef REVISION_IO_URING
+    /*
+     * Without io_uring, the reader reads every file with blocking system
+     * calls.
+     */
+    if (Stage == RevisionStageRead &&
+        Revision->InitParams.IsIoUringEnabled &&
+        !RevInitializeRing(Revision, &Worker->Ring)) {
+        Worker->Ring.Handle = -1;
+    }
+#endif
+
+Exit:
+    if (!status) {
+        free(Worker->Deque.Tasks);
+        Worker->Deque.Tasks = NULL;
+    }
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevPushTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_TASK Task
+    )
+{
+    BOOL status = TRUE;
+    PREVISION_TASK_DEQUE deque = &Worker->Deque;
+    PREVISION_TASK tasks;
+    ULONG capacity;
+    ULONG index;
+
+    AcquireSRWLockExclusive(&deque->Lock);
+
+    if (deque->Count == deque->Capacity) {
+        /*
+         * The deque is full, double its capacity and unwrap the ring
+         * buffer so that the topmost task is at index zero.
+         */
+        capacity = deque->Capacity * 2;
+        tasks = (PREVISION_TASK)malloc(capacity * sizeof(REVISION_TASK));
+        if (tasks == NULL) {
+            RevLogError(Worker->Revision,
+                        "Failed to grow the worker task deque (%llu bytes).",
+                        (ULONGLONG)capacity * sizeof(REVISION_TASK));
+            status = FALSE;
+            goto Exit;
+        }
+
+        for (index = 0; index < deque->Count; ++index) {
+            tasks[index] = deque->Tasks[(deque->Top + index) & (deque->Capacity - 1)];
+        }
+
+        free(deque->Tasks);
+        deque->Tasks = tasks;
+        deque->Capacity = capacity;
+        deque->Top = 0;
+
+        Worker->CountOfAllocations += 1;
+    }
+
+    deque->Tasks[(deque->Top + deque->Count) & (deque->Capacity - 1)] = *Task;
+    deque->Count += 1;
+
+Exit:
+    ReleaseSRWLockExclusive(&deque->Lock);
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevPopTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _Out_ PREVISION_TASK Task
+    )
+{
+    BOOL status = FALSE;
+    PREVISION_TASK_DEQUE deque = &Worker->Deque;
+
+    AcquireSRWLockExclusive(&deque->Lock);
+
+    if (deque->Count > 0) {
+        deque->Count -= 1;
+        *Task = deque->Tasks[(deque->Top + deque->Count) & (deque->Capacity - 1)];
+        status = TRUE;
+    }
+
+    ReleaseSRWLockExclusive(&deque->Lock);
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevStealTask(
+    _Inout_ PREVISION_WORKER Victim,
+    _Out_ PREVISION_TASK Task
+    )
+{
+    BOOL status = FALSE;
+    PREVISION_TASK_DEQUE deque = &Victim->Deque;
+
+    AcquireSRWLockExclusive(&deque->Lock);
+
+    if (deque->Count > 0) {
+        *Task = deque->Tasks[deque->Top];
+        deque->Top = (deque->Top + 1) & (deque->Capacity - 1);
+        deque->Count -= 1;
+        status = TRUE;
+    }
+
+    ReleaseSRWLockExclusive(&deque->Lock);
+
+    return status;
+}
+
+VOID
+RevScheduleTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ REVISION_TASK_TYPE Type,
+    _Inout_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name
+    )
+{
+    REVISION_TASK task;
+
+    task.Type = Type;
+    task.Directory = Directory;
+    task.Name = Name;
+
+    RevReferenceDirectory(Directory);
+
+    /*
+     * N.B. The pending task count must be incremented before the task
+     * becomes visible to other workers, otherwise they could observe zero
+     * pending tasks and quit while there is still work to do.
+     */
+    InterlockedIncrement(&Worker->Revision->CountOfPendingTasks);
+
+    if (!RevPushTask(Worker, &task)) {
+        RevLogWarning(Worker->Revision,
+                      "Failed to queue the task for \"" PATH_FORMAT "\", "
+                      "executing it in place.",
+                      Name);
+        RevExecuteTask(Worker, &task);
+    }
+}
+
+VOID
+RevExecuteTask(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_TASK Task
+    )
+{
+    PPATHCHAR path;
+
+    switch (Task->Type) {
+    case RevisionTaskDirectory:
+        /*
+         * N.B. A subtree that fails is skipped, but a root that fails
+         * leaves nothing to revise, so the revision fails.
+         */
+        if (!RevOpenDirectory(Worker->Revision, Task->Directory)) {
+            Worker->CountOfFailedDirectories += 1;
+            if (Task->Directory->Parent == NULL) {
+                Worker->Revision->IsRootFailed = TRUE;
+            }
+            RevReleaseDirectory(Task->Directory);
+            break;
+        }
+
+        if (!RevClaimDirectory(Worker, Task->Directory)) {
+            RevReleaseDirectory(Task->Directory);
+            break;
+        }
+
+        /*
+         * The .gitignore file applies to the directory itself, so it is
+         * compiled before the directory is enumerated or replayed.
+         */
+        if (Worker->Revision->InitParams.IsGitIgnoreUsed) {
+            RevLoadIgnoreFile(Worker, Task->Directory);
+        }
+
+        if (!RevReviseCachedDirectory(Worker, Task->Directory) &&
+            !RevEnumerateDirectory(Worker, Task->Directory)) {
+            path = RevBuildPath(Task->Directory->Parent, Task->Directory->Name);
+            RevLogError(Worker->Revision,
+                        "Failed to enumerate the directory \"" PATH_FORMAT "\".",
+                        path);
+            free(path);
+            Worker->CountOfFailedDirectories += 1;
+            if (Task->Directory->Parent == NULL) {
+                Worker->Revision->IsRootFailed = TRUE;
+            }
+        }
+
+        RevReleaseDirectory(Task->Directory);
+        break;
+
+    case RevisionTaskGitIndex:
+        /*
+         * N.B. Without the index there is nothing to revise, so the
+         * revision fails rather than reporting an empty tree.
+         */
+        if (!RevOpenDirectory(Worker->Revision, Task->Directory)) {
+            Worker->CountOfFailedDirectories += 1;
+            Worker->Revision->IsRootFailed = TRUE;
+        } else if (!RevEnumerateGitIndex(Worker, Task->Directory)) {
+            path = RevBuildPath(Task->Directory->Parent, Task->Directory->Name);
+            RevLogError(Worker->Revision,
+                        "Failed to read the git index of \"" PATH_FORMAT "\".",
+                        path);
+            free(path);
+            Worker->CountOfFailedDirectories += 1;
+            Worker->Revision->IsRootFailed = TRUE;
+        }
+
+        RevReleaseDirectory(Task->Directory);
+        break;
+
+    case RevisionTaskFileList:
+        /*
+         * N.B. A list that cannot be read would revise nothing or only
+         * some of its files, so the revision fails.
+         */
+        if (!RevOpenDirectory(Worker->Revision, Task->Directory)) {
+            Worker->CountOfFailedDirectories += 1;
+            Worker->Revision->IsRootFailed = TRUE;
+        } else if (!RevEnumerateFileList(Worker, Task->Directory)) {
+            RevLogError(Worker->Revision,
+                        "Failed to read the file list \"%ls\".",
+                        Worker->Revision->InitParams.FileList);
+            Worker->CountOfFailedDirectories += 1;
+            Worker->Revision->IsRootFailed = TRUE;
+        }
+
+        RevReleaseDirectory(Task->Directory);
+        break;
+
+    default:
+        assert(FALSE);
+        break;
+    }
+
+    Task->Name = NULL;
+    Task->Directory = NULL;
+
+    /*
+     * N.B. Any tasks scheduled by this one have already been counted, so
+     * the pending task count can only drop to zero once all work is done.
+     */
+    InterlockedDecrement(&Worker->Revision->CountOfPendingTasks);
+}
+
+VOID
+RevRunWorker(
+    _Inout_ PREVISION_WORKER Worker
+    )
+{
+    REVISION_TASK task;
+    ULONG idleRounds = 0;
+    ULONG attempt;
+    ULONG victim;
+    BOOL found;
+
+    for (;;) {
+        /*
+         * Prefer the most recently scheduled task of our own: it is the
+         * deepest one and most likely to be hot in the cache.
+         */
+        if (RevPopTask(Worker, &task)) {
+            RevExecuteTask(Worker, &task);
+            idleRounds = 0;
+            continue;
+        }
+
+        /*
+         * Out of local work, try to steal the oldest task of a randomly
+         * chosen enumerator. Old tasks are usually directories close to the
+         * root, which keeps the thief busy for a while.
+         */
+        found = FALSE;
+        for (attempt = 0;
+             attempt < Worker->Revision->CountOfEnumerators && !found;
+             ++attempt) {
+
+            Worker->RandomState ^= Worker->RandomState << 13;
+            Worker->RandomState ^= Worker->RandomState >> 17;
+            Worker->RandomState ^= Worker->RandomState << 5;
+
+            victim = Worker->RandomState % Worker->Revision->CountOfEnumerators;
+            if (victim == Worker->Index) {
+                continue;
+            }
+
+            found = RevStealTask(&Worker->Revision->Workers[victim], &task);
+        }
+
+        if (found) {
+            RevExecuteTask(Worker, &task);
+            idleRounds = 0;
+            continue;
+        }
+
+        /*
+         * Nothing to steal. If no tasks are pending anywhere, the revision
+         * is finished; otherwise, another worker is still producing tasks.
+         */
+        if (InterlockedCompareExchange(&Worker->Revision->CountOfPendingTasks, 0, 0) == 0) {
+            break;
+        }
+
+        if (++idleRounds < REVISION_IDLE_SPIN_COUNT) {
+            SwitchToThread();
+        } else {
+            Sleep(1);
+        }
+    }
+}
+
+VOID
+RevRunReader(
+    _Inout_ PREVISION_WORKER Worker
+    )
+{
+    PREVISION_FILE_BUFFER file;
+    ULONG idleRounds = 0;
+    BOOL isEnumerated;
+
+    for (;;) {
+        /*
+         * N.B. Every file is submitted before the directory task that
+         * found it completes. Checking for the end of the enumeration
+         * before looking for files ensures that the last of them are seen.
+         */
+        isEnumerated = ReadAcquire(&Worker->Revision->CountOfPendingTasks) == 0;
+
+        if (RevPopQueue(&Worker->Revision->ReadQueue, &file)) {
+#ifdef REVISION_IO_URING
+            if (Worker->Ring.Handle != -1) {
+                RevQueueRingFile(Worker, file);
+                idleRounds = 0;
+                continue;
+            }
+#endif
+            RevReadFileBuffer(Worker, file);
+            idleRounds = 0;
+            continue;
+        }
+
+#ifdef REVISION_IO_URING
+        /*
+         * Out of submitted files with files in flight: submit the queued
+         * ones and pass on those that complete.
+         */
+        if (Worker->Ring.CountOfFilesInFlight > 0) {
+            RevSubmitRing(Worker, TRUE);
+            idleRounds = 0;
+            continue;
+        }
+#endif
+
+        if (isEnumerated) {
+            break;
+        }
+
+        if (++idleRounds < REVISION_IDLE_SPIN_COUNT) {
+            SwitchToThread();
+        } else {
+            Sleep(1);
+        }
+    }
+}
+
+VOID
+RevRunCounter(
+    _Inout_ PREVISION_WORKER Worker
+    )
+{
+    PREVISION_FILE_BUFFER file;
+    ULONG idleRounds = 0;
+
+    for (;;) {
+        if (RevPopQueue(&Worker->Revision->CountQueue, &file)) {
+            RevCountFileBuffer(Worker, file);
+            idleRounds = 0;
+            continue;
+        }
+
+        /*
+         * Once the enumeration is finished, no files are submitted any
+         * more, and the revision is finished when the last one is counted.
+         */
+        if (ReadAcquire(&Worker->Revision->CountOfPendingTasks) == 0 &&
+            ReadAcquire(&Worker->Revision->CountOfPendingFiles) == 0) {
+            break;
+        }
+
+        if (++idleRounds < REVISION_IDLE_SPIN_COUNT) {
+            SwitchToThread();
+        } else {
+            Sleep(1);
+        }
+    }
+}
+
+DWORD
+WINAPI
+RevWorkerThreadProc(
+    _In_ LPVOID Parameter
+    )
+{
+    PREVISION_WORKER worker = (PREVISION_WORKER)Parameter;
+
+    /*
+     * A worker that runs out of work of its own stage moves on to the
+     * later ones, helping to drain the pipeline.
+     */
+    switch (worker->Stage) {
+    case RevisionStageEnumerate:
+        RevRunWorker(worker);
+        /* fall through */
+
+    case RevisionStageRead:
+        RevRunReader(worker);
+        /* fall through */
+
+    case RevisionStageCount:
+        RevRunCounter(worker);
+        break;
+
+    default:
+        assert(FALSE);
+        break;
+    }
+
+    return 0;
+}
+
+_Must_inspect_result_
+BOOL
+RevMergeWorker(
+    _Inout_ PREVISION Revision,
+    _Inout_ PREVISION_WORKER Worker
+    )
+{
+    BOOL status = TRUE;
+    ULONG languageId;
+    PREVISION_RECORD workerRecord;
+    PREVISION_RECORD revisionRecord;
+    PREVISION_CACHE_ENTRY cacheEntries;
+    PREVISION_CACHE_DIRECTORY cacheDirectories;
+    PPATHCHAR cacheNames;
+    SIZE_T index;
+
+    /*
+     * Merge each record of the worker into the revision record of the same
+     * language/file type.
+     */
+    for (languageId = 0; languageId < CountOfLanguages; ++languageId) {
+        workerRecord = &Worker->RevisionRecords[languageId];
+        revisionRecord = &Revision->RevisionRecords[languageId];
+
+        revisionRecord->CountOfLinesTotal += workerRecord->CountOfLinesTotal;
+        revisionRecord->CountOfLinesBlank += workerRecord->CountOfLinesBlank;
+        revisionRecord->CountOfLinesComment += workerRecord->CountOfLinesComment;
+        revisionRecord->CountOfFiles += workerRecord->CountOfFiles;
+    }
+
+    Worker->RevisionRecords = NULL;
+
+    Revision->CountOfLinesTotal += Worker->CountOfLinesTotal;
+    Revision->CountOfLinesBlank += Worker->CountOfLinesBlank;
+    Revision->CountOfLinesComment += Worker->CountOfLinesComment;
+    Revision->CountOfFiles += Worker->CountOfFiles;
+    Revision->CountOfIgnoredFiles += Worker->CountOfIgnoredFiles;
+    Revision->CountOfDirectories += Worker->CountOfDirectories;
+    Revision->CountOfAllocations += Worker->CountOfAllocations;
+    Revision->CountOfMappedFiles += Worker->CountOfMappedFiles;
+    Revision->CountOfBytesRead += Worker->CountOfBytesRead;
+    Revision->CountOfBytesMapped += Worker->CountOfBytesMapped;
+    Revision->CountOfRingFiles += Worker->CountOfRingFiles;
+    Revision->CountOfBufferHits += Worker->BufferPool.CountOfHits;
+    Revision->CountOfBufferAllocations += Worker->BufferPool.CountOfAllocations;
+    Revision->CountOfBufferBytes += Worker->BufferPool.CountOfBytesAllocated;
+    Revision->CountOfCachedFiles += Worker->CountOfCachedFiles;
+    Revision->CountOfCachedDirectories += Worker->CountOfCachedDirectories;
+    Revision->CountOfExcludedFiles += Worker->CountOfExcludedFiles;
+    Revision->CountOfExcludedDirectories += Worker->CountOfExcludedDirectories;
+    Revision->CountOfDuplicateFiles += Worker->CountOfDuplicateFiles;
+    Revision->CountOfLinkedFiles += Worker->CountOfLinkedFiles;
+    Revision->CountOfLinkedDirectories += Worker->CountOfLinkedDirectories;
+    Revision->CountOfFailedDirectories += Worker->CountOfFailedDirectories;
+
+    /*
+     * Collect the scan cache entries of the worker. If there is no room
+     * for them, their files are counted again by the next revision.
+     */
+    if (Worker->CountOfCacheEntries > 0) {
+        cacheEntries = (PREVISION_CACHE_ENTRY)realloc(
+            Revision->Cache.NewEntries,
+            (Revision->Cache.CountOfNewEntries + Worker->CountOfCacheEntries) *
+            sizeof(REVISION_CACHE_ENTRY));
+        if (cacheEntries == NULL) {
+            RevLogWarning(Revision,
+                          "Failed to collect the scan cache entries of the "
+                          "revision worker #%lu.",
+                          Worker->Index);
+        } else {
+            memcpy(cacheEntries + Revision->Cache.CountOfNewEntries,
+                   Worker->CacheEntries,
+                   Worker->CountOfCacheEntries * sizeof(REVISION_CACHE_ENTRY));
+            Revision->Cache.NewEntries = cacheEntries;
+            Revision->Cache.CountOfNewEntries += Worker->CountOfCacheEntries;
+        }
+    }
+
+    free(Worker->CacheEntries);
+    Worker->CacheEntries = NULL;
+    Worker->CountOfCacheEntries = 0;
+    Worker->CacheEntriesCapacity = 0;
+
+    /*
+     * Collect the scan cache directories of the worker the same way, with
+     * the names of their subdirectories moved after those collected so far.
+     */
+    if (Worker->CountOfCacheDirectories > 0) {
+
+        /*
+         * N.B. Directories without subdirectories bring no names, and the
+         * names collected so far are kept as they are.
+         */
+        cacheNames = Revision->Cache.NewNames;
+        if (Worker->CountOfCacheNameChars > 0) {
+            cacheNames = (PPATHCHAR)realloc(
+                Revision->Cache.NewNames,
+                (Revision->Cache.CountOfNewNameChars + Worker->CountOfCacheNameChars) *
+                sizeof(PATHCHAR));
+        }
+
+        cacheDirectories = NULL;
+        if (cacheNames != NULL || Worker->CountOfCacheNameChars == 0) {
+            Revision->Cache.NewNames = cacheNames;
+            cacheDirectories = (PREVISION_CACHE_DIRECTORY)realloc(
+                Revision->Cache.NewDirectories,
+                (Revision->Cache.CountOfNewDirectories + Worker->CountOfCacheDirectories) *
+                sizeof(REVISION_CACHE_DIRECTORY));
+        }
+
+        if (cacheDirectories == NULL) {
+            RevLogWarning(Revision,
+                          "Failed to collect the scan cache directories of the "
+                          "revision worker #%lu.",
+                          Worker->Index);
+        } else {
+            if (Worker->CountOfCacheNameChars > 0) {
+                memcpy(cacheNames + Revision->Cache.CountOfNewNameChars,
+                       Worker->CacheNames,
+                       Worker->CountOfCacheNameChars * sizeof(PATHCHAR));
+            }
+
+            for (index = 0; index < Worker->CountOfCacheDirectories; ++index) {
+                cacheDirectories[Revision->Cache.CountOfNewDirectories + index] =
+                    Worker->CacheDirectories[index];
+                cacheDirectories[Revision->Cache.CountOfNewDirectories + index].FirstNameChar +=
+                    Revision->Cache.CountOfNewNameChars;
+            }
+
+            Revision->Cache.NewDirectories = cacheDirectories;
+            Revision->Cache.CountOfNewDirectories += Worker->CountOfCacheDirectories;
+            Revision->Cache.CountOfNewNameChars += Worker->CountOfCacheNameChars;
+        }
+    }
+
+    free(Worker->CacheDirectories);
+    Worker->CacheDirectories = NULL;
+    Worker->CountOfCacheDirectories = 0;
+    Worker->CacheDirectoriesCapacity = 0;
+
+    free(Worker->CacheNames);
+    Worker->CacheNames = NULL;
+    Worker->CountOfCacheNameChars = 0;
+    Worker->CacheNamesCapacity = 0;
+
+    free(Worker->PatternPath);
+    Worker->PatternPath = NULL;
+    Worker->PatternPathCapacity = 0;
+
+    /*
+     * All tasks have been executed by now, so the deque must be empty.
+     * Only enumerators own a deque and a directory buffer.
+     */
+    assert(Worker->Deque.Count == 0);
+    free(Worker->Deque.Tasks);
+    Worker->Deque.Tasks = NULL;
+
+    Worker->DirectoryBuffer = NULL;
+
+    RevDeleteBufferPool(&Worker->BufferPool);
+
+#ifdef REVISION_IO_URING
+    if (Worker->Ring.Handle != -1) {
+        RevDeleteRing(&Worker->Ring);
+    }
+#endif
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevInitializeQueue(
+    _Inout_ PREVISION Revision,
+    _Out_ PREVISION_QUEUE Queue,
+    _In_ ULONG Capacity
+    )
+{
+    ULONG index;
+
+    assert((Capacity & (Capacity - 1)) == 0);
+
+    Queue->Cells = (PREVISION_QUEUE_CELL)RevAllocateFromArena(&Revision->Arena,
+                                                              Capacity * sizeof(REVISION_QUEUE_CELL),
+                                                              sizeof(PVOID));
+    if (Queue->Cells == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate the pipeline queue (%llu bytes).",
+                    (ULONGLONG)Capacity * sizeof(REVISION_QUEUE_CELL));
+        return FALSE;
+    }
+
+    /*
+     * A cell may be pushed to in the lap its sequence number equals the
+     * position of, and popped from once it is one past it.
+     */
+    for (index = 0; index < Capacity; ++index) {
+        Queue->Cells[index].Sequence = (LONG)index;
+        Queue->Cells[index].Item = NULL;
+    }
+
+    Queue->Mask = Capacity - 1;
+    Queue->EnqueuePosition = 0;
+    Queue->DequeuePosition = 0;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevPushQueue(
+    _Inout_ PREVISION_QUEUE Queue,
+    _In_ PREVISION_FILE_BUFFER Item
+    )
+{
+    PREVISION_QUEUE_CELL cell;
+    LONG position;
+    LONG previous;
+    LONG difference;
+
+    position = ReadAcquire(&Queue->EnqueuePosition);
+
+    for (;;) {
+        cell = &Queue->Cells[(ULONG)position & Queue->Mask];
+        difference = (LONG)((ULONG)ReadAcquire(&cell->Sequence) - (ULONG)position);
+
+        if (difference == 0) {
+
+            /*
+             * The cell is free in this lap, claim it.
+             */
+            previous = InterlockedCompareExchange(&Queue->EnqueuePosition,
+                                                  position + 1,
+                                                  position);
+            if (previous == position) {
+                break;
+            }
+            position = previous;
+
+        } else if (difference < 0) {
+
+            /*
+             * The cell still holds the item of the previous lap.
+             */
+            return FALSE;
+
+        } else {
+            position = ReadAcquire(&Queue->EnqueuePosition);
+        }
+    }
+
+    cell->Item = Item;
+    WriteRelease(&cell->Sequence, position + 1);
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevPopQueue(
+    _Inout_ PREVISION_QUEUE Queue,
+    _Out_ PREVISION_FILE_BUFFER *Item
+    )
+{
+    PREVISION_QUEUE_CELL cell;
+    LONG position;
+    LONG previous;
+    LONG difference;
+
+    position = ReadAcquire(&Queue->DequeuePosition);
+
+    for (;;) {
+        cell = &Queue->Cells[(ULONG)position & Queue->Mask];
+        difference = (LONG)((ULONG)ReadAcquire(&cell->Sequence) - (ULONG)position - 1);
+
+        if (difference == 0) {
+
+            /*
+             * The cell has been pushed to in this lap, claim it.
+             */
+            previous = InterlockedCompareExchange(&Queue->DequeuePosition,
+                                                  position + 1,
+                                                  position);
+            if (previous == position) {
+                break;
+            }
+            position = previous;
+
+        } else if (difference < 0) {
+
+            /*
+             * The cell has not been pushed to yet.
+             */
+            return FALSE;
+
+        } else {
+            position = ReadAcquire(&Queue->DequeuePosition);
+        }
+    }
+
+    *Item = cell->Item;
+    WriteRelease(&cell->Sequence, position + (LONG)Queue->Mask + 1);
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevInitializePipeline(
+    _Inout_ PREVISION Revision,
+    _In_ ULONG CountOfFileBuffers
+    )
+{
+    BOOL status = TRUE;
+    ULONG capacity;
+    ULONG index;
+
+    Revision->FileBuffers = (PREVISION_FILE_BUFFER)RevAllocateFromArena(
+        &Revision->Arena,
+        CountOfFileBuffers * sizeof(REVISION_FILE_BUFFER),
+        sizeof(PVOID));
+    if (Revision->FileBuffers == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate the pipeline file buffers (%llu bytes).",
+                    (ULONGLONG)CountOfFileBuffers * sizeof(REVISION_FILE_BUFFER));
+        status = FALSE;
+        goto Exit;
+    }
+
+    Revision->FileBufferPool = (PCHAR)RevAllocateFromArena(&Revision->Arena,
+                                                           (SIZE_T)CountOfFileBuffers *
+                                                               REVISION_FILE_BUFFER_SIZE,
+                                                           REVISION_PAGE_SIZE);
+    if (Revision->FileBufferPool == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate the pipeline buffer pool (%llu bytes).",
+                    (ULONGLONG)CountOfFileBuffers * REVISION_FILE_BUFFER_SIZE);
+        status = FALSE;
+        goto Exit;
+    }
+
+    Revision->CountOfFileBuffers = CountOfFileBuffers;
+
+    /*
+     * Each queue can hold every file buffer at once, so pushing to one
+     * never fails: the free queue running dry is the only backpressure.
+     */
+    for (capacity = 1; capacity < CountOfFileBuffers; capacity *= 2) {
+        ;
+    }
+
+    if (!RevInitializeQueue(Revision, &Revision->FreeQueue, capacity) ||
+        !RevInitializeQueue(Revision, &Revision->ReadQueue, capacity) ||
+        !RevInitializeQueue(Revision, &Revision->CountQueue, capacity)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    for (index = 0; index < CountOfFileBuffers; ++index) {
+        Revision->FileBuffers[index].Data = Revision->FileBufferPool +
+                                            (SIZE_T)index * REVISION_FILE_BUFFER_SIZE;
+
+        if (!RevPushQueue(&Revision->FreeQueue, &Revision->FileBuffers[index])) {
+            status = FALSE;
+            goto Exit;
+        }
+    }
+
+Exit:
+    return status;
+}
+
+VOID
+RevSubmitFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ PREVISION_RECORD_EXTENSION_MAPPING Mapping
+    )
+{
+    PREVISION_FILE_BUFFER file;
+    REVISION_CACHE_KEY cacheKey;
+    BOOL hasCacheKey = FALSE;
+
+    /*
+     * With a scan cache, a file that has not changed since the previous
+     * revision is not read at all. A file whose version, or that of its
+     * directory, is unknown is counted, but not cached.
+     */
+    if (Directory->HasCacheKey &&
+        RevQueryFileKey(Worker->Revision, Directory, FileName, &cacheKey)) {
+
+        if (RevReviseCachedFile(Worker, Directory, FileName, Mapping, &cacheKey)) {
+            return;
+        }
+
+        hasCacheKey = TRUE;
+    }
+
+    RevReferenceDirectory(Directory);
+
+    /*
+     * N.B. The pending file count must be incremented while the directory
+     * task is still pending, otherwise the counters could observe no
+     * pending work and quit before the file is counted.
+     */
+    InterlockedIncrement(&Worker->Revision->CountOfPendingFiles);
+
+    /*
+     * Every buffer is taken when the readers or counters fall behind. The
+     * enumeration then slows down to their pace, doing their work meanwhile.
+     */
+    while (!RevPopQueue(&Worker->Revision->FreeQueue, &file)) {
+        RevHelpPipeline(Worker);
+    }
+
+    file->Directory = Directory;
+    file->FileName = FileName;
+    file->Mapping = Mapping;
+    file->Contents = NULL;
+    file->Size = 0;
+    file->IsMapped = FALSE;
+    file->HasCacheKey = hasCacheKey;
+    file->HasContentHash = FALSE;
+    if (hasCacheKey) {
+        file->CacheEntry.Key = cacheKey;
+        file->CacheEntry.DirectoryDevice = Directory->CacheKey.Device;
+        file->CacheEntry.DirectoryInode = Directory->CacheKey.Inode;
+    }
+
+    if (!RevPushQueue(&Worker->Revision->ReadQueue, file)) {
+        RevReadFileBuffer(Worker, file);
+    }
+}
+
+VOID
+RevHelpPipeline(
+    _Inout_ PREVISION_WORKER Worker
+    )
+{
+    PREVISION_FILE_BUFFER file;
+
+    /*
+     * Counting a file frees its buffer right away, so prefer it.
+     */
+    if (RevPopQueue(&Worker->Revision->CountQueue, &file)) {
+        RevCountFileBuffer(Worker, file);
+    } else if (RevPopQueue(&Worker->Revision->ReadQueue, &file)) {
+        RevReadFileBuffer(Worker, file);
+    } else {
+        SwitchToThread();
+    }
+}
+
+VOID
+RevReadFileBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    )
+{
+    BOOL status = TRUE;
+    BOOL isRead = FALSE;
+    FILEHANDLE file = INVALID_FILE_HANDLE;
+    ULONGLONG fileSize;
+    const CHAR *view;
+    SIZE_T bytesRead;
+    PPATHCHAR path;
+
+    if (!RevOpenFile(Worker->Revision, File->Directory, File->FileName, &file)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    if (!RevQueryFileSize(Worker->Revision, File->Directory, File->FileName, file, &fileSize)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Files from the map threshold up are mapped and passed on as a view,
+     * which saves copying them out of the file system cache. Smaller files
+     * are cheaper to read than to map and unmap. If the file cannot be
+     * mapped, it is read like a small one.
+     */
+    if (fileSize > 0 &&
+        fileSize >= Worker->Revision->InitParams.MapThreshold &&
+        fileSize <= (SIZE_T)-1 &&
+        RevMapFile(Worker->Revision,
+                   File->Directory,
+                   File->FileName,
+                   file,
+                   (SIZE_T)fileSize,
+                   &view)) {
+
+        File->Contents = view;
+        File->Size = (SIZE_T)fileSize;
+        File->IsMapped = TRUE;
+
+        Worker->CountOfMappedFiles += 1;
+        Worker->CountOfBytesMapped += fileSize;
+        isRead = TRUE;
+        goto Exit;
+    }
+
+    if (fileSize < REVISION_FILE_BUFFER_SIZE) {
+        if (!RevReadFileChunk(Worker->Revision,
+                              File->Directory,
+                              File->FileName,
+                              file,
+                              File->Data,
+                              REVISION_FILE_BUFFER_SIZE,
+                              &bytesRead)) {
+            status = FALSE;
+            goto Exit;
+        }
+
+        if (bytesRead < REVISION_FILE_BUFFER_SIZE) {
+            File->Contents = File->Data;
+            File->Size = bytesRead;
+
+            Worker->CountOfBytesRead += bytesRead;
+            isRead = TRUE;
+            goto Exit;
+        }
+
+        /*
+         * The file grew to fill the buffer since its size was queried, so
+         * there may be more of it. Open it again and stream it from its
+         * start below, as the ring does for a file filling its buffer.
+         */
+        RevCloseFile(file);
+        if (!RevOpenFile(Worker->Revision, File->Directory, File->FileName, &file)) {
+            status = FALSE;
+            goto Exit;
+        }
+
+        fileSize = bytesRead;
+    }
+
+    /*
+     * The file neither fits in the buffer nor is worth mapping. Rather than
+     * holding the buffer for it, stream it through a buffer of the reader
+     * and count it here.
+     */
+    if (!RevStreamFile(Worker, File, file, fileSize)) {
+        status = FALSE;
+    }
+
+Exit:
+    if (file != INVALID_FILE_HANDLE) {
+        RevCloseFile(file);
+    }
+
+    if (!status) {
+        path = RevBuildPath(File->Directory, File->FileName);
+        RevLogError(Worker->Revision,
+                    "Failed to read the file \"" PATH_FORMAT "\".",
+                    path);
+        free(path);
+    }
+
+    if (isRead) {
+        RevPassFileBuffer(Worker, File);
+    } else {
+        RevRetireFileBuffer(Worker->Revision, File);
+    }
+}
+
+VOID
+RevPassFileBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    )
+{
+    /*
+     * The contents are in memory now, the directory is no longer needed,
+     * unless the file callback needs the path of the file once counted.
+     */
+    if (Worker->Revision->InitParams.FileCallback == NULL) {
+        RevReleaseDirectory(File->Directory);
+        File->Directory = NULL;
+        File->FileName = NULL;
+    }
+
+    if (!RevPushQueue(&Worker->Revision->CountQueue, File)) {
+        RevCountFileBuffer(Worker, File);
+    }
+}
+
+VOID
+RevCountFileBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
+    )
+{
+    RevReviseBuffer(Worker, File);
+
+    if (File->IsMapped) {
+        RevUnmapFile(File->Contents, File->Size);
+        File->IsMapped = FALSE;
+    }
+
+    RevRetireFileBuffer(Worker->Revision, File);
+}
+
+VOID
+RevRetireFileBuffer(
+    _Inout_ PREVISION Revision,
+    _Inout_ PREVISION_FILE_BUFFER File
+    )
+{
+    if (File->Directory != NULL) {
+        RevReleaseDirectory(File->Directory);
+        File->Directory = NULL;
+        File->FileName = NULL;
+    }
+
+    File->Mapping = NULL;
+    File->Contents = NULL;
+    File->Size = 0;
+
+    if (!RevPushQueue(&Revision->FreeQueue, File)) {
+        assert(FALSE);
+    }
+
+    /*
+     * N.B. The buffer must be recycled before the file is done, otherwise
+     * the revision could finish with the buffer still in flight.
+     */
+    InterlockedDecrement(&Revision->CountOfPendingFiles);
+}
+
+VOID
+RevInitializeDirectory(
+    _Out_ PREVISION_DIRECTORY Directory,
+    _In_opt_ PREVISION_DIRECTORY Parent,
+    _In_z_ PPATHCHAR Name
+    )
+{
+    Directory->Parent = Parent;
+    Directory->ReferenceCount = 0;
+#ifdef _WIN32
+    Directory->Handle = INVALID_HANDLE_VALUE;
+#else
+    Directory->Handle = -1;
+#endif
+    Directory->Name = Name;
+    Directory->EntryBlocks = NULL;
+    Directory->PatternList = Parent != NULL ? Parent->PatternList : NULL;
+    Directory->HasCacheKey = FALSE;
+    Directory->CachedDirectory = NULL;
+    Directory->DeviceIndex = 0;
+
+    if (Parent != NULL) {
+        RevReferenceDirectory(Parent);
+    }
+}
+
+_Must_inspect_result_
+BOOL
+RevOpenDirectory(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION_DIRECTORY parent = Directory->Parent;
+    PPATHCHAR path;
+    BOOL isOpen;
+#ifdef _WIN32
+    NTSTATUS ntStatus;
+    UNICODE_STRING relativeName;
+    OBJECT_ATTRIBUTES objectAttributes;
+    IO_STATUS_BLOCK ioStatusBlock;
+#endif
+
+#ifdef _WIN32
+    if (parent == NULL) {
+        Directory->Handle = CreateFileW(Directory->Name,
+                                        FILE_LIST_DIRECTORY | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                        NULL,
+                                        OPEN_EXISTING,
+                                        FILE_FLAG_BACKUP_SEMANTICS,
+                                        NULL);
+    } else {
+        /*
+         * Open the directory relative to the parent handle, so that the
+         * object manager does not have to walk the path prefix again.
+         */
+        relativeName.Buffer = Directory->Name;
+        relativeName.Length = (USHORT)(wcslen(Directory->Name) * sizeof(WCHAR));
+        relativeName.MaximumLength = relativeName.Length;
+
+        InitializeObjectAttributes(&objectAttributes,
+                                   &relativeName,
+                                   OBJ_CASE_INSENSITIVE,
+                                   parent->Handle,
+                                   NULL);
+
+        ntStatus = NtCreateFile(&Directory->Handle,
+                                FILE_LIST_DIRECTORY | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                                &objectAttributes,
+                                &ioStatusBlock,
+                                NULL,
+                                0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                FILE_OPEN,
+                                FILE_DIRECTORY_FILE |
+                                FILE_SYNCHRONOUS_IO_NONALERT |
+                                FILE_OPEN_FOR_BACKUP_INTENT,
+                                NULL,
+                                0);
+        if (!NT_SUCCESS(ntStatus)) {
+            SetLastError(RtlNtStatusToDosError(ntStatus));
+            Directory->Handle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    isOpen = (Directory->Handle != INVALID_HANDLE_VALUE);
+#else
+    Directory->Handle = openat(parent != NULL ? parent->Handle : AT_FDCWD,
+                               Directory->Name,
+                               O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    isOpen = (Directory->Handle != -1);
+#endif
+
+    if (!isOpen) {
+        path = RevBuildPath(parent, Directory->Name);
+        RevLogError(Revision,
+                    "Failed to open the directory \"" PATH_FORMAT "\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+    }
+
+    return isOpen;
+}
+
+VOID
+RevReferenceDirectory(
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    InterlockedIncrement(&Directory->ReferenceCount);
+}
+
+VOID
+RevReleaseDirectory(
+    _In_opt_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION_DIRECTORY parent;
+    PREVISION_ENTRY_BLOCK entryBlock;
+
+    /*
+     * Releasing the last reference to a directory also releases its
+     * reference to the parent, so walk up the chain iteratively.
+     *
+     * N.B. The directory itself is stored in an entry block of the parent
+     * (or by the caller of RevStartRevision for the root), so it is not
+     * freed here.
+     */
+    while (Directory != NULL &&
+           InterlockedDecrement(&Directory->ReferenceCount) == 0) {
+
+        parent = Directory->Parent;
+
+#ifdef _WIN32
+        if (Directory->Handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(Directory->Handle);
+        }
+#else
+        if (Directory->Handle != -1) {
+            close(Directory->Handle);
+        }
+#endif
+
+        while (Directory->EntryBlocks != NULL) {
+            entryBlock = Directory->EntryBlocks;
+            Directory->EntryBlocks = entryBlock->Next;
+            free(entryBlock);
+        }
+
+        if (Directory->PatternList != NULL &&
+            Directory->PatternList->Directory == Directory) {
+            free(Directory->PatternList);
+        }
+
+        Directory = parent;
+    }
+}
+
+_Ret_maybenull_
+_Must_inspect_result_
+PPATHCHAR
+RevBuildPath(
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name
+    )
+{
+    PREVISION_DIRECTORY directory;
+    SIZE_T pathLength;
+    SIZE_T componentLength;
+    PPATHCHAR path;
+
+    /*
+     * Find the length of the path.
+     */
+    pathLength = RevPathLength(Name);
+    for (directory = Directory; directory != NULL; directory = directory->Parent) {
+        pathLength += RevPathLength(directory->Name) + 1;
+    }
+
+    path = (PPATHCHAR)malloc((pathLength + 1) * sizeof(PATHCHAR));
+    if (path == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate string buffer (%llu bytes).",
+                    (ULONGLONG)((pathLength + 1) * sizeof(PATHCHAR)));
+        return NULL;
+    }
+
+    /*
+     * Fill the path from the end: the name first, then the names of the
+     * parent directories up to the root.
+     */
+    path[pathLength] = 0;
+
+    componentLength = RevPathLength(Name);
+    pathLength -= componentLength;
+    memcpy(path + pathLength, Name, componentLength * sizeof(PATHCHAR));
+
+    for (directory = Directory; directory != NULL; directory = directory->Parent) {
+        path[--pathLength] = PATH_SEPARATOR;
+
+        componentLength = RevPathLength(directory->Name);
+        pathLength -= componentLength;
+        memcpy(path + pathLength, directory->Name, componentLength * sizeof(PATHCHAR));
+    }
+
+    return path;
+}
+
+_Must_inspect_result_
+BOOL
+RevInitializeTables(
+    VOID
+    )
+{
+    LONG state;
+#ifdef _WIN32
+    DWORD consoleMode;
+#endif
+
+    state = InterlockedCompareExchange(&TablesState,
+                                       REVISION_TABLES_BUILDING,
+                                       REVISION_TABLES_UNINITIALIZED);
+    if (state == REVISION_TABLES_UNINITIALIZED) {
+
+        /*
+         * Color the output if it goes to a terminal that understands escape
+         * sequences. Enabling them on a Windows console is left to the
+         * program, which owns the console.
+         */
+#ifdef _WIN32
+        SupportAnsi = GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &consoleMode) &&
+                      (consoleMode & ENABLE_VIRTUAL_TERMINAL_PROCESSING) != 0;
+#else
+        SupportAnsi = isatty(STDOUT_FILENO);
+#endif
+
+        RevBuildLanguageTable();
+
+        if (!RevBuildSuffixTrie()) {
+            RevLogError(NULL, "Failed to build the suffix trie.");
+            WriteRelease(&TablesState, REVISION_TABLES_FAILED);
+            return FALSE;
+        }
+
+        RevSelectLineCounter();
+
+        WriteRelease(&TablesState, REVISION_TABLES_READY);
+        return TRUE;
+    }
+
+    /*
+     * Another thread is building the tables, which takes well under a
+     * millisecond.
+     */
+    while ((state = ReadAcquire(&TablesState)) == REVISION_TABLES_BUILDING) {
+        SwitchToThread();
+    }
+
+    return state == REVISION_TABLES_READY;
+}
+
+VOID
+RevBuildLanguageTable(
+    VOID
+    )
+{
+    ULONG index;
+    ULONG languageId;
+
+    CountOfLanguages = 0;
+
+    /*
+     * Languages are numbered in the order of their first appearance in the
+     * table. This runs once, so a linear search of the names is fine.
+     */
+    for (index = 0; index < ARRAYSIZE(ExtensionMappingTable); ++index) {
+        for (languageId = 0; languageId < CountOfLanguages; ++languageId) {
+            if (wcscmp(LanguageTable[languageId],
+                       ExtensionMappingTable[index].LanguageOrFileType) == 0) {
+                break;
+            }
+        }
+
+        if (languageId == CountOfLanguages) {
+            LanguageTable[CountOfLanguages++] = ExtensionMappingTable[index].LanguageOrFileType;
+        }
+
+        ExtensionMappingTable[index].LanguageId = languageId;
+    }
+
+    /*
+     * Attach the syntax of every language that has one.
+     */
+    for (index = 0; index < ARRAYSIZE(LanguageSyntaxes); ++index) {
+        RevBuildSyntaxClasses(&LanguageSyntaxes[index]);
+    }
+
+    for (languageId = 0; languageId < CountOfLanguages; ++languageId) {
+        LanguageSyntax[languageId] = NULL;
+
+        for (index = 0; index < ARRAYSIZE(LanguageSyntaxTable); ++index) {
+            if (wcscmp(LanguageSyntaxTable[index].LanguageOrFileType,
+                       LanguageTable[languageId]) == 0) {
+                LanguageSyntax[languageId] = &LanguageSyntaxes[LanguageSyntaxTable[index].Syntax];
+                break;
+            }
+        }
+    }
+}
+
+_Must_inspect_result_
+BOOL
+RevBuildSuffixTrie(
+    VOID
+    )
+{
+    BOOL status = TRUE;
+    PUSHORT firstChildren = NULL;
+    PUSHORT nextSiblings = NULL;
+    PUSHORT mappings = NULL;
+    PUCHAR classes = NULL;
+    PUSHORT slots = NULL;
+    PUSHORT order = NULL;
+    ULONG countOfNodes = 1;
+    ULONG index;
+    PPATHCHAR extension;
+#ifndef _WIN32
+    CHAR nativeExtension[64];
+#endif
+    SIZE_T length;
+    ULONG characterClass;
+    ULONG node;
+    ULONG child;
+    ULONG head;
+    ULONG tail;
+    ULONG base;
+    ULONG firstFree = 1;
+    ULONG lowestClass;
+    ULONG highestClass;
+
+    /*
+     * The trie is first built with a list of children per node, then laid
+     * out into the double array.
+     */
+    firstChildren = (PUSHORT)malloc(REVISION_SUFFIX_TRIE_SLOTS * sizeof(USHORT));
+    nextSiblings = (PUSHORT)malloc(REVISION_SUFFIX_TRIE_SLOTS * sizeof(USHORT));
+    mappings = (PUSHORT)malloc(REVISION_SUFFIX_TRIE_SLOTS * sizeof(USHORT));
+    classes = (PUCHAR)malloc(REVISION_SUFFIX_TRIE_SLOTS * sizeof(UCHAR));
+    slots = (PUSHORT)malloc(REVISION_SUFFIX_TRIE_SLOTS * sizeof(USHORT));
+    order = (PUSHORT)malloc(REVISION_SUFFIX_TRIE_SLOTS * sizeof(USHORT));
+    if (firstChildren == NULL || nextSiblings == NULL || mappings == NULL ||
+        classes == NULL || slots == NULL || order == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate memory for the suffix trie.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    memset(SuffixTrieClasses, 0, sizeof(SuffixTrieClasses));
+    CountOfSuffixTrieClasses = 1;
+#ifdef _WIN32
+    CountOfSuffixTrieWideUnits = 0;
+#endif
+
+    firstChildren[0] = REVISION_SUFFIX_TRIE_EMPTY;
+    mappings[0] = REVISION_SUFFIX_TRIE_EMPTY;
+
+    for (index = 0; index < ARRAYSIZE(ExtensionMappingTable); ++index) {
+        if (ExtensionMappingTable[index].ExtensionType != WholeName) {
+            ExtensionMappingTable[index].ExtensionType =
+                wcschr(ExtensionMappingTable[index].Extension + 1, L'.') != NULL ? MultiDot : SingleDot;
+        }
+
+        /*
+         * Names are walked in their native encoding, so the extensions are
+         * converted once here. An extension the locale cannot encode
+         * matches no name.
+         */
+#ifdef _WIN32
+        extension = ExtensionMappingTable[index].Extension;
+#else
+        length = wcstombs(nativeExtension,
+                          ExtensionMappingTable[index].Extension,
+                          sizeof(nativeExtension));
+        if (length == (SIZE_T)-1 || length >= sizeof(nativeExtension)) {
+            continue;
+        }
+        extension = nativeExtension;
+#endif
+        length = RevPathLength(extension);
+
+        node = 0;
+        while (length > 0) {
+            length -= 1;
+
+            characterClass = RevAddSuffixClass(extension[length]);
+            if (characterClass == 0) {
+                RevLogError(NULL,
+                            "The extension table uses too many characters for the suffix trie.");
+                status = FALSE;
+                goto Exit;
+            }
+
+            for (child = firstChildren[node];
+                 child != REVISION_SUFFIX_TRIE_EMPTY;
+                 child = nextSiblings[child]) {
+                if (classes[child] == characterClass) {
+                    break;
+                }
+            }
+
+            if (child == REVISION_SUFFIX_TRIE_EMPTY) {
+                if (countOfNodes == REVISION_SUFFIX_TRIE_SLOTS) {
+                    RevLogError(NULL,
+                                "The suffix trie is too small for the extension table.");
+                    status = FALSE;
+                    goto Exit;
+                }
+
+                child = countOfNodes++;
+                firstChildren[child] = REVISION_SUFFIX_TRIE_EMPTY;
+                mappings[child] = REVISION_SUFFIX_TRIE_EMPTY;
+                classes[child] = (UCHAR)characterClass;
+                nextSiblings[child] = firstChildren[node];
+                firstChildren[node] = (USHORT)child;
+            }
+
+            node = child;
+        }
+
+        /*
+         * Keep the first of duplicate extensions, the same as a linear scan
+         * of the table would.
+         */
+        if (mappings[node] == REVISION_SUFFIX_TRIE_EMPTY) {
+            mappings[node] = (USHORT)index;
+        }
+    }
+
+    for (index = 0; index < ARRAYSIZE(SuffixTrieNodes); ++index) {
+        SuffixTrieNodes[index].Base = 0;
+        SuffixTrieNodes[index].Parent = REVISION_SUFFIX_TRIE_EMPTY;
+        SuffixTrieNodes[index].Mapping = REVISION_SUFFIX_TRIE_EMPTY;
+    }
+
+    /*
+     * Place the nodes in breadth-first order. For each node, find the first
+     * base that moves all of its children into free slots. A leaf keeps a
+     * base of zero: no slot names it as a parent.
+     */
+    SuffixTrieNodes[0].Parent = 0;
+    slots[0] = 0;
+    order[0] = 0;
+    tail = 1;
+
+    for (head = 0; head < tail; ++head) {
+        node = order[head];
+        if (firstChildren[node] == REVISION_SUFFIX_TRIE_EMPTY) {
+            continue;
+        }
+
+        lowestClass = REVISION_SUFFIX_TRIE_CLASSES;
+        highestClass = 0;
+        for (child = firstChildren[node];
+             child != REVISION_SUFFIX_TRIE_EMPTY;
+             child = nextSiblings[child]) {
+            if (classes[child] < lowestClass) {
+                lowestClass = classes[child];
+            }
+            if (classes[child] > highestClass) {
+                highestClass = classes[child];
+            }
+        }
+
+        while (firstFree < REVISION_SUFFIX_TRIE_SLOTS &&
+               SuffixTrieNodes[firstFree].Parent != REVISION_SUFFIX_TRIE_EMPTY) {
+            firstFree += 1;
+        }
+
+        for (base = firstFree > lowestClass ? firstFree - lowestClass : 0;; ++base) {
+            if (base + highestClass >= REVISION_SUFFIX_TRIE_SLOTS) {
+                RevLogError(NULL,
+                            "The suffix trie is too small for the extension table.");
+                status = FALSE;
+                goto Exit;
+            }
+
+            for (child = firstChildren[node];
+                 child != REVISION_SUFFIX_TRIE_EMPTY;
+                 child = nextSiblings[child]) {
+                if (SuffixTrieNodes[base + classes[child]].Parent != REVISION_SUFFIX_TRIE_EMPTY) {
+                    break;
+                }
+            }
+
+            if (child == REVISION_SUFFIX_TRIE_EMPTY) {
+                break;
+            }
+        }
+
+        SuffixTrieNodes[slots[node]].Base = (USHORT)base;
+
+        for (child = firstChildren[node];
+             child != REVISION_SUFFIX_TRIE_EMPTY;
+             child = nextSiblings[child]) {
+            slots[child] = (USHORT)(base + classes[child]);
+            SuffixTrieNodes[slots[child]].Parent = slots[node];
+            SuffixTrieNodes[slots[child]].Mapping = mappings[child];
+            order[tail++] = (USHORT)child;
+        }
+    }
+
+Exit:
+    free(firstChildren);
+    free(nextSiblings);
+    free(mappings);
+    free(classes);
+    free(slots);
+    free(order);
+
+    return status;
+}
+
+ULONG
+RevAddSuffixClass(
+    _In_ PATHCHAR Character
+    )
+{
+    ULONG characterClass = RevGetSuffixClass(Character);
+
+    if (characterClass != 0 ||
+        CountOfSuffixTrieClasses == REVISION_SUFFIX_TRIE_CLASSES) {
+        return characterClass;
+    }
+
+#ifdef _WIN32
+    if (Character > 0xFF) {
+        if (CountOfSuffixTrieWideUnits == REVISION_SUFFIX_TRIE_WIDE_UNITS) {
+            return 0;
+        }
+
+        SuffixTrieWideUnits[CountOfSuffixTrieWideUnits] = Character;
+        SuffixTrieWideClasses[CountOfSuffixTrieWideUnits] = (UCHAR)CountOfSuffixTrieClasses;
+        CountOfSuffixTrieWideUnits += 1;
+
+        return CountOfSuffixTrieClasses++;
+    }
+
+    SuffixTrieClasses[Character] = (UCHAR)CountOfSuffixTrieClasses;
+#else
+    SuffixTrieClasses[(UCHAR)Character] = (UCHAR)CountOfSuffixTrieClasses;
+#endif
+
+    return CountOfSuffixTrieClasses++;
+}
+
+_Ret_maybenull_
+PREVISION_RECORD_EXTENSION_MAPPING
+RevLookupFileName(
+    _In_z_ PPATHCHAR FileName
+    )
+{
+    PPATHCHAR character = FileName + RevPathLength(FileName);
+    ULONG node = 0;
+    USHORT mapping = REVISION_SUFFIX_TRIE_EMPTY;
+
+    /*
+     * Walk the name backwards for as long as some extension continues with
+     * its characters, remembering the longest extension passed. Every
+     * extension starts with a dot, so it always ends at a dot of the name.
+     */
+    for (;;) {
+        if (character == FileName ||
+            character[-1] == PATH_SEPARATOR ||
+            character[-1] == '/') {
+
+            /*
+             * The whole name has been walked. A file name of the table also
+             * matches it as if it started with a dot.
+             */
+            node = RevFindSuffixChild(node, PATH_TEXT('.'));
+            if (node != REVISION_SUFFIX_TRIE_EMPTY &&
+                SuffixTrieNodes[node].Mapping != REVISION_SUFFIX_TRIE_EMPTY &&
+                ExtensionMappingTable[SuffixTrieNodes[node].Mapping].ExtensionType == WholeName) {
+                mapping = SuffixTrieNodes[node].Mapping;
+            }
+            break;
+        }
+
+        character -= 1;
+
+        node = RevFindSuffixChild(node, *character);
+        if (node == REVISION_SUFFIX_TRIE_EMPTY) {
+            break;
+        }
+
+        if (SuffixTrieNodes[node].Mapping != REVISION_SUFFIX_TRIE_EMPTY) {
+            mapping = SuffixTrieNodes[node].Mapping;
+        }
+    }
+
+    if (mapping == REVISION_SUFFIX_TRIE_EMPTY) {
+        return NULL;
+    }
+
+    return &ExtensionMappingTable[mapping];
+}
+
+_Ret_maybenull_
+PREVISION_RECORD_EXTENSION_MAPPING
+RevLookupExtensionLinear(
+    _In_z_ PWCHAR Extension
+    )
+{
+    ULONG index;
+
+    for (index = 0; index < ARRAYSIZE(ExtensionMappingTable); ++index) {
+        if (wcscmp(Extension, ExtensionMappingTable[index].Extension) == 0) {
+            return &ExtensionMappingTable[index];
+        }
+    }
+
+    return NULL;
+}
+
+_Must_inspect_result_
+BOOL
+RevBenchmarkExtensionLookup(
+    VOID
+    )
+{
+    BOOL status = TRUE;
+    ULONG countOfExtensions = ARRAYSIZE(ExtensionMappingTable) * 2;
+    PWCHAR extensions = NULL;
+    PWCHAR extension;
+    PPATHCHAR fileNames = NULL;
+    PPATHCHAR fileName;
+    SIZE_T extensionStride = 0;
+    SIZE_T fileNameStride;
+    SIZE_T length;
+    ULONG round;
+    ULONG index;
+    ULONG countOfLinearRounds = 20;
+    ULONG countOfTrieRounds = 2000;
+    ULONG countOfLinearMatches = 0;
+    ULONG countOfTrieMatches = 0;
+    ULONG countOfSkippedNames = 0;
+    LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER startQpc = {0};
+    LARGE_INTEGER endQpc = {0};
+    double linearTime;
+    double trieTime;
+    WCHAR wholeExtension[32];
+#ifndef _WIN32
+    CHAR wholeFileName[32];
+#endif
+
+    /*
+     * Files named after a file name of the table, which must match without
+     * any extension.
+     */
+    static const PWCHAR WholeFileNames[] = {
+        L"Makefile",
+        L"makefile",
+        L"Gnumakefile",
+        L"Dockerfile",
+        L"Containerfile",
+        L"CMakeLists.txt",
+        L"pom.xml",
+    };
+
+    /*
+     * Every file costs one lookup, when it is enumerated. Half of the
+     * probed extensions are in the table, the other half are not, like
+     * ignored files. The probes are sized for the longest extension of
+     * the table with "~" appended, and "file" put in front of it.
+     */
+    for (index = 0; index < ARRAYSIZE(ExtensionMappingTable); ++index) {
+        length = wcslen(ExtensionMappingTable[index].Extension) + 2;
+        if (length > extensionStride) {
+            extensionStride = length;
+        }
+    }
+
+#ifdef _WIN32
+    fileNameStride = 4 + extensionStride;
+#else
+    fileNameStride = 4 + extensionStride * MB_CUR_MAX;
+#endif
+
+    extensions = (PWCHAR)malloc(countOfExtensions * extensionStride * sizeof(WCHAR));
+    fileNames = (PPATHCHAR)malloc(countOfExtensions * fileNameStride * sizeof(PATHCHAR));
+    if (extensions == NULL || fileNames == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate memory for the benchmark.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    for (index = 0; index < ARRAYSIZE(ExtensionMappingTable); ++index) {
+        extension = extensions + index * 2 * extensionStride;
+        wcscpy_s(extension, extensionStride, ExtensionMappingTable[index].Extension);
+        wcscpy_s(extension + extensionStride, extensionStride, ExtensionMappingTable[index].Extension);
+        wcscat_s(extension + extensionStride, extensionStride, L"~");
+    }
+
+    /*
+     * The suffix trie matches whole file names, in the native encoding. A
+     * name the locale cannot encode cannot be matched either, which is
+     * reported below.
+     */
+    for (index = 0; index < countOfExtensions; ++index) {
+        extension = extensions + index * extensionStride;
+        fileName = fileNames + index * fileNameStride;
+
+#ifdef _WIN32
+        wcscpy_s(fileName, fileNameStride, L"file");
+        wcscat_s(fileName, fileNameStride, extension);
+#else
+        memcpy(fileName, "file", 4);
+        if (wcstombs(fileName + 4, extension, fileNameStride - 4) == (SIZE_T)-1) {
+            fileName[0] = '\0';
+            countOfSkippedNames += 1;
+        }
+#endif
+    }
+
+    if (!RevInitializeTables() ||
+        !QueryPerformanceFrequency(&frequency)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    QueryPerformanceCounter(&startQpc);
+    for (round = 0; round < countOfLinearRounds; ++round) {
+        for (index = 0; index < countOfExtensions; ++index) {
+            extension = extensions + index * extensionStride;
+            if (RevLookupExtensionLinear(extension) != NULL) {
+                countOfLinearMatches += 1;
+            }
+        }
+    }
+    QueryPerformanceCounter(&endQpc);
+    linearTime = (double)(endQpc.QuadPart - startQpc.QuadPart) / frequency.QuadPart;
+
+    QueryPerformanceCounter(&startQpc);
+    for (round = 0; round < countOfTrieRounds; ++round) {
+        for (index = 0; index < countOfExtensions; ++index) {
+            fileName = fileNames + index * fileNameStride;
+            if (RevLookupFileName(fileName) != NULL) {
+                countOfTrieMatches += 1;
+            }
+        }
+    }
+    QueryPerformanceCounter(&endQpc);
+    trieTime = (double)(endQpc.QuadPart - startQpc.QuadPart) / frequency.QuadPart;
+
+    /*
+     * Both lookups must agree on every extension.
+     */
+    for (index = 0; index < countOfExtensions; ++index) {
+        extension = extensions + index * extensionStride;
+        fileName = fileNames + index * fileNameStride;
+        if (fileName[0] == PATH_TEXT('\0')) {
+            RevLogWarning(NULL,
+                          "An extension of %ls cannot be encoded in the current "
+                          "locale and was not looked up.",
+                          ExtensionMappingTable[index / 2].LanguageOrFileType);
+            continue;
+        }
+
+        if (RevLookupFileName(fileName) != RevLookupExtensionLinear(extension)) {
+            RevLogError(NULL,
+                        "The suffix trie disagrees with the table on \"" PATH_FORMAT "\".",
+                        fileName);
+            status = FALSE;
+        }
+    }
+
+    /*
+     * A file named after a file name of the table must match it as well,
+     * as if the name started with a dot.
+     */
+    for (index = 0; index < ARRAYSIZE(WholeFileNames); ++index) {
+        wcscpy_s(wholeExtension, ARRAYSIZE(wholeExtension), L".");
+        wcscat_s(wholeExtension, ARRAYSIZE(wholeExtension), WholeFileNames[index]);
+
+#ifdef _WIN32
+        fileName = WholeFileNames[index];
+#else
+        fileName = wholeFileName;
+        wcstombs(wholeFileName, WholeFileNames[index], sizeof(wholeFileName));
+#endif
+
+        if (RevLookupExtensionLinear(wholeExtension) == NULL ||
+            RevLookupFileName(fileName) != RevLookupExtensionLinear(wholeExtension)) {
+            RevLogError(NULL,
+                        "The suffix trie does not match the file name \"%ls\".",
+                        WholeFileNames[index]);
+            status = FALSE;
+        }
+    }
+
+    RevPrint(L"%-25ls%20ls%20ls\n", L"Lookup", L"ns/file", L"Matches");
+    RevPrint(L"%-25ls%20.1f%20lu\n",
+             L"Linear scan",
+             linearTime * 1e9 / ((double)countOfLinearRounds * countOfExtensions),
+             countOfLinearMatches / countOfLinearRounds);
+    RevPrint(L"%-25ls%20.1f%20lu\n",
+             L"Suffix trie (file name)",
+             trieTime * 1e9 / ((double)countOfTrieRounds * countOfExtensions),
+             countOfTrieMatches / countOfTrieRounds);
+
+    if (countOfSkippedNames > 0) {
+        RevPrint(L"%-25ls%20ls%20lu\n",
+                 L"Not encodable",
+                 L"-",
+                 countOfSkippedNames);
+    }
+
+Exit:
+    free(extensions);
+    free(fileNames);
+
+    return status;
+}
+
+VOID
+RevCountLinesScalar(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    RevCountLinesFrom(Buffer, Size, 0, State);
+}
+
+/*
+ * The other kernels classify the chunk 64 bytes at a time into masks for
+ * RevCountLinesInBlock.
+ */
+
+VOID
+RevCountLinesSwar(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    const ULONGLONG lineFeed = 0x0A0A0A0A0A0A0A0AULL;
+    const ULONGLONG carriageReturn = 0x0D0D0D0D0D0D0D0DULL;
+    const ULONGLONG space = 0x2020202020202020ULL;
+    const ULONGLONG tab = 0x0909090909090909ULL;
+    const ULONGLONG verticalTab = 0x0B0B0B0B0B0B0B0BULL;
+    const ULONGLONG formFeed = 0x0C0C0C0C0C0C0C0CULL;
+    ULONGLONG word;
+    ULONGLONG lineFeedMarks;
+    ULONGLONG carriageReturnMarks;
+    ULONGLONG lineFeeds;
+    ULONGLONG carriageReturns;
+    ULONGLONG spaces;
+    SIZE_T offset = 0;
+    ULONG index;
+
+    while (Size - offset >= 64) {
+        lineFeeds = 0;
+        carriageReturns = 0;
+        spaces = 0;
+
+        for (index = 0; index < 64; index += sizeof(ULONGLONG)) {
+            word = RevLoadWord(Buffer + offset + index);
+            lineFeedMarks = RevMatchBytes(word, lineFeed);
+            carriageReturnMarks = RevMatchBytes(word, carriageReturn);
+
+            lineFeeds |= RevGatherByteMarks(lineFeedMarks) << index;
+            carriageReturns |= RevGatherByteMarks(carriageReturnMarks) << index;
+            spaces |= RevGatherByteMarks(lineFeedMarks |
+                                         carriageReturnMarks |
+                                         RevMatchBytes(word, space) |
+                                         RevMatchBytes(word, tab) |
+                                         RevMatchBytes(word, verticalTab) |
+                                         RevMatchBytes(word, formFeed)) << index;
+        }
+
+        RevCountLinesInBlock(lineFeeds, carriageReturns, spaces, State);
+        offset += 64;
+    }
+
+    RevCountLinesFrom(Buffer, Size, offset, State);
+}
+
+SIZE_T
+RevSkipPlainBytesSwar(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_reads_(CountOfStopBytes) const CHAR *StopBytes,
+    _In_ ULONG CountOfStopBytes,
+    _Inout_ PBOOL IsContent
+    )
+{
+    const ULONGLONG space = 0x2020202020202020ULL;
+    const ULONGLONG tab = 0x0909090909090909ULL;
+    const ULONGLONG verticalTab = 0x0B0B0B0B0B0B0B0BULL;
+    const ULONGLONG formFeed = 0x0C0C0C0C0C0C0C0CULL;
+    ULONGLONG stopPatterns[REVISION_MAX_STOP_BYTES];
+    ULONGLONG word;
+    ULONGLONG stopMarks;
+    ULONGLONG stops;
+    ULONGLONG spaces;
+    SIZE_T offset = 0;
+    ULONG index;
+    ULONG stop;
+
+    for (stop = 0; stop < CountOfStopBytes; ++stop) {
+        stopPatterns[stop] = (UCHAR)StopBytes[stop] * 0x0101010101010101ULL;
+    }
+
+    while (Size - offset >= 64) {
+        stops = 0;
+        spaces = 0;
+
+        for (index = 0; index < 64; index += sizeof(ULONGLONG)) {
+            word = RevLoadWord(Buffer + offset + index);
+
+            stopMarks = 0;
+            for (stop = 0; stop < CountOfStopBytes; ++stop) {
+                stopMarks |= RevMatchBytes(word, stopPatterns[stop]);
+            }
+
+            stops |= RevGatherByteMarks(stopMarks) << index;
+            spaces |= RevGatherByteMarks(RevMatchBytes(word, space) |
+                                         RevMatchBytes(word, tab) |
+                                         RevMatchBytes(word, verticalTab) |
+                                         RevMatchBytes(word, formFeed)) << index;
+        }
+
+        if (RevSkipPlainBlock(stops, spaces, &offset, IsContent)) {
+            break;
+        }
+    }
+
+    return offset;
+}
+
+#ifdef REVISION_X86
+
+/*
+ * White space and line breaks are " " and "\t" through "\r", so the vector
+ * kernels find them with one compare and one unsigned range check.
+ */
+
+REVISION_TARGET("sse2")
+VOID
+RevCountLinesSse2(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i rangeOfSpaces = _mm_set1_epi8('\r' - '\t');
+    __m128i chunk;
+    __m128i shifted;
+    ULONGLONG lineFeeds;
+    ULONGLONG carriageReturns;
+    ULONGLONG spaces;
+    SIZE_T offset = 0;
+    ULONG index;
+
+    while (Size - offset >= 64) {
+        lineFeeds = 0;
+        carriageReturns = 0;
+        spaces = 0;
+
+        for (index = 0; index < 64; index += sizeof(__m128i)) {
+            chunk = _mm_loadu_si128((const __m128i *)(Buffer + offset + index));
+            shifted = _mm_sub_epi8(chunk, tab);
+
+            lineFeeds |= (ULONGLONG)(unsigned int)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(chunk, lineFeed)) << index;
+            carriageReturns |= (ULONGLONG)(unsigned int)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(chunk, carriageReturn)) << index;
+            spaces |= (ULONGLONG)(unsigned int)_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                             _mm_cmpeq_epi8(_mm_min_epu8(shifted, rangeOfSpaces), shifted))) << index;
+        }
+
+        RevCountLinesInBlock(lineFeeds, carriageReturns, spaces, State);
+        offset += 64;
+    }
+
+    RevCountLinesFrom(Buffer, Size, offset, State);
+}
+
+REVISION_TARGET("sse2")
+SIZE_T
+RevSkipPlainBytesSse2(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_reads_(CountOfStopBytes) const CHAR *StopBytes,
+    _In_ ULONG CountOfStopBytes,
+    _Inout_ PBOOL IsContent
+    )
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i rangeOfSpaces = _mm_set1_epi8('\r' - '\t');
+    __m128i stopVectors[REVISION_MAX_STOP_BYTES];
+    __m128i chunk;
+    __m128i shifted;
+    __m128i stopMarks;
+    ULONGLONG stops;
+    ULONGLONG spaces;
+    SIZE_T offset = 0;
+    ULONG index;
+    ULONG stop;
+
+    for (stop = 0; stop < CountOfStopBytes; ++stop) {
+        stopVectors[stop] = _mm_set1_epi8(StopBytes[stop]);
+    }
+
+    /*
+     * N.B. The line breaks are stop bytes, so the range of white space may
+     * take them in as well.
+     */
+    while (Size - offset >= 64) {
+        stops = 0;
+        spaces = 0;
+
+        for (index = 0; index < 64; index += sizeof(__m128i)) {
+            chunk = _mm_loadu_si128((const __m128i *)(Buffer + offset + index));
+            shifted = _mm_sub_epi8(chunk, tab);
+
+            stopMarks = _mm_setzero_si128();
+            for (stop = 0; stop < CountOfStopBytes; ++stop) {
+                stopMarks = _mm_or_si128(stopMarks, _mm_cmpeq_epi8(chunk, stopVectors[stop]));
+            }
+
+            stops |= (ULONGLONG)(unsigned int)_mm_movemask_epi8(stopMarks) << index;
+            spaces |= (ULONGLONG)(unsigned int)_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                             _mm_cmpeq_epi8(_mm_min_epu8(shifted, rangeOfSpaces), shifted))) << index;
+        }
+
+        if (RevSkipPlainBlock(stops, spaces, &offset, IsContent)) {
+            break;
+        }
+    }
+
+    return offset;
+}
+
+REVISION_TARGET("avx2,popcnt")
+VOID
+RevCountLinesAvx2(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i rangeOfSpaces = _mm256_set1_epi8('\r' - '\t');
+    __m256i chunk;
+    __m256i shifted;
+    ULONGLONG lineFeeds;
+    ULONGLONG carriageReturns;
+    ULONGLONG spaces;
+    SIZE_T offset = 0;
+    ULONG index;
+
+    while (Size - offset >= 64) {
+        lineFeeds = 0;
+        carriageReturns = 0;
+        spaces = 0;
+
+        for (index = 0; index < 64; index += sizeof(__m256i)) {
+            chunk = _mm256_loadu_si256((const __m256i *)(Buffer + offset + index));
+            shifted = _mm256_sub_epi8(chunk, tab);
+
+            lineFeeds |= (ULONGLONG)(unsigned int)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(chunk, lineFeed)) << index;
+            carriageReturns |= (ULONGLONG)(unsigned int)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(chunk, carriageReturn)) << index;
+            spaces |= (ULONGLONG)(unsigned int)_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                                _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, rangeOfSpaces), shifted))) << index;
+        }
+
+        RevCountLinesInBlock(lineFeeds, carriageReturns, spaces, State);
+        offset += 64;
+    }
+
+    RevCountLinesFrom(Buffer, Size, offset, State);
+}
+
+REVISION_TARGET("avx2,popcnt")
+SIZE_T
+RevSkipPlainBytesAvx2(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_reads_(CountOfStopBytes) const CHAR *StopBytes,
+    _In_ ULONG CountOfStopBytes,
+    _Inout_ PBOOL IsContent
+    )
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i rangeOfSpaces = _mm256_set1_epi8('\r' - '\t');
+    __m256i stopVectors[REVISION_MAX_STOP_BYTES];
+    __m256i chunk;
+    __m256i shifted;
+    __m256i stopMarks;
+    ULONGLONG stops;
+    ULONGLONG spaces;
+    SIZE_T offset = 0;
+    ULONG index;
+    ULONG stop;
+
+    for (stop = 0; stop < CountOfStopBytes; ++stop) {
+        stopVectors[stop] = _mm256_set1_epi8(StopBytes[stop]);
+    }
+
+    /*
+     * N.B. The line breaks are stop bytes, so the range of white space may
+     * take them in as well.
+     */
+    while (Size - offset >= 64) {
+        stops = 0;
+        spaces = 0;
+
+        for (index = 0; index < 64; index += sizeof(__m256i)) {
+            chunk = _mm256_loadu_si256((const __m256i *)(Buffer + offset + index));
+            shifted = _mm256_sub_epi8(chunk, tab);
+
+            stopMarks = _mm256_setzero_si256();
+            for (stop = 0; stop < CountOfStopBytes; ++stop) {
+                stopMarks = _mm256_or_si256(stopMarks, _mm256_cmpeq_epi8(chunk, stopVectors[stop]));
+            }
+
+            stops |= (ULONGLONG)(unsigned int)_mm256_movemask_epi8(stopMarks) << index;
+            spaces |= (ULONGLONG)(unsigned int)_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                                _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, rangeOfSpaces), shifted))) << index;
+        }
+
+        if (RevSkipPlainBlock(stops, spaces, &offset, IsContent)) {
+            break;
+        }
+    }
+
+    return offset;
+}
+
+REVISION_TARGET("avx512f,avx512bw,popcnt")
+VOID
+RevCountLinesAvx512(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Inout_ PREVISION_LINE_STATE State
+    )
+{
+    const __m512i lineFeed = _mm512_set1_epi8('\n');
+    const __m512i carriageReturn = _mm512_set1_epi8('\r');
+    const __m512i space = _mm512_set1_epi8(' ');
+    const __m512i tab = _mm512_set1_epi8('\t');
+    const __m512i rangeOfSpaces = _mm512_set1_epi8('\r' - '\t');
+    __m512i chunk;
+    SIZE_T offset = 0;
+
+    /*
+     * A block is a single vector here, and the compares produce its masks
+     * directly.
+     */
+    while (Size - offset >= 64) {
+        chunk = _mm512_loadu_si512((const void *)(Buffer + offset));
+
+        RevCountLinesInBlock(_mm512_cmpeq_epi8_mask(chunk, lineFeed),
+                             _mm512_cmpeq_epi8_mask(chunk, carriageReturn),
+                             _mm512_cmpeq_epi8_mask(chunk, space) |
+                             _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, tab), rangeOfSpaces),
+                             State);
+        offset += 64;
+    }
+
+    RevCountLinesFrom(Buffer, Size, offset, State);
+}
+
+REVISION_TARGET("avx512f,avx512bw,popcnt")
+SIZE_T
+RevSkipPlainBytesAvx512(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_reads_(CountOfStopBytes) const CHAR *StopBytes,
+    _In_ ULONG CountOfStopBytes,
+    _Inout_ PBOOL IsContent
+    )
+{
+    const __m512i space = _mm512_set1_epi8(' ');
+    const __m512i tab = _mm512_set1_epi8('\t');
+    const __m512i rangeOfSpaces = _mm512_set1_epi8('\r' - '\t');
+    __m512i stopVectors[REVISION_MAX_STOP_BYTES];
+    __m512i chunk;
+    ULONGLONG stops;
+    SIZE_T offset = 0;
+    ULONG stop;
+
+    for (stop = 0; stop < CountOfStopBytes; ++stop) {
+        stopVectors[stop] = _mm512_set1_epi8(StopBytes[stop]);
+    }
+
+    while (Size - offset >= 64) {
+        chunk = _mm512_loadu_si512((const void *)(Buffer + offset));
+
+        stops = 0;
+        for (stop = 0; stop < CountOfStopBytes; ++stop) {
+            stops |= _mm512_cmpeq_epi8_mask(chunk, stopVectors[stop]);
+        }
+
+        if (RevSkipPlainBlock(stops,
+                              _mm512_cmpeq_epi8_mask(chunk, space) |
+                              _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, tab), rangeOfSpaces),
+                              &offset,
+                              IsContent)) {
+            break;
+        }
+    }
+
+    return offset;
+}
+
+#endif
+
+/**
+ * @brief The line counting kernels, fastest first. The scalar kernel
+ * is never selected: it is only the reference for RevBenchmarkLineCounters,
+ * and with it the line classifier walks every byte.
+ */
+REVISION_LINE_COUNTER LineCounters[] = {
+#ifdef REVISION_X86
+    {L"AVX-512BW",  RevCountLinesAvx512,    RevSkipPlainBytesAvx512,    REVISION_CPU_FEATURE_AVX512BW},
+    {L"AVX2",       RevCountLinesAvx2,      RevSkipPlainBytesAvx2,      REVISION_CPU_FEATURE_AVX2},
+    {L"SSE2",       RevCountLinesSse2,      RevSkipPlainBytesSse2,      REVISION_CPU_FEATURE_SSE2},
+#endif
+    {L"SWAR",       RevCountLinesSwar,      RevSkipPlainBytesSwar,      0},
+    {L"Scalar",     RevCountLinesScalar,    NULL,                       0},
+};
+
+VOID
+RevQueryCpuFeatures(
+    VOID
+    )
+{
+#ifdef REVISION_X86
+    unsigned int registers[4];
+    unsigned int maximumLeaf;
+#ifndef _MSC_VER
+    unsigned int enabledStateLow;
+    unsigned int enabledStateHigh;
+#endif
+    ULONGLONG enabledState = 0;
+
+    CpuFeatures = 0;
+
+#ifdef _MSC_VER
+    __cpuid((int *)registers, 0);
+#else
+    __cpuid(0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    maximumLeaf = registers[0];
+
+#ifdef _MSC_VER
+    __cpuid((int *)registers, 1);
+#else
+    __cpuid(1, registers[0], registers[1], registers[2], registers[3]);
+#endif
+
+    if (registers[3] & (1u << 26)) {
+        CpuFeatures |= REVISION_CPU_FEATURE_SSE2;
+    }
+
+    /*
+     * The wide registers are only usable if the operating system saves
+     * them on a context switch (OSXSAVE, then XCR0: SSE and AVX state, and
+     * the three AVX-512 states).
+     */
+    if ((registers[2] & (1u << 27)) == 0 || maximumLeaf < 7) {
+        return;
+    }
+
+#ifdef _MSC_VER
+    enabledState = _xgetbv(0);
+#else
+    __asm__ __volatile__("xgetbv" : "=a"(enabledStateLow), "=d"(enabledStateHigh) : "c"(0));
+    enabledState = ((ULONGLONG)enabledStateHigh << 32) | enabledStateLow;
+#endif
+
+#ifdef _MSC_VER
+    __cpuidex((int *)registers, 7, 0);
+#else
+    __cpuid_count(7, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+
+    if ((enabledState & 0x06) == 0x06 &&
+        (registers[1] & (1u << 5))) {
+        CpuFeatures |= REVISION_CPU_FEATURE_AVX2;
+    }
+
+    if ((enabledState & 0xE6) == 0xE6 &&
+        (registers[1] & (1u << 16)) &&
+        (registers[1] & (1u << 30))) {
+        CpuFeatures |= REVISION_CPU_FEATURE_AVX512BW;
+    }
+#else
+    CpuFeatures = 0;
+#endif
+}
+
+VOID
+RevSelectLineCounter(
+    VOID
+    )
+{
+    ULONG index;
+
+    RevQueryCpuFeatures();
+
+    for (index = 0; index < ARRAYSIZE(LineCounters); ++index) {
+        if ((LineCounters[index].RequiredFeatures & ~CpuFeatures) == 0) {
+            LineCounter = &LineCounters[index];
+            return;
+        }
+    }
+}
+
+_Must_inspect_result_
+BOOL
+RevBenchmarkLineCounters(
+    VOID
+    )
+{
+    BOOL status = TRUE;
+    SIZE_T bufferSize = 64 * 1024 * 1024;
+    PCHAR buffer = NULL;
+    PCHAR source = NULL;
+    PREVISION_LANGUAGE_SYNTAX syntax = &LanguageSyntaxes[RevisionSyntaxC];
+    REVISION_SCANNER expectedScanner;
+    REVISION_SCANNER actualScanner;
+    SIZE_T index;
+    SIZE_T size;
+    ULONG counter;
+    ULONG round;
+    ULONG countOfRounds = 8;
+    ULONG countOfClassifierRounds = 2;
+    ULONG seed = 1;
+    SIZE_T split;
+    REVISION_LINE_STATE expected;
+    REVISION_LINE_STATE actual;
+    LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER startQpc = {0};
+    LARGE_INTEGER endQpc = {0};
+    double time;
+
+    /*
+     * Fill the buffer with short lines of text, spaces and tabs broken by
+     * "\n", "\r\n" and lone "\r", so that every kind of line end and
+     * blank line shows up at every offset of a block.
+     */
+    buffer = (PCHAR)malloc(bufferSize);
+    source = (PCHAR)malloc(bufferSize);
+    if (buffer == NULL || source == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate memory for the benchmark.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    for (index = 0; index < bufferSize; ++index) {
+        seed = seed * 1103515245 + 12345;
+        switch ((seed >> 16) % 32) {
+        case 0:
+            buffer[index] = '\n';
+            break;
+        case 1:
+            buffer[index] = '\r';
+            if (index + 1 < bufferSize) {
+                buffer[++index] = '\n';
+            }
+            break;
+        case 2:
+            buffer[index] = '\r';
+            break;
+        case 3:
+        case 4:
+        case 5:
+            buffer[index] = ' ';
+            break;
+        case 6:
+            buffer[index] = '\t';
+            break;
+        default:
+            buffer[index] = (CHAR)('a' + (seed >> 24) % 26);
+            break;
+        }
+    }
+
+    /*
+     * The classifier reads lines shaped like source code instead: indented,
+     * up to 80 bytes long, some of them blank, with comment markers, string
+     * delimiters and escapes of C put in about once in 32 bytes.
+     */
+    for (index = 0; index < bufferSize; ) {
+        seed = seed * 1103515245 + 12345;
+        size = (seed >> 16) % 8 == 0 ? 0 : (seed >> 16) % 80;
+        split = (seed >> 24) % 4 * 4;
+
+        for (; size > 0 && index < bufferSize; --size) {
+            seed = seed * 1103515245 + 12345;
+            if (split > 0) {
+                source[index++] = ' ';
+                split -= 1;
+            } else if ((seed >> 16) % 32 == 0) {
+                source[index++] = "/*\"'\\"[(seed >> 24) % 5];
+            } else if ((seed >> 16) % 32 < 6) {
+                source[index++] = ' ';
+            } else {
+                source[index++] = (CHAR)('a' + (seed >> 24) % 26);
+            }
+        }
+
+        if (index < bufferSize) {
+            source[index++] = (seed >> 24) % 16 == 0 ? '\r' : '\n';
+        }
+    }
+
+    if (!RevInitializeTables() ||
+        !QueryPerformanceFrequency(&frequency)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Every kernel must agree with the scalar kernel on every size around
+     * its vector width and tail, counted in one chunk and split into two
+     * at every point, and on the whole buffer.
+     */
+    for (counter = 0; counter < ARRAYSIZE(LineCounters); ++counter) {
+        if ((LineCounters[counter].RequiredFeatures & ~CpuFeatures) != 0) {
+            continue;
+        }
+
+        for (size = 0; size <= 1024; ++size) {
+            for (index = 0; index < 4; ++index) {
+                memset(&expected, 0, sizeof(expected));
+                RevCountLinesScalar(buffer + index, size, &expected);
+                RevCompleteLineCount(&expected);
+
+                for (split = 0; split <= size; split += (split < 160 ? 1 : 61)) {
+                    memset(&actual, 0, sizeof(actual));
+                    LineCounters[counter].Routine(buffer + index, split, &actual);
+                    LineCounters[counter].Routine(buffer + index + split,
+                                                  size - split,
+                                                  &actual);
+                    RevCompleteLineCount(&actual);
+                    if (actual.CountOfLinesTotal != expected.CountOfLinesTotal ||
+                        actual.CountOfLinesBlank != expected.CountOfLinesBlank) {
+                        RevLogError(NULL,
+                                    "The %ls kernel disagrees with the scalar kernel "
+                                    "on %llu bytes split at %llu.",
+                                    LineCounters[counter].Name,
+                                    (ULONGLONG)size,
+                                    (ULONGLONG)split);
+                        status = FALSE;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    memset(&expected, 0, sizeof(expected));
+    RevCountLinesScalar(buffer, bufferSize, &expected);
+    RevCompleteLineCount(&expected);
+
+    RevPrint(L"%-25ls%20ls%20ls\n", L"Kernel", L"GB/s", L"Lines");
+    for (counter = 0; counter < ARRAYSIZE(LineCounters); ++counter) {
+        if ((LineCounters[counter].RequiredFeatures & ~CpuFeatures) != 0) {
+            continue;
+        }
+
+        QueryPerformanceCounter(&startQpc);
+        for (round = 0; round < countOfRounds; ++round) {
+            memset(&actual, 0, sizeof(actual));
+            LineCounters[counter].Routine(buffer, bufferSize, &actual);
+            RevCompleteLineCount(&actual);
+        }
+        QueryPerformanceCounter(&endQpc);
+        time = (double)(endQpc.QuadPart - startQpc.QuadPart) / frequency.QuadPart;
+
+        if (actual.CountOfLinesTotal != expected.CountOfLinesTotal ||
+            actual.CountOfLinesBlank != expected.CountOfLinesBlank) {
+            RevLogError(NULL,
+                        "The %ls kernel disagrees with the scalar kernel.",
+                        LineCounters[counter].Name);
+            status = FALSE;
+        }
+
+        RevPrint(L"%-25ls%20.2f%20llu%ls\n",
+                 LineCounters[counter].Name,
+                 (double)bufferSize * countOfRounds / time / 1e9,
+                 actual.CountOfLinesTotal,
+                 &LineCounters[counter] == LineCounter ? L" (selected)" : L"");
+    }
+
+    /*
+     * The classifier must count the same lines with the skip routine of
+     * every kernel as it does walking every byte, on every size around a
+     * block and on the whole buffer.
+     */
+    for (counter = 0; counter < ARRAYSIZE(LineCounters); ++counter) {
+        if ((LineCounters[counter].RequiredFeatures & ~CpuFeatures) != 0 ||
+            LineCounters[counter].SkipRoutine == NULL) {
+            continue;
+        }
+
+        for (size = 0; size <= 1024; ++size) {
+            for (index = 0; index < 4; ++index) {
+                memset(&expectedScanner, 0, sizeof(expectedScanner));
+                RevClassifyLines(source + index, size, TRUE, syntax, NULL, &expectedScanner);
+
+                memset(&actualScanner, 0, sizeof(actualScanner));
+                RevClassifyLines(source + index,
+                                 size,
+                                 TRUE,
+                                 syntax,
+                                 LineCounters[counter].SkipRoutine,
+                                 &actualScanner);
+
+                if (actualScanner.CountOfLinesTotal != expectedScanner.CountOfLinesTotal ||
+                    actualScanner.CountOfLinesBlank != expectedScanner.CountOfLinesBlank ||
+                    actualScanner.CountOfLinesComment != expectedScanner.CountOfLinesComment) {
+                    RevLogError(NULL,
+                                "The classifier disagrees with itself with the %ls kernel "
+                                "on %llu bytes.",
+                                LineCounters[counter].Name,
+                                (ULONGLONG)size);
+                    status = FALSE;
+                    break;
+                }
+            }
+        }
+    }
+
+    memset(&expectedScanner, 0, sizeof(expectedScanner));
+    RevClassifyLines(source, bufferSize, TRUE, syntax, NULL, &expectedScanner);
+
+    RevPrint(L"\n%-25ls%20ls%20ls\n", L"Classifier (C)", L"GB/s", L"Comment lines");
+    for (counter = 0; counter < ARRAYSIZE(LineCounters); ++counter) {
+        if ((LineCounters[counter].RequiredFeatures & ~CpuFeatures) != 0) {
+            continue;
+        }
+
+        QueryPerformanceCounter(&startQpc);
+        for (round = 0; round < countOfClassifierRounds; ++round) {
+            memset(&actualScanner, 0, sizeof(actualScanner));
+            RevClassifyLines(source,
+                             bufferSize,
+                             TRUE,
+                             syntax,
+                             LineCounters[counter].SkipRoutine,
+                             &actualScanner);
+        }
+        QueryPerformanceCounter(&endQpc);
+        time = (double)(endQpc.QuadPart - startQpc.QuadPart) / frequency.QuadPart;
+
+        if (actualScanner.CountOfLinesTotal != expectedScanner.CountOfLinesTotal ||
+            actualScanner.CountOfLinesBlank != expectedScanner.CountOfLinesBlank ||
+            actualScanner.CountOfLinesComment != expectedScanner.CountOfLinesComment) {
+            RevLogError(NULL,
+                        "The classifier disagrees with itself with the %ls kernel.",
+                        LineCounters[counter].Name);
+            status = FALSE;
+        }
+
+        RevPrint(L"%-25ls%20.2f%20llu%ls\n",
+                 LineCounters[counter].Name,
+                 (double)bufferSize * countOfClassifierRounds / time / 1e9,
+                 actualScanner.CountOfLinesComment,
+                 &LineCounters[counter] == LineCounter ? L" (selected)" : L"");
+    }
+
+Exit:
+    free(buffer);
+    free(source);
+
+    return status;
+}
+
+VOID
+RevBuildSyntaxClasses(
+    _Inout_ PREVISION_LANGUAGE_SYNTAX Syntax
+    )
+{
+    const CHAR *delimiter;
+    ULONG countOfStopBytes;
+    ULONG index;
+
+    memset(Syntax->CharacterClasses, 0, sizeof(Syntax->CharacterClasses));
+
+    Syntax->CharacterClasses[' '] = REVISION_CHARACTER_SPACE;
+    Syntax->CharacterClasses['\t'] = REVISION_CHARACTER_SPACE;
+    Syntax->CharacterClasses['\v'] = REVISION_CHARACTER_SPACE;
+    Syntax->CharacterClasses['\f'] = REVISION_CHARACTER_SPACE;
+    Syntax->CharacterClasses['\n'] = REVISION_CHARACTER_LINE_BREAK;
+    Syntax->CharacterClasses['\r'] = REVISION_CHARACTER_LINE_BREAK;
+
+    /*
+     * Only the first byte of a marker is classified, the rest is matched
+     * by RevMatchMarker.
+     */
+    for (index = 0; index < REVISION_MAX_LINE_COMMENTS; ++index) {
+        if (Syntax->LineComments[index] != NULL) {
+            Syntax->CharacterClasses[(UCHAR)Syntax->LineComments[index][0]] |= REVISION_CHARACTER_COMMENT;
+        }
+    }
+
+    if (Syntax->BlockCommentOpen != NULL) {
+        Syntax->CharacterClasses[(UCHAR)Syntax->BlockCommentOpen[0]] |= REVISION_CHARACTER_COMMENT;
+        Syntax->CharacterClasses[(UCHAR)Syntax->BlockCommentClose[0]] |= REVISION_CHARACTER_COMMENT;
+    }
+
+    for (delimiter = Syntax->StringDelimiters; *delimiter != '\0'; ++delimiter) {
+        Syntax->CharacterClasses[(UCHAR)*delimiter] |= REVISION_CHARACTER_STRING;
+    }
+
+    if (Syntax->EscapeCharacter != 0) {
+        Syntax->CharacterClasses[(UCHAR)Syntax->EscapeCharacter] |= REVISION_CHARACTER_ESCAPE;
+    }
+
+    /*
+     * Every byte with a class other than white space stops a run of plain
+     * bytes. The bytes are taken in order, so the line breaks come first:
+     * no marker or delimiter starts with a control character.
+     */
+    countOfStopBytes = 0;
+    for (index = 0; index < ARRAYSIZE(Syntax->CharacterClasses); ++index) {
+        if ((Syntax->CharacterClasses[index] & ~REVISION_CHARACTER_SPACE) == 0) {
+            continue;
+        }
+
+        if (countOfStopBytes == REVISION_MAX_STOP_BYTES) {
+            countOfStopBytes = 0;
+            break;
+        }
+
+        Syntax->StopBytes[countOfStopBytes++] = (CHAR)index;
+    }
+
+    assert(countOfStopBytes == 0 ||
+           (Syntax->StopBytes[0] == '\n' && Syntax->StopBytes[1] == '\r'));
+
+    Syntax->CountOfStopBytes = countOfStopBytes;
+}
+
+SIZE_T
+RevClassifyLines(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _In_ BOOL IsLastChunk,
+    _In_ PREVISION_LANGUAGE_SYNTAX Syntax,
+    _In_opt_ PREVISION_SKIP_PLAIN_BYTES_ROUTINE SkipRoutine,
+    _Inout_ PREVISION_SCANNER Scanner
+    )
+{
+    const UCHAR *classes = Syntax->CharacterClasses;
+    REVISION_SCANNER_STATE state = Scanner->State;
+    ULONGLONG countOfLinesTotal = Scanner->CountOfLinesTotal;
+    ULONGLONG countOfLinesBlank = Scanner->CountOfLinesBlank;
+    ULONGLONG countOfLinesComment = Scanner->CountOfLinesComment;
+    BOOL isLineCode = Scanner->IsLineCode;
+    BOOL isLineComment = Scanner->IsLineComment;
+    BOOL isPreviousCarriageReturn = Scanner->IsPreviousCarriageReturn;
+    BOOL isLineOpen = Scanner->IsLineOpen;
+    ULONG depth = Scanner->Depth;
+    CHAR delimiter = Scanner->Delimiter;
+    SIZE_T limit;
+    SIZE_T offset;
+    SIZE_T length;
+    UCHAR class;
+    ULONG index;
+    BOOL isContent;
+
+    if (Syntax->CountOfStopBytes == 0) {
+        SkipRoutine = NULL;
+    }
+
+    /*
+     * Markers and escapes look ahead of the current byte, so they must not
+     * start in the bytes left for the next chunk.
+     */
+    limit = Size;
+    if (!IsLastChunk) {
+        limit = Size > REVISION_MAX_MARKER_LENGTH - 1 ? Size - (REVISION_MAX_MARKER_LENGTH - 1) : 0;
+    }
+
+    for (offset = 0; offset < limit; ++offset) {
+        class = classes[(UCHAR)Buffer[offset]];
+
+        /*
+         * A run of plain bytes only marks its line as having content, so
+         * the kernel skips it up to the next stop byte whenever a whole
+         * block is left.
+         */
+        if ((class & ~REVISION_CHARACTER_SPACE) == 0 &&
+            SkipRoutine != NULL &&
+            limit - offset >= 64) {
+
+            /*
+             * N.B. The line breaks are the first two stop bytes, and they are
+             * all that ends a run within a line comment.
+             */
+            isContent = FALSE;
+            length = SkipRoutine(Buffer + offset,
+                                 limit - offset,
+                                 Syntax->StopBytes,
+                                 state == RevisionScannerLineComment ? 2 : Syntax->CountOfStopBytes,
+                                 &isContent);
+            if (isContent) {
+                if (state == RevisionScannerCode) {
+                    isLineCode = TRUE;
+                } else if (state != RevisionScannerString) {
+                    isLineComment = TRUE;
+                }
+            }
+            isPreviousCarriageReturn = FALSE;
+            offset += length - 1;
+            continue;
+        }
+
+        /*
+         * Most bytes are plain content: code, or the text of a comment or
+         * a string.
+         */
+        if (class == 0) {
+            if (state == RevisionScannerCode) {
+                isLineCode = TRUE;
+            } else if (state != RevisionScannerString) {
+                isLineComment = TRUE;
+            }
+            isPreviousCarriageReturn = FALSE;
+            continue;
+        }
+
+        if (class & REVISION_CHARACTER_SPACE) {
+            isPreviousCarriageReturn = FALSE;
+            continue;
+        }
+
+        if (class & REVISION_CHARACTER_LINE_BREAK) {
+            /*
+             * A line ends at its "\r", the "\n" of a "\r\n" is white space.
+             */
+            if (Buffer[offset] == '\n' && isPreviousCarriageReturn) {
+                isPreviousCarriageReturn = FALSE;
+                continue;
+            }
+
+            isPreviousCarriageReturn = Buffer[offset] == '\r';
+
+            countOfLinesTotal += 1;
+            if (!isLineCode) {
+                if (isLineComment) {
+                    countOfLinesComment += 1;
+                } else {
+                    countOfLinesBlank += 1;
+                }
+            }
+
+            isLineCode = FALSE;
+            isLineComment = FALSE;
+            if (state != RevisionScannerBlockComment) {
+                state = RevisionScannerCode;
+            }
+            continue;
+        }
+
+        isPreviousCarriageReturn = FALSE;
+
+        switch (state) {
+        case RevisionScannerCode:
+            if (class & REVISION_CHARACTER_COMMENT) {
+                /*
+                 * Block comments are tried first, their marker may begin
+                 * with a line comment marker (as "--[[" in Lua).
+                 */
+                length = RevMatchMarker(Buffer, Size, offset, Syntax->BlockCommentOpen);
+                if (length > 0) {
+                    state = RevisionScannerBlockComment;
+                    depth = 1;
+                    isLineComment = TRUE;
+                    offset += length - 1;
+                    break;
+                }
+
+                for (index = 0; index < REVISION_MAX_LINE_COMMENTS; ++index) {
+                    if (RevMatchMarker(Buffer, Size, offset, Syntax->LineComments[index]) > 0) {
+                        state = RevisionScannerLineComment;
+                        isLineComment = TRUE;
+                        break;
+                    }
+                }
+
+                if (state == RevisionScannerLineComment) {
+                    break;
+                }
+            }
+
+            isLineCode = TRUE;
+            if (class & REVISION_CHARACTER_STRING) {
+                state = RevisionScannerString;
+                delimiter = Buffer[offset];
+            }
+            break;
+
+        case RevisionScannerString:
+            if (class & REVISION_CHARACTER_ESCAPE) {
+                /*
+                 * Skip the escaped byte, unless it ends the line.
+                 */
+                if (offset + 1 < Size &&
+                    (classes[(UCHAR)Buffer[offset + 1]] & REVISION_CHARACTER_LINE_BREAK) == 0) {
+                    ++offset;
+                }
+            } else if (Buffer[offset] == delimiter) {
+                state = RevisionScannerCode;
+            }
+            break;
+
+        case RevisionScannerLineComment:
+            isLineComment = TRUE;
+            break;
+
+        case RevisionScannerBlockComment:
+            isLineComment = TRUE;
+            if (class & REVISION_CHARACTER_COMMENT) {
+                length = RevMatchMarker(Buffer, Size, offset, Syntax->BlockCommentClose);
+                if (length > 0) {
+                    offset += length - 1;
+                    if (--depth == 0) {
+                        state = RevisionScannerCode;
+                    }
+                    break;
+                }
+
+                if (Syntax->AreBlockCommentsNested) {
+                    length = RevMatchMarker(Buffer, Size, offset, Syntax->BlockCommentOpen);
+                    if (length > 0) {
+                        offset += length - 1;
+                        depth += 1;
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    if (offset > 0) {
+        isLineOpen = Buffer[offset - 1] != '\n' && Buffer[offset - 1] != '\r';
+    }
+
+    /*
+     * The last line counts even without a line end.
+     */
+    if (IsLastChunk && isLineOpen) {
+        countOfLinesTotal += 1;
+        if (!isLineCode) {
+            if (isLineComment) {
+                countOfLinesComment += 1;
+            } else {
+                countOfLinesBlank += 1;
+            }
+        }
+    }
+
+    Scanner->State = state;
+    Scanner->CountOfLinesTotal = countOfLinesTotal;
+    Scanner->CountOfLinesBlank = countOfLinesBlank;
+    Scanner->CountOfLinesComment = countOfLinesComment;
+    Scanner->IsLineCode = isLineCode;
+    Scanner->IsLineComment = isLineComment;
+    Scanner->IsPreviousCarriageReturn = isPreviousCarriageReturn;
+    Scanner->IsLineOpen = isLineOpen;
+    Scanner->Depth = depth;
+    Scanner->Delimiter = delimiter;
+
+    return offset;
+}
+
+#ifdef _WIN32
+
+_Must_inspect_result_
+BOOL
+RevEnumerateDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory
+    )
+{
+    BOOL status = TRUE;
+    PFILE_ID_BOTH_DIR_INFO entry;
+    ULONG offset;
+    WCHAR fileName[MAX_PATH];
+    SIZE_T fileNameLength;
+    BOOL isDirectory;
+    PREVISION_RECORD_EXTENSION_MAPPING mapping = NULL;
+    REVISION_CACHE_KEY linkKey;
+    ULONG deviceIndex;
+    ULONGLONG inode;
+    ULONG countOfDirectories;
+    ULONG countOfFiles = 0;
+    ULONG countOfIgnoredFiles = 0;
+    SIZE_T countOfNameChars;
+    SIZE_T entryBlockSize;
+    PREVISION_ENTRY_BLOCK entryBlock;
+    PREVISION_DIRECTORY directory;
+    PPATHCHAR name;
+    PPATHCHAR path;
+
+    Worker->CountOfDirectories += 1;
+
+    if (Worker->Revision->IsFiltered &&
+        !RevPreparePatternPath(Worker, Directory)) {
+        return FALSE;
+    }
+
+    /*
+     * Read the directory in large batches through the directory handle.
+     * Each call returns as many entries as fit into the worker's directory
+     * buffer.
+     */
+    for (;;) {
+        if (!GetFileInformationByHandleEx(Directory->Handle,
+                                          FileIdBothDirectoryInfo,
+                                          Worker->DirectoryBuffer,
+                                          REVISION_DIRECTORY_BUFFER_SIZE)) {
+            if (GetLastError() != ERROR_NO_MORE_FILES) {
+                path = RevBuildPath(Directory->Parent, Directory->Name);
+                RevLogError(Worker->Revision,
+                            "Failed to enumerate the directory \"%ls\". "
+                            "The last known error: %ls",
+                            path,
+                            RevGetLastKnownWin32Error());
+                free(path);
+                status = FALSE;
+            }
+            break;
+        }
+
+        /*
+         * The first pass filters the batch and sizes its entry block. The
+         * name of every entry that should not be scheduled is cleared.
+         */
+        countOfDirectories = 0;
+        countOfNameChars = 0;
+
+        offset = 0;
+        do {
+            entry = (PFILE_ID_BOTH_DIR_INFO)(Worker->DirectoryBuffer + offset);
+            offset += entry->NextEntryOffset;
+
+            /*
+             * N.B. Names in the directory information are not terminated.
+             */
+            fileNameLength = entry->FileNameLength / sizeof(WCHAR);
+            if (fileNameLength >= ARRAYSIZE(fileName)) {
+                RevLogWarning(Worker->Revision,
+                              "The file name \"%.*ls\" is too long.",
+                              (int)fileNameLength,
+                              entry->FileName);
+                entry->FileNameLength = 0;
+                continue;
+            }
+
+            wmemcpy(fileName, entry->FileName, fileNameLength);
+            fileName[fileNameLength] = L'\0';
+
+            if (wcscmp(fileName, L".") == 0 ||
+                wcscmp(fileName, L"..") == 0) {
+
+                /*
+                 * We want to skip one dot (for the current location) and
+                 * two dots (for the parent directory).
+                 */
+                entry->FileNameLength = 0;
+                continue;
+            }
+
+            isDirectory = (entry->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+            /*
+             * Directory symbolic links and junctions are only descended
+             * into when symbolic links are followed. For reparse points the
+             * EA size holds the reparse tag.
+             */
+            if (isDirectory &&
+                (entry->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 &&
+                IsReparseTagNameSurrogate(entry->EaSize) &&
+                !Worker->Revision->InitParams.IsSymlinkFollowed) {
+                entry->FileNameLength = 0;
+                continue;
+            }
+
+            /*
+             * Excluded entries are dropped first, so that an excluded
+             * subdirectory is never opened.
+             */
+            if (Worker->Revision->IsFiltered &&
+                RevIsEntryExcluded(Worker, Directory, fileName, isDirectory)) {
+                if (isDirectory) {
+                    Worker->CountOfExcludedDirectories += 1;
+                } else {
+                    Worker->CountOfExcludedFiles += 1;
+                }
+                entry->FileNameLength = 0;
+                continue;
+            }
+
+            /*
+             * The revision should be performed only if the file extension
+             * has been recognized. For this purpose it is enough to pass
+             * only the file name.
+             */
+            if (isDirectory) {
+                countOfDirectories += 1;
+            } else if ((mapping = RevLookupFileName(fileName)) == NULL) {
+
+                /* Increment the total count of ignored files. */
+                Worker->CountOfIgnoredFiles += 1;
+                countOfIgnoredFiles += 1;
+                entry->FileNameLength = 0;
+                continue;
+            } else {
+
+                /*
+                 * A file is identified by the file ID of its entry, a link
+                 * by the file it resolves to.
+                 */
+                if ((entry->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+                    deviceIndex = Directory->DeviceIndex;
+                    inode = (ULONGLONG)entry->FileId.QuadPart;
+                } else {
+                    if (!RevQueryFileKey(Worker->Revision, Directory, fileName, &linkKey)) {
+                        entry->FileNameLength = 0;
+                        continue;
+                    }
+
+                    deviceIndex = RevQueryDeviceIndex(&Worker->Revision->IdentitySet,
+                                                      linkKey.Device);
+                    inode = linkKey.Inode;
+                }
+
+                /*
+                 * N.B. A file reached again is counted as submitted, so
+                 * that the directory is not replayed from the cache
+                 * without it.
+                 */
+                if (!RevClaimFile(Worker, deviceIndex, inode)) {
+                    countOfFiles += 1;
+                    entry->FileNameLength = 0;
+                    continue;
+                }
+
+                /*
+                 * The second pass submits the file with the mapping found
+                 * here, kept in the file index the entry has no use for.
+                 */
+                entry->FileIndex = (ULONG)(mapping - ExtensionMappingTable);
+            }
+
+            countOfNameChars += fileNameLength + 1;
+
+        } while (entry->NextEntryOffset != 0);
+
+        if (countOfNameChars == 0) {
+            continue;
+        }
+
+        entryBlockSize = sizeof(REVISION_ENTRY_BLOCK) +
+                         countOfDirectories * sizeof(REVISION_DIRECTORY) +
+                         countOfNameChars * sizeof(PATHCHAR);
+
+        entryBlock = (PREVISION_ENTRY_BLOCK)malloc(entryBlockSize);
+        if (entryBlock == NULL) {
+            RevLogError(Worker->Revision,
+                        "Failed to allocate the entry block (%llu bytes).",
+                        (ULONGLONG)entryBlockSize);
+            status = FALSE;
+            break;
+        }
+
+        Worker->CountOfAllocations += 1;
+
+        entryBlock->Next = Directory->EntryBlocks;
+        entryBlock->CountOfDirectories = countOfDirectories;
+        Directory->EntryBlocks = entryBlock;
+
+        /*
+         * The second pass copies the names into the entry block and
+         * schedules a task for each subdirectory or file. It may be
+         * executed by this worker later or stolen by another one. The
+         * entries are opened relative to the directory handle.
+         */
+        directory = entryBlock->Directories;
+        name = (PPATHCHAR)(entryBlock->Directories + countOfDirectories);
+
+        offset = 0;
+        do {
+            entry = (PFILE_ID_BOTH_DIR_INFO)(Worker->DirectoryBuffer + offset);
+            offset += entry->NextEntryOffset;
+
+            if (entry->FileNameLength == 0) {
+                continue;
+            }
+
+            fileNameLength = entry->FileNameLength / sizeof(WCHAR);
+            wmemcpy(name, entry->FileName, fileNameLength);
+            name[fileNameLength] = L'\0';
+
+            if (entry->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                RevInitializeDirectory(directory, Directory, name);
+                RevScheduleTask(Worker,
+                                RevisionTaskDirectory,
+                                directory,
+                                name);
+                directory += 1;
+            } else {
+                RevSubmitFile(Worker,
+                              Directory,
+                              name,
+                              &ExtensionMappingTable[entry->FileIndex]);
+                countOfFiles += 1;
+            }
+
+            name += fileNameLength + 1;
+
+        } while (entry->NextEntryOffset != 0);
+    }
+
+    /*
+     * Only a complete enumeration may be replayed by the next revision.
+     */
+    if (status && Directory->HasCacheKey) {
+        RevAppendCacheDirectory(Worker, Directory, countOfFiles, countOfIgnoredFiles);
+    }
+
+    return status;
+}
+
+#else
+
+_Must_inspect_result_
+BOOL
+RevEnumerateDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory
+    )
+{
+    BOOL status = TRUE;
+    PLINUX_DIRENT64 entry;
+    struct stat fileStat;
+    unsigned char entryType;
+    BOOL isLinkResolved;
+    PREVISION_RECORD_EXTENSION_MAPPING mapping;
+    ULONG deviceIndex;
+    ULONGLONG inode;
+    SIZE_T nameLength;
+    ULONG countOfDirectories;
+    ULONG countOfFiles = 0;
+    ULONG countOfIgnoredFiles = 0;
+    SIZE_T countOfNameChars;
+    SIZE_T entryBlockSize;
+    PREVISION_ENTRY_BLOCK entryBlock;
+    PREVISION_DIRECTORY directory;
+    PPATHCHAR name;
+    PPATHCHAR path;
+    long bytesReturned;
+    long offset;
+
+    Worker->CountOfDirectories += 1;
+
+    if (Worker->Revision->IsFiltered &&
+        !RevPreparePatternPath(Worker, Directory)) {
+        return FALSE;
+    }
+
+    /*
+     * Read the directory in large batches. Each getdents64 call returns as
+     * many entries as fit into the worker's directory buffer.
+     */
+    for (;;) {
+        bytesReturned = syscall(SYS_getdents64,
+                                Directory->Handle,
+                                Worker->DirectoryBuffer,
+                                REVISION_DIRECTORY_BUFFER_SIZE);
+        if (bytesReturned == 0) {
+            break;
+        }
+        if (bytesReturned < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            path = RevBuildPath(Directory->Parent, Directory->Name);
+            RevLogError(Worker->Revision,
+                        "Failed to enumerate the directory \"%s\". "
+                        "The last known error: %ls",
+                        path,
+                        RevGetLastKnownWin32Error());
+            free(path);
+            status = FALSE;
+            break;
+        }
+
+        /*
+         * The first pass filters the batch and sizes its entry block. The
+         * name of every entry that should not be scheduled is cleared, and
+         * the resolved type is stored back into the entry.
+         */
+        countOfDirectories = 0;
+        countOfNameChars = 0;
+
+        for (offset = 0; offset < bytesReturned; offset += entry->RecordLength) {
+            entry = (PLINUX_DIRENT64)(Worker->DirectoryBuffer + offset);
+
+            /*
+             * We want to skip one dot (for the current location) and
+             * two dots (for the parent directory).
+             */
+            if (entry->Name[0] == '.' &&
+                (entry->Name[1] == '\0' ||
+                 (entry->Name[1] == '.' && entry->Name[2] == '\0'))) {
+                entry->Name[0] = '\0';
+                continue;
+            }
+
+            /*
+             * Most file systems report the entry type in the directory
+             * listing. Only stat the entry if the file system does not.
+             */
+            entryType = entry->Type;
+            if (entryType == DT_UNKNOWN) {
+                if (fstatat(Directory->Handle,
+                            entry->Name,
+                            &fileStat,
+                            AT_SYMLINK_NOFOLLOW) != 0) {
+                    RevLogWarning(Worker->Revision,
+                                  "Failed to retrieve the type of \"%s\".",
+                                  entry->Name);
+                    entry->Name[0] = '\0';
+                    continue;
+                }
+
+                if (S_ISDIR(fileStat.st_mode)) {
+                    entryType = DT_DIR;
+                } else if (S_ISREG(fileStat.st_mode)) {
+                    entryType = DT_REG;
+                } else if (S_ISLNK(fileStat.st_mode)) {
+                    entryType = DT_LNK;
+                }
+
+                entry->Type = entryType;
+            }
+
+            /*
+             * Symbolic links are treated as files, the same way the Win32
+             * enumeration reports them; they are opened through the link,
+             * but directory links are only descended into when symbolic
+             * links are followed. Then they are resolved first, so that
+             * they are excluded as directories.
+             */
+            if (entryType != DT_DIR &&
+                entryType != DT_REG &&
+                entryType != DT_LNK) {
+                entry->Name[0] = '\0';
+                continue;
+            }
+
+            isLinkResolved = FALSE;
+            if (entryType == DT_LNK &&
+                Worker->Revision->InitParams.IsSymlinkFollowed) {
+                if (!RevResolveLinkEntry(Worker, Directory, entry, &fileStat)) {
+                    entry->Name[0] = '\0';
+                    continue;
+                }
+
+                entryType = entry->Type;
+                isLinkResolved = TRUE;
+            }
+
+            /*
+             * Excluded entries are dropped first, so that an excluded
+             * subdirectory is never opened.
+             */
+            if (Worker->Revision->IsFiltered &&
+                RevIsEntryExcluded(Worker, Directory, entry->Name, entryType == DT_DIR)) {
+                if (entryType == DT_DIR) {
+                    Worker->CountOfExcludedDirectories += 1;
+                } else {
+                    Worker->CountOfExcludedFiles += 1;
+                }
+                entry->Name[0] = '\0';
+                continue;
+            }
+
+            /*
+             * It is enough to check the name, ignored files never need a
+             * full path.
+             */
+            if (entryType == DT_DIR) {
+                countOfDirectories += 1;
+            } else {
+                mapping = RevLookupFileName(entry->Name);
+                if (mapping == NULL) {
+
+                    /* Increment the total count of ignored files. */
+                    Worker->CountOfIgnoredFiles += 1;
+                    countOfIgnoredFiles += 1;
+                    entry->Name[0] = '\0';
+                    continue;
+                }
+
+                /*
+                 * A regular file is identified by the inode of its entry,
+                 * a link by the file it resolves to.
+                 */
+                if (entryType == DT_REG) {
+                    deviceIndex = Directory->DeviceIndex;
+                    inode = entry->Inode;
+                } else {
+                    if (!isLinkResolved &&
+                        !RevResolveLinkEntry(Worker, Directory, entry, &fileStat)) {
+                        entry->Name[0] = '\0';
+                        continue;
+                    }
+
+                    deviceIndex = RevQueryDeviceIndex(&Worker->Revision->IdentitySet,
+                                                      (ULONGLONG)fileStat.st_dev);
+                    inode = (ULONGLONG)fileStat.st_ino;
+                }
+
+                /*
+                 * N.B. A file reached again is counted as submitted, so that
+                 * the directory is not replayed from the cache without it:
+                 * the next revision may reach the file from here first.
+                 */
+                if (!RevClaimFile(Worker, deviceIndex, inode)) {
+                    countOfFiles += 1;
+                    entry->Name[0] = '\0';
+                    continue;
+                }
+
+                /*
+                 * The second pass submits the file with the mapping found
+                 * here, kept in the offset the entry has no use for.
+                 */
+                entry->Offset = (LONGLONG)(mapping - ExtensionMappingTable);
+            }
+
+            countOfNameChars += strlen(entry->Name) + 1;
+        }
+
+        if (countOfNameChars == 0) {
+            continue;
+        }
+
+        entryBlockSize = sizeof(REVISION_ENTRY_BLOCK) +
+                         countOfDirectories * sizeof(REVISION_DIRECTORY) +
+                         countOfNameChars * sizeof(PATHCHAR);
+
+        entryBlock = (PREVISION_ENTRY_BLOCK)malloc(entryBlockSize);
+        if (entryBlock == NULL) {
+            RevLogError(Worker->Revision,
+                        "Failed to allocate the entry block (%llu bytes).",
+                        (ULONGLONG)entryBlockSize);
+            status = FALSE;
+            break;
+        }
+
+        Worker->CountOfAllocations += 1;
+
+        entryBlock->Next = Directory->EntryBlocks;
+        entryBlock->CountOfDirectories = countOfDirectories;
+        Directory->EntryBlocks = entryBlock;
+
+        /*
+         * The second pass copies the names into the entry block and
+         * schedules a task for each subdirectory or file. The entries are
+         * opened relative to the directory descriptor.
+         */
+        directory = entryBlock->Directories;
+        name = (PPATHCHAR)(entryBlock->Directories + countOfDirectories);
+
+        for (offset = 0; offset < bytesReturned; offset += entry->RecordLength) {
+            entry = (PLINUX_DIRENT64)(Worker->DirectoryBuffer + offset);
+
+            if (entry->Name[0] == '\0') {
+                continue;
+            }
+
+            nameLength = strlen(entry->Name);
+            memcpy(name, entry->Name, nameLength + 1);
+
+            if (entry->Type == DT_DIR) {
+                RevInitializeDirectory(directory, Directory, name);
+                RevScheduleTask(Worker,
+                                RevisionTaskDirectory,
+                                directory,
+                                name);
+                directory += 1;
+            } else {
+                RevSubmitFile(Worker,
+                              Directory,
+                              name,
+                              &ExtensionMappingTable[entry->Offset]);
+                countOfFiles += 1;
+            }
+
+            name += nameLength + 1;
+        }
+    }
+
+    /*
+     * Only a complete enumeration may be replayed by the next revision.
+     */
+    if (status && Directory->HasCacheKey) {
+        RevAppendCacheDirectory(Worker, Directory, countOfFiles, countOfIgnoredFiles);
+    }
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevResolveLinkEntry(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _Inout_ PLINUX_DIRENT64 Entry,
+    _Out_ struct stat *LinkStat
+    )
+{
+    if (fstatat(Directory->Handle, Entry->Name, LinkStat, 0) != 0) {
+        RevLogWarning(Worker->Revision,
+                      "Failed to resolve the symbolic link \"%s\".",
+                      Entry->Name);
+        return FALSE;
+    }
+
+    if (S_ISDIR(LinkStat->st_mode)) {
+        if (!Worker->Revision->InitParams.IsSymlinkFollowed) {
+            return FALSE;
+        }
+
+        Entry->Type = DT_DIR;
+        return TRUE;
+    }
+
+    return S_ISREG(LinkStat->st_mode);
+}
+
+#endif
+
+#ifdef _WIN32
+
+_Must_inspect_result_
+BOOL
+RevOpenFile(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _Out_ FILEHANDLE *File
+    )
+{
+    BOOL status = TRUE;
+    HANDLE file;
+    PPATHCHAR path = NULL;
+    NTSTATUS ntStatus;
+    UNICODE_STRING relativeName;
+    OBJECT_ATTRIBUTES objectAttributes;
+    IO_STATUS_BLOCK ioStatusBlock;
+
+    /*
+     * Attempt to open the file, relative to its directory if there is one.
+     */
+    if (Directory == NULL) {
+        file = CreateFile(FileName,
+                          GENERIC_READ,
+                          FILE_SHARE_READ,
+                          NULL,
+                          OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                          NULL);
+    } else {
+        relativeName.Buffer = FileName;
+        relativeName.Length = (USHORT)(wcslen(FileName) * sizeof(WCHAR));
+        relativeName.MaximumLength = relativeName.Length;
+
+        InitializeObjectAttributes(&objectAttributes,
+                                   &relativeName,
+                                   OBJ_CASE_INSENSITIVE,
+                                   Directory->Handle,
+                                   NULL);
+
+        ntStatus = NtCreateFile(&file,
+                                FILE_GENERIC_READ,
+                                &objectAttributes,
+                                &ioStatusBlock,
+                                NULL,
+                                FILE_ATTRIBUTE_NORMAL,
+                                FILE_SHARE_READ,
+                                FILE_OPEN,
+                                FILE_NON_DIRECTORY_FILE |
+                                FILE_SYNCHRONOUS_IO_NONALERT |
+                                FILE_SEQUENTIAL_ONLY,
+                                NULL,
+                                0);
+        if (!NT_SUCCESS(ntStatus)) {
+            SetLastError(RtlNtStatusToDosError(ntStatus));
+            file = INVALID_HANDLE_VALUE;
+        }
+    }
+    if (file == INVALID_HANDLE_VALUE) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogError(Revision,
+                    "Failed to open the file \"%ls\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        status = FALSE;
+    }
+
+    free(path);
+
+    *File = file;
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevReadFileChunk(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _Out_writes_bytes_(Size) PCHAR Buffer,
+    _In_ SIZE_T Size,
+    _Out_ SIZE_T *BytesRead
+    )
+{
+    BOOL status = TRUE;
+    SIZE_T bytesRead = 0;
+    DWORD result;
+    PPATHCHAR path;
+
+    /*
+     * N.B. Currently, reading only ANSI files is supported. It is assumed
+     * that most source code files do not use utf-16 encoding, but support
+     * for encoding detection should be added in the future.
+     *
+     * Keep reading until the chunk is full or the end of the file is hit,
+     * so that a short chunk always means the end of the file.
+     */
+    while (bytesRead < Size) {
+        if (!ReadFile(File,
+                      Buffer + bytesRead,
+                      (DWORD)(Size - bytesRead),
+                      &result,
+                      NULL)) {
+
+            /*
+             * N.B. The end of a pipe, such as a piped standard input, is
+             * reported as a broken pipe.
+             */
+            if (GetLastError() == ERROR_BROKEN_PIPE) {
+                break;
+            }
+
+            path = RevBuildPath(Directory, FileName);
+            RevLogError(Revision,
+                        "Failed to read the file \"%ls\". "
+                        "The last known error: %ls.",
+                        path,
+                        RevGetLastKnownWin32Error());
+            free(path);
+            status = FALSE;
+            break;
+        }
+        if (result == 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+
+    *BytesRead = bytesRead;
+
+    return status;
+}
+
+VOID
+RevCloseFile(
+    _In_ FILEHANDLE File
+    )
+{
+    CloseHandle(File);
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryFileSize(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _Out_ ULONGLONG *FileSize
+    )
+{
+    LARGE_INTEGER fileSize;
+    PPATHCHAR path;
+
+    if (!GetFileSizeEx(File, &fileSize)) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogError(Revision,
+                    "Failed to retrieve the size of the file \"%ls\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+        *FileSize = 0;
+        return FALSE;
+    }
+
+    *FileSize = (ULONGLONG)fileSize.QuadPart;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevMapFile(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _In_ SIZE_T FileSize,
+    _Out_ const CHAR **View
+    )
+{
+    HANDLE mapping;
+    PVOID view = NULL;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    PPATHCHAR path;
+
+    mapping = CreateFileMapping(File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+        /*
+         * The view keeps the mapping alive.
+         */
+        CloseHandle(mapping);
+    }
+
+    if (view == NULL) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogWarning(Revision,
+                      "Failed to map the file \"%ls\", reading it instead. "
+                      "The last known error: %ls.",
+                      path,
+                      RevGetLastKnownWin32Error());
+        free(path);
+        *View = NULL;
+        return FALSE;
+    }
+
+    /*
+     * The handle was opened for sequential scans, so the cache manager
+     * reads ahead already; ask for the whole view up front as well.
+     */
+    range.VirtualAddress = view;
+    range.NumberOfBytes = FileSize;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+    *View = (const CHAR *)view;
+
+    return TRUE;
+}
+
+VOID
+RevUnmapFile(
+    _In_ const CHAR *View,
+    _In_ SIZE_T FileSize
+    )
+{
+    UNREFERENCED_PARAMETER(FileSize);
+
+    UnmapViewOfFile(View);
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryFileKey(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _Out_ PREVISION_CACHE_KEY CacheKey
+    )
+{
+    BOOL status;
+    FILEHANDLE file;
+    BY_HANDLE_FILE_INFORMATION information;
+    PPATHCHAR path;
+
+    /*
+     * The file ID is only available through a handle.
+     */
+    if (!RevOpenFile(Revision, Directory, FileName, &file)) {
+        return FALSE;
+    }
+
+    status = GetFileInformationByHandle(file, &information);
+    if (!status) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogError(Revision,
+                    "Failed to query the file \"%ls\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+    } else {
+        CacheKey->Device = information.dwVolumeSerialNumber;
+        CacheKey->Inode = ((ULONGLONG)information.nFileIndexHigh << 32) |
+                          information.nFileIndexLow;
+        CacheKey->Size = ((ULONGLONG)information.nFileSizeHigh << 32) |
+                         information.nFileSizeLow;
+        CacheKey->ModificationTime =
+            ((ULONGLONG)information.ftLastWriteTime.dwHighDateTime << 32) |
+            information.ftLastWriteTime.dwLowDateTime;
+    }
+
+    RevCloseFile(file);
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryDirectoryKey(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    BY_HANDLE_FILE_INFORMATION information;
+    PPATHCHAR path;
+
+    if (!GetFileInformationByHandle(Directory->Handle, &information)) {
+        path = RevBuildPath(Directory->Parent, Directory->Name);
+        RevLogError(Revision,
+                    "Failed to query the directory \"%ls\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+        return FALSE;
+    }
+
+    Directory->CacheKey.Device = information.dwVolumeSerialNumber;
+    Directory->CacheKey.Inode = ((ULONGLONG)information.nFileIndexHigh << 32) |
+                                information.nFileIndexLow;
+    Directory->CacheKey.Size = ((ULONGLONG)information.nFileSizeHigh << 32) |
+                               information.nFileSizeLow;
+    Directory->CacheKey.ModificationTime =
+        ((ULONGLONG)information.ftLastWriteTime.dwHighDateTime << 32) |
+        information.ftLastWriteTime.dwLowDateTime;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryIsDirectory(
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name,
+    _Out_ PBOOL IsDirectory
+    )
+{
+    PPATHCHAR path;
+    DWORD attributes;
+
+    *IsDirectory = FALSE;
+
+    path = RevBuildPath(Directory, Name);
+    if (path == NULL) {
+        return FALSE;
+    }
+
+    attributes = GetFileAttributes(path);
+    free(path);
+
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return FALSE;
+    }
+
+    *IsDirectory = (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevWriteCacheFile(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_CACHE_HEADER Header,
+    _In_ const REVISION_CACHE_ENTRY *Entries,
+    _In_ const REVISION_CACHE_DIRECTORY *Directories,
+    _In_ const PATHCHAR *Names
+    )
+{
+    BOOL status = TRUE;
+    PWCHAR temporaryPath;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    const CHAR *parts[4];
+    SIZE_T partSizes[4];
+    ULONG part;
+    DWORD bytesToWrite;
+    DWORD bytesWritten;
+
+    temporaryPath = RevStringAppend(Revision->Cache.Path, L".tmp");
+    if (temporaryPath == NULL) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    file = CreateFile(temporaryPath,
+                      GENERIC_WRITE,
+                      0,
+                      NULL,
+                      CREATE_ALWAYS,
+                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                      NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    parts[0] = (const CHAR *)Header;
+    partSizes[0] = sizeof(REVISION_CACHE_HEADER);
+    parts[1] = (const CHAR *)Entries;
+    partSizes[1] = (SIZE_T)Header->CountOfEntries * sizeof(REVISION_CACHE_ENTRY);
+    parts[2] = (const CHAR *)Directories;
+    partSizes[2] = (SIZE_T)Header->CountOfDirectories * sizeof(REVISION_CACHE_DIRECTORY);
+    parts[3] = (const CHAR *)Names;
+    partSizes[3] = (SIZE_T)Header->CountOfNameChars * sizeof(PATHCHAR);
+
+    for (part = 0; part < ARRAYSIZE(parts); ++part) {
+        while (partSizes[part] > 0) {
+            bytesToWrite = partSizes[part] < 0x40000000 ? (DWORD)partSizes[part] :
+                                                          0x40000000;
+            if (!WriteFile(file, parts[part], bytesToWrite, &bytesWritten, NULL)) {
+                status = FALSE;
+                goto Exit;
+            }
+
+            parts[part] += bytesWritten;
+            partSizes[part] -= bytesWritten;
+        }
+    }
+
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+
+    if (!MoveFileEx(temporaryPath, Revision->Cache.Path, MOVEFILE_REPLACE_EXISTING)) {
+        status = FALSE;
+    }
+
+Exit:
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+
+    if (!status) {
+        RevLogError(Revision,
+                    "Failed to write the scan cache \"%ls\". "
+                    "The last known error: %ls.",
+                    Revision->Cache.Path,
+                    RevGetLastKnownWin32Error());
+
+        if (temporaryPath != NULL) {
+            DeleteFile(temporaryPath);
+        }
+    }
+
+    free(temporaryPath);
+
+    return status;
+}
+
+#else
+
+_Must_inspect_result_
+BOOL
+RevOpenFile(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _Out_ FILEHANDLE *File
+    )
+{
+    BOOL status = TRUE;
+    PPATHCHAR path = NULL;
+    int file;
+
+    /*
+     * Attempt to open the file, relative to its directory if there is one.
+     */
+    file = openat(Directory != NULL ? Directory->Handle : AT_FDCWD,
+                  FileName,
+                  O_RDONLY | O_CLOEXEC);
+    if (file == -1) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogError(Revision,
+                    "Failed to open the file \"%s\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        status = FALSE;
+    } else {
+        posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    free(path);
+
+    *File = file;
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevReadFileChunk(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _Out_writes_bytes_(Size) PCHAR Buffer,
+    _In_ SIZE_T Size,
+    _Out_ SIZE_T *BytesRead
+    )
+{
+    BOOL status = TRUE;
+    SIZE_T bytesRead = 0;
+    ssize_t result;
+    PPATHCHAR path;
+
+    /*
+     * N.B. read may return less than requested, so keep reading until the
+     * chunk is full or the end of the file is hit.
+     */
+    while (bytesRead < Size) {
+        result = read(File, Buffer + bytesRead, Size - bytesRead);
+        if (result == 0) {
+            break;
+        }
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            path = RevBuildPath(Directory, FileName);
+            RevLogError(Revision,
+                        "Failed to read the file \"%s\". "
+                        "The last known error: %ls.",
+                        path,
+                        RevGetLastKnownWin32Error());
+            free(path);
+            status = FALSE;
+            break;
+        }
+        bytesRead += (SIZE_T)result;
+    }
+
+    *BytesRead = bytesRead;
+
+    return status;
+}
+
+VOID
+RevCloseFile(
+    _In_ FILEHANDLE File
+    )
+{
+    close(File);
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryFileSize(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _Out_ ULONGLONG *FileSize
+    )
+{
+    struct stat fileStat;
+    PPATHCHAR path;
+
+    if (fstat(File, &fileStat) != 0) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogError(Revision,
+                    "Failed to retrieve the size of the file \"%s\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+        *FileSize = 0;
+        return FALSE;
+    }
+
+    *FileSize = (ULONGLONG)fileStat.st_size;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevMapFile(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ FILEHANDLE File,
+    _In_ SIZE_T FileSize,
+    _Out_ const CHAR **View
+    )
+{
+    PVOID view;
+    PPATHCHAR path;
+
+    view = mmap(NULL, FileSize, PROT_READ, MAP_PRIVATE, File, 0);
+    if (view == MAP_FAILED) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogWarning(Revision,
+                      "Failed to map the file \"%s\", reading it instead. "
+                      "The last known error: %ls.",
+                      path,
+                      RevGetLastKnownWin32Error());
+        free(path);
+        *View = NULL;
+        return FALSE;
+    }
+
+    /*
+     * The view is read once from start to end: read ahead aggressively,
+     * and let the pages go soon after they have been counted.
+     */
+    madvise(view, FileSize, MADV_SEQUENTIAL);
+    madvise(view, FileSize, MADV_WILLNEED);
+
+    *View = (const CHAR *)view;
+
+    return TRUE;
+}
+
+VOID
+RevUnmapFile(
+    _In_ const CHAR *View,
+    _In_ SIZE_T FileSize
+    )
+{
+    munmap((PVOID)View, FileSize);
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryFileKey(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _Out_ PREVISION_CACHE_KEY CacheKey
+    )
+{
+    struct stat fileStat;
+    PPATHCHAR path;
+
+    if (fstatat(Directory != NULL ? Directory->Handle : AT_FDCWD,
+                FileName,
+                &fileStat,
+                0) != 0) {
+        path = RevBuildPath(Directory, FileName);
+        RevLogError(Revision,
+                    "Failed to query the file \"%s\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+        return FALSE;
+    }
+
+    CacheKey->Device = (ULONGLONG)fileStat.st_dev;
+    CacheKey->Inode = (ULONGLONG)fileStat.st_ino;
+    CacheKey->Size = (ULONGLONG)fileStat.st_size;
+    CacheKey->ModificationTime = (ULONGLONG)fileStat.st_mtim.tv_sec * 1000000000ULL +
+                                 (ULONGLONG)fileStat.st_mtim.tv_nsec;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryDirectoryKey(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    struct stat directoryStat;
+    PPATHCHAR path;
+
+    if (fstat(Directory->Handle, &directoryStat) != 0) {
+        path = RevBuildPath(Directory->Parent, Directory->Name);
+        RevLogError(Revision,
+                    "Failed to query the directory \"%s\". "
+                    "The last known error: %ls.",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+        return FALSE;
+    }
+
+    Directory->CacheKey.Device = (ULONGLONG)directoryStat.st_dev;
+    Directory->CacheKey.Inode = (ULONGLONG)directoryStat.st_ino;
+    Directory->CacheKey.Size = (ULONGLONG)directoryStat.st_size;
+    Directory->CacheKey.ModificationTime =
+        (ULONGLONG)directoryStat.st_mtim.tv_sec * 1000000000ULL +
+        (ULONGLONG)directoryStat.st_mtim.tv_nsec;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevQueryIsDirectory(
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Name,
+    _Out_ PBOOL IsDirectory
+    )
+{
+    struct stat entryStat;
+
+    *IsDirectory = FALSE;
+
+    if (fstatat(Directory->Handle, Name, &entryStat, 0) != 0) {
+        return FALSE;
+    }
+
+    *IsDirectory = S_ISDIR(entryStat.st_mode);
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevWriteCacheFile(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_CACHE_HEADER Header,
+    _In_ const REVISION_CACHE_ENTRY *Entries,
+    _In_ const REVISION_CACHE_DIRECTORY *Directories,
+    _In_ const PATHCHAR *Names
+    )
+{
+    BOOL status = TRUE;
+    PCHAR temporaryPath;
+    SIZE_T pathLength;
+    int file = -1;
+    const CHAR *parts[4];
+    SIZE_T partSizes[4];
+    ULONG part;
+    ssize_t bytesWritten;
+
+    pathLength = strlen(Revision->Cache.Path);
+    temporaryPath = (PCHAR)malloc(pathLength + sizeof(".tmp"));
+    if (temporaryPath == NULL) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    memcpy(temporaryPath, Revision->Cache.Path, pathLength);
+    memcpy(temporaryPath + pathLength, ".tmp", sizeof(".tmp"));
+
+    file = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file == -1) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    parts[0] = (const CHAR *)Header;
+    partSizes[0] = sizeof(REVISION_CACHE_HEADER);
+    parts[1] = (const CHAR *)Entries;
+    partSizes[1] = (SIZE_T)Header->CountOfEntries * sizeof(REVISION_CACHE_ENTRY);
+    parts[2] = (const CHAR *)Directories;
+    partSizes[2] = (SIZE_T)Header->CountOfDirectories * sizeof(REVISION_CACHE_DIRECTORY);
+    parts[3] = (const CHAR *)Names;
+    partSizes[3] = (SIZE_T)Header->CountOfNameChars * sizeof(PATHCHAR);
+
+    for (part = 0; part < ARRAYSIZE(parts); ++part) {
+        while (partSizes[part] > 0) {
+            bytesWritten = write(file, parts[part], partSizes[part]);
+            if (bytesWritten == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                status = FALSE;
+                goto Exit;
+            }
+
+            parts[part] += bytesWritten;
+            partSizes[part] -= (SIZE_T)bytesWritten;
+        }
+    }
+
+    if (close(file) != 0) {
+        file = -1;
+        status = FALSE;
+        goto Exit;
+    }
+    file = -1;
+
+    if (rename(temporaryPath, Revision->Cache.Path) != 0) {
+        status = FALSE;
+    }
+
+Exit:
+    if (file != -1) {
+        close(file);
+    }
+
+    if (!status) {
+        RevLogError(Revision,
+                    "Failed to write the scan cache \"%s\". "
+                    "The last known error: %ls.",
+                    Revision->Cache.Path,
+                    RevGetLastKnownWin32Error());
+
+        if (temporaryPath != NULL) {
+            unlink(temporaryPath);
+        }
+    }
+
+    free(temporaryPath);
+
+    return status;
+}
+
+#endif
+
+VOID
+RevCountBufferLines(
+    _In_ ULONG LanguageId,
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size,
+    _Out_ PULONGLONG CountOfLinesTotal,
+    _Out_ PULONGLONG CountOfLinesBlank,
+    _Out_ PULONGLONG CountOfLinesComment
+    )
+{
+    PREVISION_LANGUAGE_SYNTAX syntax = LanguageSyntax[LanguageId];
+    REVISION_LINE_STATE lineState = {0};
+    REVISION_SCANNER scanner = {0};
+
+    /*
+     * Languages with comments are classified line by line, with the kernel
+     * selected for this processor skipping the runs of plain bytes. The
+     * others only need their lines counted, which the kernel does alone,
+     * much faster.
+     */
+    if (syntax != NULL) {
+        RevClassifyLines(Buffer, Size, TRUE, syntax, LineCounter->SkipRoutine, &scanner);
+        *CountOfLinesTotal = scanner.CountOfLinesTotal;
+        *CountOfLinesBlank = scanner.CountOfLinesBlank;
+        *CountOfLinesComment = scanner.CountOfLinesComment;
+    } else {
+        LineCounter->Routine(Buffer, Size, &lineState);
+        RevCompleteLineCount(&lineState);
+        *CountOfLinesTotal = lineState.CountOfLinesTotal;
+        *CountOfLinesBlank = lineState.CountOfLinesBlank;
+        *CountOfLinesComment = 0;
+    }
+}
+
+VOID
+RevReviseBuffer(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_FILE_BUFFER File
+    )
+{
+    ULONGLONG countOfLinesTotal;
+    ULONGLONG countOfLinesBlank;
+    ULONGLONG countOfLinesComment;
+    REVISION_CONTENT_ENTRY content;
+
+    /*
+     * Hashing is much cheaper than counting, so a duplicate is only
+     * hashed. It is recorded with the counts of the first file, for the
+     * scan cache.
+     */
+    if (Worker->Revision->InitParams.IsContentDeduplicated) {
+        File->ContentHash = RevHashContents(File->Contents, File->Size);
+        File->HasContentHash = TRUE;
+
+        content.ContentHash = File->ContentHash;
+        content.LanguageId = File->Mapping->LanguageId;
+        if (RevLookupContent(&Worker->Revision->ContentSet, &content)) {
+            RevRecordFileLines(Worker,
+                               File,
+                               content.CountOfLinesTotal,
+                               content.CountOfLinesBlank,
+                               content.CountOfLinesComment);
+            return;
+        }
+    }
+
+    RevCountBufferLines(File->Mapping->LanguageId,
+                        File->Contents,
+                        File->Size,
+                        &countOfLinesTotal,
+                        &countOfLinesBlank,
+                        &countOfLinesComment);
+    RevRecordFileLines(Worker,
+                       File,
+                       countOfLinesTotal,
+                       countOfLinesBlank,
+                       countOfLinesComment);
+}
+
+VOID
+RevAddFileLines(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG LanguageId,
+    _In_ ULONGLONG CountOfLinesTotal,
+    _In_ ULONGLONG CountOfLinesBlank,
+    _In_ ULONGLONG CountOfLinesComment
+    )
+{
+    PREVISION_RECORD revisionRecord = &Worker->RevisionRecords[LanguageId];
+
+    /*
+     * Update the count of lines for the extension.
+     */
+    revisionRecord->CountOfLinesTotal += CountOfLinesTotal;
+    revisionRecord->CountOfLinesBlank += CountOfLinesBlank;
+    revisionRecord->CountOfLinesComment += CountOfLinesComment;
+    revisionRecord->CountOfFiles += 1;
+
+    /*
+     * Update the count of lines for the worker.
+     */
+    Worker->CountOfLinesTotal += CountOfLinesTotal;
+    Worker->CountOfLinesBlank += CountOfLinesBlank;
+    Worker->CountOfLinesComment += CountOfLinesComment;
+    Worker->CountOfFiles += 1;
+}
+
+VOID
+RevRecordFileLines(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_FILE_BUFFER File,
+    _In_ ULONGLONG CountOfLinesTotal,
+    _In_ ULONGLONG CountOfLinesBlank,
+    _In_ ULONGLONG CountOfLinesComment
+    )
+{
+    PCODEMETER_FILE_CALLBACK fileCallback = Worker->Revision->InitParams.FileCallback;
+    CODEMETER_FILE file;
+    PPATHCHAR path;
+    BOOL isDuplicate;
+
+    isDuplicate = File->HasContentHash &&
+                  !RevClaimContent(Worker,
+                                   File->Mapping->LanguageId,
+                                   File->ContentHash,
+                                   CountOfLinesTotal,
+                                   CountOfLinesBlank,
+                                   CountOfLinesComment);
+    if (!isDuplicate) {
+        RevAddFileLines(Worker,
+                        File->Mapping->LanguageId,
+                        CountOfLinesTotal,
+                        CountOfLinesBlank,
+                        CountOfLinesComment);
+    }
+
+    /*
+     * A duplicate is cached all the same, as it is counted in its own
+     * right once the file it duplicates is gone.
+     */
+    if (File->HasCacheKey) {
+        File->CacheEntry.LanguageId = File->Mapping->LanguageId;
+        File->CacheEntry.CountOfLinesTotal = CountOfLinesTotal;
+        File->CacheEntry.CountOfLinesBlank = CountOfLinesBlank;
+        File->CacheEntry.CountOfLinesComment = CountOfLinesComment;
+        File->CacheEntry.ContentHash = File->HasContentHash ? File->ContentHash : 0;
+
+        RevAppendCacheEntry(Worker, &File->CacheEntry);
+    }
+
+    if (isDuplicate) {
+        return;
+    }
+
+    /*
+     * Report the file to the library caller. Its full path is only built
+     * for that.
+     */
+    if (fileCallback != NULL && File->FileName != NULL) {
+        path = RevBuildPath(File->Directory, File->FileName);
+        if (path == NULL) {
+            return;
+        }
+
+        file.Path = path;
+        file.LanguageId = (uint32_t)File->Mapping->LanguageId;
+        file.Counts.CountOfLinesTotal = CountOfLinesTotal;
+        file.Counts.CountOfLinesBlank = CountOfLinesBlank;
+        file.Counts.CountOfLinesComment = CountOfLinesComment;
+
+        fileCallback(&file, Worker->Revision->InitParams.CallbackContext);
+
+        free(path);
+    }
+}
+
+_Must_inspect_result_
+BOOL
+RevLoadCache(
+    _Inout_ PREVISION Revision
+    )
+{
+    BOOL status = TRUE;
+    PREVISION_CACHE cache = &Revision->Cache;
+    FILEHANDLE file = INVALID_FILE_HANDLE;
+    ULONGLONG fileSize;
+    const CHAR *view = NULL;
+    const REVISION_CACHE_HEADER *header;
+
+#ifdef _WIN32
+    cache->Path = _wcsdup(Revision->InitParams.CacheFile);
+#else
+    cache->Path = RevConvertToMultiByte(Revision->InitParams.CacheFile);
+#endif
+    if (cache->Path == NULL) {
+        RevLogError(Revision,
+                    "Failed to copy the scan cache path.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * There is no cache before the first revision, which is not an error.
+     */
+#ifdef _WIN32
+    if (GetFileAttributes(cache->Path) == INVALID_FILE_ATTRIBUTES) {
+#else
+    if (access(cache->Path, F_OK) != 0) {
+#endif
+        goto Exit;
+    }
+
+    /*
+     * The cache is looked up in place: mapping it costs no more than
+     * mapping any other file, whatever the number of entries.
+     */
+    if (!RevOpenFile(Revision, NULL, cache->Path, &file) ||
+        !RevQueryFileSize(Revision, NULL, cache->Path, file, &fileSize) ||
+        fileSize < sizeof(REVISION_CACHE_HEADER) ||
+        fileSize > (SIZE_T)-1 ||
+        !RevMapFile(Revision, NULL, cache->Path, file, (SIZE_T)fileSize, &view)) {
+        goto Exit;
+    }
+
+    /*
+     * N.B. Each count is bounded by the file size first, so that the size
+     * the counts add up to cannot overflow.
+     */
+    header = (const REVISION_CACHE_HEADER *)view;
+    if (header->Signature != REVISION_CACHE_SIGNATURE ||
+        header->Version != REVISION_CACHE_VERSION ||
+        header->LanguageTableHash != RevHashLanguageTable() ||
+        header->Flags != RevGetCacheFlags(Revision) ||
+        header->FilterHash != RevHashFilters(Revision) ||
+        header->CountOfEntries > fileSize / sizeof(REVISION_CACHE_ENTRY) ||
+        header->CountOfDirectories > fileSize / sizeof(REVISION_CACHE_DIRECTORY) ||
+        header->CountOfNameChars > fileSize / sizeof(PATHCHAR) ||
+        sizeof(REVISION_CACHE_HEADER) +
+            header->CountOfEntries * sizeof(REVISION_CACHE_ENTRY) +
+            header->CountOfDirectories * sizeof(REVISION_CACHE_DIRECTORY) +
+            header->CountOfNameChars * sizeof(PATHCHAR) != fileSize) {
+
+        RevLogWarning(Revision,
+                      "Ignoring the outdated or corrupt scan cache \"" PATH_FORMAT "\".",
+                      cache->Path);
+        RevUnmapFile(view, (SIZE_T)fileSize);
+        goto Exit;
+    }
+
+    cache->View = view;
+    cache->ViewSize = (SIZE_T)fileSize;
+    cache->Entries = (const REVISION_CACHE_ENTRY *)(view + sizeof(REVISION_CACHE_HEADER));
+    cache->CountOfEntries = header->CountOfEntries;
+    cache->Directories = (const REVISION_CACHE_DIRECTORY *)(cache->Entries +
+                                                             cache->CountOfEntries);
+    cache->CountOfDirectories = header->CountOfDirectories;
+    cache->Names = (const PATHCHAR *)(cache->Directories + cache->CountOfDirectories);
+    cache->CountOfNameChars = header->CountOfNameChars;
+
+    if (!RevValidateCache(cache)) {
+        RevLogWarning(Revision,
+                      "Ignoring the outdated or corrupt scan cache \"" PATH_FORMAT "\".",
+                      cache->Path);
+        RevUnmapFile(view, (SIZE_T)fileSize);
+        cache->View = NULL;
+        cache->ViewSize = 0;
+        cache->Entries = NULL;
+        cache->CountOfEntries = 0;
+        cache->Directories = NULL;
+        cache->CountOfDirectories = 0;
+        cache->Names = NULL;
+        cache->CountOfNameChars = 0;
+    }
+
+Exit:
+    if (file != INVALID_FILE_HANDLE) {
+        RevCloseFile(file);
+    }
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevValidateCache(
+    _In_ PREVISION_CACHE Cache
+    )
+{
+    const REVISION_CACHE_DIRECTORY *directory;
+    const PATHCHAR *name;
+    ULONGLONG index;
+    ULONGLONG countOfNames;
+
+    for (index = 0; index < Cache->CountOfEntries; ++index) {
+        if (Cache->Entries[index].LanguageId >= CountOfLanguages) {
+            return FALSE;
+        }
+    }
+
+    for (index = 0; index < Cache->CountOfDirectories; ++index) {
+        directory = &Cache->Directories[index];
+
+        if (directory->FirstEntry > Cache->CountOfEntries ||
+            directory->CountOfEntries > Cache->CountOfEntries - directory->FirstEntry ||
+            directory->FirstNameChar > Cache->CountOfNameChars ||
+            directory->CountOfNameChars > Cache->CountOfNameChars - directory->FirstNameChar) {
+            return FALSE;
+        }
+
+        /*
+         * The names are replayed up to their terminators, so there must be
+         * as many terminators as names, and the last name must have one.
+         */
+        countOfNames = 0;
+        for (name = Cache->Names + directory->FirstNameChar;
+             name < Cache->Names + directory->FirstNameChar + directory->CountOfNameChars;
+             ++name) {
+            if (*name == 0) {
+                countOfNames += 1;
+            }
+        }
+
+        if (countOfNames != directory->CountOfSubdirectories ||
+            (directory->CountOfNameChars > 0 &&
+             Cache->Names[directory->FirstNameChar + directory->CountOfNameChars - 1] != 0)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevSaveCache(
+    _Inout_ PREVISION Revision
+    )
+{
+    PREVISION_CACHE cache = &Revision->Cache;
+    PREVISION_CACHE_DIRECTORY directory;
+    PREVISION_CACHE_ENTRY entry;
+    REVISION_CACHE_HEADER header;
+    SIZE_T index;
+    SIZE_T entryIndex;
+    SIZE_T countOfEntries = 0;
+    SIZE_T countOfDirectories = 0;
+
+    /*
+     * N.B. Windows does not replace a file that is mapped, so release the
+     * loaded cache first. Every file that is still cached has been
+     * collected again by now.
+     */
+    if (cache->View != NULL) {
+        RevUnmapFile(cache->View, cache->ViewSize);
+        cache->View = NULL;
+        cache->ViewSize = 0;
+        cache->Entries = NULL;
+        cache->CountOfEntries = 0;
+        cache->Directories = NULL;
+        cache->CountOfDirectories = 0;
+        cache->Names = NULL;
+        cache->CountOfNameChars = 0;
+    }
+
+    /*
+     * Sort the entries and directories for the lookups of the next
+     * revision, dropping the duplicates of those reached twice.
+     */
+    if (cache->CountOfNewEntries > 0) {
+        qsort(cache->NewEntries,
+              cache->CountOfNewEntries,
+              sizeof(REVISION_CACHE_ENTRY),
+              RevCompareCacheEntries);
+    }
+
+    if (cache->CountOfNewDirectories > 0) {
+        qsort(cache->NewDirectories,
+              cache->CountOfNewDirectories,
+              sizeof(REVISION_CACHE_DIRECTORY),
+              RevCompareCacheDirectories);
+    }
+
+    for (index = 0; index < cache->CountOfNewDirectories; ++index) {
+        if (countOfDirectories == 0 ||
+            RevCompareCacheDirectories(&cache->NewDirectories[countOfDirectories - 1],
+                                       &cache->NewDirectories[index]) != 0) {
+            cache->NewDirectories[countOfDirectories++] = cache->NewDirectories[index];
+        }
+    }
+
+    cache->CountOfNewDirectories = countOfDirectories;
+
+    /*
+     * Both arrays are sorted by directory, so a single pass assigns each
+     * directory its entries. Entries of a directory that was not fully
+     * enumerated have no directory to be found through, and are dropped.
+     */
+    entryIndex = 0;
+    for (index = 0; index < countOfDirectories; ++index) {
+        directory = &cache->NewDirectories[index];
+
+        while (entryIndex < cache->CountOfNewEntries &&
+               (cache->NewEntries[entryIndex].DirectoryDevice < directory->Key.Device ||
+                (cache->NewEntries[entryIndex].DirectoryDevice == directory->Key.Device &&
+                 cache->NewEntries[entryIndex].DirectoryInode < directory->Key.Inode))) {
+            entryIndex += 1;
+        }
+
+        directory->FirstEntry = countOfEntries;
+
+        for (; entryIndex < cache->CountOfNewEntries; ++entryIndex) {
+            entry = &cache->NewEntries[entryIndex];
+            if (entry->DirectoryDevice != directory->Key.Device ||
+                entry->DirectoryInode != directory->Key.Inode) {
+                break;
+            }
+
+            if (countOfEntries == directory->FirstEntry ||
+                RevCompareCacheEntries(&cache->NewEntries[countOfEntries - 1], entry) != 0) {
+                cache->NewEntries[countOfEntries++] = *entry;
+            }
+        }
+
+        directory->CountOfEntries = countOfEntries - directory->FirstEntry;
+    }
+
+    cache->CountOfNewEntries = countOfEntries;
+
+    header.Signature = REVISION_CACHE_SIGNATURE;
+    header.Version = REVISION_CACHE_VERSION;
+    header.LanguageTableHash = RevHashLanguageTable();
+    header.Flags = RevGetCacheFlags(Revision);
+    header.FilterHash = RevHashFilters(Revision);
+    header.CountOfEntries = countOfEntries;
+    header.CountOfDirectories = countOfDirectories;
+    header.CountOfNameChars = cache->CountOfNewNameChars;
+
+    return RevWriteCacheFile(Revision,
+                             &header,
+                             cache->NewEntries,
+                             cache->NewDirectories,
+                             cache->NewNames);
+}
+
+ULONGLONG
+RevGetCacheFlags(
+    _In_ PREVISION Revision
+    )
+{
+    ULONGLONG flags = 0;
+
+    if (Revision->InitParams.FileList != NULL) {
+        flags = REVISION_CACHE_FLAG_FILE_LIST;
+    } else if (Revision->InitParams.IsGitIndexUsed) {
+        flags = REVISION_CACHE_FLAG_GIT_INDEX;
+    }
+
+    if (Revision->InitParams.IsContentDeduplicated) {
+        flags |= REVISION_CACHE_FLAG_CONTENT_HASH;
+    }
+
+    return flags;
+}
+
+VOID
+RevDeleteCache(
+    _Inout_ PREVISION Revision
+    )
+{
+    PREVISION_CACHE cache = &Revision->Cache;
+
+    if (cache->View != NULL) {
+        RevUnmapFile(cache->View, cache->ViewSize);
+        cache->View = NULL;
+    }
+
+    free(cache->NewEntries);
+    cache->NewEntries = NULL;
+    cache->CountOfNewEntries = 0;
+
+    free(cache->NewDirectories);
+    cache->NewDirectories = NULL;
+    cache->CountOfNewDirectories = 0;
+
+    free(cache->NewNames);
+    cache->NewNames = NULL;
+    cache->CountOfNewNameChars = 0;
+
+    free(cache->Path);
+    cache->Path = NULL;
+}
+
+ULONGLONG
+RevHashLanguageTable(
+    VOID
+    )
+{
+    ULONGLONG hash = 0xCBF29CE484222325ULL;
+    ULONG languageId;
+    PWCHAR name;
+
+    for (languageId = 0; languageId < CountOfLanguages; ++languageId) {
+        for (name = LanguageTable[languageId]; ; ++name) {
+            hash ^= (USHORT)*name;
+            hash *= 0x100000001B3ULL;
+
+            if (*name == L'\0') {
+                break;
+            }
+        }
+    }
+
+    return hash;
+}
+
+int
+RevCompareCacheEntries(
+    _In_ const void *Entry1,
+    _In_ const void *Entry2
+    )
+{
+    const REVISION_CACHE_ENTRY *entry1 = (const REVISION_CACHE_ENTRY *)Entry1;
+    const REVISION_CACHE_ENTRY *entry2 = (const REVISION_CACHE_ENTRY *)Entry2;
+
+    if (entry1->DirectoryDevice != entry2->DirectoryDevice) {
+        return entry1->DirectoryDevice < entry2->DirectoryDevice ? -1 : 1;
+    }
+
+    if (entry1->DirectoryInode != entry2->DirectoryInode) {
+        return entry1->DirectoryInode < entry2->DirectoryInode ? -1 : 1;
+    }
+
+    if (entry1->Key.Device != entry2->Key.Device) {
+        return entry1->Key.Device < entry2->Key.Device ? -1 : 1;
+    }
+
+    if (entry1->Key.Inode != entry2->Key.Inode) {
+        return entry1->Key.Inode < entry2->Key.Inode ? -1 : 1;
+    }
+
+    return 0;
+}
+
+int
+RevCompareCacheDirectories(
+    _In_ const void *Directory1,
+    _In_ const void *Directory2
+    )
+{
+    const REVISION_CACHE_KEY *key1 = &((const REVISION_CACHE_DIRECTORY *)Directory1)->Key;
+    const REVISION_CACHE_KEY *key2 = &((const REVISION_CACHE_DIRECTORY *)Directory2)->Key;
+
+    if (key1->Device != key2->Device) {
+        return key1->Device < key2->Device ? -1 : 1;
+    }
+
+    if (key1->Inode != key2->Inode) {
+        return key1->Inode < key2->Inode ? -1 : 1;
+    }
+
+    return 0;
+}
+
+_Ret_maybenull_
+const REVISION_CACHE_DIRECTORY *
+RevLookupCacheDirectory(
+    _In_ PREVISION_CACHE Cache,
+    _In_ PREVISION_CACHE_KEY CacheKey
+    )
+{
+    const REVISION_CACHE_DIRECTORY *directory;
+    ULONGLONG low = 0;
+    ULONGLONG high = Cache->CountOfDirectories;
+    ULONGLONG middle;
+
+    /*
+     * Find the first directory that does not sort before this one.
+     */
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        directory = &Cache->Directories[middle];
+
+        if (directory->Key.Device < CacheKey->Device ||
+            (directory->Key.Device == CacheKey->Device &&
+             directory->Key.Inode < CacheKey->Inode)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == Cache->CountOfDirectories) {
+        return NULL;
+    }
+
+    directory = &Cache->Directories[low];
+    if (directory->Key.Device != CacheKey->Device ||
+        directory->Key.Inode != CacheKey->Inode) {
+        return NULL;
+    }
+
+    return directory;
+}
+
+_Ret_maybenull_
+const REVISION_CACHE_ENTRY *
+RevLookupCache(
+    _In_ PREVISION_CACHE Cache,
+    _In_ const REVISION_CACHE_DIRECTORY *CachedDirectory,
+    _In_ PREVISION_CACHE_KEY CacheKey
+    )
+{
+    const REVISION_CACHE_ENTRY *entry;
+    ULONGLONG low = CachedDirectory->FirstEntry;
+    ULONGLONG high = CachedDirectory->FirstEntry + CachedDirectory->CountOfEntries;
+    ULONGLONG end = high;
+    ULONGLONG middle;
+
+    /*
+     * Find the first entry of the directory that does not sort before the
+     * file.
+     */
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        entry = &Cache->Entries[middle];
+
+        if (entry->Key.Device < CacheKey->Device ||
+            (entry->Key.Device == CacheKey->Device &&
+             entry->Key.Inode < CacheKey->Inode)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == end) {
+        return NULL;
+    }
+
+    entry = &Cache->Entries[low];
+    if (entry->Key.Device != CacheKey->Device ||
+        entry->Key.Inode != CacheKey->Inode ||
+        entry->Key.Size != CacheKey->Size ||
+        entry->Key.ModificationTime != CacheKey->ModificationTime) {
+        return NULL;
+    }
+
+    return entry;
+}
+
+_Must_inspect_result_
+BOOL
+RevReviseCachedFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR FileName,
+    _In_ PREVISION_RECORD_EXTENSION_MAPPING Mapping,
+    _In_ PREVISION_CACHE_KEY CacheKey
+    )
+{
+    const REVISION_CACHE_ENTRY *entry;
+    REVISION_FILE_BUFFER file = {0};
+
+    if (Directory->CachedDirectory == NULL) {
+        return FALSE;
+    }
+
+    entry = RevLookupCache(&Worker->Revision->Cache, Directory->CachedDirectory, CacheKey);
+    if (entry == NULL) {
+        return FALSE;
+    }
+
+    if (Mapping->LanguageId != entry->LanguageId) {
+        return FALSE;
+    }
+
+    /*
+     * The file never enters the pipeline. It is recorded as if it had
+     * been counted, which also carries it over to the new cache.
+     */
+    file.Directory = Directory;
+    file.FileName = FileName;
+    file.Mapping = Mapping;
+    file.CacheEntry = *entry;
+    file.HasCacheKey = TRUE;
+    file.ContentHash = entry->ContentHash;
+    file.HasContentHash = Worker->Revision->InitParams.IsContentDeduplicated;
+
+    RevRecordFileLines(Worker,
+                       &file,
+                       entry->CountOfLinesTotal,
+                       entry->CountOfLinesBlank,
+                       entry->CountOfLinesComment);
+
+    Worker->CountOfCachedFiles += 1;
+
+    return TRUE;
+}
+
+_Ret_maybenull_
+const REVISION_CACHE_DIRECTORY *
+RevQueryCachedDirectory(
+    _In_ PREVISION Revision,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    /*
+     * N.B. The version of the directory has been queried when it was
+     * claimed, unless that failed.
+     */
+    if (Revision->Cache.Path == NULL ||
+        (Directory->DeviceIndex == 0 && !RevQueryDirectoryKey(Revision, Directory))) {
+        return NULL;
+    }
+
+    Directory->HasCacheKey = TRUE;
+
+    /*
+     * N.B. The record is kept even if the directory has changed since, as
+     * its unchanged files can still be taken from the cache.
+     */
+    Directory->CachedDirectory = RevLookupCacheDirectory(&Revision->Cache,
+                                                         &Directory->CacheKey);
+
+    return Directory->CachedDirectory;
+}
+
+_Must_inspect_result_
+BOOL
+RevReviseCachedDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION revision = Worker->Revision;
+    const REVISION_CACHE_DIRECTORY *cachedDirectory;
+    const REVISION_CACHE_ENTRY *entry;
+    SIZE_T entryBlockSize;
+    PREVISION_ENTRY_BLOCK entryBlock;
+    PREVISION_DIRECTORY directory;
+    PPATHCHAR name;
+    ULONGLONG index;
+
+    cachedDirectory = RevQueryCachedDirectory(revision, Directory);
+    if (cachedDirectory == NULL ||
+        !revision->InitParams.IsDirectoryTimeTrusted ||
+        revision->InitParams.FileCallback != NULL ||
+        cachedDirectory->Key.Size != Directory->CacheKey.Size ||
+        cachedDirectory->Key.ModificationTime != Directory->CacheKey.ModificationTime ||
+        cachedDirectory->CountOfEntries != cachedDirectory->CountOfFiles) {
+        return FALSE;
+    }
+
+    /*
+     * The subdirectories need an entry block like enumerated ones. If it
+     * cannot be allocated, the directory is simply enumerated.
+     */
+    entryBlockSize = sizeof(REVISION_ENTRY_BLOCK) +
+                     (SIZE_T)cachedDirectory->CountOfSubdirectories * sizeof(REVISION_DIRECTORY) +
+                     (SIZE_T)cachedDirectory->CountOfNameChars * sizeof(PATHCHAR);
+
+    entryBlock = (PREVISION_ENTRY_BLOCK)malloc(entryBlockSize);
+    if (entryBlock == NULL) {
+        return FALSE;
+    }
+
+    Worker->CountOfAllocations += 1;
+
+    entryBlock->Next = Directory->EntryBlocks;
+    entryBlock->CountOfDirectories = (ULONG)cachedDirectory->CountOfSubdirectories;
+    Directory->EntryBlocks = entryBlock;
+
+    Worker->CountOfDirectories += 1;
+    Worker->CountOfIgnoredFiles += (ULONG)cachedDirectory->CountOfIgnoredFiles;
+    Worker->CountOfCachedDirectories += 1;
+
+    for (index = 0; index < cachedDirectory->CountOfEntries; ++index) {
+        entry = &revision->Cache.Entries[cachedDirectory->FirstEntry + index];
+
+        /*
+         * A file reached again through a link is still cached under this
+         * directory, or it would be missing from the next cache.
+         */
+        if (!RevClaimFile(Worker,
+                          entry->Key.Device == Directory->CacheKey.Device ?
+                              Directory->DeviceIndex :
+                              RevQueryDeviceIndex(&revision->IdentitySet, entry->Key.Device),
+                          entry->Key.Inode)) {
+            RevAppendCacheEntry(Worker, entry);
+            continue;
+        }
+
+        if (!revision->InitParams.IsContentDeduplicated ||
+            RevClaimContent(Worker,
+                            (ULONG)entry->LanguageId,
+                            entry->ContentHash,
+                            entry->CountOfLinesTotal,
+                            entry->CountOfLinesBlank,
+                            entry->CountOfLinesComment)) {
+
+            RevAddFileLines(Worker,
+                            (ULONG)entry->LanguageId,
+                            entry->CountOfLinesTotal,
+                            entry->CountOfLinesBlank,
+                            entry->CountOfLinesComment);
+        }
+
+        RevAppendCacheEntry(Worker, entry);
+    }
+
+    Worker->CountOfCachedFiles += (ULONG)cachedDirectory->CountOfEntries;
+
+    directory = entryBlock->Directories;
+    name = (PPATHCHAR)(entryBlock->Directories + cachedDirectory->CountOfSubdirectories);
+
+    /*
+     * N.B. A cache that holds no names at all has no name buffer either.
+     */
+    if (cachedDirectory->CountOfNameChars > 0) {
+        memcpy(name,
+               revision->Cache.Names + cachedDirectory->FirstNameChar,
+               (SIZE_T)cachedDirectory->CountOfNameChars * sizeof(PATHCHAR));
+    }
+
+    for (index = 0; index < cachedDirectory->CountOfSubdirectories; ++index) {
+        RevInitializeDirectory(directory, Directory, name);
+        RevScheduleTask(Worker,
+                        RevisionTaskDirectory,
+                        directory,
+                        name);
+
+        directory += 1;
+        name += RevPathLength(name) + 1;
+    }
+
+    RevAppendCacheDirectory(Worker,
+                            Directory,
+                            (ULONG)cachedDirectory->CountOfFiles,
+                            (ULONG)cachedDirectory->CountOfIgnoredFiles);
+
+    return TRUE;
+}
+
+VOID
+RevAppendCacheEntry(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ const REVISION_CACHE_ENTRY *Entry
+    )
+{
+    if (!RevReserveCacheRoom((PVOID *)&Worker->CacheEntries,
+                             &Worker->CacheEntriesCapacity,
+                             Worker->CountOfCacheEntries + 1,
+                             sizeof(REVISION_CACHE_ENTRY))) {
+        return;
+    }
+
+    Worker->CacheEntries[Worker->CountOfCacheEntries++] = *Entry;
+}
+
+VOID
+RevAppendCacheDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_ ULONG CountOfFiles,
+    _In_ ULONG CountOfIgnoredFiles
+    )
+{
+    PREVISION_ENTRY_BLOCK entryBlock;
+    PREVISION_CACHE_DIRECTORY cacheDirectory;
+    PPATHCHAR name;
+    SIZE_T nameLength;
+    SIZE_T countOfNameChars = 0;
+    ULONG countOfSubdirectories = 0;
+    ULONG index;
+
+    for (entryBlock = Directory->EntryBlocks; entryBlock != NULL; entryBlock = entryBlock->Next) {
+        for (index = 0; index < entryBlock->CountOfDirectories; ++index) {
+            countOfNameChars += RevPathLength(entryBlock->Directories[index].Name) + 1;
+        }
+
+        countOfSubdirectories += entryBlock->CountOfDirectories;
+    }
+
+    if (!RevReserveCacheRoom((PVOID *)&Worker->CacheNames,
+                             &Worker->CacheNamesCapacity,
+                             Worker->CountOfCacheNameChars + countOfNameChars,
+                             sizeof(PATHCHAR)) ||
+        !RevReserveCacheRoom((PVOID *)&Worker->CacheDirectories,
+                             &Worker->CacheDirectoriesCapacity,
+                             Worker->CountOfCacheDirectories + 1,
+                             sizeof(REVISION_CACHE_DIRECTORY))) {
+        return;
+    }
+
+    /*
+     * The entries of the directory are assigned to it when the cache is
+     * saved, once every file has been counted.
+     */
+    cacheDirectory = &Worker->CacheDirectories[Worker->CountOfCacheDirectories++];
+    cacheDirectory->Key = Directory->CacheKey;
+    cacheDirectory->FirstEntry = 0;
+    cacheDirectory->CountOfEntries = 0;
+    cacheDirectory->CountOfFiles = CountOfFiles;
+    cacheDirectory->CountOfIgnoredFiles = CountOfIgnoredFiles;
+    cacheDirectory->FirstNameChar = Worker->CountOfCacheNameChars;
+    cacheDirectory->CountOfNameChars = countOfNameChars;
+    cacheDirectory->CountOfSubdirectories = countOfSubdirectories;
+
+    name = Worker->CacheNames + Worker->CountOfCacheNameChars;
+    for (entryBlock = Directory->EntryBlocks; entryBlock != NULL; entryBlock = entryBlock->Next) {
+        for (index = 0; index < entryBlock->CountOfDirectories; ++index) {
+            nameLength = RevPathLength(entryBlock->Directories[index].Name) + 1;
+            memcpy(name, entryBlock->Directories[index].Name, nameLength * sizeof(PATHCHAR));
+            name += nameLength;
+        }
+    }
+
+    Worker->CountOfCacheNameChars += countOfNameChars;
+}
+
+_Must_inspect_result_
+BOOL
+RevReserveCacheRoom(
+    _Inout_ PVOID *Array,
+    _Inout_ PSIZE_T Capacity,
+    _In_ SIZE_T Count,
+    _In_ SIZE_T ElementSize
+    )
+{
+    PVOID array;
+    SIZE_T capacity;
+
+    if (Count <= *Capacity) {
+        return TRUE;
+    }
+
+    capacity = *Capacity != 0 ? *Capacity : REVISION_CACHE_INITIAL_CAPACITY;
+    while (capacity < Count) {
+        capacity *= 2;
+    }
+
+    array = realloc(*Array, capacity * ElementSize);
+    if (array == NULL) {
+        return FALSE;
+    }
+
+    *Array = array;
+    *Capacity = capacity;
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevEnumerateGitIndex(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    BOOL status = TRUE;
+    PREVISION revision = Worker->Revision;
+    REVISION_GIT_INDEX index;
+    REVISION_GIT_INDEX_ENTRY entry;
+    SIZE_T entryBlockSize;
+    PREVISION_ENTRY_BLOCK entryBlock;
+    PPATHCHAR name;
+    SIZE_T nameLength;
+    ULONG countOfFiles = 0;
+    ULONG countOfIgnoredFiles = 0;
+
+    Worker->CountOfDirectories += 1;
+
+    if (!RevOpenGitIndex(revision, Directory, &index)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Every file is cached under the root directory, whose record is only
+     * used for the lookups: it never changes when a file deeper in the
+     * tree is added or removed, so it is never replayed.
+     */
+    (VOID)RevQueryCachedDirectory(revision, Directory);
+
+    /*
+     * The paths of the files are copied into a single entry block, sized
+     * by the check of the index.
+     */
+    entryBlockSize = sizeof(REVISION_ENTRY_BLOCK) +
+                     index.CountOfPathChars * sizeof(PATHCHAR);
+
+    entryBlock = (PREVISION_ENTRY_BLOCK)malloc(entryBlockSize);
+    if (entryBlock == NULL) {
+        RevLogError(revision,
+                    "Failed to allocate the entry block (%llu bytes).",
+                    (ULONGLONG)entryBlockSize);
+        status = FALSE;
+        goto Exit;
+    }
+
+    Worker->CountOfAllocations += 1;
+
+    entryBlock->Next = Directory->EntryBlocks;
+    entryBlock->CountOfDirectories = 0;
+    Directory->EntryBlocks = entryBlock;
+
+    name = (PPATHCHAR)entryBlock->Directories;
+
+    while (RevReadGitIndexEntry(&index, &entry)) {
+
+        /*
+         * Only files checked out in the work tree are revised: neither
+         * submodules nor entries outside of a sparse checkout. An unmerged
+         * path has an entry for each stage, but is revised once.
+         */
+        if (((entry.Mode & REVISION_GIT_MODE_TYPE_MASK) != REVISION_GIT_MODE_REGULAR &&
+             (entry.Mode & REVISION_GIT_MODE_TYPE_MASK) != REVISION_GIT_MODE_SYMLINK) ||
+            entry.IsSkipWorktree ||
+            entry.IsRepeatedPath) {
+            continue;
+        }
+
+        if (!RevConvertUtf8Path(entry.Path, entry.PathLength, name, &nameLength)) {
+            RevLogWarning(revision,
+                          "Failed to convert the path \"%.*s\" of the git index.",
+                          (int)entry.PathLength,
+                          entry.Path);
+            Worker->CountOfIgnoredFiles += 1;
+            countOfIgnoredFiles += 1;
+            continue;
+        }
+
+        if (!RevSubmitListedFile(Worker, Directory, name)) {
+            countOfIgnoredFiles += 1;
+            continue;
+        }
+
+        countOfFiles += 1;
+
+        name += nameLength + 1;
+    }
+
+    if (index.EntryIndex != index.CountOfEntries) {
+        RevLogError(revision,
+                    "Failed to read the entry #%lu of the git index.",
+                    index.EntryIndex);
+        status = FALSE;
+        goto Exit;
+    }
+
+    if (Directory->HasCacheKey) {
+        RevAppendCacheDirectory(Worker, Directory, countOfFiles, countOfIgnoredFiles);
+    }
+
+Exit:
+    RevCloseGitIndex(&index);
+
+    return status;
+}
+
+_Ret_maybenull_
+_Must_inspect_result_
+PPATHCHAR
+RevLocateGitIndex(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_DIRECTORY Directory
+    )
+{
+    PPATHCHAR indexPath = NULL;
+    PPATHCHAR gitDirectory = NULL;
+    PPATHCHAR linkPath = NULL;
+    PPATHCHAR path;
+    BOOL isDirectory;
+    FILEHANDLE file = INVALID_FILE_HANDLE;
+    CHAR link[REVISION_GIT_LINK_SIZE];
+    SIZE_T bytesRead;
+    SIZE_T linkLength;
+    SIZE_T pathLength;
+    BOOL isAbsolute;
+
+    if (!RevQueryIsDirectory(Directory, PATH_TEXT(".git"), &isDirectory)) {
+        path = RevBuildPath(Directory->Parent, Directory->Name);
+        RevLogError(Revision,
+                    "The directory \"" PATH_FORMAT "\" is not a git work tree.",
+                    path);
+        free(path);
+        goto Exit;
+    }
+
+    if (isDirectory) {
+        gitDirectory = RevBuildPath(Directory, PATH_TEXT(".git"));
+    } else {
+
+        /*
+         * A .git file holds "gitdir: " and the path of the git directory,
+         * absolute or relative to the work tree.
+         */
+        if (!RevOpenFile(Revision, Directory, PATH_TEXT(".git"), &file) ||
+            !RevReadFileChunk(Revision,
+                              Directory,
+                              PATH_TEXT(".git"),
+                              file,
+                              link,
+                              sizeof(link) - 1,
+                              &bytesRead)) {
+            goto Exit;
+        }
+
+        link[bytesRead] = '\0';
+
+        if (strncmp(link, "gitdir: ", sizeof("gitdir: ") - 1) != 0) {
+            path = RevBuildPath(Directory, PATH_TEXT(".git"));
+            RevLogError(Revision,
+                        "The file \"" PATH_FORMAT "\" does not link to a git directory.",
+                        path);
+            free(path);
+            goto Exit;
+        }
+
+        linkLength = strcspn(link + sizeof("gitdir: ") - 1, "\r\n");
+
+        linkPath = (PPATHCHAR)malloc((linkLength + 1) * sizeof(PATHCHAR));
+        if (linkPath == NULL ||
+            !RevConvertUtf8Path(link + sizeof("gitdir: ") - 1, linkLength, linkPath, &pathLength) ||
+            pathLength == 0) {
+            RevLogError(Revision,
+                        "Failed to convert the git directory path \"%.*s\".",
+                        (int)linkLength,
+                        link + sizeof("gitdir: ") - 1);
+            goto Exit;
+        }
+
+#ifdef _WIN32
+        isAbsolute = linkPath[0] == L'\\' || linkPath[1] == L':';
+#else
+        isAbsolute = linkPath[0] == '/';
+#endif
+        if (isAbsolute) {
+            gitDirectory = linkPath;
+            linkPath = NULL;
+        } else {
+            gitDirectory = RevBuildPath(Directory, linkPath);
+        }
+    }
+
+    if (gitDirectory == NULL) {
+        goto Exit;
+    }
+
+    pathLength = RevPathLength(gitDirectory);
+    indexPath = (PPATHCHAR)malloc((pathLength + sizeof("/index")) * sizeof(PATHCHAR));
+    if (indexPath == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate string buffer (%llu bytes).",
+                    (ULONGLONG)((pathLength + sizeof("/index")) * sizeof(PATHCHAR)));
+        goto Exit;
+    }
+
+    memcpy(indexPath, gitDirectory, pathLength * sizeof(PATHCHAR));
+    indexPath[pathLength] = PATH_SEPARATOR;
+    memcpy(indexPath + pathLength + 1, PATH_TEXT("index"), sizeof(PATH_TEXT("index")));
+
+Exit:
+    if (file != INVALID_FILE_HANDLE) {
+        RevCloseFile(file);
+    }
+
+    free(linkPath);
+    free(gitDirectory);
+
+    return indexPath;
+}
+
+_Must_inspect_result_
+BOOL
+RevOpenGitIndex(
+    _In_ PREVISION Revision,
+    _In_ PREVISION_DIRECTORY Directory,
+    _Out_ PREVISION_GIT_INDEX Index
+    )
+{
+    BOOL status = TRUE;
+    PPATHCHAR indexPath;
+    FILEHANDLE file = INVALID_FILE_HANDLE;
+    ULONGLONG fileSize;
+    const CHAR *view;
+
+    memset(Index, 0, sizeof(*Index));
+
+    indexPath = RevLocateGitIndex(Revision, Directory);
+    if (indexPath == NULL) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * The whole index is read once, sequentially, through a view.
+     */
+    if (!RevOpenFile(Revision, NULL, indexPath, &file) ||
+        !RevQueryFileSize(Revision, NULL, indexPath, file, &fileSize)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    if (fileSize < REVISION_GIT_INDEX_HEADER_SIZE + REVISION_GIT_SHA1_SIZE ||
+        fileSize > (SIZE_T)-1 ||
+        !RevMapFile(Revision, NULL, indexPath, file, (SIZE_T)fileSize, &view)) {
+        RevLogError(Revision,
+                    "Failed to read the git index \"" PATH_FORMAT "\".",
+                    indexPath);
+        status = FALSE;
+        goto Exit;
+    }
+
+    Index->View = (const UCHAR *)view;
+    Index->Size = (SIZE_T)fileSize;
+    Index->Version = RevReadBigEndian32(Index->View + 4);
+    Index->CountOfEntries = RevReadBigEndian32(Index->View + 8);
+
+    if (RevReadBigEndian32(Index->View) != REVISION_GIT_INDEX_SIGNATURE ||
+        Index->Version < REVISION_GIT_INDEX_MIN_VERSION ||
+        Index->Version > REVISION_GIT_INDEX_MAX_VERSION) {
+        RevLogError(Revision,
+                    "The git index \"" PATH_FORMAT "\" is not an index of version "
+                    "2, 3 or 4.",
+                    indexPath);
+        status = FALSE;
+        goto Exit;
+    }
+
+    if (!RevCheckGitIndex(Index, REVISION_GIT_SHA1_SIZE) &&
+        !RevCheckGitIndex(Index, REVISION_GIT_SHA256_SIZE)) {
+        RevLogError(Revision,
+                    "The git index \"" PATH_FORMAT "\" is corrupt, or split, which "
+                    "is not supported.",
+                    indexPath);
+        status = FALSE;
+        goto Exit;
+    }
+
+    RevRewindGitIndex(Index);
+
+Exit:
+    if (file != INVALID_FILE_HANDLE) {
+        RevCloseFile(file);
+    }
+
+    free(indexPath);
+
+    return status;
+}
+
+_Must_inspect_result_
+BOOL
+RevCheckGitIndex(
+    _Inout_ PREVISION_GIT_INDEX Index,
+    _In_ ULONG ObjectIdSize
+    )
+{
+    REVISION_GIT_INDEX_ENTRY entry;
+    SIZE_T offset;
+    SIZE_T end;
+    ULONG extensionSize;
+
+    if (Index->Size < REVISION_GIT_INDEX_HEADER_SIZE + ObjectIdSize) {
+        return FALSE;
+    }
+
+    Index->ObjectIdSize = ObjectIdSize;
+    Index->CountOfPathChars = 0;
+
+    RevRewindGitIndex(Index);
+
+    while (RevReadGitIndexEntry(Index, &entry)) {
+        Index->CountOfPathChars += entry.PathLength + 1;
+    }
+
+    if (Index->EntryIndex != Index->CountOfEntries) {
+        return FALSE;
+    }
+
+    /*
+     * The extensions, each a signature and a size, must end exactly at the
+     * checksum of the index.
+     */
+    offset = Index->Offset;
+    end = Index->Size - ObjectIdSize;
+
+    while (offset < end) {
+        if (end - offset < 8) {
+            return FALSE;
+        }
+
+        if (RevReadBigEndian32(Index->View + offset) == REVISION_GIT_EXTENSION_LINK) {
+            return FALSE;
+        }
+
+        extensionSize = RevReadBigEndian32(Index->View + offset + 4);
+        if (extensionSize > end - offset - 8) {
+            return FALSE;
+        }
+
+        offset += 8 + (SIZE_T)extensionSize;
+    }
+
+    return offset == end;
+}
+
+VOID
+RevRewindGitIndex(
+    _Inout_ PREVISION_GIT_INDEX Index
+    )
+{
+    Index->Offset = REVISION_GIT_INDEX_HEADER_SIZE;
+    Index->EntryIndex = 0;
+    Index->PathLength = 0;
+}
+
+_Must_inspect_result_
+BOOL
+RevReadGitIndexEntry(
+    _Inout_ PREVISION_GIT_INDEX Index,
+    _Out_ PREVISION_GIT_INDEX_ENTRY Entry
+    )
+{
+    const UCHAR *entry;
+    const UCHAR *name;
+    const UCHAR *nameEnd;
+    const UCHAR *end;
+    SIZE_T nameOffset;
+    SIZE_T nameLength;
+    SIZE_T prefixLength;
+    SIZE_T pathLength;
+    SIZE_T entrySize;
+    SIZE_T stripLength;
+    SIZE_T capacity;
+    PCHAR path;
+    ULONG flags;
+    ULONG extendedFlags = 0;
+    UCHAR byte;
+
+    if (Index->EntryIndex == Index->CountOfEntries) {
+        return FALSE;
+    }
+
+    /*
+     * An entry never extends into the checksum that ends the index.
+     */
+    end = Index->View + Index->Size - Index->ObjectIdSize;
+    entry = Index->View + Index->Offset;
+    nameOffset = REVISION_GIT_ENTRY_OBJECT_ID_OFFSET + Index->ObjectIdSize + 2;
+
+    if (Index->Offset > (SIZE_T)(end - Index->View) ||
+        (SIZE_T)(end - entry) < nameOffset) {
+        return FALSE;
+    }
+
+    flags = RevReadBigEndian16(entry + nameOffset - 2);
+    if (flags & REVISION_GIT_FLAG_EXTENDED) {
+        if (Index->Version < 3 ||
+            (SIZE_T)(end - entry) < nameOffset + 2) {
+            return FALSE;
+        }
+
+        extendedFlags = RevReadBigEndian16(entry + nameOffset);
+        nameOffset += 2;
+    }
+
+    name = entry + nameOffset;
+
+    /*
+     * From version 4, the path starts with the number of bytes to strip
+     * from the end of the previous path, in the variable-length encoding
+     * of git, followed by the bytes to append. Earlier paths are whole.
+     */
+    stripLength = 0;
+    if (Index->Version >= 4) {
+        if (name == end) {
+            return FALSE;
+        }
+
+        byte = *name++;
+        stripLength = byte & 0x7F;
+        while (byte & 0x80) {
+            if (name == end || stripLength >= Index->PathLength) {
+                return FALSE;
+            }
+
+            byte = *name++;
+            stripLength = ((stripLength + 1) << 7) | (byte & 0x7F);
+        }
+
+        if (stripLength > Index->PathLength) {
+            return FALSE;
+        }
+    }
+
+    nameEnd = (const UCHAR *)memchr(name, '\0', (SIZE_T)(end - name));
+    if (nameEnd == NULL) {
+        return FALSE;
+    }
+
+    nameLength = (SIZE_T)(nameEnd - name);
+    prefixLength = Index->Version >= 4 ? Index->PathLength - stripLength : 0;
+    pathLength = prefixLength + nameLength;
+
+    if (Index->Version < 4) {
+        if ((flags & REVISION_GIT_FLAG_NAME_MASK) != REVISION_GIT_FLAG_NAME_MASK ?
+                (flags & REVISION_GIT_FLAG_NAME_MASK) != nameLength :
+                nameLength < REVISION_GIT_FLAG_NAME_MASK) {
+            return FALSE;
+        }
+
+        /*
+         * The entry is padded with 1 to 8 zero bytes to a multiple of 8.
+         */
+        entrySize = (nameOffset + nameLength + 8) & ~(SIZE_T)7;
+        if (entrySize > (SIZE_T)(end - entry)) {
+            return FALSE;
+        }
+    } else {
+        entrySize = (SIZE_T)(nameEnd + 1 - entry);
+    }
+
+    if (pathLength + 1 > Index->PathCapacity) {
+        capacity = Index->PathCapacity != 0 ? Index->PathCapacity : 256;
+        while (capacity < pathLength + 1) {
+            capacity *= 2;
+        }
+
+        path = (PCHAR)realloc(Index->Path, capacity);
+        if (path == NULL) {
+            return FALSE;
+        }
+
+        Index->Path = path;
+        Index->PathCapacity = capacity;
+    }
+
+    Entry->IsRepeatedPath = Index->EntryIndex != 0 &&
+                            pathLength == Index->PathLength &&
+                            memcmp(Index->Path + prefixLength, name, nameLength) == 0;
+
+    memcpy(Index->Path + prefixLength, name, nameLength);
+    Index->Path[pathLength] = '\0';
+    Index->PathLength = pathLength;
+
+    Entry->Path = Index->Path;
+    Entry->PathLength = pathLength;
+    Entry->Mode = RevReadBigEndian32(entry + REVISION_GIT_ENTRY_MODE_OFFSET);
+    Entry->Stage = (flags & REVISION_GIT_FLAG_STAGE_MASK) >> REVISION_GIT_FLAG_STAGE_SHIFT;
+    Entry->ObjectId = entry + REVISION_GIT_ENTRY_OBJECT_ID_OFFSET;
+    Entry->IsSkipWorktree = (extendedFlags & REVISION_GIT_EXTENDED_SKIP_WORKTREE) != 0;
+
+    Index->Offset += entrySize;
+    Index->EntryIndex += 1;
+
+    return TRUE;
+}
+
+VOID
+RevCloseGitIndex(
+    _Inout_ PREVISION_GIT_INDEX Index
+    )
+{
+    if (Index->View != NULL) {
+        RevUnmapFile((const CHAR *)Index->View, Index->Size);
+        Index->View = NULL;
+    }
+
+    free(Index->Path);
+    Index->Path = NULL;
+    Index->PathCapacity = 0;
+}
+
+_Must_inspect_result_
+BOOL
+RevConvertUtf8Path(
+    _In_reads_(PathLength) const CHAR *Path,
+    _In_ SIZE_T PathLength,
+    _Out_writes_(PathLength + 1) PPATHCHAR Buffer,
+    _Out_ PSIZE_T NativePathLength
+    )
+{
+#ifdef _WIN32
+    int length = 0;
+    int index;
+
+    if (PathLength > INT_MAX) {
+        return FALSE;
+    }
+
+    if (PathLength > 0) {
+        length = MultiByteToWideChar(CP_UTF8,
+                                     MB_ERR_INVALID_CHARS,
+                                     Path,
+                                     (int)PathLength,
+                                     Buffer,
+                                     (int)PathLength);
+        if (length == 0) {
+            return FALSE;
+        }
+    }
+
+    for (index = 0; index < length; ++index) {
+        if (Buffer[index] == L'/') {
+            Buffer[index] = PATH_SEPARATOR;
+        }
+    }
+
+    Buffer[length] = L'\0';
+    *NativePathLength = (SIZE_T)length;
+#else
+    memcpy(Buffer, Path, PathLength);
+    Buffer[PathLength] = '\0';
+    *NativePathLength = PathLength;
+#endif
+
+    return TRUE;
+}
+
+BOOL
+RevIsPathWithinDirectory(
+    _In_z_ PPATHCHAR Path
+    )
+{
+    PPATHCHAR component = Path;
+    SIZE_T length;
+
+#ifdef _WIN32
+    if (Path[0] == L'\\' || (Path[0] != L'\0' && Path[1] == L':')) {
+        return FALSE;
+    }
+#else
+    if (Path[0] == '/') {
+        return FALSE;
+    }
+#endif
+
+    for (;;) {
+        for (length = 0;
+             component[length] != PATH_TEXT('\0') && component[length] != PATH_SEPARATOR;
+             ++length) {
+        }
+
+        if (length == 2 && component[0] == PATH_TEXT('.') && component[1] == PATH_TEXT('.')) {
+            return FALSE;
+        }
+
+        if (component[length] == PATH_TEXT('\0')) {
+            return TRUE;
+        }
+
+        component += length + 1;
+    }
+}
+
+BOOL
+RevSubmitListedFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory,
+    _In_z_ PPATHCHAR Path
+    )
+{
+    PREVISION revision = Worker->Revision;
+    PPATHCHAR baseName;
+    PREVISION_RECORD_EXTENSION_MAPPING mapping;
+    ULONG deviceIndex;
+    ULONGLONG inode;
+#ifdef _WIN32
+    REVISION_CACHE_KEY fileKey;
+#else
+    struct stat fileStat;
+#endif
+
+    /*
+     * N.B. A listed path is opened relative to the root directory, but
+     * would be opened all the same if it were absolute or went up with a
+     * ".." component. Neither is within the root, so both are ignored.
+     */
+    if (!RevIsPathWithinDirectory(Path)) {
+        RevLogWarning(revision,
+                      "Ignoring the listed path \"" PATH_FORMAT "\", which "
+                      "is not within the root directory.",
+                      Path);
+        Worker->CountOfIgnoredFiles += 1;
+        return FALSE;
+    }
+
+    if ((revision->ExcludePatterns != NULL || revision->IncludePatterns != NULL) &&
+        RevIsPathExcluded(Worker, Path)) {
+        Worker->CountOfExcludedFiles += 1;
+        return FALSE;
+    }
+
+    /*
+     * It is enough to check the name of the file, the same way the
+     * enumeration does.
+     */
+#ifdef _WIN32
+    baseName = wcsrchr(Path, PATH_SEPARATOR);
+#else
+    baseName = strrchr(Path, PATH_SEPARATOR);
+#endif
+    baseName = baseName != NULL ? baseName + 1 : Path;
+
+    mapping = RevLookupFileName(baseName);
+    if (mapping == NULL) {
+
+        /* Increment the total count of ignored files. */
+        Worker->CountOfIgnoredFiles += 1;
+        return FALSE;
+    }
+
+#ifndef _WIN32
+    /*
+     * N.B. Unlike an enumerated entry, a listed path comes without its type,
+     * and a FIFO or a device in its place would block the reader forever.
+     * Only regular files, or links to them, are opened. On Windows, the
+     * file is opened as a non-directory file, which cannot block.
+     */
+    if (fstatat(Directory->Handle, Path, &fileStat, 0) != 0 ||
+        !S_ISREG(fileStat.st_mode)) {
+
+        /*
+         * A listed path was named by the caller, so it is worth a warning.
+         * A tracked path may just be checked out as something else.
+         */
+        if (revision->InitParams.FileList != NULL) {
+            RevLogWarning(revision,
+                          "Ignoring the listed path \"" PATH_FORMAT "\", which "
+                          "is not a regular file.",
+                          Path);
+        }
+
+        Worker->CountOfIgnoredFiles += 1;
+        return FALSE;
+    }
+
+    deviceIndex = RevQueryDeviceIndex(&revision->IdentitySet, (ULONGLONG)fileStat.st_dev);
+    inode = (ULONGLONG)fileStat.st_ino;
+#else
+    if (!RevQueryFileKey(revision, Directory, Path, &fileKey)) {
+        Worker->CountOfIgnoredFiles += 1;
+        return FALSE;
+    }
+
+    deviceIndex = RevQueryDeviceIndex(&revision->IdentitySet, fileKey.Device);
+    inode = fileKey.Inode;
+#endif
+
+    /*
+     * A path listed twice, or another link to a file listed already, is
+     * counted once, the same as during the enumeration.
+     */
+    if (!RevClaimFile(Worker, deviceIndex, inode)) {
+        return FALSE;
+    }
+
+    RevSubmitFile(Worker, Directory, Path, mapping);
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevEnumerateFileList(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    BOOL status = TRUE;
+    PREVISION revision = Worker->Revision;
+    PPATHCHAR listPath = NULL;
+    FILEHANDLE file = INVALID_FILE_HANDLE;
+    BOOL isStandardInput;
+    PCHAR block = NULL;
+    SIZE_T carriedSize = 0;
+    SIZE_T bytesRead;
+    SIZE_T blockSize;
+    SIZE_T parsedSize;
+    SIZE_T entryBlockSize;
+    PREVISION_ENTRY_BLOCK entryBlock;
+    PPATHCHAR firstName;
+    PPATHCHAR name;
+    SIZE_T nameLength;
+    PCHAR path;
+    PCHAR pathEnd;
+    PCHAR end;
+    SIZE_T pathLength;
+    CHAR separator;
+    BOOL isEnd = FALSE;
+    ULONG countOfFiles = 0;
+    ULONG countOfIgnoredFiles = 0;
+
+    Worker->CountOfDirectories += 1;
+
+    separator = revision->InitParams.IsFileListNulSeparated ? '\0' : '\n';
+    isStandardInput = wcscmp(revision->InitParams.FileList, L"-") == 0;
+
+#ifdef _WIN32
+    listPath = _wcsdup(isStandardInput ? L"<stdin>" : revision->InitParams.FileList);
+#else
+    listPath = RevConvertToMultiByte(isStandardInput ? L"<stdin>" : revision->InitParams.FileList);
+#endif
+    if (listPath == NULL) {
+        RevLogError(revision,
+                    "Failed to copy the file list path.");
+        status = FALSE;
+        goto Exit;
+    }
+
+    if (isStandardInput) {
+#ifdef _WIN32
+        file = GetStdHandle(STD_INPUT_HANDLE);
+#else
+        file = STDIN_FILENO;
+#endif
+    } else if (!RevOpenFile(revision, NULL, listPath, &file)) {
+        status = FALSE;
+        goto Exit;
+    }
+
+    block = (PCHAR)malloc(REVISION_FILE_LIST_BLOCK_SIZE);
+    if (block == NULL) {
+        RevLogError(revision,
+                    "Failed to allocate the file list block (%llu bytes).",
+                    (ULONGLONG)REVISION_FILE_LIST_BLOCK_SIZE);
+        status = FALSE;
+        goto Exit;
+    }
+
+    /*
+     * Every file that is not in the cache directory of the root is missed
+     * by the cache, so the root is looked up, but never replayed.
+     */
+    (VOID)RevQueryCachedDirectory(revision, Directory);
+
+    while (!isEnd) {
+
+        /*
+         * Fill the block after the partial path carried over from the
+         * previous one. A short read means the end of the list.
+         */
+        if (!RevReadFileChunk(revision,
+                              NULL,
+                              listPath,
+                              file,
+                              block + carriedSize,
+                              REVISION_FILE_LIST_BLOCK_SIZE - carriedSize,
+                              &bytesRead)) {
+            status = FALSE;
+            goto Exit;
+        }
+
+        blockSize = carriedSize + bytesRead;
+        isEnd = blockSize < REVISION_FILE_LIST_BLOCK_SIZE;
+
+        /*
+         * Only the complete paths are parsed, up to the last separator,
+         * unless the list ends without one.
+         */
+        if (isEnd) {
+            parsedSize = blockSize;
+        } else {
+            parsedSize = blockSize;
+            while (parsedSize > 0 && block[parsedSize - 1] != separator) {
+                parsedSize -= 1;
+            }
+
+            if (parsedSize == 0) {
+                RevLogError(revision,
+                            "The file list \"" PATH_FORMAT "\" has a path longer "
+                            "than %lu bytes.",
+                            listPath,
+                            (ULONG)REVISION_FILE_LIST_BLOCK_SIZE);
+                status = FALSE;
+                goto Exit;
+            }
+        }
+
+        /*
+         * The paths of a block are converted into a single entry block,
+         * which lives as long as the root directory.
+         */
+        entryBlockSize = sizeof(REVISION_ENTRY_BLOCK) +
+                         (parsedSize + 1) * sizeof(PATHCHAR);
+
+        entryBlock = (PREVISION_ENTRY_BLOCK)malloc(entryBlockSize);
+        if (entryBlock == NULL) {
+            RevLogError(revision,
+                        "Failed to allocate the entry block (%llu bytes).",
+                        (ULONGLONG)entryBlockSize);
+            status = FALSE;
+            goto Exit;
+        }
+
+        entryBlock->CountOfDirectories = 0;
+        firstName = (PPATHCHAR)entryBlock->Directories;
+        name = firstName;
+
+        path = block;
+        end = block + parsedSize;
+        while (path < end) {
+            pathEnd = (PCHAR)memchr(path, separator, (SIZE_T)(end - path));
+            if (pathEnd == NULL) {
+                pathEnd = end;
+            }
+
+            pathLength = (SIZE_T)(pathEnd - path);
+            if (separator == '\n' && pathLength > 0 && path[pathLength - 1] == '\r') {
+                pathLength -= 1;
+            }
+
+            /*
+             * N.B. "./" prefixes, as printed by find, are dropped because
+             * relative NT names cannot contain "." components.
+             */
+            while (pathLength > 2 && path[0] == '.' && path[1] == '/') {
+                path += 2;
+                pathLength -= 2;
+            }
+
+            if (pathLength == 0) {
+                path = pathEnd + 1;
+                continue;
+            }
+
+            if (!RevConvertUtf8Path(path, pathLength, name, &nameLength)) {
+                RevLogWarning(revision,
+                              "Failed to convert the listed path \"%.*s\".",
+                              (int)pathLength,
+                              path);
+                Worker->CountOfIgnoredFiles += 1;
+                countOfIgnoredFiles += 1;
+                path = pathEnd + 1;
+                continue;
+            }
+
+            if (RevSubmitListedFile(Worker, Directory, name)) {
+                countOfFiles += 1;
+                name += nameLength + 1;
+            } else {
+                countOfIgnoredFiles += 1;
+            }
+
+            path = pathEnd + 1;
+        }
+
+        if (name == firstName) {
+            free(entryBlock);
+        } else {
+            Worker->CountOfAllocations += 1;
+
+            entryBlock->Next = Directory->EntryBlocks;
+            Directory->EntryBlocks = entryBlock;
+        }
+
+        carriedSize = blockSize - parsedSize;
+        memmove(block, block + parsedSize, carriedSize);
+    }
+
+    if (Directory->HasCacheKey) {
+        RevAppendCacheDirectory(Worker, Directory, countOfFiles, countOfIgnoredFiles);
+    }
+
+Exit:
+    if (file != INVALID_FILE_HANDLE && !isStandardInput) {
+        RevCloseFile(file);
+    }
+
+    free(block);
+    free(listPath);
+
+    return status;
+}
+
+_Ret_maybenull_
+_Must_inspect_result_
+PREVISION_PATTERN_LIST
+RevCompilePatternList(
+    _In_ PREVISION Revision,
+    _In_reads_(TextLength) const PATHCHAR *Text,
+    _In_ SIZE_T TextLength,
+    _In_opt_ PREVISION_PATTERN_LIST Parent,
+    _In_ SIZE_T BaseLength
+    )
+{
+    PREVISION_PATTERN_LIST patternList;
+    PREVISION_PATTERN pattern;
+    SIZE_T countOfLines = 1;
+    SIZE_T countOfWildcards;
+    SIZE_T listSize;
+    SIZE_T lineLength;
+    SIZE_T index;
+    const PATHCHAR *textEnd = Text + TextLength;
+    const PATHCHAR *line;
+    const PATHCHAR *lineEnd;
+    PPATHCHAR patternText;
+    ULONG flags;
+
+    for (index = 0; index < TextLength; ++index) {
+        if (Text[index] == '\n') {
+            countOfLines += 1;
+        }
+    }
+
+    /*
+     * The patterns and their text are stored with the list. The text of a
+     * pattern is never longer than its line.
+     */
+    listSize = sizeof(REVISION_PATTERN_LIST) +
+               countOfLines * sizeof(REVISION_PATTERN) +
+               (TextLength + 1) * sizeof(PATHCHAR);
+
+    patternList = (PREVISION_PATTERN_LIST)malloc(listSize);
+    if (patternList == NULL) {
+        RevLogError(Revision,
+                    "Failed to allocate the pattern list (%llu bytes).",
+                    (ULONGLONG)listSize);
+        return NULL;
+    }
+
+    patternList->Parent = Parent;
+    patternList->Directory = NULL;
+    patternList->BaseLength = BaseLength;
+    patternList->HasAnchoredPatterns = Parent != NULL && Parent->HasAnchoredPatterns;
+    patternList->CountOfPatterns = 0;
+
+    patternText = (PPATHCHAR)(patternList->Patterns + countOfLines);
+
+    for (line = Text; line < textEnd; line = lineEnd + 1) {
+        lineEnd = line;
+        while (lineEnd < textEnd && *lineEnd != '\n') {
+            lineEnd += 1;
+        }
+
+        lineLength = (SIZE_T)(lineEnd - line);
+        if (lineLength > 0 && line[lineLength - 1] == '\r') {
+            lineLength -= 1;
+        }
+
+        /*
+         * Trailing spaces are dropped unless escaped. Blank lines and
+         * comments have no pattern.
+         */
+        while (lineLength > 0 &&
+               line[lineLength - 1] == ' ' &&
+               (lineLength < 2 || line[lineLength - 2] != '\\')) {
+            lineLength -= 1;
+        }
+
+        if (lineLength == 0 || line[0] == '#') {
+            continue;
+        }
+
+        flags = 0;
+
+        if (line[0] == '!') {
+            flags |= REVISION_PATTERN_NEGATED;
+            line += 1;
+            lineLength -= 1;
+        }
+
+        if (lineLength > 0 && line[lineLength - 1] == '/') {
+            flags |= REVISION_PATTERN_DIRECTORY_ONLY;
+            lineLength -= 1;
+        }
+
+        for (index = 0; index < lineLength; ++index) {
+            if (line[index] == '/') {
+                flags |= REVISION_PATTERN_ANCHORED;
+                break;
+            }
+        }
+
+        if (lineLength > 0 && line[0] == '/') {
+            line += 1;
+            lineLength -= 1;
+        }
+
+        if (lineLength == 0) {
+            continue;
+        }
+
+        countOfWildcards = 0;
+        for (index = 0; index < lineLength; ++index) {
+            if (line[index] == '*' || line[index] == '?' ||
+                line[index] == '[' || line[index] == '\\') {
+                countOfWildcards += 1;
+            }
+        }
+
+        memcpy(patternText, line, lineLength * sizeof(PATHCHAR));
+        patternText[lineLength] = '\0';
+
+        pattern = &patternList->Patterns[patternList->CountOfPatterns++];
+        pattern->Text = patternText;
+        pattern->Length = lineLength;
+        pattern->Flags = flags;
+
+        /*
+         * Most patterns are names or extensions, which are compared without
+         * running the glob matcher.
+         */
+        if (countOfWildcards == 0) {
+            pattern->Type = RevisionPatternLiteral;
+
+#ifdef _WIN32
+            for (index = 0; index < lineLength; ++index) {
+                if (patternText[index] == L'/') {
+                    patternText[index] = PATH_SEPARATOR;
+                }
+            }
+#endif
+        } else if (countOfWildcards == 1 &&
+                   line[0] == '*' &&
+                   !(flags & REVISION_PATTERN_ANCHORED)) {
+            pattern->Type = RevisionPatternSuffix;
+            pattern->Text = patternText + 1;
+            pattern->Length = lineLength - 1;
+        } else {
+            pattern->Type = RevisionPatternGlob;
+        }
+
+        if (flags & REVISION_PATTERN_ANCHORED) {
+            patternList->HasAnchoredPatterns = TRUE;
+        }
+
+        patternText += lineLength + 1;
+    }
+
+    if (patternList->CountOfPatterns == 0) {
+        free(patternList);
+        return NULL;
+    }
+
+    return patternList;
+}
+
+_Must_inspect_result_
+BOOL
+RevCompileCommandLinePatterns(
+    _In_ PREVISION Revision,
+    _In_reads_(CountOfPatterns) PWCHAR *Patterns,
+    _In_ ULONG CountOfPatterns,
+    _Out_ PREVISION_PATTERN_LIST *PatternList
+    )
+{
+    BOOL status = TRUE;
+    PPATHCHAR text = NULL;
+    PPATHCHAR newText;
+    SIZE_T textLength = 0;
+    PPATHCHAR pattern;
+    SIZE_T patternLength;
+    ULONG index;
+
+    *PatternList = NULL;
+
+    if (CountOfPatterns == 0) {
+        goto Exit;
+    }
+
+    /*
+     * The patterns are joined into lines, as in a .gitignore file.
+     */
+    for (index = 0; index < CountOfPatterns; ++index) {
+#ifdef _WIN32
+        pattern = Patterns[index];
+#else
+        pattern = RevConvertToMultiByte(Patterns[index]);
+        if (pattern == NULL) {
+            RevLogError(Revision,
+                        "Failed to convert the pattern \"%ls\".",
+                        Patterns[index]);
+            status = FALSE;
+            goto Exit;
+        }
+#endif
+
+        patternLength = RevPathLength(pattern);
+
+        newText = (PPATHCHAR)realloc(text, (textLength + patternLength + 1) * sizeof(PATHCHAR));
+        if (newText != NULL) {
+            memcpy(newText + textLength, pattern, patternLength * sizeof(PATHCHAR));
+            newText[textLength + patternLength] = '\n';
+            textLength += patternLength + 1;
+            text = newText;
+        }
+
+#ifndef _WIN32
+        free(pattern);
+#endif
+
+        if (newText == NULL) {
+            RevLogError(Revision,
+                        "Failed to allocate the pattern text (%llu bytes).",
+                        (ULONGLONG)((textLength + patternLength + 1) * sizeof(PATHCHAR)));
+            status = FALSE;
+            goto Exit;
+        }
+    }
+
+    *PatternList = RevCompilePatternList(Revision, text, textLength, NULL, 0);
+
+Exit:
+    free(text);
+
+    return status;
+}
+
+VOID
+RevLoadIgnoreFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION revision = Worker->Revision;
+    BOOL isDirectory;
+    FILEHANDLE file = INVALID_FILE_HANDLE;
+    ULONGLONG fileSize;
+    PCHAR content = NULL;
+    PCHAR contentStart;
+    SIZE_T bytesRead;
+    PPATHCHAR text = NULL;
+    SIZE_T textLength;
+    PREVISION_PATTERN_LIST patternList;
+    PPATHCHAR path;
+
+    /*
+     * Most directories have no .gitignore file, which costs one failed
+     * query.
+     */
+    if (!RevQueryIsDirectory(Directory, PATH_TEXT(".gitignore"), &isDirectory) ||
+        isDirectory) {
+        return;
+    }
+
+    if (!RevOpenFile(revision, Directory, PATH_TEXT(".gitignore"), &file) ||
+        !RevQueryFileSize(revision, Directory, PATH_TEXT(".gitignore"), file, &fileSize)) {
+        goto Exit;
+    }
+
+    if (fileSize > REVISION_IGNORE_FILE_MAX_SIZE) {
+        path = RevBuildPath(Directory, PATH_TEXT(".gitignore"));
+        RevLogWarning(revision,
+                      "Ignoring \"" PATH_FORMAT "\", which is larger than %lu bytes.",
+                      path,
+                      (ULONG)REVISION_IGNORE_FILE_MAX_SIZE);
+        free(path);
+        goto Exit;
+    }
+
+    content = (PCHAR)malloc((SIZE_T)fileSize + 1);
+    if (content == NULL ||
+        !RevReadFileChunk(revision,
+                          Directory,
+                          PATH_TEXT(".gitignore"),
+                          file,
+                          content,
+                          (SIZE_T)fileSize,
+                          &bytesRead)) {
+        goto Exit;
+    }
+
+    /*
+     * The file is in UTF-8, possibly with a byte order mark.
+     */
+    contentStart = content;
+    if (bytesRead >= 3 && memcmp(content, "\xEF\xBB\xBF", 3) == 0) {
+        contentStart += 3;
+        bytesRead -= 3;
+    }
+
+#ifdef _WIN32
+    text = (PPATHCHAR)malloc((bytesRead + 1) * sizeof(WCHAR));
+    if (text == NULL) {
+        goto Exit;
+    }
+
+    textLength = 0;
+    if (bytesRead > 0) {
+        textLength = (SIZE_T)MultiByteToWideChar(CP_UTF8,
+                                                 0,
+                                                 contentStart,
+                                                 (int)bytesRead,
+                                                 text,
+                                                 (int)bytesRead);
+    }
+#else
+    text = contentStart;
+    textLength = bytesRead;
+#endif
+
+    patternList = RevCompilePatternList(revision,
+                                        text,
+                                        textLength,
+                                        Directory->PatternList,
+                                        RevQueryRelativePathLength(Directory));
+    if (patternList != NULL) {
+        patternList->Directory = Directory;
+        Directory->PatternList = patternList;
+    }
 
-/**
- * @brief Indicates whether ANSI escape sequences are supported.
- */
-BOOL SupportAnsi;
+Exit:
+    if (file != INVALID_FILE_HANDLE) {
+        RevCloseFile(file);
+    }
 
-//
-// -------------------------------------------------------- Function Prototypes
-//
+#ifdef _WIN32
+    free(text);
+#endif
+    free(content);
+}
 
-/**
- * @brief This function retrieves the calling thread's last-error code
- * value and translates it into its corresponding error message.
- *
- * @return A pointer to the error message string on success,
- * or NULL on failure.
- */
-_Ret_maybenull_
-_Must_inspect_result_
-PWCHAR
-RevGetLastKnownWin32Error(
-    VOID
-    );
+SIZE_T
+RevQueryRelativePathLength(
+    _In_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION_DIRECTORY directory;
+    SIZE_T pathLength = 0;
 
-/**
- * @brief This function appends one unicode string to another and returns
- * the result.
- *
- * @param String1 The first string (to which String2 will be appended).
- *
- * @param String2 The second string (to be appended to String1).
- *
- * @return A new string containing the concatenation of String1 and
- * String2. NULL if the function failed.
- *
- * @remarks The caller is responsible for freeing the memory.
- */
-_Ret_maybenull_
-_Must_inspect_result_
-PWCHAR
-RevStringAppend(
-    _In_z_ PWCHAR String1,
-    _In_z_ PWCHAR String2
-    );
+    for (directory = Directory; directory->Parent != NULL; directory = directory->Parent) {
+        pathLength += RevPathLength(directory->Name) + 1;
+    }
 
-/**
- * @brief This function prepends one unicode string to another and
- * returns the result.
- *
- * @param String1 Supplies the first string (to be appended to).
- *
- * @param String2 Supplies the second string (to be prepended).
- *
- * @return A new string containing the concatenation of String1 and
- * String2. NULL if the function failed.
- *
- * @remarks N.B. The caller is responsible for freeing the memory.
- */
-_Ret_maybenull_
-_Must_inspect_result_
-PWCHAR
-RevStringPrepend(
-    _In_z_ PWCHAR String1,
-    _In_z_ PWCHAR String2
-    );
+    return pathLength > 0 ? pathLength - 1 : 0;
+}
 
-/**
- * @brief This function is responsible for initializing the revision
- * system.
- *
- * @param InitParams Supplies the revision initialization parameters.
- *
- * @return TRUE if succeeded, FALSE if failed.
- */
 _Must_inspect_result_
 BOOL
-RevInitializeRevision(
-    _In_ PREVISION_INIT_PARAMS InitParams
-    );
+RevPreparePatternPath(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION revision = Worker->Revision;
+    PREVISION_DIRECTORY directory;
+    SIZE_T pathLength;
+    SIZE_T componentLength;
+
+    Worker->HasPatternPath = FALSE;
+
+    if ((revision->ExcludePatterns == NULL || !revision->ExcludePatterns->HasAnchoredPatterns) &&
+        (revision->IncludePatterns == NULL || !revision->IncludePatterns->HasAnchoredPatterns) &&
+        (Directory->PatternList == NULL || !Directory->PatternList->HasAnchoredPatterns)) {
+        return TRUE;
+    }
+
+    /*
+     * The path of the directory and a separator, followed by room for the
+     * name of an entry.
+     */
+    pathLength = RevQueryRelativePathLength(Directory);
+    if (pathLength > 0) {
+        pathLength += 1;
+    }
+
+    if (!RevReserveCacheRoom((PVOID *)&Worker->PatternPath,
+                             &Worker->PatternPathCapacity,
+                             pathLength + 256,
+                             sizeof(PATHCHAR))) {
+        RevLogError(revision,
+                    "Failed to allocate the pattern path (%llu bytes).",
+                    (ULONGLONG)((pathLength + 256) * sizeof(PATHCHAR)));
+        return FALSE;
+    }
+
+    /*
+     * Fill the path from the end, as RevBuildPath does, without the root.
+     */
+    Worker->PatternPathLength = pathLength;
+
+    if (pathLength > 0) {
+        Worker->PatternPath[--pathLength] = PATH_SEPARATOR;
+    }
+
+    for (directory = Directory; directory->Parent != NULL; directory = directory->Parent) {
+        componentLength = RevPathLength(directory->Name);
+        pathLength -= componentLength;
+        memcpy(Worker->PatternPath + pathLength,
+               directory->Name,
+               componentLength * sizeof(PATHCHAR));
+
+        if (pathLength > 0) {
+            Worker->PatternPath[--pathLength] = PATH_SEPARATOR;
+        }
+    }
+
+    Worker->HasPatternPath = TRUE;
+
+    return TRUE;
+}
 
-/**
- * @brief This function is responsible for starting the revision system.
- * It ensures that the system has been initialized correctly before
- * proceeding with its operations.
- *
- * @return TRUE if succeeded, FALSE if failed.
- */
 _Must_inspect_result_
 BOOL
-RevStartRevision(
-    VOID
-    );
+RevIsEntryExcluded(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_DIRECTORY Directory,
+    _In_z_ const PATHCHAR *Name,
+    _In_ BOOL IsDirectory
+    )
+{
+    SIZE_T nameLength = RevPathLength(Name);
+    const PATHCHAR *path = NULL;
+
+    if (Worker->HasPatternPath) {
+        if (!RevReserveCacheRoom((PVOID *)&Worker->PatternPath,
+                                 &Worker->PatternPathCapacity,
+                                 Worker->PatternPathLength + nameLength + 1,
+                                 sizeof(PATHCHAR))) {
+            return FALSE;
+        }
+
+        memcpy(Worker->PatternPath + Worker->PatternPathLength,
+               Name,
+               (nameLength + 1) * sizeof(PATHCHAR));
+        path = Worker->PatternPath;
+    }
+
+    return RevIsExcluded(Worker->Revision,
+                         Directory->PatternList,
+                         Name,
+                         nameLength,
+                         path,
+                         IsDirectory);
+}
 
-/**
- * @brief This function initializes a REVISION_RECORD structure.
- *
- * @param Extension Supplies the file extension of the revision record.
- *
- * @param LanguageOrFileType Supplies the language or file type of the
- * revision record.
- *
- * @return If the initialization is successful, returns a pointer to the
- * new revision record; otherwise, NULL.
- */
-_Ret_maybenull_
 _Must_inspect_result_
-PREVISION_RECORD
-RevInitializeRevisionRecord(
-    _In_z_ PWCHAR Extension,
-    _In_z_ PWCHAR LanguageOrFileType
-    );
+BOOL
+RevIsPathExcluded(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_z_ const PATHCHAR *Path
+    )
+{
+    BOOL isExcluded = FALSE;
+    SIZE_T pathLength = RevPathLength(Path);
+    SIZE_T nameStart = 0;
+    SIZE_T index;
+    PPATHCHAR path;
+
+    if (!RevReserveCacheRoom((PVOID *)&Worker->PatternPath,
+                             &Worker->PatternPathCapacity,
+                             pathLength + 1,
+                             sizeof(PATHCHAR))) {
+        return FALSE;
+    }
+
+    path = Worker->PatternPath;
+    memcpy(path, Path, (pathLength + 1) * sizeof(PATHCHAR));
+
+    /*
+     * Each directory on the way is checked as the walk would check it, so
+     * that excluding a directory excludes every file under it.
+     */
+    for (index = 0; index <= pathLength && !isExcluded; ++index) {
+        if (index < pathLength && path[index] != PATH_SEPARATOR) {
+            continue;
+        }
+
+        if (index > nameStart) {
+            path[index] = '\0';
+            isExcluded = RevIsExcluded(Worker->Revision,
+                                       NULL,
+                                       path + nameStart,
+                                       index - nameStart,
+                                       path,
+                                       index < pathLength);
+            path[index] = Path[index];
+        }
+
+        nameStart = index + 1;
+    }
+
+    return isExcluded;
+}
 
-/**
- * @brief This function is designed to recursively traverse and enumerate
- * files and subdirectories within a given root directory path.
- *
- * @param RootDirectoryPath Supplies the root directory path from which
- * enumeration should begin.
- *
- * @return TRUE if succeeded, FALSE if failed.
- */
 _Must_inspect_result_
 BOOL
-RevEnumerateRecursively(
-    _In_z_ PWCHAR RootDirectoryPath
-    );
+RevIsExcluded(
+    _In_ PREVISION Revision,
+    _In_opt_ PREVISION_PATTERN_LIST PatternList,
+    _In_z_ const PATHCHAR *Name,
+    _In_ SIZE_T NameLength,
+    _In_opt_z_ const PATHCHAR *Path,
+    _In_ BOOL IsDirectory
+    )
+{
+    const REVISION_PATTERN *pattern = NULL;
+    BOOL isExcluded = FALSE;
 
-/**
- * This function searches a table of file extension-to-language mappings
- * to find the programming language associated with the provided file
- * extension.
- *
- * @param Extension Supplies the file extension.
- *
- * @return If a matching file extension is found in the mapping table,
- * the function returns the associated programming language as a string.
- * If no match is found, the function returns NULL.
- */
-_Ret_maybenull_
-PWCHAR
-RevMapExtensionToLanguage(
-    _In_z_ PWCHAR Extension
-    );
+    /*
+     * Git never looks into its own directory.
+     */
+    if (Revision->InitParams.IsGitIgnoreUsed &&
+        IsDirectory &&
+        NameLength == 4 &&
+        RevPathStringsEqual(Name, PATH_TEXT(".git"), 4)) {
+        return TRUE;
+    }
+
+    if (Revision->ExcludePatterns != NULL) {
+        pattern = RevMatchPatternList(Revision->ExcludePatterns,
+                                      Name,
+                                      NameLength,
+                                      Path,
+                                      IsDirectory);
+    }
+
+    if (pattern == NULL && PatternList != NULL) {
+        pattern = RevMatchPatternList(PatternList,
+                                      Name,
+                                      NameLength,
+                                      Path,
+                                      IsDirectory);
+    }
+
+    if (pattern != NULL) {
+        isExcluded = !(pattern->Flags & REVISION_PATTERN_NEGATED);
+    }
+
+    /*
+     * With include patterns, only the files they match are counted.
+     */
+    if (!isExcluded && !IsDirectory && Revision->IncludePatterns != NULL) {
+        pattern = RevMatchPatternList(Revision->IncludePatterns,
+                                      Name,
+                                      NameLength,
+                                      Path,
+                                      IsDirectory);
+        isExcluded = pattern == NULL || (pattern->Flags & REVISION_PATTERN_NEGATED);
+    }
+
+    return isExcluded;
+}
 
-/**
- * @brief This function checks if a REVISION_RECORD for a language/file
- * type with a given extension exists in the global revision's list of
- * revision records.
- *
- * @param Extension Supplies the file extension to search for.
- *
- * @return If a matching REVISION_RECORD is found, returns a pointer to
- * that record; otherwise, returns NULL.
- */
 _Ret_maybenull_
-_Must_inspect_result_
-PREVISION_RECORD
-RevFindRevisionRecordForLanguageByExtension(
-    _In_z_ PWCHAR Extension
-    );
+const REVISION_PATTERN *
+RevMatchPatternList(
+    _In_ PREVISION_PATTERN_LIST PatternList,
+    _In_z_ const PATHCHAR *Name,
+    _In_ SIZE_T NameLength,
+    _In_opt_z_ const PATHCHAR *Path,
+    _In_ BOOL IsDirectory
+    )
+{
+    PREVISION_PATTERN_LIST patternList;
+    const REVISION_PATTERN *pattern;
+    SIZE_T pathLength = Path != NULL ? RevPathLength(Path) : 0;
+    const PATHCHAR *text;
+    SIZE_T textLength;
+    SIZE_T offset;
+    ULONG index;
+    BOOL isMatch;
+
+    for (patternList = PatternList; patternList != NULL; patternList = patternList->Parent) {
+
+        /*
+         * The last matching pattern of a list decides.
+         */
+        for (index = patternList->CountOfPatterns; index-- > 0;) {
+            pattern = &patternList->Patterns[index];
+
+            if ((pattern->Flags & REVISION_PATTERN_DIRECTORY_ONLY) && !IsDirectory) {
+                continue;
+            }
+
+            if (pattern->Flags & REVISION_PATTERN_ANCHORED) {
+                if (Path == NULL) {
+                    continue;
+                }
+
+                offset = patternList->BaseLength > 0 ? patternList->BaseLength + 1 : 0;
+                if (offset > pathLength) {
+                    continue;
+                }
+
+                text = Path + offset;
+                textLength = pathLength - offset;
+            } else {
+                text = Name;
+                textLength = NameLength;
+            }
+
+            switch (pattern->Type) {
+            case RevisionPatternLiteral:
+                isMatch = textLength == pattern->Length &&
+                          RevPathStringsEqual(text, pattern->Text, textLength);
+                break;
+
+            case RevisionPatternSuffix:
+                isMatch = textLength >= pattern->Length &&
+                          RevPathStringsEqual(text + textLength - pattern->Length,
+                                              pattern->Text,
+                                              pattern->Length);
+                break;
+
+            default:
+                isMatch = RevMatchGlob(pattern->Text, pattern->Text, text);
+                break;
+            }
+
+            if (isMatch) {
+                return pattern;
+            }
+        }
+    }
+
+    return NULL;
+}
 
-/**
- * @brief This function checks if a file extension is in the extension
- * table. File should be revised only if it has valid (is in the table)
- * extension.
- *
- * @param FileName Supplies the name of the file to be checked.
- *
- * @return TRUE if succeeded, FALSE if failed.
- */
 _Must_inspect_result_
 BOOL
-RevShouldReviseFile(
-    _In_z_ PWCHAR FileName
-    );
+RevMatchGlob(
+    _In_z_ const PATHCHAR *PatternStart,
+    _In_z_ const PATHCHAR *Pattern,
+    _In_z_ const PATHCHAR *Text
+    )
+{
+    PATHCHAR patternChar;
+    BOOL isMatch;
+
+    for (;;) {
+        patternChar = *Pattern;
+
+        if (patternChar == '\0') {
+            return *Text == '\0';
+        }
+
+        if (patternChar == '*') {
+
+            /*
+             * A "**" component matches everything below at the end of the
+             * pattern, and any number of whole components elsewhere.
+             */
+            if (Pattern[1] == '*' &&
+                (Pattern == PatternStart || Pattern[-1] == '/') &&
+                (Pattern[2] == '/' || Pattern[2] == '\0')) {
+
+                if (Pattern[2] == '\0') {
+                    return TRUE;
+                }
+
+                for (;;) {
+                    if (RevMatchGlob(PatternStart, Pattern + 3, Text)) {
+                        return TRUE;
+                    }
+
+                    while (*Text != '\0' && *Text != PATH_SEPARATOR) {
+                        Text += 1;
+                    }
+
+                    if (*Text == '\0') {
+                        return FALSE;
+                    }
+
+                    Text += 1;
+                }
+            }
+
+            /*
+             * Any other run of stars matches within the component.
+             */
+            while (*Pattern == '*') {
+                Pattern += 1;
+            }
+
+            for (;;) {
+                if (RevMatchGlob(PatternStart, Pattern, Text)) {
+                    return TRUE;
+                }
+
+                if (*Text == '\0' || *Text == PATH_SEPARATOR) {
+                    return FALSE;
+                }
+
+                Text += 1;
+            }
+        }
+
+        if (*Text == '\0') {
+            return FALSE;
+        }
+
+        if (patternChar == '?') {
+            if (*Text == PATH_SEPARATOR) {
+                return FALSE;
+            }
+        } else if (patternChar == '[' && RevMatchGlobSet(&Pattern, *Text, &isMatch)) {
+            if (!isMatch) {
+                return FALSE;
+            }
+        } else {
+            if (patternChar == '\\' && Pattern[1] != '\0') {
+                Pattern += 1;
+                patternChar = *Pattern;
+            }
+
+            if (patternChar == '/') {
+                if (*Text != PATH_SEPARATOR) {
+                    return FALSE;
+                }
+            } else if (!RevPathCharsEqual(patternChar, *Text)) {
+                return FALSE;
+            }
+        }
+
+        Pattern += 1;
+        Text += 1;
+    }
+}
 
-/**
- * @brief This function reads and revises the specified file.
- * @param FilePath Supplies the path to the file to be revised.
- * @return TRUE if succeeded, FALSE if failed.
- */
 _Must_inspect_result_
 BOOL
-RevReviseFile(
-    _In_z_ PWCHAR FilePath
-    );
-
-/**
- * @brief This function outputs the revision statistics to the console.
- */
-VOID
-RevOutputRevisionStatistics(
-    VOID
-    );
-
-/**
- * @brief This function initializes a LIST_ENTRY structure that
- * represents the head of a doubly linked list.
- *
- * @param ListHead Supplies a pointer to a LIST_ENTRY that represents the
- * head of the list.
- */
-FORCEINLINE
-VOID
-RevInitializeListHead(
-    _Inout_ PLIST_ENTRY ListHead
+RevMatchGlobSet(
+    _Inout_ const PATHCHAR **Pattern,
+    _In_ PATHCHAR Char,
+    _Out_ PBOOL IsMatch
     )
 {
-    ListHead->Flink = ListHead->Blink = ListHead;
+    const PATHCHAR *pattern = *Pattern + 1;
+    PATHCHAR lowChar;
+    PATHCHAR highChar;
+    BOOL isNegated = FALSE;
+    BOOL isMatch = FALSE;
+    BOOL isFirst = TRUE;
+
+    *IsMatch = FALSE;
+
+    if (*pattern == '!' || *pattern == '^') {
+        isNegated = TRUE;
+        pattern += 1;
+    }
+
+    /*
+     * A "]" right after the "[" is a member of the set.
+     */
+    while (*pattern != '\0' && (*pattern != ']' || isFirst)) {
+        isFirst = FALSE;
+
+        lowChar = *pattern;
+        if (lowChar == '\\' && pattern[1] != '\0') {
+            pattern += 1;
+            lowChar = *pattern;
+        }
+        pattern += 1;
+
+        if (pattern[0] == '-' && pattern[1] != ']' && pattern[1] != '\0') {
+            highChar = pattern[1];
+            if (highChar == '\\' && pattern[2] != '\0') {
+                pattern += 1;
+                highChar = pattern[1];
+            }
+            pattern += 2;
+
+            if (Char >= lowChar && Char <= highChar) {
+                isMatch = TRUE;
+            }
+
+#ifdef _WIN32
+            if (towlower(Char) >= towlower(lowChar) &&
+                towlower(Char) <= towlower(highChar)) {
+                isMatch = TRUE;
+            }
+#endif
+        } else if (RevPathCharsEqual(Char, lowChar)) {
+            isMatch = TRUE;
+        }
+    }
+
+    if (*pattern != ']') {
+        return FALSE;
+    }
+
+    *Pattern = pattern;
+    *IsMatch = isMatch != isNegated && Char != PATH_SEPARATOR;
+
+    return TRUE;
 }
 
-/**
- * @brief This function checks whether a LIST_ENTRY is empty.
- *
- * @param ListHead Supplies a pointer to a LIST_ENTRY that represents the
- * head of the list.
- *
- * @return TRUE if there are currently no entries in the list and FALSE
- * otherwise.
- */
-FORCEINLINE
-BOOL
-RevIsListEmpty(
-    _In_ PLIST_ENTRY ListHead
+ULONGLONG
+RevHashFilters(
+    _In_ PREVISION Revision
     )
 {
-    return ListHead->Flink == ListHead;
+    ULONGLONG hash = 0xCBF29CE484222325ULL;
+    ULONG index;
+    PWCHAR pattern;
+
+    hash ^= Revision->InitParams.IsGitIgnoreUsed ? 1 : 0;
+    hash *= 0x100000001B3ULL;
+
+    for (index = 0; index < Revision->InitParams.CountOfExcludePatterns; ++index) {
+        for (pattern = Revision->InitParams.ExcludePatterns[index]; ; ++pattern) {
+            hash ^= (USHORT)*pattern;
+            hash *= 0x100000001B3ULL;
+
+            if (*pattern == L'\0') {
+                break;
+            }
+        }
+    }
+
+    /*
+     * Keep an exclude pattern apart from the same include pattern.
+     */
+    hash ^= 0xFFFF;
+    hash *= 0x100000001B3ULL;
+
+    for (index = 0; index < Revision->InitParams.CountOfIncludePatterns; ++index) {
+        for (pattern = Revision->InitParams.IncludePatterns[index]; ; ++pattern) {
+            hash ^= (USHORT)*pattern;
+            hash *= 0x100000001B3ULL;
+
+            if (*pattern == L'\0') {
+                break;
+            }
+        }
+    }
+
+    return hash;
 }
 
-/**
- * @brief This function inserts an entry at the tail of a list.
- *
- * @param ListHead Supplies a pointer to a LIST_ENTRY that represents the
- * head of the list.
- *
- * @param Entry Supplies a pointer to a LIST_ENTRY that represents the
- * entry to be inserted.
- */
-FORCEINLINE
 VOID
-RevInsertTailList(
-    _In_ PLIST_ENTRY ListHead,
-    _In_ PLIST_ENTRY Entry
+RevInitializeContentSet(
+    _Out_ PREVISION_CONTENT_SET Set
     )
 {
-    PLIST_ENTRY Blink;
+    ULONG index;
 
-    Blink = ListHead->Blink;
-    Entry->Flink = ListHead;
-    Entry->Blink = Blink;
-    Blink->Flink = Entry;
-    ListHead->Blink = Entry;
+    for (index = 0; index < REVISION_CONTENT_SHARD_COUNT; ++index) {
+        InitializeSRWLock(&Set->Shards[index].Lock);
+        Set->Shards[index].Entries = NULL;
+        Set->Shards[index].Capacity = 0;
+        Set->Shards[index].Count = 0;
+    }
 }
 
-/**
- * @brief This function prints a formatted string in the specified color.
- *
- * @param Color Supplies the text foreground color.
- *
- * @param Format Supplies the format specifier.
- *
- * @param ... Supplies additional parameters to be formatted and printed.
- */
 VOID
-RevPrintEx(
-    CONSOLE_FOREGROUND_COLOR Color,
-    const wchar_t *Format,
-    ...
-)
+RevDeleteContentSet(
+    _Inout_ PREVISION_CONTENT_SET Set
+    )
 {
-    va_list args;
-    const PWCHAR color = ConsoleForegroundColors[Color];
+    ULONG index;
 
-    if (SupportAnsi) {
-        wprintf(color);
-    }
-    va_start(args, Format);
-    vwprintf(Format, args);
-    va_end(args);
-    if (SupportAnsi) {
-        wprintf(L"\033[0m");
+    for (index = 0; index < REVISION_CONTENT_SHARD_COUNT; ++index) {
+        free(Set->Shards[index].Entries);
+        Set->Shards[index].Entries = NULL;
+        Set->Shards[index].Capacity = 0;
+        Set->Shards[index].Count = 0;
     }
 }
 
-/**
- * @brief This function prints a formatted string in [default] green
- * color.
- *
- * @param Format Supplies the format specifier.
- *
- * @param ... Supplies additional parameters to be formatted and printed.
- */
-#define RevPrint(Format, ...)                           \
-    do {                                                \
-        RevPrintEx(Green, Format, __VA_ARGS__);         \
-    } while (0)
+_Must_inspect_result_
+BOOL
+RevLookupContent(
+    _Inout_ PREVISION_CONTENT_SET Set,
+    _Inout_ PREVISION_CONTENT_ENTRY Entry
+    )
+{
+    PREVISION_CONTENT_SHARD shard;
+    PREVISION_CONTENT_ENTRY slot;
+    BOOL isFound = FALSE;
 
-/**
- * @brief This function outputs a red text error message to the standard
- * error stream.
- *
- * @param Message Supplies the error message.
- *
- * @note This function respects the verbose mode setting from the global
- * revision structure. The logging is conditioned on whether verbose mode
- * is enabled.
- */
-#define RevLogError(Message, ...)                                                       \
-    do {                                                                                \
-        if (Revision && Revision->InitParams.IsVerboseMode) {                           \
-            fprintf(stderr,                                                             \
-                    SupportAnsi ?                                                       \
-                        "\033[0;31m[ERROR]\n└───> (in %s@%d): " Message "\033[0m\n" :   \
-                        "[ERROR]\n└───> (in %s@%d): " Message "\n",                     \
-                        __FUNCTION__,                                                   \
-                        __LINE__,                                                       \
-                        ##__VA_ARGS__);                                                 \
-        }                                                                               \
-    } while (0)
+    /*
+     * The slot is taken from the low bits of the hash, the shard from
+     * higher ones.
+     */
+    shard = &Set->Shards[(ULONG)(Entry->ContentHash >> 32) % REVISION_CONTENT_SHARD_COUNT];
 
-/**
- * @brief This function outputs a yellow text warning message to the
- * standard output stream.
- *
- * @param Message Supplies the warning message.
- *
- * @note This function respects the verbose mode setting from the global
- * revision structure. The logging is conditioned on whether verbose mode
- * is enabled.
- */
-#define RevLogWarning(Message, ...)                                                     \
-    do {                                                                                \
-        if (Revision && Revision->InitParams.IsVerboseMode) {                           \
-            fprintf(stdout,                                                             \
-                    SupportAnsi ?                                                       \
-                        "\033[0;33m[WARNING]\n└───> (in %s@%d): " Message "\033[0m\n" : \
-                        "[WARNING]\n└───> (in %s@%d): " Message "\n",                   \
-                        __FUNCTION__,                                                   \
-                        __LINE__,                                                       \
-                        ##__VA_ARGS__);                                                 \
-        }                                                                               \
-    } while (0)
+    AcquireSRWLockExclusive(&shard->Lock);
 
-//
-// ------------------------------------------------------------------ Functions
-//
+    if (shard->Capacity > 0) {
+        slot = RevFindContentSlot(shard, Entry->ContentHash, Entry->LanguageId);
+        if (slot->IsUsed) {
+            Entry->CountOfLinesTotal = slot->CountOfLinesTotal;
+            Entry->CountOfLinesBlank = slot->CountOfLinesBlank;
+            Entry->CountOfLinesComment = slot->CountOfLinesComment;
+            isFound = TRUE;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&shard->Lock);
+
+    return isFound;
+}
 
-_Ret_maybenull_
 _Must_inspect_result_
-PWCHAR
-RevGetLastKnownWin32Error(
-    VOID
+BOOL
+RevInsertContent(
+    _Inout_ PREVISION_CONTENT_SET Set,
+    _Inout_ PREVISION_CONTENT_ENTRY Entry
     )
 {
-    PWCHAR messageBuffer;
-    SIZE_T messageBufferSize;
-    DWORD formatResult;
-    const DWORD lastKnownError = GetLastError();
+    PREVISION_CONTENT_SHARD shard;
+    PREVISION_CONTENT_ENTRY slot;
+    BOOL isInserted = TRUE;
 
-    /*
-     * Attempt to format the error code into a human-readable string.
-     */
-    formatResult = FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER |
-                                  FORMAT_MESSAGE_FROM_SYSTEM,
-                                  NULL,
-                                  lastKnownError,
-                                  0,
-                                  (LPWSTR)&messageBuffer,
-                                  0,
-                                  NULL);
+    shard = &Set->Shards[(ULONG)(Entry->ContentHash >> 32) % REVISION_CONTENT_SHARD_COUNT];
 
-    if (formatResult == 0) {
-        /*
-         * If FormatMessageW failed, convert the error code to a string
-         * and return that.
-         */
+    AcquireSRWLockExclusive(&shard->Lock);
 
-        /* N.B. The maximum error code value is a 5-digit number (15999). */
-        messageBufferSize = (5 + 1) * sizeof(WCHAR);
-        messageBuffer = (PWCHAR) malloc(messageBufferSize);
-        if (messageBuffer == NULL) {
-            RevLogError("Failed to allocate a message buffer (%llu bytes).",
-                        messageBufferSize);
+    if (shard->Capacity > 0) {
+        slot = RevFindContentSlot(shard, Entry->ContentHash, Entry->LanguageId);
+        if (slot->IsUsed) {
+            Entry->CountOfLinesTotal = slot->CountOfLinesTotal;
+            Entry->CountOfLinesBlank = slot->CountOfLinesBlank;
+            Entry->CountOfLinesComment = slot->CountOfLinesComment;
+            isInserted = FALSE;
             goto Exit;
         }
+    }
 
-        if (swprintf_s(messageBuffer,
-                       (5 + 1),
-                       L"%lu",
-                       lastKnownError) == -1) {
-            RevLogError("Failed to write formatted data to a string.");
-            if (messageBuffer) {
-                free(messageBuffer);
-            }
-            messageBuffer = NULL;
+    /*
+     * Keep a quarter of the slots free, so that probes stay short.
+     */
+    if (shard->Count >= shard->Capacity / 4 * 3) {
+        if (!RevGrowContentShard(shard)) {
             goto Exit;
         }
     }
 
+    slot = RevFindContentSlot(shard, Entry->ContentHash, Entry->LanguageId);
+    *slot = *Entry;
+    slot->IsUsed = TRUE;
+    shard->Count += 1;
+
 Exit:
+    ReleaseSRWLockExclusive(&shard->Lock);
 
-    return messageBuffer;
+    return isInserted;
+}
+
+PREVISION_CONTENT_ENTRY
+RevFindContentSlot(
+    _In_ PREVISION_CONTENT_SHARD Shard,
+    _In_ ULONGLONG ContentHash,
+    _In_ ULONG LanguageId
+    )
+{
+    SIZE_T mask = Shard->Capacity - 1;
+    SIZE_T index = (SIZE_T)ContentHash & mask;
+    PREVISION_CONTENT_ENTRY slot = &Shard->Entries[index];
+
+    while (slot->IsUsed &&
+           (slot->ContentHash != ContentHash || slot->LanguageId != LanguageId)) {
+        index = (index + 1) & mask;
+        slot = &Shard->Entries[index];
+    }
+
+    return slot;
 }
 
-_Ret_maybenull_
 _Must_inspect_result_
-PWCHAR
-RevStringAppend(
-    _In_z_ PWCHAR String1,
-    _In_z_ PWCHAR String2
+BOOL
+RevGrowContentShard(
+    _Inout_ PREVISION_CONTENT_SHARD Shard
     )
 {
-    SIZE_T string1Length;
-    SIZE_T string2Length;
-    SIZE_T resultStringLength;
-    PWCHAR result;
+    PREVISION_CONTENT_ENTRY entries = Shard->Entries;
+    SIZE_T capacity = Shard->Capacity;
+    SIZE_T index;
 
-    /*
-     * Find the length of the result string.
-     */
-    string1Length = wcslen(String1);
-    string2Length = wcslen(String2);
-    resultStringLength = string1Length + string2Length + 1;
+    Shard->Capacity = capacity == 0 ? REVISION_CONTENT_INITIAL_CAPACITY : capacity * 2;
+    Shard->Entries = (PREVISION_CONTENT_ENTRY)calloc(Shard->Capacity,
+                                                     sizeof(REVISION_CONTENT_ENTRY));
+    if (Shard->Entries == NULL) {
+        Shard->Entries = entries;
+        Shard->Capacity = capacity;
+        return FALSE;
+    }
 
-    /*
-     * Allocate buffer for the new string.
-     */
-    result = (PWCHAR) malloc(resultStringLength * sizeof(WCHAR));
-    if (result == NULL) {
-        RevLogError("Failed to allocate string buffer (%llu bytes).",
-                    resultStringLength * sizeof(WCHAR));
-        goto Exit;
+    for (index = 0; index < capacity; ++index) {
+        if (entries[index].IsUsed) {
+            *RevFindContentSlot(Shard,
+                                entries[index].ContentHash,
+                                entries[index].LanguageId) = entries[index];
+        }
+    }
+
+    free(entries);
+
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOL
+RevClaimContent(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG LanguageId,
+    _In_ ULONGLONG ContentHash,
+    _In_ ULONGLONG CountOfLinesTotal,
+    _In_ ULONGLONG CountOfLinesBlank,
+    _In_ ULONGLONG CountOfLinesComment
+    )
+{
+    REVISION_CONTENT_ENTRY entry;
+
+    entry.ContentHash = ContentHash;
+    entry.LanguageId = LanguageId;
+    entry.IsUsed = TRUE;
+    entry.CountOfLinesTotal = CountOfLinesTotal;
+    entry.CountOfLinesBlank = CountOfLinesBlank;
+    entry.CountOfLinesComment = CountOfLinesComment;
+
+    if (RevInsertContent(&Worker->Revision->ContentSet, &entry)) {
+        return TRUE;
     }
 
+    Worker->CountOfDuplicateFiles += 1;
+
+    return FALSE;
+}
+
+VOID
+RevInitializeContentHash(
+    _Out_ PREVISION_CONTENT_HASH Hash
+    )
+{
+    Hash->Lanes[0] = REVISION_CONTENT_PRIME1 + REVISION_CONTENT_PRIME2;
+    Hash->Lanes[1] = REVISION_CONTENT_PRIME2;
+    Hash->Lanes[2] = 0;
+    Hash->Lanes[3] = 0 - REVISION_CONTENT_PRIME1;
+    Hash->CountOfStripeBytes = 0;
+    Hash->Size = 0;
+}
+
+VOID
+RevUpdateContentHash(
+    _Inout_ PREVISION_CONTENT_HASH Hash,
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size
+    )
+{
+    const UCHAR *bytes = (const UCHAR *)Buffer;
+    const UCHAR *end = bytes + Size;
+    ULONGLONG lane0;
+    ULONGLONG lane1;
+    ULONGLONG lane2;
+    ULONGLONG lane3;
+    SIZE_T countOfBytes;
+
+    Hash->Size += Size;
+
     /*
-     * Copy the first string to the result.
+     * Complete the stripe left over by the previous piece first.
      */
-    if (wcscpy_s(result, resultStringLength, String1) != 0) {
-        free(result);
-        result = NULL;
-        goto Exit;
+    if (Hash->CountOfStripeBytes > 0) {
+        countOfBytes = REVISION_CONTENT_STRIPE_SIZE - Hash->CountOfStripeBytes;
+        if (countOfBytes > Size) {
+            countOfBytes = Size;
+        }
+
+        memcpy(Hash->Stripe + Hash->CountOfStripeBytes, bytes, countOfBytes);
+        Hash->CountOfStripeBytes += countOfBytes;
+        bytes += countOfBytes;
+
+        if (Hash->CountOfStripeBytes < REVISION_CONTENT_STRIPE_SIZE) {
+            return;
+        }
+
+        Hash->Lanes[0] = RevMixContentLane(Hash->Lanes[0], RevReadContentWord64(Hash->Stripe));
+        Hash->Lanes[1] = RevMixContentLane(Hash->Lanes[1], RevReadContentWord64(Hash->Stripe + 8));
+        Hash->Lanes[2] = RevMixContentLane(Hash->Lanes[2], RevReadContentWord64(Hash->Stripe + 16));
+        Hash->Lanes[3] = RevMixContentLane(Hash->Lanes[3], RevReadContentWord64(Hash->Stripe + 24));
+        Hash->CountOfStripeBytes = 0;
     }
 
     /*
-     * Concatenate the second string to the result.
+     * The lanes do not depend on each other, so the multiplications of a
+     * stripe run in parallel. They are kept in locals for the compiler to
+     * keep them in registers.
      */
-    if (wcscat_s(result, resultStringLength, String2) != 0) {
-        free(result);
-        result = NULL;
-        goto Exit;
+    lane0 = Hash->Lanes[0];
+    lane1 = Hash->Lanes[1];
+    lane2 = Hash->Lanes[2];
+    lane3 = Hash->Lanes[3];
+
+    while ((SIZE_T)(end - bytes) >= REVISION_CONTENT_STRIPE_SIZE) {
+        lane0 = RevMixContentLane(lane0, RevReadContentWord64(bytes));
+        lane1 = RevMixContentLane(lane1, RevReadContentWord64(bytes + 8));
+        lane2 = RevMixContentLane(lane2, RevReadContentWord64(bytes + 16));
+        lane3 = RevMixContentLane(lane3, RevReadContentWord64(bytes + 24));
+        bytes += REVISION_CONTENT_STRIPE_SIZE;
     }
 
-Exit:
-    return result;
+    Hash->Lanes[0] = lane0;
+    Hash->Lanes[1] = lane1;
+    Hash->Lanes[2] = lane2;
+    Hash->Lanes[3] = lane3;
+
+    countOfBytes = (SIZE_T)(end - bytes);
+    if (countOfBytes > 0) {
+        memcpy(Hash->Stripe, bytes, countOfBytes);
+        Hash->CountOfStripeBytes = countOfBytes;
+    }
 }
 
-_Ret_maybenull_
-_Must_inspect_result_
-PWCHAR
-RevStringPrepend(
-    _In_z_ PWCHAR String1,
-    _In_z_ PWCHAR String2
+ULONGLONG
+RevFinalizeContentHash(
+    _In_ PREVISION_CONTENT_HASH Hash
     )
 {
-    SIZE_T string1Length;
-    SIZE_T string2Length;
-    SIZE_T resultStringLength;
-    PWCHAR result;
+    ULONGLONG hash;
+    const UCHAR *bytes = Hash->Stripe;
+    SIZE_T countOfBytes = Hash->CountOfStripeBytes;
 
-    if (String1 == NULL || String2 == NULL) {
-        RevLogError("Invalid parameter/-s.");
-        result = NULL;
-        goto Exit;
+    if (Hash->Size >= REVISION_CONTENT_STRIPE_SIZE) {
+        hash = RevRotateLeft64(Hash->Lanes[0], 1) +
+               RevRotateLeft64(Hash->Lanes[1], 7) +
+               RevRotateLeft64(Hash->Lanes[2], 12) +
+               RevRotateLeft64(Hash->Lanes[3], 18);
+        hash = RevMergeContentLane(hash, Hash->Lanes[0]);
+        hash = RevMergeContentLane(hash, Hash->Lanes[1]);
+        hash = RevMergeContentLane(hash, Hash->Lanes[2]);
+        hash = RevMergeContentLane(hash, Hash->Lanes[3]);
+    } else {
+        hash = REVISION_CONTENT_PRIME5;
     }
 
-    /*
-     * Find the length of the result string.
-     */
-    string1Length = wcslen(String1);
-    string2Length = wcslen(String2);
-    resultStringLength = string1Length + string2Length + 1;
+    hash += Hash->Size;
 
     /*
-     * Allocate buffer for the new string.
+     * Mix in the bytes short of a stripe, then let every bit of the hash
+     * depend on every other.
      */
-    result = (PWCHAR) malloc(resultStringLength * sizeof(WCHAR));
-    if (result == NULL) {
-        RevLogError("Failed to allocate string buffer (%llu bytes).",
-                    resultStringLength * sizeof(WCHAR));
-        goto Exit;
+    while (countOfBytes >= 8) {
+        hash ^= RevMixContentLane(0, RevReadContentWord64(bytes));
+        hash = RevRotateLeft64(hash, 27) * REVISION_CONTENT_PRIME1 + REVISION_CONTENT_PRIME4;
+        bytes += 8;
+        countOfBytes -= 8;
     }
 
-    /*
-     * Copy the second string to the beginning of the result.
-     */
-    if (wcscpy_s(result, resultStringLength, String2) != 0) {
-        free(result);
-        result = NULL;
-        goto Exit;
+    if (countOfBytes >= 4) {
+        hash ^= RevReadContentWord32(bytes) * REVISION_CONTENT_PRIME1;
+        hash = RevRotateLeft64(hash, 23) * REVISION_CONTENT_PRIME2 + REVISION_CONTENT_PRIME3;
+        bytes += 4;
+        countOfBytes -= 4;
     }
 
-    /*
-     * Concatenate the first string to the result.
-     */
-    if (wcscat_s(result, resultStringLength, String1) != 0) {
-        free(result);
-        result = NULL;
-        goto Exit;
+    while (countOfBytes > 0) {
+        hash ^= *bytes * REVISION_CONTENT_PRIME5;
+        hash = RevRotateLeft64(hash, 11) * REVISION_CONTENT_PRIME1;
+        bytes += 1;
+        countOfBytes -= 1;
     }
 
-Exit:
-    return result;
+    hash ^= hash >> 33;
+    hash *= REVISION_CONTENT_PRIME2;
+    hash ^= hash >> 29;
+    hash *= REVISION_CONTENT_PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
 }
 
-BOOL
-RevInitializeRevision(
-    _In_ PREVISION_INIT_PARAMS InitParams
+ULONGLONG
+RevHashContents(
+    _In_reads_bytes_(Size) const CHAR *Buffer,
+    _In_ SIZE_T Size
     )
 {
-    BOOL status = TRUE;
+    REVISION_CONTENT_HASH hash;
 
-    if (Revision != NULL) {
-        RevLogError("The revision is already initialized.");
-        status = FALSE;
-        goto Exit;
+    RevInitializeContentHash(&hash);
+    RevUpdateContentHash(&hash, Buffer, Size);
+
+    return RevFinalizeContentHash(&hash);
+}
+
+VOID
+RevInitializeIdentitySet(
+    _Out_ PREVISION_IDENTITY_SET Set
+    )
+{
+    ULONG index;
+
+    for (index = 0; index < REVISION_IDENTITY_SHARD_COUNT; ++index) {
+        InitializeSRWLock(&Set->Shards[index].Lock);
+        Set->Shards[index].Keys = NULL;
+        Set->Shards[index].Capacity = 0;
+        Set->Shards[index].Count = 0;
+        Set->Shards[index].WideKeys = NULL;
+        Set->Shards[index].WideCapacity = 0;
+        Set->Shards[index].WideCount = 0;
     }
 
-    if (InitParams == NULL ||
-        InitParams->RootDirectory == NULL) {
+    InitializeSRWLock(&Set->DeviceLock);
+    Set->Devices = NULL;
+    Set->CountOfDevices = 0;
+    Set->DevicesCapacity = 0;
+}
 
-        RevLogError("Invalid parameter/-s.");
-        status = FALSE;
-        goto Exit;
+VOID
+RevDeleteIdentitySet(
+    _Inout_ PREVISION_IDENTITY_SET Set
+    )
+{
+    ULONG index;
+
+    for (index = 0; index < REVISION_IDENTITY_SHARD_COUNT; ++index) {
+        free(Set->Shards[index].Keys);
+        Set->Shards[index].Keys = NULL;
+        Set->Shards[index].Capacity = 0;
+        Set->Shards[index].Count = 0;
+
+        free(Set->Shards[index].WideKeys);
+        Set->Shards[index].WideKeys = NULL;
+        Set->Shards[index].WideCapacity = 0;
+        Set->Shards[index].WideCount = 0;
     }
 
+    free(Set->Devices);
+    Set->Devices = NULL;
+    Set->CountOfDevices = 0;
+    Set->DevicesCapacity = 0;
+}
+
+ULONG
+RevQueryDeviceIndex(
+    _Inout_ PREVISION_IDENTITY_SET Set,
+    _In_ ULONGLONG Device
+    )
+{
+    ULONG deviceIndex = 0;
+    SIZE_T index;
+
     /*
-     * Initialize the revision structure.
+     * A tree spans a handful of devices, and the device of a directory is
+     * only looked up once, so a linear search is all it takes.
      */
+    AcquireSRWLockExclusive(&Set->DeviceLock);
 
-    Revision = (PREVISION)malloc(sizeof(REVISION));
-    if (Revision == NULL) {
-        RevLogError("Failed to allocate memory for the global revision "
-                    "structure (%llu bytes).",
-                    sizeof(REVISION));
-        status = FALSE;
-        goto Exit;
+    for (index = 0; index < Set->CountOfDevices; ++index) {
+        if (Set->Devices[index] == Device) {
+            deviceIndex = (ULONG)index + 1;
+            goto Exit;
+        }
     }
 
-    /*
-     * Initialize the list of revision records and other fields.
-     */
-    RevInitializeListHead(&Revision->RevisionRecordListHead);
-    Revision->InitParams = *InitParams;
-    Revision->CountOfLinesTotal = 0;
-    Revision->CountOfLinesBlank = 0;
-    Revision->CountOfFiles = 0;
-    Revision->CountOfIgnoredFiles = 0;
+    if (Set->CountOfDevices < REVISION_IDENTITY_MAX_DEVICES &&
+        RevReserveCacheRoom((PVOID *)&Set->Devices,
+                            &Set->DevicesCapacity,
+                            Set->CountOfDevices + 1,
+                            sizeof(ULONGLONG))) {
+        Set->Devices[Set->CountOfDevices] = Device;
+        Set->CountOfDevices += 1;
+        deviceIndex = (ULONG)Set->CountOfDevices;
+    }
 
 Exit:
-    return status;
+    ReleaseSRWLockExclusive(&Set->DeviceLock);
+
+    return deviceIndex;
 }
 
+_Must_inspect_result_
 BOOL
-RevStartRevision(
-    VOID
+RevInsertIdentity(
+    _Inout_ PREVISION_IDENTITY_SET Set,
+    _In_ ULONG DeviceIndex,
+    _In_ ULONGLONG Inode
     )
 {
-    BOOL status = TRUE;
+    PREVISION_IDENTITY_SHARD shard;
+    PULONGLONG slot;
+    PREVISION_IDENTITY wideSlot;
+    ULONGLONG key;
+    BOOL isInserted = TRUE;
 
-    if (Revision == NULL ||
-        Revision->InitParams.RootDirectory == NULL) {
-        RevLogError("The revision is not initialized/initialized correctly.");
-        status = FALSE;
-        goto Exit;
+    if (DeviceIndex == 0) {
+        return TRUE;
     }
 
-    RevEnumerateRecursively(Revision->InitParams.RootDirectory);
+    /*
+     * Most inodes fit in a packed key. The slot is taken from the low bits
+     * of the hash of the key, the shard from higher ones.
+     */
+    if (Inode < (1ULL << REVISION_IDENTITY_INODE_BITS)) {
+        key = ((ULONGLONG)DeviceIndex << REVISION_IDENTITY_INODE_BITS) | Inode;
+        shard = &Set->Shards[(ULONG)(RevHashIdentity(key) >> 32) % REVISION_IDENTITY_SHARD_COUNT];
+
+        AcquireSRWLockExclusive(&shard->Lock);
+
+        if (shard->Capacity > 0 && *RevFindIdentitySlot(shard, key) == key) {
+            isInserted = FALSE;
+            goto Exit;
+        }
+
+        /*
+         * Keep a quarter of the slots free, so that probes stay short.
+         */
+        if (shard->Count >= shard->Capacity / 4 * 3 &&
+            !RevGrowIdentityShard(shard)) {
+            goto Exit;
+        }
+
+        slot = RevFindIdentitySlot(shard, key);
+        *slot = key;
+        shard->Count += 1;
+    } else {
+        key = Inode ^ RevRotateLeft64(DeviceIndex, 32);
+        shard = &Set->Shards[(ULONG)(RevHashIdentity(key) >> 32) % REVISION_IDENTITY_SHARD_COUNT];
+
+        AcquireSRWLockExclusive(&shard->Lock);
+
+        if (shard->WideCapacity > 0 &&
+            RevFindWideIdentitySlot(shard, DeviceIndex, Inode)->DeviceIndex != 0) {
+            isInserted = FALSE;
+            goto Exit;
+        }
+
+        if (shard->WideCount >= shard->WideCapacity / 4 * 3 &&
+            !RevGrowWideIdentityShard(shard)) {
+            goto Exit;
+        }
+
+        wideSlot = RevFindWideIdentitySlot(shard, DeviceIndex, Inode);
+        wideSlot->DeviceIndex = DeviceIndex;
+        wideSlot->Inode = Inode;
+        shard->WideCount += 1;
+    }
 
 Exit:
-    return status;
+    ReleaseSRWLockExclusive(&shard->Lock);
+
+    return isInserted;
 }
 
-_Ret_maybenull_
-PREVISION_RECORD
-RevInitializeRevisionRecord(
-    _In_z_ PWCHAR Extension,
-    _In_z_ PWCHAR LanguageOrFileType
+PULONGLONG
+RevFindIdentitySlot(
+    _In_ PREVISION_IDENTITY_SHARD Shard,
+    _In_ ULONGLONG Key
     )
 {
-    PREVISION_RECORD revisionRecord;
+    SIZE_T mask = Shard->Capacity - 1;
+    SIZE_T index = (SIZE_T)RevHashIdentity(Key) & mask;
 
-    revisionRecord = (PREVISION_RECORD)malloc(sizeof(REVISION_RECORD));
-    if (revisionRecord == NULL) {
-        RevLogError("Failed to allocate memory for the revision record "
-                    "(%llu bytes).",
-                    sizeof(REVISION_RECORD));
-        return NULL;
+    while (Shard->Keys[index] != 0 && Shard->Keys[index] != Key) {
+        index = (index + 1) & mask;
     }
 
-    revisionRecord->ExtensionMapping.Extension = Extension;
-    revisionRecord->ExtensionMapping.LanguageOrFileType = LanguageOrFileType;
-    revisionRecord->CountOfLinesTotal = 0;
-    revisionRecord->CountOfLinesBlank = 0;
-    revisionRecord->CountOfFiles = 0;
-    RevInitializeListHead(&revisionRecord->ListEntry);
+    return &Shard->Keys[index];
+}
+
+PREVISION_IDENTITY
+RevFindWideIdentitySlot(
+    _In_ PREVISION_IDENTITY_SHARD Shard,
+    _In_ ULONGLONG DeviceIndex,
+    _In_ ULONGLONG Inode
+    )
+{
+    SIZE_T mask = Shard->WideCapacity - 1;
+    SIZE_T index = (SIZE_T)RevHashIdentity(Inode ^ RevRotateLeft64(DeviceIndex, 32)) & mask;
+    PREVISION_IDENTITY slot = &Shard->WideKeys[index];
+
+    while (slot->DeviceIndex != 0 &&
+           (slot->DeviceIndex != DeviceIndex || slot->Inode != Inode)) {
+        index = (index + 1) & mask;
+        slot = &Shard->WideKeys[index];
+    }
 
-    return revisionRecord;
+    return slot;
 }
 
-_Ret_maybenull_
-PWCHAR
-RevMapExtensionToLanguage(
-    _In_z_ PWCHAR Extension
+_Must_inspect_result_
+BOOL
+RevGrowIdentityShard(
+    _Inout_ PREVISION_IDENTITY_SHARD Shard
     )
 {
-    LONG index = 0;
+    PULONGLONG keys = Shard->Keys;
+    SIZE_T capacity = Shard->Capacity;
+    SIZE_T index;
 
-    if (Extension == NULL) {
-        RevLogError("Extension is NULL.");
-        return NULL;
+    Shard->Capacity = capacity == 0 ? REVISION_IDENTITY_INITIAL_CAPACITY : capacity * 2;
+    Shard->Keys = (PULONGLONG)calloc(Shard->Capacity, sizeof(ULONGLONG));
+    if (Shard->Keys == NULL) {
+        Shard->Keys = keys;
+        Shard->Capacity = capacity;
+        return FALSE;
     }
 
-    do {
-        if (wcscmp(Extension, ExtensionMappingTable[index].Extension) == 0) {
-            return ExtensionMappingTable[index].LanguageOrFileType;
+    for (index = 0; index < capacity; ++index) {
+        if (keys[index] != 0) {
+            *RevFindIdentitySlot(Shard, keys[index]) = keys[index];
         }
-        ++index;
-    } while (index < ARRAYSIZE(ExtensionMappingTable));
+    }
 
-    return NULL;
+    free(keys);
+
+    return TRUE;
 }
 
-_Ret_maybenull_
 _Must_inspect_result_
-PREVISION_RECORD
-RevFindRevisionRecordForLanguageByExtension(
-    _In_z_ PWCHAR Extension
+BOOL
+RevGrowWideIdentityShard(
+    _Inout_ PREVISION_IDENTITY_SHARD Shard
     )
 {
-    PLIST_ENTRY entry;
-    PWCHAR languageOrFileType;
-    PREVISION_RECORD revisionRecord;
+    PREVISION_IDENTITY wideKeys = Shard->WideKeys;
+    SIZE_T capacity = Shard->WideCapacity;
+    SIZE_T index;
 
-    if (Extension == NULL) {
-        RevLogError("Extension is NULL.");
-        return NULL;
+    Shard->WideCapacity = capacity == 0 ? REVISION_IDENTITY_INITIAL_CAPACITY : capacity * 2;
+    Shard->WideKeys = (PREVISION_IDENTITY)calloc(Shard->WideCapacity,
+                                                 sizeof(REVISION_IDENTITY));
+    if (Shard->WideKeys == NULL) {
+        Shard->WideKeys = wideKeys;
+        Shard->WideCapacity = capacity;
+        return FALSE;
     }
 
-    /*
-     * Map the provided file extension to a language or file type.
-     */
-    languageOrFileType = RevMapExtensionToLanguage(Extension);
-    if (languageOrFileType == NULL) {
-        RevLogError("No langauge/file type match was found for the extension \"%ls\".",
-                    Extension);
-        return NULL;
+    for (index = 0; index < capacity; ++index) {
+        if (wideKeys[index].DeviceIndex != 0) {
+            *RevFindWideIdentitySlot(Shard,
+                                     wideKeys[index].DeviceIndex,
+                                     wideKeys[index].Inode) = wideKeys[index];
+        }
     }
 
-    assert(Revision != NULL);
+    free(wideKeys);
 
-    entry = Revision->RevisionRecordListHead.Flink;
+    return TRUE;
+}
 
-    while (entry != &Revision->RevisionRecordListHead) {
-        revisionRecord = CONTAINING_RECORD(entry, REVISION_RECORD, ListEntry);
+VOID
+RevMeasureIdentitySet(
+    _In_ PREVISION_IDENTITY_SET Set,
+    _Out_ PSIZE_T CountOfKeys,
+    _Out_ PSIZE_T CountOfBytes
+    )
+{
+    PREVISION_IDENTITY_SHARD shard;
+    ULONG index;
 
-        /*
-         * Check if there is a match.
-         */
-        if (wcscmp(revisionRecord->ExtensionMapping.LanguageOrFileType,
-                   languageOrFileType) == 0) {
-            return revisionRecord;
-        }
+    *CountOfKeys = 0;
+    *CountOfBytes = 0;
 
-        entry = entry->Flink;
+    for (index = 0; index < REVISION_IDENTITY_SHARD_COUNT; ++index) {
+        shard = &Set->Shards[index];
+        *CountOfKeys += shard->Count + shard->WideCount;
+        *CountOfBytes += shard->Capacity * sizeof(ULONGLONG) +
+                         shard->WideCapacity * sizeof(REVISION_IDENTITY);
     }
+}
+
+_Must_inspect_result_
+BOOL
+RevClaimDirectory(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_DIRECTORY Directory
+    )
+{
+    PREVISION revision = Worker->Revision;
 
     /*
-     * If no matching language or file type was found for the provided extension
-     * initialize a new revision record.
+     * A directory whose version cannot be queried is enumerated all the
+     * same, but its files are not checked for links.
      */
-    revisionRecord = RevInitializeRevisionRecord(Extension,
-                                                 languageOrFileType);
-    if (revisionRecord == NULL) {
-        RevLogError("Failed to initialize a revision record (\"%ls\", \"%ls\").",
-                    Extension,
-                    languageOrFileType);
-        return NULL;
+    if (!RevQueryDirectoryKey(revision, Directory)) {
+        return TRUE;
     }
 
+    Directory->DeviceIndex = RevQueryDeviceIndex(&revision->IdentitySet,
+                                                 Directory->CacheKey.Device);
+
     /*
-     * Add the new revision record to the global list of revision records.
+     * Without following symbolic links, a directory is only ever reached
+     * from its parent, so it need not be stored.
      */
-    RevInsertTailList(&Revision->RevisionRecordListHead,
-                      &revisionRecord->ListEntry);
+    if (!revision->InitParams.IsSymlinkFollowed ||
+        RevInsertIdentity(&revision->IdentitySet,
+                          Directory->DeviceIndex,
+                          Directory->CacheKey.Inode)) {
+        return TRUE;
+    }
 
-    return revisionRecord;
+    Worker->CountOfLinkedDirectories += 1;
+
+    return FALSE;
 }
 
 _Must_inspect_result_
 BOOL
-RevEnumerateRecursively(
-    _In_z_ PWCHAR RootDirectoryPath
+RevClaimFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG DeviceIndex,
+    _In_ ULONGLONG Inode
     )
 {
-    BOOL status = TRUE;
-    HANDLE findFile = INVALID_HANDLE_VALUE;
-    WIN32_FIND_DATAW findFileData;
-    PWCHAR subPath = NULL;
-    PWCHAR searchPath = NULL;
-
-    /*
-     * Check validity of passed arguments.
-     */
-    if (RootDirectoryPath == NULL) {
-        RevLogError("Invalid parameter/-s.");
-        status = FALSE;
-        goto Exit;
+    if (RevInsertIdentity(&Worker->Revision->IdentitySet, DeviceIndex, Inode)) {
+        return TRUE;
     }
 
-    /*
-     * Each directory path should indicate that we are examining all files.
-     * Check if the passed RootDirectoryPath already includes the wildcard (*).
-     */
-    if (wcsstr(RootDirectoryPath, ASTERISK) == NULL) {
-        /*
-         * If no, append a wildcard character to the root path.
-         */
-        searchPath = RevStringAppend(RootDirectoryPath,
-                                     ASTERISK);
-        if (searchPath == NULL) {
-            RevLogError("Failed to normalize the revision subdirectory path "
-                        "(RevStringAppend failed).");
-            status = FALSE;
-            goto Exit;
-        }
-    }
+    Worker->CountOfLinkedFiles += 1;
 
-    /*
-     * Try to find a file or subdirectory with a name that matches the pattern.
-     */
-    findFile = FindFirstFileW(searchPath,
-                              &findFileData);
+    return FALSE;
+}
 
-    /*
-     * Free after RevStringAppend.
-     */
-    free(searchPath);
-    searchPath = NULL;
+_Must_inspect_result_
+PCHAR
+RevAcquireBuffer(
+    _Inout_ PREVISION_BUFFER_POOL Pool,
+    _In_ SIZE_T Size,
+    _Out_ SIZE_T *Capacity
+    )
+{
+    ULONG sizeClass = 0;
+    PCHAR buffer;
 
-    /*
-     * Check if FindFirstFileW failed.
-     */
-    if (findFile == INVALID_HANDLE_VALUE) {
-        RevLogError("Failed to find a file named \"%ls\" to start the enumeration. "
-                    "The last known error: %ls",
-                    RootDirectoryPath,
-                    RevGetLastKnownWin32Error());
-        status = FALSE;
-        goto Exit;
+    while (sizeClass < REVISION_BUFFER_CLASSES - 1 &&
+           ((SIZE_T)REVISION_PAGE_SIZE << sizeClass) < Size) {
+        sizeClass += 1;
     }
 
-    do {
-        if (wcscmp(findFileData.cFileName, L".") == 0 ||
-            wcscmp(findFileData.cFileName, L"..") == 0) {
+    *Capacity = (SIZE_T)REVISION_PAGE_SIZE << sizeClass;
 
-            /*
-             * We want to skip one dot (for the current location) and
-             * two dots (for the parent directory).
-             */
-            continue;
-        }
+    buffer = Pool->FreeBuffers[sizeClass];
+    if (buffer != NULL) {
+        memcpy(&Pool->FreeBuffers[sizeClass], buffer, sizeof(PCHAR));
+        Pool->CountOfHits += 1;
+        return buffer;
+    }
 
-        /*
-         * To construct a subpath, append the "\" to the RootDirectoryPath.
-         */
-        subPath = RevStringAppend(RootDirectoryPath,
-                                  L"\\");
-        if (subPath == NULL) {
-            RevLogError("Failed to normalize the revision subdirectory path "
-                        "(RevStringAppend failed).");
-            status = FALSE;
-            break;
-        }
+    buffer = (PCHAR)_aligned_malloc(*Capacity, REVISION_PAGE_SIZE);
+    if (buffer == NULL) {
+        RevLogError(NULL,
+                    "Failed to allocate a read buffer (%llu bytes).",
+                    (ULONGLONG)*Capacity);
+        return NULL;
+    }
 
-        /*
-         * Then append the subdirectory name that need to be traversed next.
-         * N.B. The wildcard character (an asterisk) is not needed to be added
-         * as it is done before calling FindFirstFileW.
-         */
-        subPath = RevStringAppend(subPath,
-                                  findFileData.cFileName);
-        if (subPath == NULL) {
-            RevLogError("Failed to normalize the revision subdirectory path "
-                        "(RevStringAppend failed).");
-            status = FALSE;
-            break;
-        }
+    Pool->CountOfAllocations += 1;
+    Pool->CountOfBytesAllocated += *Capacity;
 
-        /*
-         * Check if found a subdirectory.
-         */
-        if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+    return buffer;
+}
 
-            /*
-             * Recursively traverse a subdirectory.
-             */
-            if (!RevEnumerateRecursively(subPath)) {
-                RevLogError("Recursive subdirectory traversal failed.");
-                status = FALSE;
-                break;
-            }
-        } else {
+VOID
+RevReleaseBuffer(
+    _Inout_ PREVISION_BUFFER_POOL Pool,
+    _In_ PCHAR Buffer,
+    _In_ SIZE_T Capacity
+    )
+{
+    ULONG sizeClass = 0;
 
-            /*
-             * If found a file, check if the file should be revised, and if so,
-             * revise it.
-             *
-             * The revision should be performed only if the file extension has
-             * been recognized. For this purpose it is enough to pass only the
-             * file name (findFileData.cFileName), but for file revision the
-             * full path (subdirectoryPath) is required.
-             */
-            if (RevShouldReviseFile(findFileData.cFileName)) {
-                if (!RevReviseFile(subPath)) {
-                    RevLogError("RevReviseFile failed to revise the file \"%ls\".",
-                                subPath);
-                }
-            } else {
+    while (((SIZE_T)REVISION_PAGE_SIZE << sizeClass) < Capacity) {
+        sizeClass += 1;
+    }
 
-                /* Increment the total count of ignored files. */
-                Revision->CountOfIgnoredFiles += 1;
-            }
-        }
+    assert(sizeClass < REVISION_BUFFER_CLASSES);
 
-    } while (FindNextFileW(findFile, &findFileData) != 0);
+    memcpy(Buffer, &Pool->FreeBuffers[sizeClass], sizeof(PCHAR));
+    Pool->FreeBuffers[sizeClass] = Buffer;
+}
 
-    FindClose(findFile);
+VOID
+RevDeleteBufferPool(
+    _Inout_ PREVISION_BUFFER_POOL Pool
+    )
+{
+    ULONG sizeClass;
+    PCHAR buffer;
 
-Exit:
-    /*
-     * Free after RevStringAppend.
-     */
-    if (RootDirectoryPath) {
-        free(RootDirectoryPath);
+    for (sizeClass = 0; sizeClass < REVISION_BUFFER_CLASSES; ++sizeClass) {
+        while (Pool->FreeBuffers[sizeClass] != NULL) {
+            buffer = Pool->FreeBuffers[sizeClass];
+            memcpy(&Pool->FreeBuffers[sizeClass], buffer, sizeof(PCHAR));
+            _aligned_free(buffer);
+        }
     }
-
-    return status;
 }
 
 _Must_inspect_result_
 BOOL
-RevShouldReviseFile(
-    _In_z_ PWCHAR FileName
+RevStreamFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ PREVISION_FILE_BUFFER File,
+    _In_ FILEHANDLE Handle,
+    _In_ ULONGLONG FileSize
     )
 {
-    LONG i;
-    PWCHAR fileExtension;
+    BOOL status = TRUE;
+    PREVISION_LANGUAGE_SYNTAX syntax = LanguageSyntax[File->Mapping->LanguageId];
+    REVISION_LINE_STATE lineState = {0};
+    REVISION_SCANNER scanner = {0};
+    PCHAR buffer;
+    SIZE_T capacity;
+    SIZE_T bytesRead;
+    SIZE_T bytesCarried = 0;
+    SIZE_T bytesClassified;
+    BOOL isLastChunk;
+    BOOL isContentHashed = Worker->Revision->InitParams.IsContentDeduplicated;
+    REVISION_CONTENT_HASH contentHash;
 
-    if (FileName == NULL) {
-        RevLogError("FileName is NULL.");
-        return FALSE;
-    }
+    RevInitializeContentHash(&contentHash);
 
     /*
-     * Find the file extension.
+     * Size the buffer to the file, up to one chunk, so that a worker
+     * streaming small files does not hold a large buffer. One byte more
+     * lets the first read see the end of a file that fits.
      */
-    fileExtension = wcsrchr(FileName, L'.');
-    if (fileExtension == NULL) {
-        RevLogWarning("Failed to determine the extension for the file \"%ls\".",
-                      FileName);
+    buffer = RevAcquireBuffer(&Worker->BufferPool,
+                              FileSize < REVISION_READ_CHUNK_SIZE ?
+                                  (SIZE_T)FileSize + 1 :
+                                  REVISION_READ_CHUNK_SIZE,
+                              &capacity);
+    if (buffer == NULL) {
         return FALSE;
     }
 
     /*
-     * Check if the extension matches any entries in the ExtensionMappingTable.
+     * Stream the file through the buffer one chunk at a time, so that
+     * memory use does not depend on the size of the file. A chunk that
+     * does not fill the buffer is the last one.
      */
-    for (i = 0; i < ARRAYSIZE(ExtensionMappingTable); ++i) {
-        if (wcscmp(ExtensionMappingTable[i].Extension, fileExtension) == 0) {
-            return TRUE;
+    do {
+        if (!RevReadFileChunk(Worker->Revision,
+                              File->Directory,
+                              File->FileName,
+                              Handle,
+                              buffer + bytesCarried,
+                              capacity - bytesCarried,
+                              &bytesRead)) {
+            status = FALSE;
+            goto Exit;
+        }
+
+        Worker->CountOfBytesRead += bytesRead;
+        isLastChunk = bytesRead < capacity - bytesCarried;
+
+        /*
+         * Hash the chunk while it is in the cache, before it is counted.
+         * The bytes carried over were hashed with the previous one.
+         */
+        if (isContentHashed) {
+            RevUpdateContentHash(&contentHash, buffer + bytesCarried, bytesRead);
+        }
+
+        bytesRead += bytesCarried;
+
+        if (syntax != NULL) {
+
+            /*
+             * The classifier may leave the bytes of a comment or string
+             * marker split by the end of the chunk; carry them over to the
+             * start of the next one.
+             */
+            bytesClassified = RevClassifyLines(buffer,
+                                               bytesRead,
+                                               isLastChunk,
+                                               syntax,
+                                               LineCounter->SkipRoutine,
+                                               &scanner);
+            bytesCarried = bytesRead - bytesClassified;
+            memmove(buffer, buffer + bytesClassified, bytesCarried);
+        } else {
+            LineCounter->Routine(buffer, bytesRead, &lineState);
         }
+    } while (!isLastChunk);
+
+    if (isContentHashed) {
+        File->ContentHash = RevFinalizeContentHash(&contentHash);
+        File->HasContentHash = TRUE;
     }
 
-    return FALSE;
+    if (syntax != NULL) {
+        RevRecordFileLines(Worker,
+                           File,
+                           scanner.CountOfLinesTotal,
+                           scanner.CountOfLinesBlank,
+                           scanner.CountOfLinesComment);
+    } else {
+        RevCompleteLineCount(&lineState);
+        RevRecordFileLines(Worker,
+                           File,
+                           lineState.CountOfLinesTotal,
+                           lineState.CountOfLinesBlank,
+                           0);
+    }
+
+Exit:
+    RevReleaseBuffer(&Worker->BufferPool, buffer, capacity);
+
+    return status;
 }
 
+#ifdef REVISION_IO_URING
+
 _Must_inspect_result_
 BOOL
-RevReviseFile(
-    _In_z_ PWCHAR FilePath
+RevInitializeRing(
+    _In_ PREVISION Revision,
+    _Out_ PREVISION_RING Ring
     )
 {
     BOOL status = TRUE;
-    PREVISION_RECORD revisionRecord;
-    ULONGLONG lineCountTotal = 0;
-    ULONGLONG lineCountBlank = 0;
-    PCHAR fileBuffer = NULL;
-    DWORD fileBufferSize;
-    PWCHAR fileExtension;
-    HANDLE file;
-    LARGE_INTEGER fileSize;
-    DWORD bytesRead;
-    BOOL isPreviousCharCarriageReturn;
-    BOOL isNextCharCarriageReturn;
-    BOOL isNextCharNewline;
-    DWORD index;
+    struct io_uring_params params;
+    struct iovec bufferPool;
+    int fileTable[REVISION_RING_SLOTS];
+    ULONG index;
+    int handle;
 
-    /*
-     * Attempt to open the file.
-     */
-    file = CreateFile(FilePath,
-                      GENERIC_READ,
-                      FILE_SHARE_READ,
-                      NULL,
-                      OPEN_EXISTING,
-                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                      NULL);
-    if (file == INVALID_HANDLE_VALUE) {
-        RevLogError("Failed to open the file \"%ls\". "
-                    "The last known error: %ls.",
-                    FilePath,
-                    RevGetLastKnownWin32Error());
+    memset(Ring, 0, sizeof(*Ring));
+    Ring->Handle = -1;
+    Ring->FreeSlot = REVISION_RING_SLOTS;
+
+    memset(&params, 0, sizeof(params));
+    handle = (int)syscall(__NR_io_uring_setup,
+                          REVISION_RING_SLOTS * RevisionRingOperations,
+                          &params);
+    if (handle < 0) {
+        RevLogWarning(Revision,
+                      "Failed to set up io_uring, reading files with blocking "
+                      "system calls. The last known error: %ls.",
+                      RevGetLastKnownWin32Error());
         status = FALSE;
         goto Exit;
     }
 
+    Ring->Handle = handle;
+
     /*
-     * Retrieve the size of the file
+     * The read of a file goes to the direct descriptor its open creates
+     * in the same link, which needs the kernel to assign the files of
+     * linked requests only when they are issued.
      */
-    if (!GetFileSizeEx(file, &fileSize)) {
-        RevLogError("Failed to retrieve the size of the file \"%ls\". "
-                    "The last known error: %ls.",
-                    FilePath,
-                    RevGetLastKnownWin32Error());
+    if ((params.features & IORING_FEAT_LINKED_FILE) == 0) {
+        RevLogWarning(Revision,
+                      "The kernel does not support linked file assignment, "
+                      "reading files with blocking system calls.");
         status = FALSE;
         goto Exit;
     }
 
-    /*
-     * Allocate buffer for the entire file.
-     * N.B. Currently, reading only ANSI files is supported, so the read buffer
-     * is allocated with a size that takes sizeof(CHAR) into account.
-     * It is assumed that most source code files do not use utf-16 encoding, but
-     * support for encoding detection should be added in the future.
-     */
-    fileBufferSize = (DWORD)fileSize.QuadPart * sizeof(CHAR);
-    fileBuffer = (PCHAR)malloc(fileBufferSize);
-    if (fileBuffer == NULL) {
-        RevLogError("Failed to allocate a line buffer (%llu bytes)",
-                    fileSize.QuadPart * sizeof(CHAR));
-        status = FALSE;
-        goto Exit;
+    Ring->SubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    Ring->CompletionRingSize = params.cq_off.cqes +
+                               params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (Ring->CompletionRingSize > Ring->SubmissionRingSize) {
+            Ring->SubmissionRingSize = Ring->CompletionRingSize;
+        }
     }
 
-    /*
-     * Attempt to read the file.
-     */
-    if (!ReadFile(file,
-                  fileBuffer,
-                  fileBufferSize,
-                  &bytesRead,
-                  NULL)) {
-        RevLogError("Failed to read the file \"%ls\". "
-                    "The last known error: %ls.",
-                    FilePath,
-                    RevGetLastKnownWin32Error());
+    Ring->SubmissionRing = mmap(NULL,
+                                Ring->SubmissionRingSize,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE,
+                                handle,
+                                IORING_OFF_SQ_RING);
+    if (Ring->SubmissionRing == MAP_FAILED) {
+        Ring->SubmissionRing = NULL;
         status = FALSE;
         goto Exit;
     }
 
-    for (index = 0; index < bytesRead; index++) {
-        if (fileBuffer[index] == '\n') {
-
-            /*
-             * Increment the total line count for every newline
-             * character encountered.
-             */
-            ++lineCountTotal;
-
-            /* Check if the previous character is a carriage return character. */
-            isPreviousCharCarriageReturn = (index > 0) && (fileBuffer[index - 1] == '\r');
-
-            /* Check if the next character is a carriage return character. */
-            isNextCharCarriageReturn = (index < bytesRead - 2) && (fileBuffer[index + 1] == '\r');
-
-            /* Check if the character after the next one is a newline character. */
-            isNextCharNewline = (index < bytesRead - 2) && (fileBuffer[index + 2] == '\n');
-
-            /*
-             * Check is it a blank line?
-             */
-            if (isPreviousCharCarriageReturn &&
-                isNextCharCarriageReturn &&
-                isNextCharNewline) {
-
-                /* If so, increment the blank line count. */
-                ++lineCountBlank;
-            }
-        }
-    }
-    if (fileSize.QuadPart > 0) {
-        /*
-         * Increment the total line count for the last line.
-         */
-        ++lineCountTotal;
-
-        /*
-         * Check if the last line is a blank line.
-         */
-        if (bytesRead > 1 &&
-            fileBuffer[bytesRead - 2] == '\r' &&
-            fileBuffer[bytesRead - 1] == '\n') {
-            /* If so, increment the blank line count. */
-            ++lineCountBlank;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        Ring->CompletionRing = Ring->SubmissionRing;
+    } else {
+        Ring->CompletionRing = mmap(NULL,
+                                    Ring->CompletionRingSize,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE,
+                                    handle,
+                                    IORING_OFF_CQ_RING);
+        if (Ring->CompletionRing == MAP_FAILED) {
+            Ring->CompletionRing = NULL;
+            status = FALSE;
+            goto Exit;
         }
     }
 
-    /*
-     * Find the file extension.
-     */
-    fileExtension = wcsrchr(FilePath, L'.');
-    if (fileExtension == NULL) {
-        RevLogError("Failed to determine the extension for the file \"%ls\".",
-                    FilePath);
+    Ring->SubmissionsSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    Ring->Submissions = (struct io_uring_sqe *)mmap(NULL,
+                                                    Ring->SubmissionsSize,
+                                                    PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE,
+                                                    handle,
+                                                    IORING_OFF_SQES);
+    if (Ring->Submissions == MAP_FAILED) {
+        Ring->Submissions = NULL;
         status = FALSE;
         goto Exit;
     }
 
+    Ring->SubmissionTail = (unsigned *)((PCHAR)Ring->SubmissionRing + params.sq_off.tail);
+    Ring->SubmissionArray = (unsigned *)((PCHAR)Ring->SubmissionRing + params.sq_off.array);
+    Ring->SubmissionMask = *(unsigned *)((PCHAR)Ring->SubmissionRing + params.sq_off.ring_mask);
+    Ring->CompletionHead = (unsigned *)((PCHAR)Ring->CompletionRing + params.cq_off.head);
+    Ring->CompletionTail = (unsigned *)((PCHAR)Ring->CompletionRing + params.cq_off.tail);
+    Ring->CompletionMask = *(unsigned *)((PCHAR)Ring->CompletionRing + params.cq_off.ring_mask);
+    Ring->Completions = (struct io_uring_cqe *)((PCHAR)Ring->CompletionRing +
+                                                params.cq_off.cqes);
+
     /*
-     * If there is a revision record for that language/file type in the revision
-     * record list, we'll update it. If this file type hasn't been encountered,
-     * we create a new node for it in the list.
+     * Files are opened into a sparse table of direct descriptors, one per
+     * slot, so they never enter the descriptor table of the process.
      */
-    revisionRecord = RevFindRevisionRecordForLanguageByExtension(fileExtension);
-    if (revisionRecord == NULL) {
-        RevLogError("Failed to get/initialize the revision record for the file "
-                    "extension \"%ls\".",
-                    fileExtension);
+    for (index = 0; index < REVISION_RING_SLOTS; ++index) {
+        fileTable[index] = -1;
+    }
+
+    if (syscall(__NR_io_uring_register,
+                handle,
+                IORING_REGISTER_FILES,
+                fileTable,
+                REVISION_RING_SLOTS) < 0) {
+        RevLogWarning(Revision,
+                      "Failed to register the io_uring file table, reading "
+                      "files with blocking system calls. "
+                      "The last known error: %ls.",
+                      RevGetLastKnownWin32Error());
         status = FALSE;
         goto Exit;
     }
 
     /*
-     * Update the count of lines for the extension.
+     * Registering the pipeline buffer pool saves pinning the buffer pages
+     * on every read. It counts against the locked memory limit, so fall
+     * back to plain reads if it fails.
      */
-    revisionRecord->CountOfLinesTotal += lineCountTotal;
-    revisionRecord->CountOfLinesBlank += lineCountBlank;
-    revisionRecord->CountOfFiles += 1;
+    bufferPool.iov_base = Revision->FileBufferPool;
+    bufferPool.iov_len = (SIZE_T)Revision->CountOfFileBuffers * REVISION_FILE_BUFFER_SIZE;
+    Ring->AreBuffersRegistered = syscall(__NR_io_uring_register,
+                                         handle,
+                                         IORING_REGISTER_BUFFERS,
+                                         &bufferPool,
+                                         1) == 0;
 
-    /*
-     * Update the count of lines for the revision.
-     */
-    Revision->CountOfLinesTotal += lineCountTotal;
-    Revision->CountOfLinesBlank += lineCountBlank;
-    Revision->CountOfFiles += 1;
+    for (index = 0; index < REVISION_RING_SLOTS; ++index) {
+        Ring->Slots[index].NextFreeSlot = index + 1;
+    }
+
+    Ring->FreeSlot = 0;
 
 Exit:
-    CloseHandle(file);
+    if (!status) {
+        RevDeleteRing(Ring);
+    }
 
-    /*
-     * Free after RevEnumerateRecursively.
-     */
-    if (FilePath) {
-        free(FilePath);
-        FilePath = NULL;
+    return status;
+}
+
+VOID
+RevDeleteRing(
+    _Inout_ PREVISION_RING Ring
+    )
+{
+    assert(Ring->CountOfFilesInFlight == 0);
+
+    if (Ring->Submissions != NULL) {
+        munmap(Ring->Submissions, Ring->SubmissionsSize);
+        Ring->Submissions = NULL;
     }
 
-    if (fileBuffer) {
-        free(fileBuffer);
+    if (Ring->CompletionRing != NULL &&
+        Ring->CompletionRing != Ring->SubmissionRing) {
+        munmap(Ring->CompletionRing, Ring->CompletionRingSize);
     }
+    Ring->CompletionRing = NULL;
 
-    return status;
+    if (Ring->SubmissionRing != NULL) {
+        munmap(Ring->SubmissionRing, Ring->SubmissionRingSize);
+        Ring->SubmissionRing = NULL;
+    }
+
+    if (Ring->Handle != -1) {
+        close(Ring->Handle);
+        Ring->Handle = -1;
+    }
+
+    Ring->FreeSlot = REVISION_RING_SLOTS;
 }
 
 VOID
-RevOutputRevisionStatistics(
-    VOID
+RevQueueRingFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _Inout_ PREVISION_FILE_BUFFER File
     )
 {
-    PLIST_ENTRY entry;
-    PREVISION_RECORD revisionRecord;
+    PREVISION_RING ring = &Worker->Ring;
+    PREVISION_RING_SLOT slot;
+    struct io_uring_sqe *submission;
+    ULONG slotIndex;
+    ULONG operation;
+    unsigned tail;
 
     /*
-     * The table header.
+     * Pick up the files that are done already, and wait for one if every
+     * slot is taken.
      */
-    RevPrint(L"----------------------------------------------------------------------------------\n");
-    RevPrint(L"%-25s%10s%22s%25s\n",
-             L"File Type",
-             L"Files",
-             L"Blank",
-             L"Total");
-    RevPrint(L"----------------------------------------------------------------------------------\n");
+    RevReapRing(Worker);
+    while (ring->FreeSlot == REVISION_RING_SLOTS) {
+        RevSubmitRing(Worker, TRUE);
+    }
+
+    slotIndex = ring->FreeSlot;
+    slot = &ring->Slots[slotIndex];
+    ring->FreeSlot = slot->NextFreeSlot;
+    ring->CountOfFilesInFlight += 1;
+
+    slot->File = File;
+    slot->OpenResult = 0;
+    slot->ReadResult = 0;
+    slot->CountOfPendingOperations = RevisionRingOperations;
 
     /*
-     * Iterate through the revision record list and print statistics for each
-     * file type.
+     * Queue the open into the direct descriptor of the slot, the read of
+     * the first buffer of the file and the close as one link. A failed
+     * open cancels the rest of the link. The read is linked hard, so that
+     * a short read (the end of a small file) does not cancel the close.
+     *
+     * N.B. There is always room in the submission queue: it holds the
+     * operations of every slot.
      */
-    for (entry = Revision->RevisionRecordListHead.Flink;
-         entry != &Revision->RevisionRecordListHead;
-         entry = entry->Flink) {
+    tail = *ring->SubmissionTail;
 
-        revisionRecord = CONTAINING_RECORD(entry, REVISION_RECORD, ListEntry);
-        if (revisionRecord) {
-            RevPrint(L"%-25s%10u%22u%25u\n",
-                     revisionRecord->ExtensionMapping.LanguageOrFileType,
-                     revisionRecord->CountOfFiles,
-                     revisionRecord->CountOfLinesBlank,
-                     revisionRecord->CountOfLinesTotal);
+    for (operation = 0; operation < RevisionRingOperations; ++operation) {
+        submission = &ring->Submissions[(tail + operation) & ring->SubmissionMask];
+        memset(submission, 0, sizeof(*submission));
+        submission->user_data = (ULONGLONG)slotIndex * RevisionRingOperations + operation;
+
+        switch (operation) {
+        case RevisionRingOpen:
+            submission->opcode = IORING_OP_OPENAT;
+            submission->flags = IOSQE_IO_LINK;
+            submission->fd = File->Directory != NULL ? File->Directory->Handle :
+                                                       AT_FDCWD;
+            submission->addr = (ULONGLONG)(uintptr_t)File->FileName;
+            submission->open_flags = O_RDONLY;
+            submission->file_index = slotIndex + 1;
+            break;
+
+        case RevisionRingRead:
+            submission->opcode = ring->AreBuffersRegistered ? IORING_OP_READ_FIXED :
+                                                              IORING_OP_READ;
+            submission->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+            submission->fd = (int)slotIndex;
+            submission->addr = (ULONGLONG)(uintptr_t)File->Data;
+            submission->len = REVISION_FILE_BUFFER_SIZE;
+            submission->off = 0;
+            submission->buf_index = 0;
+            break;
+
+        case RevisionRingClose:
+            submission->opcode = IORING_OP_CLOSE;
+            submission->file_index = slotIndex + 1;
+            break;
         }
+
+        ring->SubmissionArray[(tail + operation) & ring->SubmissionMask] =
+            (tail + operation) & ring->SubmissionMask;
+    }
+
+    __atomic_store_n(ring->SubmissionTail,
+                     tail + RevisionRingOperations,
+                     __ATOMIC_RELEASE);
+
+    ring->CountOfUnsubmitted += RevisionRingOperations;
+
+    if (ring->CountOfUnsubmitted >= REVISION_RING_SUBMIT_BATCH * RevisionRingOperations) {
+        RevSubmitRing(Worker, FALSE);
     }
+}
+
+VOID
+RevSubmitRing(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ BOOL IsWaiting
+    )
+{
+    PREVISION_RING ring = &Worker->Ring;
+    ULONG minimumCompletions = 0;
+    long result;
 
     /*
-     * The table footer with total statistics.
+     * Only block if nothing has completed since the last look.
      */
-    RevPrint(L"----------------------------------------------------------------------------------\n");
-    RevPrint(L"%-25s%10u%22u%25u\n",
-             L"Total:",
-             Revision->CountOfFiles,
-             Revision->CountOfLinesBlank,
-             Revision->CountOfLinesTotal);
-    RevPrint(L"----------------------------------------------------------------------------------\n");
+    if (IsWaiting && RevReapRing(Worker) == 0) {
+        minimumCompletions = 1;
+    }
+
+    if (ring->CountOfUnsubmitted == 0 && minimumCompletions == 0) {
+        return;
+    }
+
+    do {
+        result = syscall(__NR_io_uring_enter,
+                         ring->Handle,
+                         ring->CountOfUnsubmitted,
+                         minimumCompletions,
+                         minimumCompletions > 0 ? IORING_ENTER_GETEVENTS : 0,
+                         NULL,
+                         0);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        RevLogError(Worker->Revision,
+                    "Failed to submit to io_uring. The last known error: %ls.",
+                    RevGetLastKnownWin32Error());
+    } else {
+        ring->CountOfUnsubmitted -= (ULONG)result;
+    }
+
+    RevReapRing(Worker);
 }
 
-int
-wmain(
-    int argc,
-    wchar_t *argv[]
+ULONG
+RevReapRing(
+    _Inout_ PREVISION_WORKER Worker
     )
 {
-    int status = 0;
-    BOOL measuringTime = TRUE;
-    double resultTime = 0;
-    LARGE_INTEGER startQpc = {0};
-    LARGE_INTEGER endQpc = {0};
-    LARGE_INTEGER frequency = {0};
-    PWCHAR revisionPath = NULL;
-    SIZE_T revisionPathLength;
-    REVISION_INIT_PARAMS revisionInitParams;
-    LONG index;
+    PREVISION_RING ring = &Worker->Ring;
+    PREVISION_RING_SLOT slot;
+    struct io_uring_cqe *completion;
+    ULONG countOfCompletions = 0;
+    ULONG slotIndex;
+    unsigned head;
+    unsigned tail;
 
-    SupportAnsi = SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE),
-                                 ENABLE_PROCESSED_OUTPUT |
-                                 ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    head = *ring->CompletionHead;
+    tail = __atomic_load_n(ring->CompletionTail, __ATOMIC_ACQUIRE);
 
-    RevPrint(WelcomeString);
+    for (; head != tail; ++head) {
+        completion = &ring->Completions[head & ring->CompletionMask];
+        slotIndex = (ULONG)(completion->user_data / RevisionRingOperations);
+        slot = &ring->Slots[slotIndex];
 
-    /*
-     * Process the command line arguments if any.
-     */
+        switch (completion->user_data % RevisionRingOperations) {
+        case RevisionRingOpen:
+            slot->OpenResult = completion->res;
+            break;
 
-     // if (argc <= 1) {
-     //     /*
-     //      * The command line arguments were not passed at all, so a folder
-     //      * selection dialog should be opened where the user can select a
-     //      * directory to perform the revision.
-     //      */
-     //     RevPrint(UsageString);
-     //     goto Exit;
-     // }
-     //
-     // if (wcscmp(argv[1], L"-help") == 0 ||
-     //     wcscmp(argv[1], L"-h") == 0 ||
-     //     wcscmp(argv[1], L"-?") == 0) {
-     //     /*
-     //      * The only command line argument passed was '-help', '-h', or '-?',
-     //      * so show the instruction for use.
-     //      */
-     //     RevPrint(UsageString);
-     //     goto Exit;
-     // }
+        case RevisionRingRead:
+            slot->ReadResult = completion->res;
+            break;
+        }
 
-    /*
-     * The first argument is the path to the root revision directory:
-     */
+        countOfCompletions += 1;
 
-    if (wcscmp(argv[1], L".") == 0) {
         /*
-         * If a dot was given, we need to revise the current directory.
-         * Let's find it. TODO.
+         * Release the completion to the kernel before passing the file on,
+         * the slot holds everything that is needed.
          */
-        assert(FALSE);
+        __atomic_store_n(ring->CompletionHead, head + 1, __ATOMIC_RELEASE);
+
+        if (--slot->CountOfPendingOperations == 0) {
+            RevCompleteRingFile(Worker, slotIndex);
+        }
+    }
+
+    return countOfCompletions;
+}
+
+VOID
+RevCompleteRingFile(
+    _Inout_ PREVISION_WORKER Worker,
+    _In_ ULONG SlotIndex
+    )
+{
+    PREVISION_RING ring = &Worker->Ring;
+    PREVISION_RING_SLOT slot = &ring->Slots[SlotIndex];
+    PREVISION_FILE_BUFFER file = slot->File;
+    PPATHCHAR path;
+
+    slot->File = NULL;
+    slot->NextFreeSlot = ring->FreeSlot;
+    ring->FreeSlot = SlotIndex;
+    ring->CountOfFilesInFlight -= 1;
 
-        revisionPath = L"c:\\dev"; //argv[1];
+    if (slot->OpenResult < 0 || slot->ReadResult < 0) {
+        errno = slot->OpenResult < 0 ? -slot->OpenResult : -slot->ReadResult;
+        path = RevBuildPath(file->Directory, file->FileName);
+        RevLogError(Worker->Revision,
+                    "Failed to %s the file \"%s\". "
+                    "The last known error: %ls.",
+                    slot->OpenResult < 0 ? "open" : "read",
+                    path,
+                    RevGetLastKnownWin32Error());
+        free(path);
+        RevRetireFileBuffer(Worker->Revision, file);
+
+    } else if (slot->ReadResult == REVISION_FILE_BUFFER_SIZE) {
+
+        /*
+         * The file fills the buffer, so there may be more of it. Read it
+         * again with blocking system calls, which also map or stream it if
+         * it is large.
+         */
+        RevReadFileBuffer(Worker, file);
 
     } else {
-        revisionPath = L"c:\\dev"; //argv[1];
+        file->Contents = file->Data;
+        file->Size = (SIZE_T)slot->ReadResult;
+
+        Worker->CountOfBytesRead += (ULONGLONG)slot->ReadResult;
+        Worker->CountOfRingFiles += 1;
+        RevPassFileBuffer(Worker, file);
     }
+}
 
-    revisionPathLength = wcslen(revisionPath);
+#endif
 
-    /*
-     * As part of improving input parameter validation, remove trailing '\' symbols
-     * replacing them with '\0' character.
-     */
-    while (revisionPathLength > 0 &&
-           revisionPath[revisionPathLength - 1] == L'\\') {
-        revisionPath[--revisionPathLength] = L'\0';
-    }
+VOID
+RevOutputRevisionStatistics(
+    _In_ PREVISION Revision
+    )
+{
+    SIZE_T countOfIdentities;
+    SIZE_T identityBytes;
 
     /*
-     * Prepend L"\\?\" to the `argv[1]` if not prepended yet to avoid the obsolete
-     * MAX_PATH limitation.
+     * Entries are scheduled from per-batch entry blocks, so the number
+     * of allocations follows the number of directories, not files.
      */
-    if (wcsncmp(revisionPath, MAX_PATH_FIX, wcslen(MAX_PATH_FIX)) != 0) {
+    RevPrintEx(Cyan,
+               L"Walked %lu directories with %lu allocations\n",
+               Revision->CountOfDirectories,
+               Revision->CountOfAllocations);
+    RevPrintEx(Cyan,
+               L"Ran %lu enumerators, %lu readers and %lu counters\n",
+               Revision->CountOfEnumerators,
+               Revision->CountOfReaders,
+               Revision->CountOfCounters);
+    RevPrintEx(Cyan,
+               L"Counted lines with the %ls kernel\n",
+               LineCounter->Name);
+    RevPrintEx(Cyan,
+               L"Read %llu bytes, mapped %llu bytes in %lu files\n",
+               Revision->CountOfBytesRead,
+               Revision->CountOfBytesMapped,
+               Revision->CountOfMappedFiles);
+#ifdef REVISION_IO_URING
+    RevPrintEx(Cyan,
+               L"Read %lu files through io_uring\n",
+               Revision->CountOfRingFiles);
+#endif
+    RevPrintEx(Cyan,
+               L"Served %llu read buffers from the worker pools, "
+               L"allocated %lu (%llu bytes)\n",
+               Revision->CountOfBufferHits,
+               Revision->CountOfBufferAllocations,
+               Revision->CountOfBufferBytes);
+    RevPrintEx(Cyan,
+               L"Held %llu bytes in %lu arena blocks\n",
+               Revision->Arena.CountOfBytes,
+               Revision->Arena.CountOfBlocks);
+    if (Revision->Cache.Path != NULL) {
+        RevPrintEx(Cyan,
+                   L"Took %lu files and %lu whole directories from the scan cache, "
+                   L"which now holds %llu files in %llu directories\n",
+                   Revision->CountOfCachedFiles,
+                   Revision->CountOfCachedDirectories,
+                   (ULONGLONG)Revision->Cache.CountOfNewEntries,
+                   (ULONGLONG)Revision->Cache.CountOfNewDirectories);
+    }
+    if (Revision->IsFiltered) {
+        RevPrintEx(Cyan,
+                   L"Excluded %lu directories and %lu files by pattern\n",
+                   Revision->CountOfExcludedDirectories,
+                   Revision->CountOfExcludedFiles);
+    }
+    RevMeasureIdentitySet(&Revision->IdentitySet, &countOfIdentities, &identityBytes);
+    RevPrintEx(Cyan,
+               L"Reached %lu files and %lu directories again through links, "
+               L"tracked %llu identities in %llu bytes\n",
+               Revision->CountOfLinkedFiles,
+               Revision->CountOfLinkedDirectories,
+               (ULONGLONG)countOfIdentities,
+               (ULONGLONG)identityBytes);
+}
 
-        revisionPath = RevStringPrepend(revisionPath, MAX_PATH_FIX);
-        if (revisionPath == NULL) {
-            RevLogError("Failed to normalize the revision path "
-                        "(RevStringPrepend failed).");
-            status = -1;
-            goto Exit;
-        }
+CODEMETER_API
+uint32_t
+CodeMeterGetCountOfLanguages(
+    VOID
+    )
+{
+    if (!RevInitializeTables()) {
+        return 0;
     }
 
-    /*
-     * Now we are ready to set the root path of the revision directory.
-     */
-    revisionInitParams.RootDirectory = revisionPath;
-    revisionInitParams.IsVerboseMode = FALSE;
+    return (uint32_t)CountOfLanguages;
+}
 
-    if (argc > 2) {
-        /*
-         * It is expected that in the case of multiple command line arguments:
-         *  1) The first argument is the path to the root revision directory.
-         *  2) The remaining parameters are for optional revision configuration
-         *     overrides.
-         *
-         * Process additional parameters:
-         */
+CODEMETER_API
+const wchar_t *
+CodeMeterGetLanguageName(
+    _In_ uint32_t LanguageId
+    )
+{
+    if (!RevInitializeTables() ||
+        LanguageId >= CountOfLanguages) {
+        return NULL;
+    }
 
-        for (index = 2; index < argc; ++index) {
+    return LanguageTable[LanguageId];
+}
 
-            /*
-             * -v: Sets the IsVerboseMode configuration flag to TRUE.
-             */
-            if (wcscmp(argv[index], L"-v") == 0) {
-                revisionInitParams.IsVerboseMode = TRUE;
-            }
+CODEMETER_API
+int
+CodeMeterLookupLanguage(
+    _In_z_ const wchar_t *Extension,
+    _Out_ uint32_t *LanguageId
+    )
+{
+    PREVISION_RECORD_EXTENSION_MAPPING mapping;
+    PPATHCHAR name;
 
-        }
+    if (Extension == NULL ||
+        LanguageId == NULL ||
+        !RevInitializeTables()) {
+        return FALSE;
     }
 
-#ifndef NDEBUG
-    /*
-     * Always use verbose mode in debug builds.
-     */
-    if (revisionInitParams.IsVerboseMode == FALSE) {
-        revisionInitParams.IsVerboseMode = TRUE;
+#ifdef _WIN32
+    name = (PPATHCHAR)Extension;
+#else
+    name = RevConvertToMultiByte((PWCHAR)Extension);
+    if (name == NULL) {
+        return FALSE;
     }
 #endif
 
     /*
-     * Initialize the revision engine.
+     * The suffix trie finds the longest extension the name ends with, which
+     * only counts if it is the whole extension that was asked for.
      */
-    status = RevInitializeRevision(&revisionInitParams);
-    if (status == FALSE) {
-        RevLogError("Failed to initialize the revision engine.");
-        goto Exit;
+    mapping = RevLookupFileName(name);
+
+#ifndef _WIN32
+    free(name);
+#endif
+
+    if (mapping == NULL ||
+        wcscmp(mapping->Extension, Extension) != 0) {
+        return FALSE;
     }
 
-    if (!QueryPerformanceFrequency(&frequency)) {
-        RevLogError("Failed to retrieve the frequency of the performance "
-                    "counter.");
-        measuringTime = FALSE;
+    *LanguageId = (uint32_t)mapping->LanguageId;
+
+    return TRUE;
+}
+
+CODEMETER_API
+int
+CodeMeterCountBuffer(
+    _In_ uint32_t LanguageId,
+    _In_reads_bytes_(Size) const char *Buffer,
+    _In_ size_t Size,
+    _Out_ CODEMETER_COUNTS *Counts
+    )
+{
+    ULONGLONG countOfLinesTotal;
+    ULONGLONG countOfLinesBlank;
+    ULONGLONG countOfLinesComment;
+
+    if ((Buffer == NULL && Size > 0) ||
+        Counts == NULL ||
+        !RevInitializeTables() ||
+        LanguageId >= CountOfLanguages) {
+        return FALSE;
     }
 
-    if (measuringTime) {
-        QueryPerformanceCounter(&startQpc);
+    RevCountBufferLines(LanguageId,
+                        Buffer,
+                        Size,
+                        &countOfLinesTotal,
+                        &countOfLinesBlank,
+                        &countOfLinesComment);
+
+    Counts->CountOfLinesTotal = countOfLinesTotal;
+    Counts->CountOfLinesBlank = countOfLinesBlank;
+    Counts->CountOfLinesComment = countOfLinesComment;
+
+    return TRUE;
+}
+
+CODEMETER_API
+int
+CodeMeterScanTree(
+    _In_z_ const wchar_t *RootDirectory,
+    _In_opt_ const CODEMETER_SCAN_PARAMS *Params,
+    _Out_opt_ CODEMETER_RESULT *Result,
+    _Out_writes_opt_(CountOfLanguages) CODEMETER_RECORD *Records
+    )
+{
+    BOOL status = TRUE;
+    REVISION_INIT_PARAMS initParams = {0};
+    PREVISION revision = NULL;
+    PREVISION_RECORD revisionRecord;
+    CODEMETER_RECORD record;
+    ULONG languageId;
+
+    /*
+     * N.B. The revision only reads the root directory path.
+     */
+    initParams.RootDirectory = (PWCHAR)RootDirectory;
+    initParams.MapThreshold = REVISION_DEFAULT_MAP_THRESHOLD;
+    initParams.IsIoUringEnabled = TRUE;
+
+    if (Params != NULL) {
+        initParams.IsVerboseMode = Params->IsVerboseMode != 0;
+        initParams.CountOfWorkers = Params->CountOfEnumerators;
+        initParams.CountOfReaders = Params->CountOfReaders;
+        initParams.CountOfCounters = Params->CountOfCounters;
+        if (Params->MapThreshold != 0) {
+            initParams.MapThreshold = Params->MapThreshold;
+        }
+        initParams.IsIoUringEnabled = Params->IsIoUringDisabled == 0;
+        initParams.CacheFile = (PWCHAR)Params->CacheFile;
+        initParams.IsDirectoryTimeTrusted = Params->IsDirectoryTimeTrusted != 0;
+        initParams.IsGitIndexUsed = Params->IsGitIndexUsed != 0;
+        initParams.FileList = (PWCHAR)Params->FileList;
+        initParams.IsFileListNulSeparated = Params->IsFileListNulSeparated != 0;
+        initParams.ExcludePatterns = (PWCHAR *)Params->ExcludePatterns;
+        initParams.CountOfExcludePatterns = Params->CountOfExcludePatterns;
+        initParams.IncludePatterns = (PWCHAR *)Params->IncludePatterns;
+        initParams.CountOfIncludePatterns = Params->CountOfIncludePatterns;
+        initParams.IsGitIgnoreUsed = Params->IsGitIgnoreUsed != 0;
+        initParams.IsContentDeduplicated = Params->IsContentDeduplicated != 0;
+        initParams.IsSymlinkFollowed = Params->IsSymlinkFollowed != 0;
+        initParams.FileCallback = Params->FileCallback;
+        initParams.CallbackContext = Params->CallbackContext;
     }
 
-    status = RevStartRevision();
-    if (status == FALSE) {
-        RevLogError("Failed to start the revision engine.");
+    if (!RevInitializeRevision(&initParams, &revision) ||
+        !RevStartRevision(revision)) {
+        status = FALSE;
         goto Exit;
     }
 
-    if (measuringTime) {
-        QueryPerformanceCounter(&endQpc);
+    if (Result != NULL) {
+        Result->CountOfFiles = (uint32_t)revision->CountOfFiles;
+        Result->CountOfIgnoredFiles = (uint32_t)revision->CountOfIgnoredFiles;
+        Result->CountOfDuplicateFiles = (uint32_t)revision->CountOfDuplicateFiles;
+        Result->CountOfLinkedFiles = (uint32_t)revision->CountOfLinkedFiles;
+        Result->CountOfDirectories = (uint32_t)revision->CountOfDirectories;
+        Result->Counts.CountOfLinesTotal = revision->CountOfLinesTotal;
+        Result->Counts.CountOfLinesBlank = revision->CountOfLinesBlank;
+        Result->Counts.CountOfLinesComment = revision->CountOfLinesComment;
     }
 
-    RevOutputRevisionStatistics();
+    for (languageId = 0; languageId < CountOfLanguages; ++languageId) {
+        revisionRecord = &revision->RevisionRecords[languageId];
 
-    if (measuringTime) {
-        resultTime =
-            (double)(endQpc.QuadPart - startQpc.QuadPart) / frequency.QuadPart;
-        RevPrintEx(Cyan,
-                   L"Time: %.3fs",
-                   resultTime);
-    }
+        record.LanguageId = (uint32_t)languageId;
+        record.LanguageOrFileType = LanguageTable[languageId];
+        record.CountOfFiles = (uint32_t)revisionRecord->CountOfFiles;
+        record.Counts.CountOfLinesTotal = revisionRecord->CountOfLinesTotal;
+        record.Counts.CountOfLinesBlank = revisionRecord->CountOfLinesBlank;
+        record.Counts.CountOfLinesComment = revisionRecord->CountOfLinesComment;
 
-    if (Revision->CountOfIgnoredFiles > 0) {
-        RevPrintEx(Cyan,
-                   L"\tIgnored %d files\n",
-                   Revision->CountOfIgnoredFiles);
+        if (Records != NULL) {
+            Records[languageId] = record;
+        }
+
+        if (Params != NULL &&
+            Params->RecordCallback != NULL &&
+            record.CountOfFiles > 0) {
+            Params->RecordCallback(&record, Params->CallbackContext);
+        }
     }
 
-#ifndef NDEBUG
-    system("pause");
-#endif
+    if (initParams.IsVerboseMode) {
+        RevOutputRevisionStatistics(revision);
+    }
 
 Exit:
-    free(revisionPath);
+    RevDeleteRevision(revision);
 
     return status;
 }
+
+CODEMETER_API
+int
+CodeMeterRunBenchmark(
+    _In_ CODEMETER_BENCHMARK Benchmark
+    )
+{
+    switch (Benchmark) {
+    case CodeMeterBenchmarkLookup:
+        return RevBenchmarkExtensionLookup();
+
+    case CodeMeterBenchmarkCount:
+        return RevBenchmarkLineCounters();
+
+    default:
+        return FALSE;
+    }
+}
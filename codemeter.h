@@ -0,0 +1,425 @@
+/*++
+
+Copyright (c) 2023  wnstngs. All rights reserved.
+
+Module Name:
+
+    codemeter.h
+
+Abstract:
+
+    This module declares the interface of the CodeMeter library, which lets
+    other programs count lines of code in process: a memory buffer of a given
+    language, or a whole directory tree with the same engine and results as
+    the CodeMeter program, which is itself built on this interface.
+
+    Language IDs are dense, from zero to CodeMeterGetCountOfLanguages() - 1,
+    and stay the same for the lifetime of the process.
+
+--*/
+
+#ifndef CODEMETER_H
+#define CODEMETER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The library is static unless CODEMETER_SHARED is defined, in which case
+ * only the functions below are exported.
+ */
+#ifdef CODEMETER_SHARED
+#ifdef _WIN32
+#ifdef CODEMETER_EXPORTS
+#define CODEMETER_API   __declspec(dllexport)
+#else
+#define CODEMETER_API   __declspec(dllimport)
+#endif
+#else
+#define CODEMETER_API   __attribute__((visibility("default")))
+#endif
+#else
+#define CODEMETER_API
+#endif
+
+/**
+ * @brief Character of a path in the native encoding of the file system:
+ * unicode on Windows, multibyte elsewhere.
+ */
+#ifdef _WIN32
+typedef wchar_t CODEMETER_PATHCHAR;
+#else
+typedef char CODEMETER_PATHCHAR;
+#endif
+
+/**
+ * @brief This structure receives the line counts of a buffer.
+ */
+typedef struct CODEMETER_COUNTS {
+    /**
+     * @brief Number of lines.
+     */
+    uint64_t CountOfLinesTotal;
+
+    /**
+     * @brief Number of blank lines.
+     */
+    uint64_t CountOfLinesBlank;
+
+    /**
+     * @brief Number of comment lines. Always zero for languages counted
+     * without comments.
+     */
+    uint64_t CountOfLinesComment;
+} CODEMETER_COUNTS, *PCODEMETER_COUNTS;
+
+/**
+ * @brief This structure describes a file counted by CodeMeterScanTree.
+ */
+typedef struct CODEMETER_FILE {
+    /**
+     * @brief Full path of the file, valid only during the callback.
+     */
+    const CODEMETER_PATHCHAR *Path;
+
+    /**
+     * @brief Language ID of the file.
+     */
+    uint32_t LanguageId;
+
+    /**
+     * @brief Line counts of the file.
+     */
+    CODEMETER_COUNTS Counts;
+} CODEMETER_FILE, *PCODEMETER_FILE;
+
+/**
+ * @brief This structure holds the statistics of one language/file type.
+ */
+typedef struct CODEMETER_RECORD {
+    /**
+     * @brief Language ID of the record.
+     */
+    uint32_t LanguageId;
+
+    /**
+     * @brief Name of the language/file type.
+     */
+    const wchar_t *LanguageOrFileType;
+
+    /**
+     * @brief Number of files of the language/file type.
+     */
+    uint32_t CountOfFiles;
+
+    /**
+     * @brief Line counts summed over the files.
+     */
+    CODEMETER_COUNTS Counts;
+} CODEMETER_RECORD, *PCODEMETER_RECORD;
+
+/**
+ * @brief This structure holds the totals of a directory tree.
+ */
+typedef struct CODEMETER_RESULT {
+    /**
+     * @brief Number of files counted.
+     */
+    uint32_t CountOfFiles;
+
+    /**
+     * @brief Number of files ignored: unknown extensions and files that
+     * could not be read.
+     */
+    uint32_t CountOfIgnoredFiles;
+
+    /**
+     * @brief Number of files skipped because a file with the same contents
+     * was counted. Always zero unless IsContentDeduplicated is set.
+     */
+    uint32_t CountOfDuplicateFiles;
+
+    /**
+     * @brief Number of files skipped because they were reached again,
+     * through a hard link or a symbolic link.
+     */
+    uint32_t CountOfLinkedFiles;
+
+    /**
+     * @brief Number of directories enumerated.
+     */
+    uint32_t CountOfDirectories;
+
+    /**
+     * @brief Line counts summed over every counted file.
+     */
+    CODEMETER_COUNTS Counts;
+} CODEMETER_RESULT, *PCODEMETER_RESULT;
+
+/**
+ * @brief Callback receiving every counted file.
+ *
+ * @note Files are counted by several threads at once, so the callback is
+ * called concurrently and in no particular order.
+ */
+typedef void (*PCODEMETER_FILE_CALLBACK)(
+    const CODEMETER_FILE *File,
+    void *Context
+    );
+
+/**
+ * @brief Callback receiving the record of every language/file type with
+ * at least one file, in the order of the language IDs, once the tree has
+ * been counted.
+ */
+typedef void (*PCODEMETER_RECORD_CALLBACK)(
+    const CODEMETER_RECORD *Record,
+    void *Context
+    );
+
+/**
+ * @brief This structure stores the optional parameters of
+ * CodeMeterScanTree. Zeroed parameters select the defaults of the
+ * CodeMeter program.
+ */
+typedef struct CODEMETER_SCAN_PARAMS {
+    /**
+     * @brief Number of enumerator, reader and counter threads. Zero means
+     * one per logical processor.
+     */
+    uint32_t CountOfEnumerators;
+    uint32_t CountOfReaders;
+    uint32_t CountOfCounters;
+
+    /**
+     * @brief Size in bytes from which files are mapped into memory rather
+     * than read. Zero selects the default.
+     */
+    uint64_t MapThreshold;
+
+    /**
+     * @brief Nonzero to read files without io_uring. Ignored on Windows.
+     */
+    int IsIoUringDisabled;
+
+    /**
+     * @brief Nonzero to log errors and warnings to the standard streams,
+     * and the statistics of the engine to the standard output once the
+     * tree has been counted.
+     */
+    int IsVerboseMode;
+
+    /**
+     * @brief Path of the scan cache file, or NULL. Files that have not
+     * changed since they were cached are not read, and the cache is
+     * replaced once the tree has been counted.
+     */
+    const wchar_t *CacheFile;
+
+    /**
+     * @brief Nonzero to take whole directories whose modification time has
+     * not changed from the scan cache, without listing them or checking
+     * their files. Files rewritten in place, rather than replaced, are then
+     * missed. Ignored with a file callback.
+     */
+    int IsDirectoryTimeTrusted;
+
+    /**
+     * @brief Nonzero to count only the files tracked by the git index of
+     * the root directory, which must be a git work tree, instead of
+     * walking the tree.
+     */
+    int IsGitIndexUsed;
+
+    /**
+     * @brief Path of a file listing the files to count, relative to the
+     * root directory, or L"-" for the standard input, or NULL to walk the
+     * tree. Takes precedence over IsGitIndexUsed.
+     */
+    const wchar_t *FileList;
+
+    /**
+     * @brief Nonzero if the paths of FileList are separated by NUL
+     * characters, zero if they are separated by newlines.
+     */
+    int IsFileListNulSeparated;
+
+    /**
+     * @brief Exclude patterns, in the syntax of .gitignore files, relative
+     * to the root directory. Excluded directories are never opened.
+     */
+    const wchar_t *const *ExcludePatterns;
+    uint32_t CountOfExcludePatterns;
+
+    /**
+     * @brief Include patterns. If there are any, only the files matching
+     * one of them are counted.
+     */
+    const wchar_t *const *IncludePatterns;
+    uint32_t CountOfIncludePatterns;
+
+    /**
+     * @brief Nonzero to honour the .gitignore files of the tree and skip
+     * .git directories.
+     */
+    int IsGitIgnoreUsed;
+
+    /**
+     * @brief Nonzero to count files with the same contents, as the same
+     * language/file type, once. The others are neither counted nor passed
+     * to the file callback.
+     */
+    int IsContentDeduplicated;
+
+    /**
+     * @brief Nonzero to descend into symbolic links to directories. Every
+     * directory is enumerated once, so link cycles end. Links to files are
+     * always followed, and every file is counted once however many links
+     * lead to it.
+     */
+    int IsSymlinkFollowed;
+
+    /**
+     * @brief Optional callbacks and the context passed to them.
+     */
+    PCODEMETER_FILE_CALLBACK FileCallback;
+    PCODEMETER_RECORD_CALLBACK RecordCallback;
+    void *CallbackContext;
+} CODEMETER_SCAN_PARAMS, *PCODEMETER_SCAN_PARAMS;
+
+/**
+ * @brief This enumeration represents the parts of the engine measured by
+ * CodeMeterRunBenchmark.
+ */
+typedef enum CODEMETER_BENCHMARK {
+    /**
+     * @brief The per-file lookup of the language of a file name.
+     */
+    CodeMeterBenchmarkLookup,
+
+    /**
+     * @brief The line counting kernels the processor supports.
+     */
+    CodeMeterBenchmarkCount
+} CODEMETER_BENCHMARK;
+
+/**
+ * @brief This function returns the number of languages/file types.
+ *
+ * @return The number of language IDs, or zero if the language tables
+ * could not be built.
+ */
+CODEMETER_API
+uint32_t
+CodeMeterGetCountOfLanguages(
+    void
+    );
+
+/**
+ * @brief This function returns the name of a language/file type.
+ *
+ * @param LanguageId Supplies the language ID.
+ *
+ * @return The name, or NULL if the language ID is not valid.
+ */
+CODEMETER_API
+const wchar_t *
+CodeMeterGetLanguageName(
+    uint32_t LanguageId
+    );
+
+/**
+ * @brief This function looks up the language/file type of a file
+ * extension.
+ *
+ * @param Extension Supplies the file extension, including the dot.
+ *
+ * @param LanguageId Receives the language ID.
+ *
+ * @return Nonzero if the extension is known, zero otherwise.
+ */
+CODEMETER_API
+int
+CodeMeterLookupLanguage(
+    const wchar_t *Extension,
+    uint32_t *LanguageId
+    );
+
+/**
+ * @brief This function counts the lines of a memory buffer as the
+ * contents of a file of the given language/file type.
+ *
+ * @param LanguageId Supplies the language ID.
+ *
+ * @param Buffer Supplies the contents.
+ *
+ * @param Size Supplies the size of the contents in bytes.
+ *
+ * @param Counts Receives the line counts.
+ *
+ * @return Nonzero if succeeded, zero if failed.
+ */
+CODEMETER_API
+int
+CodeMeterCountBuffer(
+    uint32_t LanguageId,
+    const char *Buffer,
+    size_t Size,
+    CODEMETER_COUNTS *Counts
+    );
+
+/**
+ * @brief This function counts the lines of every file in a directory
+ * tree. Several trees can be counted at once from different threads.
+ *
+ * @param RootDirectory Supplies the path of the root directory.
+ *
+ * @param Params Supplies the optional parameters, or NULL.
+ *
+ * @param Result Receives the totals of the tree, or NULL.
+ *
+ * @param Records Receives the record of every language/file type, indexed
+ * by the language ID, or NULL. It must hold CodeMeterGetCountOfLanguages()
+ * records.
+ *
+ * @return Nonzero if succeeded, zero if failed, as when the root directory
+ * cannot be opened or enumerated. Subdirectories that cannot be opened or
+ * enumerated are skipped.
+ *
+ * @note Outside of Windows, paths and extensions are converted with the
+ * LC_CTYPE locale of the process.
+ */
+CODEMETER_API
+int
+CodeMeterScanTree(
+    const wchar_t *RootDirectory,
+    const CODEMETER_SCAN_PARAMS *Params,
+    CODEMETER_RESULT *Result,
+    CODEMETER_RECORD *Records
+    );
+
+/**
+ * @brief This function measures a part of the engine on synthetic input,
+ * checking its variants against each other, and prints the results to the
+ * standard output.
+ *
+ * @param Benchmark Supplies the part to measure.
+ *
+ * @return Nonzero if succeeded and the variants agree, zero otherwise.
+ */
+CODEMETER_API
+int
+CodeMeterRunBenchmark(
+    CODEMETER_BENCHMARK Benchmark
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
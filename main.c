@@ -0,0 +1,689 @@
+/*++
+
+Copyright (c) 2023  wnstngs. All rights reserved.
+
+Module Name:
+
+    main.c
+
+Abstract:
+
+    This module implements the CodeMeter program: it parses the command line,
+    counts the lines of a directory tree through the interface declared in
+    codemeter.h, and prints the results as a table.
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#ifdef _WIN32
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+#else
+
+#include <locale.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#endif
+
+#include "codemeter.h"
+
+//
+// ------------------------------------------------------ Constants and Globals
+//
+
+/**
+ * @brief ANSI escape sequences for the colors of the output.
+ */
+#define CLI_COLOR_RED       "\033[0;31m"
+#define CLI_COLOR_GREEN     "\033[32m"
+#define CLI_COLOR_CYAN      "\033[36m"
+#define CLI_COLOR_RESET     "\033[0m"
+
+static const char WelcomeString[] =
+    "CodeMeter v0.0.1                 Copyright(c) 2023 Glebs\n"
+    "--------------------------------------------------------\n\n";
+
+static const char UsageString[] =
+    "DESCRIPTION:\n\n"
+    "\tIn order to count the number of lines of CodeMeter code, you need\n"
+    "\tthe path to the root directory of the project you want to revise.\n"
+    "\tThe path should be passed as the first argument of the command line:\n\n\t"
+    "CodeMeter.exe \"C:\\\\MyProject\"\n\n"
+    "OPTIONS:\n\n"
+    "\t-help, -h, -?\n"
+    "\tPrint a help message and exit.\n\n"
+    "\t-v\n"
+    "\tEnable verbose logging mode.\n\n"
+    "\t-j N\n"
+    "\tWalk the tree with N enumerator threads (default: one per logical\n"
+    "\tprocessor).\n\n"
+    "\t-readers N\n"
+    "\tRead files with N reader threads (default: one per logical\n"
+    "\tprocessor).\n\n"
+    "\t-counters N\n"
+    "\tCount lines with N counter threads (default: one per logical\n"
+    "\tprocessor).\n\n"
+    "\t-map-threshold N\n"
+    "\tMap files of N bytes or more into memory instead of reading them\n"
+    "\t(default: 1048576).\n\n"
+    "\t-no-io-uring\n"
+    "\tRead every file with blocking system calls instead of reading small\n"
+    "\tfiles in batches through io_uring (Linux only).\n\n"
+    "\t-cache FILE\n"
+    "\tKeep the counts of every file in FILE, and take them from there for\n"
+    "\tthe files that have not changed since the previous run.\n\n"
+    "\t-trust-directory-mtime\n"
+    "\tWith -cache, take whole directories whose modification time has not\n"
+    "\tchanged from the cache, without listing them or checking their files.\n"
+    "\tFiles rewritten in place, rather than replaced, are then missed.\n\n"
+    "\t-git-index\n"
+    "\tCount only the files tracked by the git index of the work tree given\n"
+    "\tas the path, instead of walking the tree.\n\n"
+    "\t-files-from FILE\n"
+    "\tCount only the files listed in FILE, one path per line, relative to\n"
+    "\tthe path, instead of walking the tree. FILE - is the standard input.\n\n"
+    "\t-files0-from FILE\n"
+    "\tLike -files-from, with paths separated by NUL characters, as printed\n"
+    "\tby git ls-files -z or find -print0.\n\n"
+    "\t-exclude PATTERN\n"
+    "\tSkip the files and directories matching PATTERN, in the syntax of\n"
+    "\t.gitignore files, relative to the path. Excluded directories are\n"
+    "\tnever opened. May be given several times.\n\n"
+    "\t-include PATTERN\n"
+    "\tCount only the files matching PATTERN, or one of the include\n"
+    "\tpatterns if given several times.\n\n"
+    "\t-gitignore\n"
+    "\tHonour the .gitignore files of the tree and skip .git directories.\n\n"
+    "\t-dedup\n"
+    "\tCount files with the same contents once, such as vendored copies of\n"
+    "\tthe same files. Contents are told apart by a 64-bit hash.\n\n"
+    "\t-follow-symlinks\n"
+    "\tDescend into symbolic links to directories. Every directory is\n"
+    "\tenumerated once, so link cycles are harmless. Hard-linked files and\n"
+    "\tfile links are counted once either way.\n\n"
+    "\t-benchmark-lookup\n"
+    "\tMeasure the per-file cost of extension lookups and exit. Given in\n"
+    "\tplace of the path.\n\n"
+    "\t-benchmark-count\n"
+    "\tCheck the line counting kernels the processor supports against each\n"
+    "\tother, and the comment classifier with each of them, measure their\n"
+    "\tthroughput and exit. Given in place of the path.\n\n";
+
+/**
+ * @brief Indicates whether ANSI escape sequences are supported.
+ */
+static int SupportAnsi;
+
+//
+// -------------------------------------------------------------------- Macros
+//
+
+/**
+ * @brief This macro prints an error message to the standard error stream,
+ * the same way the engine does.
+ */
+#define CliLogError(Message, ...)                                                       \
+    fprintf(stderr,                                                                     \
+            SupportAnsi ?                                                               \
+                CLI_COLOR_RED "[ERROR]\n└───> (in %s@%d): " Message CLI_COLOR_RESET "\n" : \
+                "[ERROR]\n└───> (in %s@%d): " Message "\n",                             \
+            __FUNCTION__,                                                               \
+            __LINE__,                                                                   \
+            ##__VA_ARGS__)
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+/**
+ * @brief This function prints a formatted string in the given color.
+ *
+ * @param Color Supplies the escape sequence of the color.
+ *
+ * @param Format Supplies the format specifier. Wide strings are printed
+ * with %ls.
+ *
+ * @param ... Supplies additional parameters to be formatted and printed.
+ */
+static
+void
+CliPrintEx(
+    const char *Color,
+    const char *Format,
+    ...
+    )
+{
+    va_list args;
+
+    /*
+     * N.B. The engine writes narrow strings to stdout, and a stream cannot
+     * be both wide- and byte-oriented outside of Windows, so the program
+     * prints narrow strings too.
+     */
+    if (SupportAnsi) {
+        fputs(Color, stdout);
+    }
+    va_start(args, Format);
+    vprintf(Format, args);
+    va_end(args);
+    if (SupportAnsi) {
+        fputs(CLI_COLOR_RESET, stdout);
+    }
+}
+
+/**
+ * @brief This function returns a monotonic time in seconds.
+ *
+ * @return The time, or a negative value if it is not available.
+ */
+static
+double
+CliQueryTime(
+    void
+    )
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+
+    if (!QueryPerformanceFrequency(&frequency) ||
+        !QueryPerformanceCounter(&counter)) {
+        return -1;
+    }
+
+    return (double)counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec time;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &time) != 0) {
+        return -1;
+    }
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * @brief This function prints the records of a tree and its totals as a
+ * table.
+ *
+ * @param Result Supplies the totals of the tree.
+ *
+ * @param Records Supplies the record of every language/file type.
+ *
+ * @param CountOfLanguages Supplies the number of records.
+ */
+static
+void
+CliOutputRevisionStatistics(
+    const CODEMETER_RESULT *Result,
+    const CODEMETER_RECORD *Records,
+    uint32_t CountOfLanguages
+    )
+{
+    uint32_t languageId;
+
+    /*
+     * The table header.
+     */
+    CliPrintEx(CLI_COLOR_GREEN, "----------------------------------------------------------------------------------\n");
+    CliPrintEx(CLI_COLOR_GREEN,
+               "%-25s%10s%15s%15s%17s\n",
+               "File Type",
+               "Files",
+               "Blank",
+               "Comment",
+               "Total");
+    CliPrintEx(CLI_COLOR_GREEN, "----------------------------------------------------------------------------------\n");
+
+    /*
+     * Print statistics for each file type that has been encountered.
+     */
+    for (languageId = 0; languageId < CountOfLanguages; ++languageId) {
+        if (Records[languageId].CountOfFiles > 0) {
+            CliPrintEx(CLI_COLOR_GREEN,
+                       "%-25ls%10lu%15llu%15llu%17llu\n",
+                       Records[languageId].LanguageOrFileType,
+                       (unsigned long)Records[languageId].CountOfFiles,
+                       (unsigned long long)Records[languageId].Counts.CountOfLinesBlank,
+                       (unsigned long long)Records[languageId].Counts.CountOfLinesComment,
+                       (unsigned long long)Records[languageId].Counts.CountOfLinesTotal);
+        }
+    }
+
+    /*
+     * The table footer with total statistics.
+     */
+    CliPrintEx(CLI_COLOR_GREEN, "----------------------------------------------------------------------------------\n");
+    CliPrintEx(CLI_COLOR_GREEN,
+               "%-25s%10lu%15llu%15llu%17llu\n",
+               "Total:",
+               (unsigned long)Result->CountOfFiles,
+               (unsigned long long)Result->Counts.CountOfLinesBlank,
+               (unsigned long long)Result->Counts.CountOfLinesComment,
+               (unsigned long long)Result->Counts.CountOfLinesTotal);
+    CliPrintEx(CLI_COLOR_GREEN, "----------------------------------------------------------------------------------\n");
+}
+
+int
+wmain(
+    int argc,
+    wchar_t *argv[]
+    )
+{
+    int status = 0;
+    double startTime;
+    double endTime;
+    CODEMETER_SCAN_PARAMS scanParams = {0};
+    CODEMETER_RESULT result;
+    CODEMETER_RECORD *records = NULL;
+    uint32_t countOfLanguages;
+    const wchar_t **excludePatterns = NULL;
+    const wchar_t **includePatterns = NULL;
+    int index;
+#ifndef _WIN32
+    struct rlimit fileLimit;
+#endif
+
+#ifdef _WIN32
+    SupportAnsi = SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE),
+                                 ENABLE_PROCESSED_OUTPUT |
+                                 ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#else
+    SupportAnsi = isatty(STDOUT_FILENO);
+#endif
+
+    CliPrintEx(CLI_COLOR_GREEN, "%s", WelcomeString);
+
+    /*
+     * Process the command line arguments if any.
+     */
+
+    if (argc <= 1) {
+        /*
+         * The command line arguments were not passed at all, so show the
+         * instruction for use.
+         */
+        CliPrintEx(CLI_COLOR_GREEN, "%s", UsageString);
+        goto Exit;
+    }
+
+    if (wcscmp(argv[1], L"-help") == 0 ||
+        wcscmp(argv[1], L"-h") == 0 ||
+        wcscmp(argv[1], L"-?") == 0) {
+        /*
+         * The only command line argument passed was '-help', '-h', or '-?',
+         * so show the instruction for use.
+         */
+        CliPrintEx(CLI_COLOR_GREEN, "%s", UsageString);
+        goto Exit;
+    }
+
+    if (wcscmp(argv[1], L"-benchmark-lookup") == 0) {
+        /*
+         * Measure the per-file extension lookup instead of revising.
+         */
+        status = CodeMeterRunBenchmark(CodeMeterBenchmarkLookup) ? 0 : -1;
+        goto Exit;
+    }
+
+    if (wcscmp(argv[1], L"-benchmark-count") == 0) {
+        /*
+         * Measure the line counting kernels instead of revising.
+         */
+        status = CodeMeterRunBenchmark(CodeMeterBenchmarkCount) ? 0 : -1;
+        goto Exit;
+    }
+
+    /*
+     * The first argument is the path to the root revision directory:
+     */
+
+#ifdef _WIN32
+    if (wcscmp(argv[1], L".") == 0) {
+        /*
+         * If a dot was given, we need to revise the current directory.
+         * Let's find it. TODO.
+         */
+        assert(0);
+    }
+#endif
+
+    /*
+     * Every pattern is an argument of its own, so there are fewer patterns
+     * than arguments.
+     */
+    excludePatterns = (const wchar_t **)malloc(argc * sizeof(wchar_t *));
+    includePatterns = (const wchar_t **)malloc(argc * sizeof(wchar_t *));
+    if (excludePatterns == NULL || includePatterns == NULL) {
+        CliLogError("Failed to allocate the pattern arrays.");
+        status = -1;
+        goto Exit;
+    }
+
+    scanParams.ExcludePatterns = excludePatterns;
+    scanParams.IncludePatterns = includePatterns;
+
+    if (argc > 2) {
+        /*
+         * It is expected that in the case of multiple command line arguments:
+         *  1) The first argument is the path to the root revision directory.
+         *  2) The remaining parameters are for optional revision configuration
+         *     overrides.
+         *
+         * Process additional parameters. Once an option is handled, along
+         * with its value, the next argument is processed:
+         */
+
+        for (index = 2; index < argc; ++index) {
+
+            /*
+             * -v: Sets the IsVerboseMode configuration flag to TRUE.
+             */
+            if (wcscmp(argv[index], L"-v") == 0) {
+                scanParams.IsVerboseMode = 1;
+                continue;
+            }
+
+            /*
+             * -j N: Sets the number of enumerator threads.
+             */
+            if (wcscmp(argv[index], L"-j") == 0 && index + 1 < argc) {
+                scanParams.CountOfEnumerators = (uint32_t)wcstoul(argv[++index], NULL, 10);
+                continue;
+            }
+
+            /*
+             * -readers N: Sets the number of reader threads.
+             */
+            if (wcscmp(argv[index], L"-readers") == 0 && index + 1 < argc) {
+                scanParams.CountOfReaders = (uint32_t)wcstoul(argv[++index], NULL, 10);
+                continue;
+            }
+
+            /*
+             * -counters N: Sets the number of counter threads.
+             */
+            if (wcscmp(argv[index], L"-counters") == 0 && index + 1 < argc) {
+                scanParams.CountOfCounters = (uint32_t)wcstoul(argv[++index], NULL, 10);
+                continue;
+            }
+
+            /*
+             * -map-threshold N: Sets the size from which files are mapped.
+             */
+            if (wcscmp(argv[index], L"-map-threshold") == 0 && index + 1 < argc) {
+                scanParams.MapThreshold = wcstoull(argv[++index], NULL, 10);
+                continue;
+            }
+
+            /*
+             * -no-io-uring: Reads every file with blocking system calls.
+             */
+            if (wcscmp(argv[index], L"-no-io-uring") == 0) {
+                scanParams.IsIoUringDisabled = 1;
+                continue;
+            }
+
+            /*
+             * -cache FILE: Sets the scan cache file.
+             */
+            if (wcscmp(argv[index], L"-cache") == 0 && index + 1 < argc) {
+                scanParams.CacheFile = argv[++index];
+                continue;
+            }
+
+            /*
+             * -trust-directory-mtime: Replays unchanged directories from
+             * the scan cache.
+             */
+            if (wcscmp(argv[index], L"-trust-directory-mtime") == 0) {
+                scanParams.IsDirectoryTimeTrusted = 1;
+                continue;
+            }
+
+            /*
+             * -git-index: Counts the files tracked by the git index.
+             */
+            if (wcscmp(argv[index], L"-git-index") == 0) {
+                scanParams.IsGitIndexUsed = 1;
+                continue;
+            }
+
+            /*
+             * -files-from FILE, -files0-from FILE: Sets the file list and
+             * its separator.
+             */
+            if ((wcscmp(argv[index], L"-files-from") == 0 ||
+                 wcscmp(argv[index], L"-files0-from") == 0) &&
+                index + 1 < argc) {
+                scanParams.IsFileListNulSeparated =
+                    wcscmp(argv[index], L"-files0-from") == 0;
+                scanParams.FileList = argv[++index];
+                continue;
+            }
+
+            /*
+             * -exclude PATTERN, -include PATTERN: Adds an exclude or an
+             * include pattern.
+             */
+            if (wcscmp(argv[index], L"-exclude") == 0 && index + 1 < argc) {
+                excludePatterns[scanParams.CountOfExcludePatterns++] = argv[++index];
+                continue;
+            }
+
+            if (wcscmp(argv[index], L"-include") == 0 && index + 1 < argc) {
+                includePatterns[scanParams.CountOfIncludePatterns++] = argv[++index];
+                continue;
+            }
+
+            /*
+             * -gitignore: Honours the .gitignore files of the tree.
+             */
+            if (wcscmp(argv[index], L"-gitignore") == 0) {
+                scanParams.IsGitIgnoreUsed = 1;
+                continue;
+            }
+
+            /*
+             * -dedup: Counts files with the same contents once.
+             */
+            if (wcscmp(argv[index], L"-dedup") == 0) {
+                scanParams.IsContentDeduplicated = 1;
+                continue;
+            }
+
+            /*
+             * -follow-symlinks: Descends into symbolic links to directories.
+             */
+            if (wcscmp(argv[index], L"-follow-symlinks") == 0) {
+                scanParams.IsSymlinkFollowed = 1;
+                continue;
+            }
+
+            /*
+             * The argument is not an option, or is the last one and lacks
+             * the value of its option. Either way the command line is not
+             * what was meant, so show the instruction for use.
+             */
+            CliLogError("The option \"%ls\" is unknown or lacks its value.",
+                        argv[index]);
+            CliPrintEx(CLI_COLOR_GREEN, "%s", UsageString);
+            status = -1;
+            goto Exit;
+        }
+    }
+
+#ifndef NDEBUG
+    /*
+     * Always use verbose mode in debug builds.
+     */
+    scanParams.IsVerboseMode = 1;
+#endif
+
+#ifndef _WIN32
+    /*
+     * Every directory with pending entries keeps its descriptor open, so
+     * allow as many descriptors as the hard limit permits. This is left to
+     * the program, since the library must not change the limits of the
+     * process that hosts it.
+     */
+    if (getrlimit(RLIMIT_NOFILE, &fileLimit) == 0 &&
+        fileLimit.rlim_cur < fileLimit.rlim_max) {
+        fileLimit.rlim_cur = fileLimit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &fileLimit);
+    }
+#endif
+
+    /*
+     * Build the language tables before the time is measured.
+     */
+    countOfLanguages = CodeMeterGetCountOfLanguages();
+    if (countOfLanguages == 0) {
+        CliLogError("Failed to initialize the revision engine.");
+        status = -1;
+        goto Exit;
+    }
+
+    records = (CODEMETER_RECORD *)malloc(countOfLanguages * sizeof(CODEMETER_RECORD));
+    if (records == NULL) {
+        CliLogError("Failed to allocate the revision records.");
+        status = -1;
+        goto Exit;
+    }
+
+    startTime = CliQueryTime();
+
+    if (!CodeMeterScanTree(argv[1], &scanParams, &result, records)) {
+        /*
+         * N.B. The cause is only logged in verbose mode, so name the input
+         * that could not be read here.
+         */
+        if (scanParams.FileList != NULL) {
+            CliLogError("Failed to read the file list \"%ls\".",
+                        scanParams.FileList);
+        } else if (scanParams.IsGitIndexUsed) {
+            CliLogError("Failed to read the git index of \"%ls\".",
+                        argv[1]);
+        } else {
+            CliLogError("Failed to enumerate the directory \"%ls\".",
+                        argv[1]);
+        }
+        status = -1;
+        goto Exit;
+    }
+
+    endTime = CliQueryTime();
+
+    CliOutputRevisionStatistics(&result, records, countOfLanguages);
+
+    if (startTime >= 0 && endTime >= 0) {
+        CliPrintEx(CLI_COLOR_CYAN,
+                   "Time: %.3fs",
+                   endTime - startTime);
+    }
+
+    if (result.CountOfIgnoredFiles > 0) {
+        CliPrintEx(CLI_COLOR_CYAN,
+                   "\tIgnored %lu files",
+                   (unsigned long)result.CountOfIgnoredFiles);
+    }
+
+    if (result.CountOfDuplicateFiles > 0) {
+        CliPrintEx(CLI_COLOR_CYAN,
+                   "\tSkipped %lu duplicate files",
+                   (unsigned long)result.CountOfDuplicateFiles);
+    }
+
+    if (result.CountOfLinkedFiles > 0) {
+        CliPrintEx(CLI_COLOR_CYAN,
+                   "\tSkipped %lu linked files",
+                   (unsigned long)result.CountOfLinkedFiles);
+    }
+
+    CliPrintEx(CLI_COLOR_GREEN, "\n");
+
+#if defined(_WIN32) && !defined(NDEBUG)
+    system("pause");
+#endif
+
+Exit:
+    free(records);
+    free(excludePatterns);
+    free(includePatterns);
+
+    return status;
+}
+
+#ifndef _WIN32
+
+int
+main(
+    int argc,
+    char *argv[]
+    )
+{
+    int status;
+    int index;
+    size_t argumentLength;
+    wchar_t **wideArgv;
+
+    /*
+     * Use the user's locale, so that paths and output are converted
+     * between the native multibyte encoding and unicode correctly.
+     */
+    setlocale(LC_ALL, "");
+
+    wideArgv = (wchar_t **)calloc(argc + 1, sizeof(wchar_t *));
+    if (wideArgv == NULL) {
+        return -1;
+    }
+
+    for (index = 0; index < argc; ++index) {
+        argumentLength = mbstowcs(NULL, argv[index], 0);
+        if (argumentLength == (size_t)-1) {
+            fprintf(stderr, "Invalid multibyte sequence in argument #%d.\n", index);
+            status = -1;
+            goto Exit;
+        }
+
+        wideArgv[index] = (wchar_t *)malloc((argumentLength + 1) * sizeof(wchar_t));
+        if (wideArgv[index] == NULL) {
+            status = -1;
+            goto Exit;
+        }
+
+        mbstowcs(wideArgv[index], argv[index], argumentLength + 1);
+    }
+
+    status = wmain(argc, wideArgv);
+
+Exit:
+    for (index = 0; index < argc; ++index) {
+        free(wideArgv[index]);
+    }
+    free(wideArgv);
+
+    return status;
+}
+
+#endif